@@ -0,0 +1,234 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file lyr_freetype/glyphcache.cpp
+**	\brief Process-wide cache of glyph outlines
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cstdlib>
+
+#include "glyphcache.h"
+
+#include FT_OUTLINE_H
+
+#endif
+
+using namespace synfig;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+namespace {
+
+Vector
+to_vector(const FT_Vector *v)
+	{ return Vector((Real)v->x, (Real)v->y); }
+
+int
+outline_move_to(const FT_Vector *to, void *user)
+	{ ((rendering::Contour*)user)->move_to(to_vector(to)); return 0; }
+
+int
+outline_line_to(const FT_Vector *to, void *user)
+	{ ((rendering::Contour*)user)->line_to(to_vector(to)); return 0; }
+
+int
+outline_conic_to(const FT_Vector *control, const FT_Vector *to, void *user)
+	{ ((rendering::Contour*)user)->conic_to(to_vector(to), to_vector(control)); return 0; }
+
+int
+outline_cubic_to(const FT_Vector *control1, const FT_Vector *control2, const FT_Vector *to, void *user)
+	{ ((rendering::Contour*)user)->cubic_to(to_vector(to), to_vector(control1), to_vector(control2)); return 0; }
+
+//! Approximate memory of map node and usage list node for each entry
+const size_t entry_overhead = 128;
+
+} // end of anonimous namespace
+
+/* === M E T H O D S ======================================================= */
+
+const size_t GlyphCache::default_memory_budget = 32*1024*1024;
+
+GlyphCache::Glyph::~Glyph()
+{
+	// FreeType calls are guarded by mutex of cache, glyphs are released under it too
+	if (bitmap) FT_Done_Glyph(bitmap);
+}
+
+size_t
+GlyphCache::Glyph::get_memory() const
+{
+	size_t memory = sizeof(*this) + chunks.capacity()*sizeof(rendering::Contour::Chunk) + entry_overhead;
+	if (bitmap && bitmap->format == FT_GLYPH_FORMAT_BITMAP) {
+		const FT_Bitmap &b = ((FT_BitmapGlyph)bitmap)->bitmap;
+		memory += sizeof(FT_BitmapGlyphRec) + (size_t)b.rows*(size_t)std::abs(b.pitch);
+	}
+	return memory;
+}
+
+bool
+GlyphCache::Key::operator<(const Key &other) const
+{
+	if (face != other.face) return face < other.face;
+	if (glyph_index != other.glyph_index) return glyph_index < other.glyph_index;
+	if (x_scale != other.x_scale) return x_scale < other.x_scale;
+	if (y_scale != other.y_scale) return y_scale < other.y_scale;
+	return hinting < other.hinting;
+}
+
+GlyphCache::GlyphCache():
+	memory_budget(default_memory_budget)
+{ }
+
+GlyphCache&
+GlyphCache::instance()
+{
+	static GlyphCache cache;
+	return cache;
+}
+
+void
+GlyphCache::trim()
+{
+	while(statistics.memory > memory_budget && !usage.empty()) {
+		EntryMap::iterator i = entries.find(usage.back());
+		statistics.memory -= i->second.glyph->get_memory();
+		--statistics.count;
+		++statistics.evictions;
+		entries.erase(i);
+		usage.pop_back();
+	}
+}
+
+GlyphCache::Glyph::Handle
+GlyphCache::get(FT_Face face, FT_UInt glyph_index, bool scaled, bool hinting)
+{
+	if (!face) return Glyph::Handle();
+
+	Key key;
+	key.face = face;
+	key.glyph_index = glyph_index;
+	// bitmap fonts have no outlines, so their glyphs are loaded as before the cache
+	const bool bitmap = scaled && !FT_IS_SCALABLE(face);
+	key.x_scale = !scaled || !face->size ? 0 : bitmap ? face->size->metrics.x_ppem : face->size->metrics.x_scale;
+	key.y_scale = !scaled || !face->size ? 0 : bitmap ? face->size->metrics.y_ppem : face->size->metrics.y_scale;
+	key.hinting = scaled && hinting;
+
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+
+	EntryMap::iterator i = entries.find(key);
+	if (i != entries.end()) {
+		++statistics.hits;
+		usage.splice(usage.begin(), usage, i->second.usage);
+		return i->second.glyph;
+	}
+	++statistics.misses;
+
+	FT_Int32 flags = !scaled ? FT_LOAD_NO_SCALE
+	               : bitmap  ? FT_LOAD_DEFAULT
+	               : hinting ? FT_LOAD_DEFAULT|FT_LOAD_NO_BITMAP
+	               : FT_LOAD_DEFAULT|FT_LOAD_NO_BITMAP|FT_LOAD_NO_HINTING;
+	if (FT_Load_Glyph(face, glyph_index, flags))
+		return Glyph::Handle();
+
+	FT_GlyphSlot slot = face->glyph;
+	etl::handle<Glyph> glyph(new Glyph());
+	glyph->advance = slot->advance;
+
+	if (slot->format == FT_GLYPH_FORMAT_BITMAP) {
+		if (FT_Get_Glyph(slot, &glyph->bitmap))
+			return Glyph::Handle();
+		FT_BBox bbox;
+		FT_Glyph_Get_CBox(glyph->bitmap, FT_GLYPH_BBOX_SUBPIXELS, &bbox);
+		glyph->y_max = bbox.yMax;
+	} else
+	if (slot->format == FT_GLYPH_FORMAT_OUTLINE && slot->outline.n_points > 0) {
+		FT_BBox bbox;
+		FT_Outline_Get_CBox(&slot->outline, &bbox);
+		glyph->y_max = bbox.yMax;
+
+		FT_Outline_Funcs funcs;
+		funcs.move_to = &outline_move_to;
+		funcs.line_to = &outline_line_to;
+		funcs.conic_to = &outline_conic_to;
+		funcs.cubic_to = &outline_cubic_to;
+		funcs.shift = 0;
+		funcs.delta = 0;
+
+		rendering::Contour contour;
+		FT_Outline_Decompose(&slot->outline, &funcs, &contour);
+		contour.close();
+		glyph->chunks = contour.get_chunks();
+	}
+
+	Entry &entry = entries[key];
+	entry.glyph = glyph;
+	usage.push_front(key);
+	entry.usage = usage.begin();
+	++statistics.count;
+	statistics.memory += glyph->get_memory();
+	trim();
+
+	return glyph;
+}
+
+void
+GlyphCache::set_memory_budget(size_t bytes)
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	memory_budget = bytes;
+	trim();
+}
+
+size_t
+GlyphCache::get_memory_budget()
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	return memory_budget;
+}
+
+GlyphCache::Statistics
+GlyphCache::get_statistics()
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	return statistics;
+}
+
+void
+GlyphCache::clear()
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	entries.clear();
+	usage.clear();
+	statistics.count = 0;
+	statistics.memory = 0;
+}
+
+/* === E N T R Y P O I N T ================================================= */
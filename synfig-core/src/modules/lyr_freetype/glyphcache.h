@@ -0,0 +1,149 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file lyr_freetype/glyphcache.h
+**	\brief Process-wide cache of glyph outlines
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_LYR_FREETYPE_GLYPHCACHE_H
+#define __SYNFIG_LYR_FREETYPE_GLYPHCACHE_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <mutex>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_GLYPH_H
+
+#include <synfig/rendering/primitive/contour.h>
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+//! Outlines of glyphs shared by all text layers, so layers with the same font
+//! don't load and convert the same glyphs again on each render.
+//! Glyphs are keyed by face, scale of face, glyph index and hinting,
+//! least recently used glyphs are dropped when memory budget is exceeded.
+class GlyphCache
+{
+public:
+	class Glyph: public etl::shared_object
+	{
+	public:
+		typedef etl::handle<const Glyph> Handle;
+
+		//! outline in units of loaded glyph: 26.6 pixels for scaled glyphs, font units otherwise
+		synfig::rendering::Contour::ChunkList chunks;
+		//! image of glyph of non-scalable face, which has no outlines
+		FT_Glyph bitmap;
+		FT_Vector advance;
+		//! top of control box of outline
+		FT_Pos y_max;
+
+		Glyph(): bitmap(), advance(), y_max() { }
+		~Glyph();
+		size_t get_memory() const;
+
+	private:
+		Glyph(const Glyph&) = delete;
+		Glyph& operator=(const Glyph&) = delete;
+	};
+
+	struct Statistics
+	{
+		long long hits;
+		long long misses;
+		long long evictions;
+		size_t count;
+		size_t memory;
+
+		Statistics(): hits(), misses(), evictions(), count(), memory() { }
+		double hit_rate() const
+			{ return hits + misses > 0 ? double(hits)/double(hits + misses) : 0.0; }
+	};
+
+	static const size_t default_memory_budget;
+
+private:
+	struct Key
+	{
+		FT_Face face;
+		//! ppem for non-scalable faces
+		FT_Fixed x_scale, y_scale;
+		FT_UInt glyph_index;
+		bool hinting;
+
+		bool operator<(const Key &other) const;
+	};
+
+	struct Entry
+	{
+		Glyph::Handle glyph;
+		std::list<Key>::iterator usage;
+	};
+
+	typedef std::map<Key, Entry> EntryMap;
+
+	std::recursive_mutex mutex;
+	EntryMap entries;
+	//! keys from most to least recently used
+	std::list<Key> usage;
+	size_t memory_budget;
+	Statistics statistics;
+
+	GlyphCache();
+	GlyphCache(const GlyphCache&) = delete;
+	GlyphCache& operator=(const GlyphCache&) = delete;
+
+	void trim();
+
+public:
+	static GlyphCache& instance();
+
+	//! FreeType faces are not thread-safe, all code which uses faces
+	//! (including calls of get()) should hold this mutex
+	std::recursive_mutex& get_mutex() { return mutex; }
+
+	//! Returns glyph from cache or loads it from face.
+	//! Scaled glyphs are loaded with current size of face, in 26.6 pixels,
+	//! unscaled ones are loaded in font units without hinting.
+	//! Scaled glyphs of non-scalable faces are loaded as bitmaps.
+	//! Returns null handle when glyph can not be loaded.
+	Glyph::Handle get(FT_Face face, FT_UInt glyph_index, bool scaled, bool hinting);
+
+	//! Budget is set from environment variable SYNFIG_GLYPH_CACHE_SIZE (in megabytes)
+	//! when module is loaded, zero disables the cache
+	void set_memory_budget(size_t bytes);
+	size_t get_memory_budget();
+
+	Statistics get_statistics();
+	void clear();
+};
+
+/* === E N D =============================================================== */
+
+#endif
@@ -42,6 +42,7 @@
 #include <pango/pangocairo.h>
 
 #include "lyr_freetype.h"
+#include "glyphcache.h"
 
 #include <synfig/localization.h>
 #include <synfig/general.h>
@@ -51,6 +52,9 @@
 
 #include <synfig/context.h>
 
+#include <synfig/rendering/common/task/taskcontour.h>
+#include <synfig/rendering/software/function/contour.h>
+
 //#ifdef __APPLE__
 //#define USE_MAC_FT_FUNCS	(1)
 //#endif
@@ -122,7 +126,7 @@ extern FT_Library ft_library;
 
 struct Glyph
 {
-	FT_Glyph glyph;
+	GlyphCache::Glyph::Handle glyph;
 	FT_Vector pos;
 	//int width;
 };
@@ -133,7 +137,6 @@ struct TextLine
 	std::vector<Glyph> glyph_table;
 
 	TextLine():width(0) { }
-	void clear_and_free();
 
 	int actual_height()const
 	{
@@ -141,19 +144,47 @@ struct TextLine
 
 		std::vector<Glyph>::const_iterator iter;
 		for(iter=glyph_table.begin();iter!=glyph_table.end();++iter)
-		{
-			FT_BBox   glyph_bbox;
-
-			//FT_Glyph_Get_CBox( glyphs[n], ft_glyph_bbox_pixels, &glyph_bbox );
-			FT_Glyph_Get_CBox( iter->glyph, ft_glyph_bbox_subpixels, &glyph_bbox );
-
-			if(glyph_bbox.yMax>height)
-				height=glyph_bbox.yMax;
-		}
+			if(iter->glyph->y_max>height)
+				height=iter->glyph->y_max;
 		return height;
 	}
 };
 
+//! Blends bitmap of glyph of non-scalable face into surface,
+//! such fonts have no outlines to be rendered as contour
+static void
+blit_glyph_bitmap(
+	Surface &surface,
+	const Surface &src_surface,
+	FT_Glyph image,
+	const FT_Vector &pen,
+	int sign_y,
+	bool invert,
+	const Color &color,
+	Real amount,
+	Color::BlendMethod blend_method )
+{
+	if (!image || image->format != FT_GLYPH_FORMAT_BITMAP)
+		return;
+	FT_BitmapGlyph bit = (FT_BitmapGlyph)image;
+	for(int v=0;v<(int)bit->bitmap.rows;v++)
+		for(int u=0;u<(int)bit->bitmap.width;u++)
+		{
+			int x=u+((pen.x+32)>>6)+ bit->left;
+			int y=((pen.y+32)>>6) + (bit->top - v) * sign_y;
+			if(	y>=0 &&
+				x>=0 &&
+				y<surface.get_h() &&
+				x<surface.get_w())
+			{
+				Real myamount=(Real)bit->bitmap.buffer[v*bit->bitmap.pitch+u]/255.0f;
+				if(invert)
+					myamount=1.0f-myamount;
+				surface[y][x]=Color::blend(color,src_surface[y][x],myamount*amount,blend_method);
+			}
+		}
+}
+
 #ifdef WITH_FONTCONFIG
 // Allow proper finalization of FontConfig
 struct FontConfigWrap {
@@ -264,21 +295,52 @@ private:
 
 /* === P R O C E D U R E S ================================================= */
 
-/*Glyph::~Glyph()
-{
-	if(glyph)FT_Done_Glyph(glyph);
-}
-*/
-void
-TextLine::clear_and_free()
+//! Decodes utf-8 text into character codes, bad characters are skipped
+static void
+decode_utf8(const String &text, std::vector<unsigned int> &codes)
 {
-	std::vector<Glyph>::iterator iter;
-	for(iter=glyph_table.begin();iter!=glyph_table.end();++iter)
+	for (string::const_iterator iter=text.begin(); iter!=text.end(); ++iter)
 	{
-		if(iter->glyph)FT_Done_Glyph(iter->glyph);
-		iter->glyph=0;
+		unsigned int c = (unsigned char)*iter;
+		unsigned int code = c;
+		int bytes = 0;
+		while ((c & 0x80) != 0) { c = (c << 1) & 0xff; bytes++; }
+		bool bad_char = (bytes == 1);
+		if (bytes > 1)
+		{
+			bytes--;
+			code = c << (5*bytes - 1);
+			while (bytes > 0) {
+				iter++;
+				bytes--;
+				if (iter >= text.end()) { bad_char = true; --iter; break; }
+				c = (unsigned char)*iter;
+				if ((c & 0xc0) != 0x80) { bad_char = true; break; }
+				code |= (c & 0x3f) << (6 * bytes);
+			}
+		}
+
+		if (bad_char)
+		{
+			synfig::warning("Layer_Freetype: multibyte: %s",
+							_("Can't parse multibyte character.\n"));
+			continue;
+		}
+
+		codes.push_back(code);
 	}
-	glyph_table.clear();
+}
+
+//! Appends outline of cached glyph transformed by matrix to contour
+static void
+add_glyph(rendering::Contour &contour, const rendering::Contour::ChunkList &chunks, const Matrix &matrix)
+{
+	for(rendering::Contour::ChunkList::const_iterator i = chunks.begin(); i != chunks.end(); ++i)
+		contour.add_chunk(rendering::Contour::Chunk(
+			i->type,
+			matrix.get_transformed(i->p1),
+			matrix.get_transformed(i->pp0),
+			matrix.get_transformed(i->pp1) ));
 }
 
 static bool
@@ -977,8 +1039,6 @@ Layer_Freetype::accelerated_render(Context context,Surface *surface,int quality,
 	synfig::Point origin=param_origin.get(Point());
 	synfig::Vector orient=param_orient.get(Vector());
 
-	static std::recursive_mutex freetype_mutex;
-
 	if(needs_sync_)
 		const_cast<Layer_Freetype*>(this)->sync();
 
@@ -998,11 +1058,7 @@ Layer_Freetype::accelerated_render(Context context,Surface *surface,int quality,
 		return true;
 	}
 
-	String text(Layer_Freetype::param_text.get(synfig::String()));
-	if(text=="@_FILENAME_@" && get_canvas() && !get_canvas()->get_file_name().empty())
-	{
-		text=basename(get_canvas()->get_file_name());
-	}
+	String text(get_text());
 
 	// Width and Height of a pixel
 	Vector::value_type pw=renddesc.get_w()/(renddesc.get_br()[0]-renddesc.get_tl()[0]);
@@ -1019,7 +1075,8 @@ Layer_Freetype::accelerated_render(Context context,Surface *surface,int quality,
 		return true;
 	}
 
-	std::lock_guard<std::recursive_mutex> lock(freetype_mutex);
+	GlyphCache &glyph_cache = GlyphCache::instance();
+	std::lock_guard<std::recursive_mutex> lock(glyph_cache.get_mutex());
 
 #define CHAR_RESOLUTION		(64)
 	error = FT_Set_Char_Size(
@@ -1042,10 +1099,8 @@ Layer_Freetype::accelerated_render(Context context,Surface *surface,int quality,
 		if(cb)cb->warning(string("Layer_Freetype:")+_("Unable to set face size.")+strprintf(" (err=%d)",error));
 	}
 
-	FT_GlyphSlot  slot = face->glyph;  // a small shortcut
 	FT_UInt       glyph_index(0);
 	FT_UInt       previous(0);
-	int u,v;
 
 	std::list<TextLine> lines;
 
@@ -1053,15 +1108,14 @@ Layer_Freetype::accelerated_render(Context context,Surface *surface,int quality,
  --	** -- CREATE GLYPHS -------------------------------------------------------
 	*/
 
-	mbstate_t ps;
-	memset(&ps, 0, sizeof(ps));
+	std::vector<unsigned int> codes;
+	decode_utf8(text, codes);
 
 	lines.push_front(TextLine());
-	string::const_iterator iter;
 	int bx=0;
 	int by=0;
 
-	for (iter=text.begin(); iter!=text.end(); ++iter)
+	for (std::vector<unsigned int>::const_iterator iter=codes.begin(); iter!=codes.end(); ++iter)
 	{
 		int multiplier(1);
 		if(*iter=='\n')
@@ -1079,33 +1133,7 @@ Layer_Freetype::accelerated_render(Context context,Surface *surface,int quality,
 		}
 		else
 		{
-			// read uft8 char
-			unsigned int c = (unsigned char)*iter;
-			unsigned int code = c;
-			int bytes = 0;
-			while ((c & 0x80) != 0) { c = (c << 1) & 0xff; bytes++; }
-			bool bad_char = (bytes == 1);
-			if (bytes > 1)
-			{
-				bytes--;
-				code = c << (5*bytes - 1);
-				while (bytes > 0) {
-					iter++;
-					bytes--;
-					c = (unsigned char)*iter;
-					if (iter >= text.end() || (c & 0xc0) != 0x80) { bad_char = true; break; }
-					code |= (c & 0x3f) << (6 * bytes);
-				}
-			}
-
-			if (bad_char)
-			{
-				synfig::warning("Layer_Freetype: multibyte: %s",
-								_("Can't parse multibyte character.\n"));
-				continue;
-			}
-
-			glyph_index = FT_Get_Char_Index( face, code );
+			glyph_index = FT_Get_Char_Index( face, *iter );
 		}
 
         // retrieve kerning distance and move pen position
@@ -1136,32 +1164,26 @@ Layer_Freetype::accelerated_render(Context context,Surface *surface,int quality,
         curr_glyph.pos.x = bx;
         curr_glyph.pos.y = by;
 
-        // load glyph image into the slot. DO NOT RENDER IT !!
-        if(grid_fit)
-			error = FT_Load_Glyph( face, glyph_index, FT_LOAD_DEFAULT);
-		else
-			error = FT_Load_Glyph( face, glyph_index, FT_LOAD_DEFAULT|FT_LOAD_NO_HINTING );
-        if (error) continue;  // ignore errors, jump to next glyph
-
-        // extract glyph image and store it in our table
-        error = FT_Get_Glyph( face->glyph, &curr_glyph.glyph );
-        if (error) continue;  // ignore errors, jump to next glyph
+        // take outline of glyph from cache, it is loaded only at first use
+        curr_glyph.glyph = glyph_cache.get(face, glyph_index, true, grid_fit);
+        if (!curr_glyph.glyph) continue;  // ignore errors, jump to next glyph
+        const FT_Vector &advance = curr_glyph.glyph->advance;
 
         // record current glyph index
         previous = glyph_index;
 
 		// Update the line width
-		lines.front().width=bx+slot->advance.x;
+		lines.front().width=bx+advance.x;
 
 		// increment pen position
 		if(multiplier>1)
-			bx += round_to_int(slot->advance.x*multiplier*compress)-bx%round_to_int(slot->advance.x*multiplier*compress);
+			bx += round_to_int(advance.x*multiplier*compress)-bx%round_to_int(advance.x*multiplier*compress);
 		else
-			bx += round_to_int(slot->advance.x*compress*multiplier);
+			bx += round_to_int(advance.x*compress*multiplier);
 
 		//bx += round_to_int(slot->advance.x*compress*multiplier);
 		//by += round_to_int(slot->advance.y*compress);
-		by += slot->advance.y*multiplier;
+		by += advance.y*multiplier;
 
 		lines.front().glyph_table.push_back(curr_glyph);
 
@@ -1186,26 +1208,26 @@ Layer_Freetype::accelerated_render(Context context,Surface *surface,int quality,
 	//synfig::info("line_height=%f",line_height);
 
 	/*
- --	** -- RENDER THE GLYPHS ---------------------------------------------------
+ --	** -- PLACE THE GLYPHS ----------------------------------------------------
 	*/
 
-	Surface src_;
-	Surface *src_surface;
-
-	src_surface=surface;
+	rendering::Contour contour;
 
-	if(invert)
+	// glyphs of non-scalable faces are bitmaps, they are blended
+	// into surface directly, as text was rendered before outlines
+	const bool bitmaps = !FT_IS_SCALABLE(face);
+	Surface src_;
+	Surface *src_surface = surface;
+	if (bitmaps && invert)
 	{
 		src_=*surface;
 		Surface::alpha_pen pen(surface->begin(),get_amount(),get_blend_method());
-
 		surface->fill(color,pen,src_.get_w(),src_.get_h());
-
 		src_surface=&src_;
 	}
 
+	int sign_y = ph >= 0.0 ? 1 : -1;
 	{
-		int sign_y = ph >= 0.0 ? 1 : -1;
 		Real offset_x = (origin[0]-renddesc.get_tl()[0])*pw*CHAR_RESOLUTION;
 		Real offset_y = (origin[1]-renddesc.get_tl()[1])*ph*CHAR_RESOLUTION
 				      - sign_y*text_height*(1.0 - orient[1]);
@@ -1220,58 +1242,213 @@ Layer_Freetype::accelerated_render(Context context,Surface *surface,int quality,
 			// the .bmp format describing the image from bottom to top,
 			// renders text in the wrong place.
 			by=round_to_int(offset_y + sign_y*curr_line*line_height);
-			/*
-			by=round_to_int((origin[1]-renddesc.get_tl()[1])*ph*CHAR_RESOLUTION +
-							(1.0-orient[1])*string_height +
-							(ph>0 ? line_height*(lines.size()-1-curr_line)-lines.back().actual_height(): -line_height*curr_line));
-			*/
-
-			//by=round_to_int(vcompress*((origin[1]-renddesc.get_tl()[1])*ph*64+(1.0-orient[1])*string_height-face->size->metrics.height*curr_line));
-			//synfig::info("curr_line=%d, bx=%d, by=%d",curr_line,bx,by);
 
 			std::vector<Glyph>::iterator iter2;
 			for(iter2=iter->glyph_table.begin();iter2!=iter->glyph_table.end();++iter2)
 			{
-				FT_Glyph  image(iter2->glyph);
 				FT_Vector pen;
-				FT_BitmapGlyph  bit;
-
 				pen.x = bx + iter2->pos.x;
 				pen.y = by + iter2->pos.y;
 
-				//synfig::info("GLYPH: line %d, pen.x=%d, pen,y=%d",curr_line,(pen.x+32)>>6,(pen.y+32)>>6);
-
-				error = FT_Glyph_To_Bitmap( &image, ft_render_mode_normal,0/*&pen*/, 1 );
-				if(error) { FT_Done_Glyph( image ); continue; }
-
-				bit = (FT_BitmapGlyph)image;
-
-				for(v=0;v<(int)bit->bitmap.rows;v++)
-					for(u=0;u<(int)bit->bitmap.width;u++)
-					{
-						int x=u+((pen.x+32)>>6)+ bit->left;
-						int y=((pen.y+32)>>6) + (bit->top - v) * sign_y;
-						if(	y>=0 &&
-							x>=0 &&
-							y<surface->get_h() &&
-							x<surface->get_w())
-						{
-							Real myamount=(Real)bit->bitmap.buffer[v*bit->bitmap.pitch+u]/255.0f;
-							if(invert)
-								myamount=1.0f-myamount;
-							(*surface)[y][x]=Color::blend(color,(*src_surface)[y][x],myamount*get_amount(),get_blend_method());
-						}
-					}
-
-				FT_Done_Glyph( image );
+				if (bitmaps)
+				{
+					blit_glyph_bitmap(*surface, *src_surface, iter2->glyph->bitmap, pen, sign_y,
+						invert, color, get_amount(), get_blend_method());
+					continue;
+				}
+
+				// glyphs are placed at whole pixels as FreeType bitmaps were,
+				// outlines are in 26.6 pixels with y axis directed up
+				Matrix matrix;
+				matrix.m00 = 1.0/CHAR_RESOLUTION;
+				matrix.m11 = sign_y/(Real)CHAR_RESOLUTION;
+				matrix.m20 = (pen.x+32)>>6;
+				matrix.m21 = (pen.y+32)>>6;
+				add_glyph(contour, iter2->glyph->chunks, matrix);
 			}
-			//iter->clear_and_free();
 		}
 	}
 
+	/*
+ --	** -- RENDER THE GLYPHS ---------------------------------------------------
+	*/
+
+	if (bitmaps)
+		return true;
+
+	rendering::software::Contour::render_contour(
+		*surface,
+		contour.get_chunks(),
+		invert,
+		true,
+		rendering::Contour::WINDING_NON_ZERO,
+		Matrix(),
+		color,
+		get_amount(),
+		get_blend_method() );
+
 	return true;
 }
 
+String
+Layer_Freetype::get_text()const
+{
+	String text(param_text.get(synfig::String()));
+	if(text=="@_FILENAME_@" && get_canvas() && !get_canvas()->get_file_name().empty())
+		text=basename(get_canvas()->get_file_name());
+	return text;
+}
+
+/*! Places unhinted glyphs in font units, the same way as accelerated_render()
+**	places them in pixels, and returns matrix from font units to layer units.
+**	Outlines don't depend on resolution here, so the contour is rendered
+**	by TaskContour and may be split between threads.
+*/
+Matrix
+Layer_Freetype::build_contour(rendering::Contour &contour)const
+{
+	bool use_kerning=param_use_kerning.get(bool());
+	synfig::Point origin=param_origin.get(Point());
+	synfig::Vector orient=param_orient.get(Vector());
+	Vector size(param_size.get(synfig::Vector())*2);
+
+	// the same as compensation in accelerated_render() for ideal ppem
+	const Real error_compensation = (72.0/64.0)/1.13f/0.996;
+	const Real compress(param_compress.get(Real())*error_compensation);
+	const Real vcompress(param_vcompress.get(Real())*error_compensation);
+
+	String text(get_text());
+	if(!face || !FT_IS_SCALABLE(face) || text.empty())
+		return Matrix();
+
+	GlyphCache &glyph_cache = GlyphCache::instance();
+	std::lock_guard<std::recursive_mutex> lock(glyph_cache.get_mutex());
+
+	struct PlacedGlyph {
+		GlyphCache::Glyph::Handle glyph;
+		Vector pos;
+	};
+	struct Line {
+		Real width;
+		FT_Pos height;
+		std::vector<PlacedGlyph> glyphs;
+		Line(): width(), height() { }
+	};
+
+	std::vector<unsigned int> codes;
+	decode_utf8(text, codes);
+
+	std::vector<Line> lines(1);
+	FT_UInt glyph_index(0);
+	FT_UInt previous(0);
+	Real bx=0.0;
+	Real by=0.0;
+
+	for (std::vector<unsigned int>::const_iterator iter=codes.begin(); iter!=codes.end(); ++iter)
+	{
+		int multiplier(1);
+		if(*iter=='\n')
+		{
+			lines.push_back(Line());
+			bx=0.0;
+			by=0.0;
+			previous=0;
+			continue;
+		}
+		if(*iter=='\t')
+		{
+			multiplier=8;
+			glyph_index = FT_Get_Char_Index( face, ' ' );
+		}
+		else
+		{
+			glyph_index = FT_Get_Char_Index( face, *iter );
+		}
+
+		if ( FT_HAS_KERNING(face) && use_kerning && previous && glyph_index )
+		{
+			FT_Vector delta;
+			FT_Get_Kerning( face, previous, glyph_index, FT_KERNING_UNSCALED, &delta );
+			Real k = compress < 1.0 ? compress : 1.0;
+			bx += delta.x*k;
+			by += delta.y*k;
+		}
+
+		PlacedGlyph placed;
+		placed.pos = Vector(bx, by);
+		placed.glyph = glyph_cache.get(face, glyph_index, false, false);
+		if (!placed.glyph) continue;
+		const FT_Vector &advance = placed.glyph->advance;
+
+		previous = glyph_index;
+
+		Line &line = lines.back();
+		line.width = bx + advance.x;
+		line.height = std::max(line.height, placed.glyph->y_max);
+
+		if(multiplier>1)
+		{
+			// tab stops
+			Real tab = advance.x*multiplier*compress;
+			if (tab > 0.0) bx += tab - fmod(bx, tab);
+		}
+		else
+		{
+			bx += advance.x*compress;
+		}
+		by += advance.y*multiplier;
+
+		line.glyphs.push_back(placed);
+	}
+
+	Real line_height = vcompress*(Real)face->height;
+	Real text_height = (lines.size() - 1)*line_height + (Real)lines.front().height;
+
+	for(size_t i = 0; i < lines.size(); ++i)
+	{
+		const Line &line = lines[i];
+		Vector offset(
+			-orient[0]*line.width,
+			-text_height*(1.0 - orient[1]) + (Real)(lines.size() - 1 - i)*line_height );
+		for(std::vector<PlacedGlyph>::const_iterator j = line.glyphs.begin(); j != line.glyphs.end(); ++j)
+			add_glyph(contour, j->glyph->chunks, Matrix().set_translate(offset + j->pos));
+	}
+
+	// font size is one point at resolution of size*64 dots per unit,
+	// see FT_Set_Char_Size() in accelerated_render()
+	Real units_per_em = face->units_per_EM > 0 ? (Real)face->units_per_EM : 1.0;
+	Matrix scale;
+	scale.set_scale(
+		std::fabs(size[0])*64.0/72.0/units_per_em,
+		std::fabs(size[1])*64.0/72.0/units_per_em );
+	return Matrix().set_translate(origin)*scale;
+}
+
+rendering::Task::Handle
+Layer_Freetype::build_composite_task_vfunc(ContextParams context_params)const
+{
+	if(needs_sync_)
+		const_cast<Layer_Freetype*>(this)->sync();
+
+	// hinting depends on resolution, which is unknown here,
+	// so grid-fitted text is still rendered by accelerated_render(),
+	// as well as text of bitmap fonts
+	if (param_grid_fit.get(bool()) || (face && !FT_IS_SCALABLE(face)))
+		return Layer_Composite::build_composite_task_vfunc(context_params);
+
+	rendering::TaskContour::Handle task(new rendering::TaskContour());
+	task->contour = new rendering::Contour();
+	task->contour->color = param_color.get(Color());
+	task->contour->invert = param_invert.get(bool());
+	task->contour->antialias = true;
+	task->contour->winding_style = rendering::Contour::WINDING_NON_ZERO;
+	// each row of text crosses edges of many glyphs, so sorting of marks
+	// costs more than the buffer for bounds of text
+	task->rasterizer = rendering::TaskContour::RASTERIZER_ACCUMULATION;
+	task->transformation->matrix = build_contour(*task->contour);
+	return task;
+}
+
 ////
 bool
 Layer_Freetype::accelerated_cairorender(Context context, cairo_t *cr, int quality, const RendDesc &renddesc, ProgressCallback *cb)const
@@ -32,6 +32,7 @@
 /* === H E A D E R S ======================================================= */
 
 #include <synfig/layers/layer_composite.h>
+#include <synfig/rendering/primitive/contour.h>
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
@@ -87,6 +88,8 @@ private:
 	void sync();
 
 	synfig::Color color_func(const synfig::Point &x, int quality=10, synfig::ColorReal supersample=0)const;
+	synfig::String get_text()const;
+	synfig::Matrix build_contour(synfig::rendering::Contour &contour)const;
 
 	mutable std::mutex mutex;
 
@@ -108,6 +111,9 @@ public:
 
 	virtual synfig::Rect get_bounding_rect()const;
 
+protected:
+	virtual synfig::rendering::Task::Handle build_composite_task_vfunc(synfig::ContextParams context_params)const;
+
 private:
 	void new_font(const synfig::String &family, int style=0, int weight=400);
 	bool new_font_(const synfig::String &family, int style=0, int weight=400);
@@ -38,8 +38,11 @@
 #include <synfig/general.h>
 
 #include <string.h>
+#include <stdlib.h>
+#include <algorithm>
 #include <synfig/module.h>
 #include "lyr_freetype.h"
+#include "glyphcache.h"
 #include <iostream>
 #include <ETL/stringf>
 
@@ -65,11 +68,21 @@ bool freetype_constructor(synfig::ProgressCallback *cb)
 		if(cb)cb->error(strprintf("Layer_Freetype: FreeType initialization failed. (err=%d)",error));
 		return false;
 	}
+
+	if (const char *s = getenv("SYNFIG_GLYPH_CACHE_SIZE"))
+		GlyphCache::instance().set_memory_budget((size_t)std::max(0, atoi(s))*1024*1024);
 	return true;
 }
 
 void freetype_destructor()
 {
+	GlyphCache::Statistics statistics = GlyphCache::instance().get_statistics();
+	if (statistics.hits + statistics.misses > 0)
+		synfig::info("Layer_Freetype: glyph cache: %lld hits, %lld misses (hit rate %.1f%%), %lld evictions, %d glyphs, %d of %d KiB",
+			statistics.hits, statistics.misses, statistics.hit_rate()*100.0, statistics.evictions,
+			(int)statistics.count, (int)(statistics.memory/1024), (int)(GlyphCache::instance().get_memory_budget()/1024));
+	GlyphCache::instance().clear();
+
 	FT_Done_FreeType(ft_library);
 	std::cerr<<"freetype_destructor()"<<std::endl;
 }
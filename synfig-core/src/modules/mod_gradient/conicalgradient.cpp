@@ -44,6 +44,7 @@
 #include <synfig/angle.h>
 
 #include "conicalgradient.h"
+#include "taskgradient.h"
 
 #endif
 
@@ -64,6 +65,32 @@ SYNFIG_LAYER_SET_CVS_ID(ConicalGradient,"$Id$");
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+class ConicalShape: public GradientShape
+{
+public:
+	Point center;
+	Angle angle;
+
+	virtual void fill_row(Real *positions, Real *widths, int count, const Point &p, const Vector &dx, const Vector &pixel_size) const
+	{
+		// see ConicalGradient::color_func and ConicalGradient::calc_supersample
+		Real half_pw = 0.5*pixel_size[0];
+		Real half_ph = 0.5*pixel_size[1];
+		Point centered = p - center;
+		for(int i = 0; i < count; ++i, centered += dx) {
+			Angle::rot a = Angle::tan(-centered[1], centered[0]).mod();
+			a += angle;
+			positions[i] = a.mod().get();
+			widths[i] = fabs(centered[0]) < half_pw && fabs(centered[1]) < half_ph
+			          ? 0.25 : half_pw/(centered.mag()*PI*2);
+		}
+	}
+};
+
+} // end of anonimous namespace
+
 /* === M E T H O D S ======================================================= */
 
 /* === E N T R Y P O I N T ================================================= */
@@ -439,3 +466,16 @@ ConicalGradient::compile_mesh(cairo_pattern_t* pattern, Gradient mygradient, Rea
 	}
 	return cpoints_all_opaque;
 }
+
+rendering::Task::Handle
+ConicalGradient::build_composite_task_vfunc(ContextParams /* context_params */)const
+{
+	etl::handle<ConicalShape> shape(new ConicalShape());
+	shape->center = param_center.get(Point());
+	shape->angle = param_angle.get(Angle());
+
+	TaskGradient::Handle task(new TaskGradient());
+	task->gradient = new GradientLUT(compiled_gradient);
+	task->shape = shape;
+	return task;
+}
@@ -34,6 +34,7 @@
 #endif
 
 #include "curvegradient.h"
+#include "taskgradient.h"
 
 #include <synfig/localization.h>
 #include <synfig/general.h>
@@ -249,15 +250,28 @@ CurveGradient::CurveGradient():
 	SET_STATIC_DEFAULTS();
 }
 
-inline Color
-CurveGradient::color_func(const Point &point_, int quality, Real supersample)const
+inline void
+CurveGradient::fill_params(Params &params)const
 {
-	Point origin=param_origin.get(Point());
-	Real width=param_width.get(Real());
-	std::vector<synfig::BLinePoint> bline(param_bline.get_list_of(BLinePoint()));
-	bool loop=param_loop.get(bool());
-	bool perpendicular=param_perpendicular.get(bool());
-	bool fast=param_fast.get(bool());
+	params.origin=param_origin.get(Point());
+	params.width=param_width.get(Real());
+	params.bline=param_bline.get_list_of(BLinePoint());
+	params.bline_loop=bline_loop;
+	params.curve_length=curve_length_;
+	params.loop=param_loop.get(bool());
+	params.perpendicular=param_perpendicular.get(bool());
+	params.fast=param_fast.get(bool());
+}
+
+Real
+CurveGradient::calc_position(const Params &params, const Point &point_, int quality, Real &supersample)
+{
+	const Point &origin=params.origin;
+	Real width=params.width;
+	const std::vector<synfig::BLinePoint> &bline=params.bline;
+	bool loop=params.loop;
+	bool perpendicular=params.perpendicular;
+	bool fast=params.fast;
 
 	Vector tangent;
 	Vector diff;
@@ -269,7 +283,7 @@ CurveGradient::color_func(const Point &point_, int quality, Real supersample)con
 	bool edge_case = false;
 
 	if(bline.size()==0)
-		return Color::alpha();
+		{ supersample = 0; return 0; }
 	else if(bline.size()==1)
 	{
 		tangent=bline.front().get_tangent1();
@@ -287,12 +301,12 @@ CurveGradient::color_func(const Point &point_, int quality, Real supersample)con
 		// Taking into account looping.
 		if(perpendicular)
 		{
-			next=find_closest(fast,bline,point,t,bline_loop,&perp_dist);
-			perp_dist/=curve_length_;
+			next=find_closest(fast,bline,point,t,params.bline_loop,&perp_dist);
+			perp_dist/=params.curve_length;
 		}
 		else					// not perpendicular
 		{
-			next=find_closest(fast,bline,point,t,bline_loop);
+			next=find_closest(fast,bline,point,t,params.bline_loop);
 		}
 
 		iter=next++;
@@ -404,7 +418,7 @@ CurveGradient::color_func(const Point &point_, int quality, Real supersample)con
 
 		if(perpendicular)
 		{
-			tangent*=curve_length_;
+			tangent*=params.curve_length;
 			p1-=tangent*perp_dist;
 			tangent=-tangent.perp();
 		}
@@ -453,6 +467,15 @@ CurveGradient::color_func(const Point &point_, int quality, Real supersample)con
 	}
 
 	supersample *= 0.5;
+	return dist;
+}
+
+inline Color
+CurveGradient::color_func(const Params &params, const Point &point, int quality, Real supersample)const
+{
+	if (params.bline.empty())
+		return Color::alpha();
+	Real dist = calc_position(params, point, quality, supersample);
 	return compiled_gradient.average(dist - supersample, dist + supersample);
 }
 
@@ -469,7 +492,11 @@ CurveGradient::hit_check(synfig::Context context, const synfig::Point &point)con
 		return const_cast<CurveGradient*>(this);
 	if(get_amount()==0.0)
 		return context.hit_check(point);
-	if((get_blend_method()==Color::BLEND_STRAIGHT || get_blend_method()==Color::BLEND_COMPOSITE|| get_blend_method()==Color::BLEND_ONTO) && color_func(point).get_a()>0.5)
+
+	Params params;
+	fill_params(params);
+
+	if((get_blend_method()==Color::BLEND_STRAIGHT || get_blend_method()==Color::BLEND_COMPOSITE|| get_blend_method()==Color::BLEND_ONTO) && color_func(params,point).get_a()>0.5)
 		return const_cast<CurveGradient*>(this);
 	return context.hit_check(point);
 }
@@ -564,7 +591,10 @@ CurveGradient::get_param_vocab()const
 Color
 CurveGradient::get_color(Context context, const Point &point)const
 {
-	const Color color(color_func(point,0));
+	Params params;
+	fill_params(params);
+
+	const Color color(color_func(params,point,0));
 
 	if(get_amount()==1.0 && get_blend_method()==Color::BLEND_STRAIGHT)
 		return color;
@@ -592,6 +622,9 @@ CurveGradient::accelerated_render(Context context,Surface *surface,int quality,
 	}
 
 
+	Params params;
+	fill_params(params);
+
 	int x,y;
 
 	Surface::pen pen(surface->begin());
@@ -605,13 +638,13 @@ CurveGradient::accelerated_render(Context context,Surface *surface,int quality,
 	{
 		for(y=0,pos[1]=tl[1];y<h;y++,pen.inc_y(),pen.dec_x(x),pos[1]+=ph)
 			for(x=0,pos[0]=tl[0];x<w;x++,pen.inc_x(),pos[0]+=pw)
-				pen.put_value(color_func(pos,quality,calc_supersample(pos,pw,ph)));
+				pen.put_value(color_func(params,pos,quality,calc_supersample(pos,pw,ph)));
 	}
 	else
 	{
 		for(y=0,pos[1]=tl[1];y<h;y++,pen.inc_y(),pen.dec_x(x),pos[1]+=ph)
 			for(x=0,pos[0]=tl[0];x<w;x++,pen.inc_x(),pos[0]+=pw)
-				pen.put_value(Color::blend(color_func(pos,quality,calc_supersample(pos,pw,ph)),pen.get_value(),get_amount(),get_blend_method()));
+				pen.put_value(Color::blend(color_func(params,pos,quality,calc_supersample(pos,pw,ph)),pen.get_value(),get_amount(),get_blend_method()));
 	}
 
 	// Mark our progress as finished
@@ -655,6 +688,9 @@ CurveGradient::accelerated_cairorender(Context context, cairo_t *cr,int quality,
 	}
 	
 	
+	Params params;
+	fill_params(params);
+
 	int x,y;
 	cairo_surface_t *surface;
 	
@@ -668,7 +704,7 @@ CurveGradient::accelerated_cairorender(Context context, cairo_t *cr,int quality,
 	}
 	for(y=0,pos[1]=tl[1];y<h;y++,pos[1]+=ph)
 		for(x=0,pos[0]=tl[0];x<w;x++,pos[0]+=pw)
-			csurface[y][x]=CairoColor(color_func(pos,calc_supersample(pos,pw,ph))).premult_alpha();
+			csurface[y][x]=CairoColor(color_func(params,pos,calc_supersample(pos,pw,ph))).premult_alpha();
 	csurface.unmap_cairo_image();
 	
 	// paint surface on cr
@@ -687,3 +723,33 @@ CurveGradient::accelerated_cairorender(Context context, cairo_t *cr,int quality,
 	return true;
 
 }
+
+class CurveGradient::Shape: public GradientShape
+{
+public:
+	Params params;
+
+	virtual void fill_row(Real *positions, Real *widths, int count, const Point &p, const Vector &dx, const Vector &pixel_size) const
+	{
+		// use the same quality as software renderer passes to accelerated_render
+		const int quality = 4;
+		Point pos = p;
+		for(int i = 0; i < count; ++i, pos += dx) {
+			Real supersample = pixel_size[0];
+			positions[i] = calc_position(params, pos, quality, supersample);
+			widths[i] = supersample;
+		}
+	}
+};
+
+rendering::Task::Handle
+CurveGradient::build_composite_task_vfunc(ContextParams /* context_params */)const
+{
+	etl::handle<Shape> shape(new Shape());
+	fill_params(shape->params);
+
+	TaskGradient::Handle task(new TaskGradient());
+	task->gradient = new GradientLUT(shape->params.bline.empty() ? CompiledGradient() : compiled_gradient);
+	task->shape = shape;
+	return task;
+}
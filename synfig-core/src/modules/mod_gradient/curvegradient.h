@@ -72,9 +72,25 @@ private:
 
 	CompiledGradient compiled_gradient;
 
+	struct Params {
+		Point origin;
+		Real width;
+		std::vector<synfig::BLinePoint> bline;
+		bool bline_loop;
+		Real curve_length;
+		bool loop;
+		bool perpendicular;
+		bool fast;
+		Params(): width(), bline_loop(), curve_length(), loop(), perpendicular(), fast() { }
+	};
+
+	class Shape;
+
 	void compile();
 	void sync();
-	Color color_func(const Point &x, int quality=10, Real supersample=0)const;
+	void fill_params(Params &params)const;
+	static Real calc_position(const Params &params, const Point &x, int quality, Real &supersample);
+	Color color_func(const Params &params, const Point &x, int quality=10, Real supersample=0)const;
 	Real calc_supersample(const Point &x, Real pw, Real ph)const;
 
 public:
@@ -88,6 +104,9 @@ public:
 	Layer::Handle hit_check(synfig::Context context, const synfig::Point &point)const;
 
 	virtual Vocab get_param_vocab()const;
+
+protected:
+	virtual rendering::Task::Handle build_composite_task_vfunc(ContextParams context_params)const;
 };
 
 /* === E N D =============================================================== */
@@ -33,6 +33,7 @@
 #endif
 
 #include "lineargradient.h"
+#include "taskgradient.h"
 
 #include <synfig/localization.h>
 #include <synfig/general.h>
@@ -61,6 +62,31 @@ SYNFIG_LAYER_SET_CVS_ID(LinearGradient,"$Id$");
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+class LinearShape: public GradientShape
+{
+public:
+	Vector diff;
+	Real offset;
+	Real supersample;
+
+	LinearShape(): offset(), supersample() { }
+
+	virtual void fill_row(Real *positions, Real *widths, int count, const Point &p, const Vector &dx, const Vector &pixel_size) const
+	{
+		Real pos = p*diff - offset;
+		Real step = dx*diff;
+		Real width = 0.5*pixel_size[0]*supersample;
+		for(int i = 0; i < count; ++i) {
+			positions[i] = pos + i*step;
+			widths[i] = width;
+		}
+	}
+};
+
+} // end of anonimous namespace
+
 /* === M E T H O D S ======================================================= */
 
 inline void
@@ -308,6 +334,22 @@ LinearGradient::accelerated_cairorender(Context context, cairo_t *cr, int qualit
 }
 
 
+rendering::Task::Handle
+LinearGradient::build_composite_task_vfunc(ContextParams /* context_params */)const
+{
+	Params params;
+	fill_params(params);
+
+	etl::handle<LinearShape> shape(new LinearShape());
+	shape->diff = params.diff;
+	shape->offset = params.p1*params.diff;
+	shape->supersample = calc_supersample(params, 1.0, 1.0);
+
+	TaskGradient::Handle task(new TaskGradient());
+	task->gradient = new GradientLUT(params.gradient);
+	task->shape = shape;
+	return task;
+}
 
 bool
 LinearGradient::compile_gradient(cairo_pattern_t* pattern, Gradient mygradient)const
@@ -44,6 +44,7 @@
 #include <synfig/valuenode.h>
 
 #include "radialgradient.h"
+#include "taskgradient.h"
 
 #endif
 
@@ -64,6 +65,32 @@ SYNFIG_LAYER_SET_CVS_ID(RadialGradient,"$Id$");
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+class RadialShape: public GradientShape
+{
+public:
+	Point center;
+	Real radius;
+
+	RadialShape(): radius() { }
+
+	virtual void fill_row(Real *positions, Real *widths, int count, const Point &p, const Vector &dx, const Vector &pixel_size) const
+	{
+		Real x = p[0] - center[0];
+		Real y = p[1] - center[1];
+		Real width = 0.6*pixel_size[0]/radius; // see RadialGradient::calc_supersample
+		for(int i = 0; i < count; ++i) {
+			Real xx = x + i*dx[0];
+			Real yy = y + i*dx[1];
+			positions[i] = sqrt(xx*xx + yy*yy)/radius;
+			widths[i] = width;
+		}
+	}
+};
+
+} // end of anonimous namespace
+
 /* === M E T H O D S ======================================================= */
 
 /* === E N T R Y P O I N T ================================================= */
@@ -282,6 +309,19 @@ RadialGradient::accelerated_cairorender(Context context,cairo_t *cr, int quality
 	return true;
 }
 
+rendering::Task::Handle
+RadialGradient::build_composite_task_vfunc(ContextParams /* context_params */)const
+{
+	etl::handle<RadialShape> shape(new RadialShape());
+	shape->center = param_center.get(Point());
+	shape->radius = param_radius.get(Real());
+
+	TaskGradient::Handle task(new TaskGradient());
+	task->gradient = new GradientLUT(compiled_gradient);
+	task->shape = shape;
+	return task;
+}
+
 bool
 RadialGradient::compile_gradient(cairo_pattern_t* pattern, Gradient mygradient)const
 {
@@ -44,6 +44,7 @@
 #include <synfig/cairo_renddesc.h>
 
 #include "spiralgradient.h"
+#include "taskgradient.h"
 
 #endif
 
@@ -64,6 +65,46 @@ SYNFIG_LAYER_SET_CVS_ID(SpiralGradient,"$Id$");
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+class SpiralShape: public GradientShape
+{
+public:
+	Point center;
+	Real radius;
+	Angle angle;
+	bool clockwise;
+
+	SpiralShape(): radius(), clockwise() { }
+
+	virtual void fill_row(Real *positions, Real *widths, int count, const Point &p, const Vector &dx, const Vector &pixel_size) const
+	{
+		// see SpiralGradient::color_func and SpiralGradient::calc_supersample
+		Real pw = pixel_size[0];
+		Point centered = p - center;
+		for(int i = 0; i < count; ++i, centered += dx) {
+			Angle a;
+			a = Angle::tan(-centered[1], centered[0]).mod();
+			a = a + angle;
+
+			Real mag = centered.mag();
+			Real supersample = (1.41421*pw/radius + (1.41421*pw/mag)/(PI*2))*0.5;
+			if (supersample < 0.00001) supersample = 0.00001;
+
+			Real dist = mag/radius;
+			if (clockwise)
+				dist += Angle::rot(a.mod()).get();
+			else
+				dist -= Angle::rot(a.mod()).get();
+
+			positions[i] = dist;
+			widths[i] = 0.5*supersample;
+		}
+	}
+};
+
+} // end of anonimous namespace
+
 /* === M E T H O D S ======================================================= */
 
 /* === E N T R Y P O I N T ================================================= */
@@ -319,5 +360,17 @@ SpiralGradient::accelerated_cairorender(Context context, cairo_t *cr,int quality
 	return true;
 }
 
-
-
+rendering::Task::Handle
+SpiralGradient::build_composite_task_vfunc(ContextParams /* context_params */)const
+{
+	etl::handle<SpiralShape> shape(new SpiralShape());
+	shape->center = param_center.get(Point());
+	shape->radius = param_radius.get(Real());
+	shape->angle = param_angle.get(Angle());
+	shape->clockwise = param_clockwise.get(bool());
+
+	TaskGradient::Handle task(new TaskGradient());
+	task->gradient = new GradientLUT(compiled_gradient);
+	task->shape = shape;
+	return task;
+}
@@ -0,0 +1,154 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file taskgradient.cpp
+**	\brief Implementation of rendering task of gradient layers
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <algorithm>
+
+#include <synfig/surface.h>
+
+#include <synfig/rendering/common/task/taskblend.h>
+#include <synfig/rendering/software/task/tasksw.h>
+
+#include "taskgradient.h"
+
+#endif
+
+using namespace synfig;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+namespace {
+
+class TaskGradientSW: public TaskGradient, public rendering::TaskSW,
+	public rendering::TaskInterfaceBlendToTarget,
+	public rendering::TaskInterfaceSplit
+{
+public:
+	typedef etl::handle<TaskGradientSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	virtual void on_target_set_as_source() {
+		Task::Handle &subtask = sub_task(0);
+		if ( subtask
+		  && subtask->target_surface == target_surface
+		  && !Color::is_straight(blend_method) )
+		{
+			trunc_by_bounds();
+			subtask->source_rect = source_rect;
+			subtask->target_rect = target_rect;
+		}
+	}
+
+	virtual Color::BlendMethodFlags get_supported_blend_methods() const
+		{ return Color::BLEND_METHODS_ALL; }
+
+	virtual bool run(RunParams&) const {
+		if (!is_valid() || !gradient || !shape)
+			return true;
+
+		Vector ppu = get_pixels_per_unit();
+
+		Matrix bounds_transfromation;
+		bounds_transfromation.m00 = ppu[0];
+		bounds_transfromation.m11 = ppu[1];
+		bounds_transfromation.m20 = target_rect.minx - ppu[0]*source_rect.minx;
+		bounds_transfromation.m21 = target_rect.miny - ppu[1]*source_rect.miny;
+
+		Matrix matrix = bounds_transfromation * transformation->matrix;
+		Matrix inv_matrix = matrix.get_inverted();
+
+		int tw = target_rect.get_width();
+		Vector dx = inv_matrix.axis_x();
+		Vector dy = inv_matrix.axis_y();
+		Vector pixel_size(dx.mag(), dy.mag());
+		Vector p = inv_matrix.get_transformed( Vector((Real)target_rect.minx, (Real)target_rect.miny) );
+
+		LockWrite la(this);
+		if (!la)
+			return false;
+		synfig::Surface &surface = la->get_surface();
+
+		// positions are calculated for whole row at once,
+		// so loops of shapes and lookups in gradient are short and simple
+		std::vector<Real> positions(tw), widths(tw);
+		const GradientLUT &lut = *gradient;
+		ColorReal amount = blend ? this->amount : ColorReal(1.0);
+		bool straight = !blend || (blend_method == Color::BLEND_STRAIGHT && approximate_equal_lp(amount, ColorReal(1.0)));
+
+		for(int iy = target_rect.miny; iy < target_rect.maxy; ++iy, p += dy) {
+			shape->fill_row(&positions.front(), &widths.front(), tw, p, dx, pixel_size);
+
+			Color *row = &surface[iy][target_rect.minx];
+			const Real *pos = &positions.front(), *w = &widths.front();
+			if (straight) {
+				for(Color *end = row + tw; row < end; ++row, ++pos, ++w)
+					*row = lut.average(*pos - *w, *pos + *w);
+			} else {
+				for(Color *end = row + tw; row < end; ++row, ++pos, ++w)
+					*row = Color::blend(lut.average(*pos - *w, *pos + *w), *row, amount, blend_method);
+			}
+		}
+
+		return true;
+	}
+};
+
+rendering::Task::Token TaskGradientSW::token(
+	DescReal<TaskGradientSW, TaskGradient>("GradientSW") );
+
+} // end of anonimous namespace
+
+/* === M E T H O D S ======================================================= */
+
+GradientLUT::GradientLUT(const CompiledGradient &gradient):
+	gradient(gradient),
+	table(Size + 1),
+	last()
+{
+	const CompiledGradient::List &list = this->gradient.get_list();
+	last = (int)list.size() - 1;
+
+	// each cell points to entry for a bit smaller position than cell begin,
+	// so rounding errors of (int)(x*Size) never lead past the right entry
+	for(int i = 0; i <= Size; ++i) {
+		Real x = std::max(Real(0.0), (i - Real(0.5))/Size);
+		table[i] = (int)(this->gradient.find(x) - list.begin());
+	}
+}
+
+rendering::Task::Token TaskGradient::token(
+	DescAbstract<TaskGradient>("Gradient") );
+
+/* === E N T R Y P O I N T ================================================= */
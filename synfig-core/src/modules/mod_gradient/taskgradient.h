@@ -0,0 +1,144 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file taskgradient.h
+**	\brief Header file for rendering task of gradient layers
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_MOD_GRADIENT_TASKGRADIENT_H
+#define __SYNFIG_MOD_GRADIENT_TASKGRADIENT_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <vector>
+
+#include <synfig/gradient.h>
+#include <synfig/vector.h>
+
+#include <synfig/rendering/task.h>
+#include <synfig/rendering/common/task/tasktransformation.h>
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+//! Geometry of gradient layer: maps points to positions in gradient
+class GradientShape: public etl::shared_object
+{
+public:
+	typedef etl::handle<GradientShape> Handle;
+
+	virtual ~GradientShape() { }
+
+	//! Calculates positions in gradient for row of count pixels
+	//! started from point p with step dx (in layer coordinates).
+	//! Also fills half-widths of pixels in gradient units for antialiasing.
+	//! pixel_size is a size of pixel in layer units.
+	virtual void fill_row(
+		synfig::Real *positions,
+		synfig::Real *widths,
+		int count,
+		const synfig::Point &p,
+		const synfig::Vector &dx,
+		const synfig::Vector &pixel_size ) const = 0;
+};
+
+
+//! Compiled gradient with lookup table of segments,
+//! gives exactly the same colors as CompiledGradient but without binary search
+class GradientLUT: public etl::shared_object
+{
+public:
+	typedef etl::handle<GradientLUT> Handle;
+	typedef synfig::CompiledGradient::Accumulator Accumulator;
+	typedef synfig::CompiledGradient::Entry Entry;
+
+	enum { Size = 1024 };
+
+private:
+	synfig::CompiledGradient gradient;
+	std::vector<int> table;
+	int last;
+
+	inline const Entry& find(synfig::Real x) const
+	{
+		// table contains lower bound of cell, go forward to exact entry
+		int cell = !(x > 0.0) ? 0 : x >= 1.0 ? (int)Size : (int)(x*Size);
+		const Entry *entries = &gradient.get_list().front();
+		int i = table[cell];
+		while(i < last && entries[i].next_pos < x) ++i;
+		return entries[i];
+	}
+
+	inline Accumulator summary(synfig::Real x) const
+	{
+		if (gradient.get_repeat()) {
+			synfig::Real count = floor(x);
+			x -= count;
+			return gradient.summary()*count + find(x).summary(x);
+		}
+		return find(x).summary(x);
+	}
+
+	inline synfig::Color color(synfig::Real x) const
+	{
+		if (gradient.get_repeat()) x -= floor(x);
+		return find(x).color(x);
+	}
+
+public:
+	explicit GradientLUT(const synfig::CompiledGradient &gradient);
+
+	const synfig::CompiledGradient& get_gradient() const
+		{ return gradient; }
+
+	//! Same as CompiledGradient::average(x0, x1)
+	inline synfig::Color average(synfig::Real x0, synfig::Real x1) const
+	{
+		synfig::Real w = x1 - x0;
+		if (std::isnan(w) || std::isinf(w)) return gradient.average();
+		if (fabs(w) < synfig::real_precision<synfig::Real>()) return color(x0);
+		return ((summary(x1) - summary(x0))/w).color();
+	}
+};
+
+
+//! Fills whole plane by gradient
+class TaskGradient: public synfig::rendering::Task,
+	public synfig::rendering::TaskInterfaceTransformation
+{
+public:
+	typedef etl::handle<TaskGradient> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	GradientLUT::Handle gradient;
+	GradientShape::Handle shape;
+	synfig::rendering::Holder<synfig::rendering::TransformationAffine> transformation;
+
+	virtual synfig::rendering::Transformation::Handle get_transformation() const
+		{ return transformation.handle(); }
+};
+
+/* === E N D =============================================================== */
+
+#endif
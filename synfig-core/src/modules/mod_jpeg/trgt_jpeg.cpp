@@ -32,9 +32,16 @@
 #	include <config.h>
 #endif
 
+#include <csetjmp>
 #include <glib/gstdio.h>
+#include <sigc++/bind.h>
+#include <synfig/general.h>
 #include "trgt_jpeg.h"
 #include <ETL/stringf>
+
+extern "C" {
+	#include <jpeglib.h>
+}
 #endif
 
 /* === M A C R O S ========================================================= */
@@ -51,38 +58,64 @@ SYNFIG_TARGET_SET_EXT(jpeg_trgt,"jpg");
 SYNFIG_TARGET_SET_VERSION(jpeg_trgt,"0.1");
 SYNFIG_TARGET_SET_CVS_ID(jpeg_trgt,"$Id$");
 
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace {
+
+//! Error manager which jumps back to the caller of libjpeg instead of exit()
+struct ErrorManager
+{
+	jpeg_error_mgr pub;
+	jmp_buf jump;
+
+	static void error_exit(j_common_ptr cinfo)
+	{
+		char message[JMSG_LENGTH_MAX];
+		(*cinfo->err->format_message)(cinfo, message);
+		synfig::error("jpeg_trgt: error: %s", message);
+		longjmp(((ErrorManager*)cinfo->err)->jump, 1);
+	}
+};
+
+} // end of anonimous namespace
+
+struct jpeg_trgt::Frame
+{
+	//! empty for stdout
+	String filename;
+	int width;
+	int height;
+	int quality;
+	//! converted pixels of the whole frame, empty when rows are written directly
+	std::vector<unsigned char> pixels;
+
+	//! file being written, opened by open_file()
+	FILE *file;
+	bool compressing;
+	jpeg_compress_struct cinfo;
+	ErrorManager jerr;
+
+	Frame(): width(), height(), quality(), file(), compressing(), cinfo(), jerr() { }
+	~Frame() { jpeg_trgt::destroy_file(*this); }
+	size_t get_stride() const { return 3*(size_t)width; }
+};
+
 /* === M E T H O D S ======================================================= */
 
 jpeg_trgt::jpeg_trgt(const char *Filename, const synfig::TargetParam &params):
-	file(nullptr),
 	quality(95),
-	cinfo(),
-	jerr(),
 	multi_image(),
-	ready(false),
+	failed(),
 	imagecount(),
+	scanline(),
 	filename(Filename),
-	buffer(nullptr),
-	color_buffer(nullptr),
 	sequence_separator(params.sequence_separator)
 {
 	set_alpha_mode(TARGET_ALPHA_MODE_FILL);
 }
 
 jpeg_trgt::~jpeg_trgt()
-{
-	if(ready)
-	{
-		jpeg_finish_compress(&cinfo);
-		jpeg_destroy_compress(&cinfo);
-		ready=false;
-	}
-	if(file)
-		fclose(file);
-	file=nullptr;
-	delete [] buffer;
-	delete [] color_buffer;
-}
+	{ }
 
 bool
 jpeg_trgt::set_rend_desc(RendDesc *given_desc)
@@ -96,49 +129,44 @@ jpeg_trgt::set_rend_desc(RendDesc *given_desc)
 	return true;
 }
 
-bool
-jpeg_trgt::start_frame(synfig::ProgressCallback *callback)
+void
+jpeg_trgt::destroy_file(Frame &frame)
 {
-	int w=desc.get_w(),h=desc.get_h();
+	if (frame.compressing)
+		jpeg_destroy_compress(&frame.cinfo);
+	frame.compressing = false;
+	if (frame.file && frame.file != stdout)
+		fclose(frame.file);
+	frame.file = NULL;
+}
 
-	if(file && file!=stdout)
-		fclose(file);
-	if(filename=="-")
-	{
-		if(callback)callback->task(strprintf("(stdout) %d",imagecount).c_str());
-		file=stdout;
-	}
-	else if(multi_image)
-	{
-		String newfilename(filename_sans_extension(filename) +
-						   sequence_separator +
-						   etl::strprintf("%04d",imagecount) +
-						   filename_extension(filename));
-		file=g_fopen(newfilename.c_str(),POPEN_BINARY_WRITE_TYPE);
-		if(callback)callback->task(newfilename);
-	}
-	else
+bool
+jpeg_trgt::open_file(Frame &frame)
+{
+	frame.file = frame.filename.empty()
+	           ? stdout
+	           : g_fopen(frame.filename.c_str(),POPEN_BINARY_WRITE_TYPE);
+	if (!frame.file)
 	{
-		file=g_fopen(filename.c_str(),POPEN_BINARY_WRITE_TYPE);
-		if(callback)callback->task(filename);
+		synfig::error("jpeg_trgt: unable to open file: %s", frame.filename.c_str());
+		return false;
 	}
 
-	if(!file)
+	jpeg_compress_struct &cinfo = frame.cinfo;
+	cinfo.err = jpeg_std_error(&frame.jerr.pub);
+	frame.jerr.pub.error_exit = ErrorManager::error_exit;
+	if (setjmp(frame.jerr.jump))
+	{
+		destroy_file(frame);
 		return false;
+	}
 
-	delete [] buffer;
-	buffer=new unsigned char[3*w];
-
-	delete [] color_buffer;
-	color_buffer=new Color[w];
-
-
-	cinfo.err = jpeg_std_error(&jerr);
 	jpeg_create_compress(&cinfo);
-	jpeg_stdio_dest(&cinfo, file);
+	frame.compressing = true;
+	jpeg_stdio_dest(&cinfo, frame.file);
 
-	cinfo.image_width = w; 	/* image width and height, in pixels */
-	cinfo.image_height = h;
+	cinfo.image_width = frame.width; 	/* image width and height, in pixels */
+	cinfo.image_height = frame.height;
 	cinfo.input_components = 3;		/* # of color components per pixel */
 	cinfo.in_color_space = JCS_RGB; 	/* colorspace of input image */
 	/* Now use the library's routine to set default compression parameters.
@@ -149,7 +177,7 @@ jpeg_trgt::start_frame(synfig::ProgressCallback *callback)
 	/* Now you can set any non-default parameters you wish to.
 	* Here we just illustrate the use of quality (quantization table) scaling:
 	*/
-	jpeg_set_quality(&cinfo, quality, TRUE /* limit to baseline-JPEG values */);
+	jpeg_set_quality(&cinfo, frame.quality, TRUE /* limit to baseline-JPEG values */);
 
 	/* Step 4: Start compressor */
 
@@ -157,43 +185,167 @@ jpeg_trgt::start_frame(synfig::ProgressCallback *callback)
 	* Pass TRUE unless you are very sure of what you're doing.
 	*/
 	jpeg_start_compress(&cinfo, TRUE);
+	return true;
+}
+
+bool
+jpeg_trgt::write_row(Frame &frame, unsigned char *row)
+{
+	if (!frame.compressing)
+		return false;
+
+	// ErrorManager::error_exit() jumps here
+	if (setjmp(frame.jerr.jump))
+	{
+		destroy_file(frame);
+		return false;
+	}
+
+	JSAMPROW rows[1] = { row };
+	jpeg_write_scanlines(&frame.cinfo, rows, 1);
+	return true;
+}
+
+bool
+jpeg_trgt::close_file(Frame &frame)
+{
+	if (!frame.compressing)
+		return false;
+
+	// ErrorManager::error_exit() jumps here
+	if (setjmp(frame.jerr.jump))
+	{
+		destroy_file(frame);
+		return false;
+	}
+
+	jpeg_finish_compress(&frame.cinfo);
+	jpeg_destroy_compress(&frame.cinfo);
+	frame.compressing = false;
 
-	ready=true;
+	FILE *file = frame.file;
+	frame.file = NULL;
+	if (file==stdout)
+		fflush(file);
+	else
+	if (fclose(file))
+	{
+		synfig::error("jpeg_trgt: unable to write file: %s", frame.filename.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool
+jpeg_trgt::write_frame(std::shared_ptr<Frame> frame)
+{
+	if (!open_file(*frame))
+		return false;
+
+	size_t stride = frame->get_stride();
+	for(int y = 0; y < frame->height; ++y)
+		if (!write_row(*frame, &frame->pixels[y*stride]))
+			return false;
+
+	return close_file(*frame);
+}
+
+bool
+jpeg_trgt::start_frame(synfig::ProgressCallback *callback)
+{
+	// stop at the first frame which was not written
+	if (failed)
+		return false;
+
+	int w=desc.get_w(),h=desc.get_h();
+
+	frame = std::make_shared<Frame>();
+	if(filename=="-")
+	{
+		if(callback)callback->task(strprintf("(stdout) %d",imagecount).c_str());
+	}
+	else if(multi_image)
+	{
+		frame->filename = filename_sans_extension(filename) +
+						  sequence_separator +
+						  etl::strprintf("%04d",imagecount) +
+						  filename_extension(filename);
+		if(callback)callback->task(frame->filename);
+	}
+	else
+	{
+		frame->filename = filename;
+		if(callback)callback->task(filename);
+	}
+
+	frame->width   = w;
+	frame->height  = h;
+	frame->quality = quality;
+
+	// frames written to stdout must keep their order, and frames rendered
+	// by bands must stay within the memory limit, so their rows are
+	// compressed and written directly
+	size_t frame_size = frame->get_stride()*(size_t)h;
+	if (!frame->filename.empty() && can_write_frame_async(frame_size))
+	{
+		frame->pixels.resize(frame_size);
+	}
+	else
+	{
+		row_buffer.resize(frame->get_stride());
+		if (!open_file(*frame))
+		{
+			frame.reset();
+			failed = true;
+			return false;
+		}
+	}
+
+	color_buffer.resize(w);
 	return true;
 }
 
 void
 jpeg_trgt::end_frame()
 {
-	if(ready)
+	if (frame)
 	{
-		jpeg_finish_compress(&cinfo);
-		jpeg_destroy_compress(&cinfo);
-		ready=false;
+		if (frame->pixels.empty())
+			failed = !close_file(*frame) || failed;
+		else
+			failed = !write_frame_async(
+				sigc::bind(sigc::ptr_fun(&jpeg_trgt::write_frame), frame),
+				frame->pixels.size() ) || failed;
 	}
-
-	if(file && file!=stdout)
-		fclose(file);
-	file=nullptr;
+	frame.reset();
 	imagecount++;
 }
 
 Color *
-jpeg_trgt::start_scanline(int /*scanline*/)
+jpeg_trgt::start_scanline(int scanline)
 {
-	return color_buffer;
+	this->scanline=scanline;
+	return &color_buffer.front();
 }
 
 bool
 jpeg_trgt::end_scanline()
 {
-	if(!file || !ready)
+	if(!frame || scanline < 0 || scanline >= frame->height)
 		return false;
 
-	color_to_pixelformat(buffer, color_buffer, PF_RGB, nullptr, desc.get_w());
-
-	JSAMPROW *row_pointer(&buffer);
-	jpeg_write_scanlines(&cinfo, row_pointer, 1);
+	if (!frame->pixels.empty())
+	{
+		color_to_pixelformat(&frame->pixels[(size_t)scanline*frame->get_stride()], &color_buffer.front(), PF_RGB, nullptr, frame->width);
+		return true;
+	}
 
-	return true;
+	// rows are written directly, so they must come in order
+	if (scanline != (int)frame->cinfo.next_scanline)
+	{
+		synfig::error("jpeg_trgt: unexpected order of rows in %s", frame->filename.c_str());
+		return false;
+	}
+	color_to_pixelformat(&row_buffer.front(), &color_buffer.front(), PF_RGB, nullptr, frame->width);
+	return write_row(*frame, &row_buffer.front());
 }
@@ -33,10 +33,8 @@
 #include <synfig/string.h>
 #include <synfig/targetparam.h>
 #include <cstdio>
-
-extern "C" {
-	#include <jpeglib.h>
-}
+#include <memory>
+#include <vector>
 
 /* === M A C R O S ========================================================= */
 
@@ -48,17 +46,27 @@ class jpeg_trgt : public synfig::Target_Scanline
 {
 	SYNFIG_TARGET_MODULE_EXT
 private:
-	FILE *file;
-	int /*w,h,*/quality;
-	struct jpeg_compress_struct cinfo;
-	struct jpeg_error_mgr jerr;
+	//! Converted pixels of the frame, it is compressed and written in background by write_frame(),
+	//! or row by row by end_scanline() when it doesn't fit into memory
+	struct Frame;
 
+	//! Opens the file and starts compression
+	static bool open_file(Frame &frame);
+	static bool write_row(Frame &frame, unsigned char *row);
+	//! Finishes the file, returns \c false if it was not written
+	static bool close_file(Frame &frame);
+	//! Releases libjpeg struct and closes the file without finishing it
+	static void destroy_file(Frame &frame);
+	static bool write_frame(std::shared_ptr<Frame> frame);
 
-	bool multi_image,ready;
+	int quality;
+	bool multi_image,failed;
 	int imagecount;
+	int scanline;
 	synfig::String filename;
-	unsigned char *buffer;
-	synfig::Color *color_buffer;
+	std::shared_ptr<Frame> frame;
+	std::vector<synfig::Color> color_buffer;
+	std::vector<unsigned char> row_buffer;
 	synfig::String sequence_separator;
 public:
 	jpeg_trgt(const char *filename, const synfig::TargetParam& /* params */);
@@ -35,7 +35,7 @@
 #include <synfig/module.h>
 #include <synfig/layer.h>
 
-//#include "mptr.h"
+#include "mptr.h"
 #include "trgt_av.h"
 
 #endif
@@ -64,6 +64,16 @@ MODULE_INVENTORY_BEGIN(mod_libavcodec)
 		//TARGET_EXT(Target_LibAVCodec,"dv")
 	END_TARGETS
 	BEGIN_IMPORTERS
-//		IMPORTER(bmp_mptr)
+		// module is loaded after mod_ffmpeg, so these replace
+		// the importer which runs ffmpeg process for each frame
+		IMPORTER_EXT(Importer_LibAVCodec,"avi")
+		IMPORTER_EXT(Importer_LibAVCodec,"mp4")
+		IMPORTER_EXT(Importer_LibAVCodec,"mpg")
+		IMPORTER_EXT(Importer_LibAVCodec,"mpeg")
+		IMPORTER_EXT(Importer_LibAVCodec,"mov")
+		IMPORTER_EXT(Importer_LibAVCodec,"mkv")
+		IMPORTER_EXT(Importer_LibAVCodec,"webm")
+		IMPORTER_EXT(Importer_LibAVCodec,"rm")
+		IMPORTER_EXT(Importer_LibAVCodec,"dv")
 	END_IMPORTERS
 MODULE_INVENTORY_END
@@ -29,45 +29,357 @@
 #	include <config.h>
 #endif
 
-#include "mptr.h"
-#include <synfig/general.h>
-#include <synfig/localization.h>
-#include <synfig/surface.h>
+// ffmpeg library headers have historically had multiple locations.
+// We should check all of the locations to be more portable.
 
-#include <algorithm>
-#include <functional>
+extern "C"
+{
+#ifdef HAVE_LIBAVFORMAT_AVFORMAT_H
+#	include <libavformat/avformat.h>
+#elif defined(HAVE_AVFORMAT_H)
+#	include <avformat.h>
+#elif defined(HAVE_FFMPEG_AVFORMAT_H)
+#	include <ffmpeg/avformat.h>
+#else
+#   ifndef DISABLE_MODULE
+#   define DISABLE_MODULE
+#   endif
+#endif
+
+#ifdef HAVE_LIBSWSCALE_SWSCALE_H
+#	include <libswscale/swscale.h>
+#elif defined(HAVE_SWSCALE_H)
+#	include <swscale.h>
+#elif defined(HAVE_FFMPEG_SWSCALE_H)
+#	include <ffmpeg/swscale.h>
+#else
+#   ifndef DISABLE_MODULE
+#   define DISABLE_MODULE
+#   endif
+#endif
+} // extern "C"
+
+#ifndef DISABLE_MODULE
+#	include <cassert>
+#	include <algorithm>
+#	include <cmath>
+#	include <deque>
+#	include <functional>
+#	include <vector>
+#	include <synfig/general.h>
+#	include <synfig/localization.h>
+#	include <synfig/surface.h>
+#	include "mptr.h"
 #endif
 
+#endif
+
+#ifndef DISABLE_MODULE
+
 /* === U S I N G =========================================================== */
 
 using namespace synfig;
 using namespace std;
 using namespace etl;
 
+/* === M A C R O S ========================================================= */
+
+// how many decoded frames are kept for random access to the nearby frames
+#define FRAME_RING_SIZE 8
+
+// decoder seeks to the keyframe when requested frame is farther
+// than this number of frames forward from the last decoded one
+#define MAX_SKIP_FRAMES 64
+
 /* === G L O B A L S ======================================================= */
 
 SYNFIG_IMPORTER_INIT(Importer_LibAVCodec);
 SYNFIG_IMPORTER_SET_NAME(Importer_LibAVCodec,"libav");
 SYNFIG_IMPORTER_SET_EXT(Importer_LibAVCodec,"avi");
-SYNFIG_IMPORTER_SET_VERSION(Importer_LibAVCodec,"0.1");
+SYNFIG_IMPORTER_SET_VERSION(Importer_LibAVCodec,"0.2");
 SYNFIG_IMPORTER_SET_CVS_ID(Importer_LibAVCodec,"$Id$");
 SYNFIG_IMPORTER_SET_SUPPORTS_FILE_SYSTEM_WRAPPER(Importer_LibAVCodec, false);
 
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+static bool av_registered = false;
+#endif
 
-/* === M E T H O D S ======================================================= */
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+/*!	Decode context stays opened between the calls of get_frame(),
+**	so frames requested one by one are decoded sequentially.
+**	Decoder seeks only when requested frame is behind the last decoded one,
+**	or too far forward. Last decoded frames are kept in the small ring
+**	for the nearby random access (i.e. when time is scrubbed back and forth).
+*/
+class Importer_LibAVCodec::Internal
+{
+private:
+	struct Frame
+	{
+		int64_t pts;
+		Surface surface;
+		Frame(): pts() { }
+	};
+
+	AVFormatContext *context;
+	AVCodecContext *codec_context;
+	AVStream *stream;
+	int stream_index;
+	AVPacket *packet;
+	AVFrame *frame;
+	SwsContext *swscale_context;
+	std::vector<uint8_t> rgba;
+
+	//! duration of frame in units of stream time base
+	int64_t frame_duration;
+	//! pts of the last decoded frame
+	int64_t last_pts;
+	bool end_of_stream;
+
+	std::deque<Frame> ring;
+	ColorReal byte_to_color[256];
+
+	int64_t time_to_pts(Time time) const {
+		int64_t start = stream->start_time == AV_NOPTS_VALUE ? 0 : stream->start_time;
+		return start + (int64_t)floor((double)time/av_q2d(stream->time_base) + 0.5);
+	}
+
+	//! finds the frame which is shown at \a pts in the ring
+	const Frame* find(int64_t pts) const {
+		for(std::deque<Frame>::const_reverse_iterator i = ring.rbegin(); i != ring.rend(); ++i)
+			if (i->pts <= pts)
+				return pts < i->pts + frame_duration || (end_of_stream && i == ring.rbegin()) ? &*i : NULL;
+		return NULL;
+	}
+
+	void seek(int64_t pts) {
+		if (av_seek_frame(context, stream_index, pts, AVSEEK_FLAG_BACKWARD) < 0)
+			synfig::warning("Importer_LibAVCodec: seek failed, decoding continues from the current position");
+		avcodec_flush_buffers(codec_context);
+		ring.clear();
+		last_pts = AV_NOPTS_VALUE;
+		end_of_stream = false;
+	}
+
+	//! decodes next frame of video stream into \a frame, returns false at the end of stream
+	bool decode_next() {
+		if (end_of_stream)
+			return false;
+		while(true) {
+			int res = avcodec_receive_frame(codec_context, frame);
+			if (res == 0)
+				break;
+			if (res != AVERROR(EAGAIN)) {
+				end_of_stream = true;
+				return false;
+			}
+
+			// decoder needs more data
+			res = av_read_frame(context, packet);
+			if (res < 0) {
+				avcodec_send_packet(codec_context, NULL); // flush the delayed frames
+				continue;
+			}
+			if (packet->stream_index == stream_index)
+				avcodec_send_packet(codec_context, packet);
+			av_packet_unref(packet);
+		}
 
+		int64_t pts = frame->best_effort_timestamp;
+		if (pts == AV_NOPTS_VALUE)
+			pts = last_pts == AV_NOPTS_VALUE ? time_to_pts(0) : last_pts + frame_duration;
+		last_pts = pts;
+		return true;
+	}
+
+	void convert(Surface &surface) {
+		int w = frame->width;
+		int h = frame->height;
+		swscale_context = sws_getCachedContext(
+			swscale_context,
+			w, h, (AVPixelFormat)frame->format,
+			w, h, AV_PIX_FMT_RGBA,
+			SWS_POINT, NULL, NULL, NULL );
+		if (!swscale_context) {
+			synfig::error("Importer_LibAVCodec: cannot initialize the conversion context");
+			surface.set_wh(w, h);
+			surface.clear();
+			return;
+		}
+
+		rgba.resize(4*w*h);
+		uint8_t *dst_data[4] = { &rgba.front(), NULL, NULL, NULL };
+		int dst_linesize[4] = { 4*w, 0, 0, 0 };
+		sws_scale(
+			swscale_context,
+			(const uint8_t * const *)frame->data,
+			frame->linesize,
+			0, h,
+			dst_data,
+			dst_linesize );
+
+		surface.set_wh(w, h);
+		const uint8_t *src = &rgba.front();
+		for(int y = 0; y < h; ++y) {
+			Color *dst = surface[y];
+			for(int x = 0; x < w; ++x, src += 4, ++dst)
+				*dst = Color(
+					byte_to_color[src[0]],
+					byte_to_color[src[1]],
+					byte_to_color[src[2]],
+					byte_to_color[src[3]] );
+		}
+	}
+
+	void push_frame() {
+		if (ring.size() >= FRAME_RING_SIZE)
+			ring.pop_front();
+		ring.push_back(Frame());
+		ring.back().pts = last_pts;
+		convert(ring.back().surface);
+	}
+
+public:
+	Internal():
+		context(),
+		codec_context(),
+		stream(),
+		stream_index(-1),
+		packet(),
+		frame(),
+		swscale_context(),
+		frame_duration(1),
+		last_pts(AV_NOPTS_VALUE),
+		end_of_stream()
+	{
+		for(int i = 0; i < 256; ++i)
+			byte_to_color[i] = i/255.0;
+	}
+	~Internal() { close(); }
+
+	bool open(const String &filename) {
+		close();
+
+		#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+		if (!av_registered) {
+			av_register_all();
+			av_registered = true;
+		}
+		#endif
+
+		if (avformat_open_input(&context, filename.c_str(), NULL, NULL) < 0) {
+			synfig::error("Importer_LibAVCodec: unable to open file: %s", filename.c_str());
+			context = NULL;
+			return false;
+		}
+		if (avformat_find_stream_info(context, NULL) < 0) {
+			synfig::error("Importer_LibAVCodec: unable to find stream info: %s", filename.c_str());
+			close();
+			return false;
+		}
+
+		stream_index = av_find_best_stream(context, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+		if (stream_index < 0) {
+			synfig::error("Importer_LibAVCodec: no video stream found: %s", filename.c_str());
+			close();
+			return false;
+		}
+		stream = context->streams[stream_index];
+
+		const AVCodec *codec = avcodec_find_decoder(stream->codecpar->codec_id);
+		if (!codec) {
+			synfig::error("Importer_LibAVCodec: video codec not found: %s", filename.c_str());
+			close();
+			return false;
+		}
+		codec_context = avcodec_alloc_context3(codec);
+		if ( !codec_context
+		  || avcodec_parameters_to_context(codec_context, stream->codecpar) < 0
+		  || avcodec_open2(codec_context, codec, NULL) < 0 )
+		{
+			synfig::error("Importer_LibAVCodec: could not open video codec: %s", filename.c_str());
+			close();
+			return false;
+		}
+
+		AVRational rate = stream->avg_frame_rate.num ? stream->avg_frame_rate : stream->r_frame_rate;
+		if (rate.num && rate.den)
+			frame_duration = std::max((int64_t)1, av_rescale_q(1, av_inv_q(rate), stream->time_base));
+
+		packet = av_packet_alloc();
+		frame = av_frame_alloc();
+		assert(packet && frame);
+		return true;
+	}
+
+	void close() {
+		ring.clear();
+		if (swscale_context) {
+			sws_freeContext(swscale_context);
+			swscale_context = NULL;
+		}
+		if (frame) av_frame_free(&frame);
+		if (packet) av_packet_free(&packet);
+		if (codec_context) avcodec_free_context(&codec_context);
+		if (context) avformat_close_input(&context);
+		stream = NULL;
+		stream_index = -1;
+		frame_duration = 1;
+		last_pts = AV_NOPTS_VALUE;
+		end_of_stream = false;
+	}
+
+	bool get_frame(Surface &surface, Time time) {
+		if (!context)
+			return false;
+
+		int64_t pts = time_to_pts(time);
+		if (const Frame *f = find(pts))
+			{ surface = f->surface; return true; }
+
+		// seek on discontinuities, otherwise continue sequential decoding
+		if (last_pts == AV_NOPTS_VALUE) {
+			if (pts > time_to_pts(0) + MAX_SKIP_FRAMES*frame_duration)
+				seek(pts);
+		} else
+		if (pts < last_pts || pts > last_pts + MAX_SKIP_FRAMES*frame_duration) {
+			seek(pts);
+		}
+
+		// frames far from the requested one are skipped without conversion
+		while(decode_next()) {
+			if (last_pts + frame_duration*FRAME_RING_SIZE > pts)
+				push_frame();
+			if (last_pts + frame_duration > pts)
+				break;
+		}
+
+		if (const Frame *f = find(pts))
+			{ surface = f->surface; return true; }
+		if (ring.empty())
+			return false;
+		// before the beginning or after the end of video show the first or the last frame
+		surface = (pts < ring.front().pts ? ring.front() : ring.back()).surface;
+		return true;
+	}
+};
+
+/* === M E T H O D S ======================================================= */
 
 Importer_LibAVCodec::Importer_LibAVCodec(const synfig::FileSystem::Identifier &identifier):
-	Importer(identifier)
+	Importer(identifier),
+	internal(new Internal())
 {
+	if (!internal->open(identifier.filename))
+		synfig::warning("Importer_LibAVCodec: unable to initialize decoder");
 }
 
 Importer_LibAVCodec::~Importer_LibAVCodec()
-{
-}
+	{ delete internal; }
 
 bool
-Importer_LibAVCodec::get_frame(Surface &/*surface*/, const RendDesc &/*renddesc*/, Time /*time*/, ProgressCallback */*callback*/)
-{
-	return false;
-}
+Importer_LibAVCodec::get_frame(Surface &surface, const RendDesc &/*renddesc*/, Time time, ProgressCallback */*callback*/)
+	{ return internal->get_frame(surface, time); }
+
+#endif
@@ -43,12 +43,15 @@ class Importer_LibAVCodec : public synfig::Importer
 SYNFIG_IMPORTER_MODULE_EXT
 
 private:
-	synfig::String filename;
+	class Internal;
+	Internal *internal;
 
 public:
-	Importer_LibAVCodec(const synfig::FileSystem::Identifier &identifier); 
+	Importer_LibAVCodec(const synfig::FileSystem::Identifier &identifier);
 	~Importer_LibAVCodec();
 
+	virtual bool is_animated() { return true; }
+
 	virtual bool get_frame(synfig::Surface &surface, const synfig::RendDesc &renddesc, synfig::Time time, synfig::ProgressCallback *callback);
 };
 
@@ -66,8 +66,14 @@ extern "C"
 #	include <cstring>
 #	include <algorithm>
 #	include <functional>
+#	include <deque>
+#	include <vector>
+#	include <thread>
+#	include <mutex>
+#	include <condition_variable>
 #	include <synfig/general.h>
 #	include <synfig/localization.h>
+#	include <synfig/color/common.h>
 #	include "trgt_av.h"
 #endif
 
@@ -81,6 +87,17 @@ using namespace synfig;
 using namespace std;
 using namespace etl;
 
+/* === M A C R O S ========================================================= */
+
+// limited ("TV") range, the default for YUV formats in libavcodec
+#define Y_FLOOR   (16.f)
+#define Y_RANGE   (219.f)
+#define UV_CENTER (128.f)
+#define UV_RANGE  (224.f)
+
+// how many converted frames may wait for the encoder thread
+#define FRAME_QUEUE_SIZE 2
+
 /* === I N F O ============================================================= */
 
 SYNFIG_TARGET_INIT(Target_LibAVCodec);
@@ -88,13 +105,106 @@ SYNFIG_TARGET_SET_NAME(Target_LibAVCodec,"libav");
 //Use some non-existing extension to disable exporting through this module
 //SYNFIG_TARGET_SET_EXT(Target_LibAVCodec,"avi");
 SYNFIG_TARGET_SET_EXT(Target_LibAVCodec,"NONEXISTING-EXTENSION");
-SYNFIG_TARGET_SET_VERSION(Target_LibAVCodec,"0.2");
+SYNFIG_TARGET_SET_VERSION(Target_LibAVCodec,"0.3");
 SYNFIG_TARGET_SET_CVS_ID(Target_LibAVCodec,"$Id$");
 
+/* === P R O C E D U R E S ================================================= */
+
+namespace {
+
+// Loops below are written without branches and with plain float arithmetic
+// so the compiler is able to vectorize them.
+
+inline unsigned char
+clamp_to_byte(float x)
+	{ return (unsigned char)std::min(std::max(x, 0.f), 255.f); }
+
+void
+convert_row_y(unsigned char *dst, const Color *src, int width)
+{
+	// 0.5 is added for rounding
+	const float kr = EncodeYUV[0][0]*Y_RANGE;
+	const float kg = EncodeYUV[0][1]*Y_RANGE;
+	const float kb = EncodeYUV[0][2]*Y_RANGE;
+	const float k0 = Y_FLOOR + 0.5f;
+	for(int i = 0; i < width; ++i)
+		dst[i] = clamp_to_byte(k0 + kr*src[i].get_r() + kg*src[i].get_g() + kb*src[i].get_b());
+}
+
+inline void
+convert_uv(unsigned char &u, unsigned char &v, float r, float g, float b)
+{
+	const float k0 = UV_CENTER + 0.5f;
+	u = clamp_to_byte(k0 + UV_RANGE*(EncodeYUV[1][0]*r + EncodeYUV[1][1]*g + EncodeYUV[1][2]*b));
+	v = clamp_to_byte(k0 + UV_RANGE*(EncodeYUV[2][0]*r + EncodeYUV[2][1]*g + EncodeYUV[2][2]*b));
+}
+
+void
+convert_row_uv444(unsigned char *dst_u, unsigned char *dst_v, const Color *src, int width)
+{
+	for(int i = 0; i < width; ++i)
+		convert_uv(dst_u[i], dst_v[i], src[i].get_r(), src[i].get_g(), src[i].get_b());
+}
+
+//! average each 2x2 block of \a src0 and \a src1 rows into one chroma sample
+void
+convert_row_uv420(unsigned char *dst_u, unsigned char *dst_v, const Color *src0, const Color *src1, int width)
+{
+	const int pairs = width/2;
+	for(int i = 0; i < pairs; ++i) {
+		const Color &a = src0[2*i], &b = src0[2*i + 1], &c = src1[2*i], &d = src1[2*i + 1];
+		convert_uv( dst_u[i], dst_v[i],
+			0.25f*(a.get_r() + b.get_r() + c.get_r() + d.get_r()),
+			0.25f*(a.get_g() + b.get_g() + c.get_g() + d.get_g()),
+			0.25f*(a.get_b() + b.get_b() + c.get_b() + d.get_b()) );
+	}
+	if (width & 1) {
+		const Color &a = src0[width - 1], &c = src1[width - 1];
+		convert_uv( dst_u[pairs], dst_v[pairs],
+			0.5f*(a.get_r() + c.get_r()),
+			0.5f*(a.get_g() + c.get_g()),
+			0.5f*(a.get_b() + c.get_b()) );
+	}
+}
+
+//! converts \a surface into planar YUV420P or YUV444P \a frame
+void
+convert_frame(AVFrame &frame, const Surface &surface, int width, int height)
+{
+	for(int y = 0; y < height; ++y)
+		convert_row_y(frame.data[0] + y*frame.linesize[0], surface[y], width);
+
+	if (frame.format == AV_PIX_FMT_YUV444P) {
+		for(int y = 0; y < height; ++y)
+			convert_row_uv444(
+				frame.data[1] + y*frame.linesize[1],
+				frame.data[2] + y*frame.linesize[2],
+				surface[y],
+				width );
+	} else {
+		for(int y = 0; y < height; y += 2)
+			convert_row_uv420(
+				frame.data[1] + (y/2)*frame.linesize[1],
+				frame.data[2] + (y/2)*frame.linesize[2],
+				surface[y],
+				surface[std::min(y + 1, height - 1)],
+				width );
+	}
+}
+
+} // end of anonymous namespace
+
 /* === C L A S S E S & S T R U C T S ======================================= */
 
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
 static bool av_registered = false;
+#endif
 
+/*!	Frames are converted to YUV by the rendering thread and then passed
+**	to the encoder thread, so encoding of the frame overlaps with rendering
+**	of the next one. Frame buffers are recycled through \a free_frames,
+**	which also limits the amount of frames waiting for the encoder.
+*/
 class Target_LibAVCodec::Internal
 {
 private:
@@ -106,20 +216,68 @@ private:
 	const AVCodec *video_codec;
 	AVStream *video_stream;
 	AVCodecContext *video_context;
-	AVFrame *video_frame;
-	AVFrame *video_frame_rgb;
+	int64_t video_pts;
+
+	// used only when codec doesn't accept neither YUV420P nor YUV444P
+	AVFrame *video_frame_yuv;
 	SwsContext *video_swscale_context;
 
-	bool add_video_stream(enum AVCodecID codec_id, const RendDesc &desc) {
+	std::vector<AVFrame*> frames;
+	std::deque<AVFrame*> free_frames;
+	std::deque<AVFrame*> queued_frames;
+
+	std::thread encoder_thread;
+	std::mutex mutex;
+	std::condition_variable cond;
+	bool stopping;
+	bool failed;
+
+	static AVPixelFormat choose_pixel_format(const AVCodec &codec) {
+		if (!codec.pix_fmts)
+			return AV_PIX_FMT_YUV420P;
+		for(const AVPixelFormat *f = codec.pix_fmts; *f != AV_PIX_FMT_NONE; ++f)
+			if (*f == AV_PIX_FMT_YUV420P) return *f;
+		for(const AVPixelFormat *f = codec.pix_fmts; *f != AV_PIX_FMT_NONE; ++f)
+			if (*f == AV_PIX_FMT_YUV444P) return *f;
+		return codec.pix_fmts[0];
+	}
+
+	static AVFrame* alloc_frame(AVPixelFormat format, int width, int height) {
+		AVFrame *frame = av_frame_alloc();
+		assert(frame);
+		frame->format = format;
+		frame->width  = width;
+		frame->height = height;
+		if (av_frame_get_buffer(frame, 32) < 0) {
+			av_frame_free(&frame);
+			return NULL;
+		}
+		return frame;
+	}
+
+	bool add_video_stream(const TargetParam &params, const RendDesc &desc) {
 		// find the video encoder
-		video_codec = avcodec_find_encoder(codec_id);
+		if (!params.video_codec.empty() && params.video_codec != "none") {
+			video_codec = avcodec_find_encoder_by_name(params.video_codec.c_str());
+			if (!video_codec)
+				synfig::warning( "Target_LibAVCodec: video codec '%s' not found, using default for the format",
+								 params.video_codec.c_str() );
+		}
+		if (!video_codec) {
+			if (context->oformat->video_codec == AV_CODEC_ID_NONE) {
+				synfig::error("Target_LibAVCodec: selected format (%s) does not support video", context->oformat->name);
+				close();
+				return false;
+			}
+			video_codec = avcodec_find_encoder(context->oformat->video_codec);
+		}
 		if (!video_codec) {
 			synfig::error("Target_LibAVCodec: video codec not found");
 			close();
 			return false;
 		}
 
-		video_stream = avformat_new_stream(context, video_codec);
+		video_stream = avformat_new_stream(context, NULL);
 		if (!video_stream) {
 			synfig::error("Target_LibAVCodec: could not allocate video stream");
 			close();
@@ -135,14 +293,18 @@ private:
 
 		// set parameters
 		int fps = (int)roundf(desc.get_frame_rate());
-		video_context->bit_rate     = 400*1024*1024/3600; // 400Mb per hour
-		video_context->width        = desc.get_w();       // in most cases resolution must be multiple of two
+		video_context->bit_rate     = params.bitrate > 0
+		                            ? params.bitrate*1000      // kbit/s, same as in ffmpeg target
+		                            : 400*1024*1024/3600;      // 400Mb per hour
+		video_context->width        = desc.get_w();            // in most cases resolution must be multiple of two
 		video_context->height       = desc.get_h();
 		video_context->coded_width  = video_context->width;
 		video_context->coded_height = video_context->height;
-		video_context->pix_fmt      = AV_PIX_FMT_YUV420P;
-		video_context->gop_size     = fps;                // emit one intra frame every second
-		video_context->mb_decision  = FF_MB_DECISION_RD;  // use best acroblock decision algorithm
+		video_context->pix_fmt      = choose_pixel_format(*video_codec);
+		video_context->color_range  = AVCOL_RANGE_MPEG;
+		video_context->colorspace   = AVCOL_SPC_BT470BG;       // coefficients from EncodeYUV
+		video_context->gop_size     = fps;                     // emit one intra frame every second
+		video_context->mb_decision  = FF_MB_DECISION_RD;       // use best acroblock decision algorithm
 		video_context->framerate    = (AVRational){ fps, 1 };
 		video_context->time_base    = (AVRational){ 1, fps };
 		video_stream->time_base     = video_context->time_base;
@@ -152,7 +314,7 @@ private:
 			video_context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
 
 		return true;
-    }
+	}
 
 	bool open_video_stream() {
 		if (avcodec_open2(video_context, NULL, NULL) < 0) {
@@ -162,41 +324,38 @@ private:
 			video_context = NULL;
 			close();
 			return false;
-        }
-
-		// allocate frame
-		video_frame = av_frame_alloc();
-		assert(video_frame);
-		video_frame->format = video_context->pix_fmt;
-		video_frame->width  = video_context->width;
-		video_frame->height = video_context->height;
-		video_frame->pts    = 0;
-		if (av_frame_get_buffer(video_frame, 32) < 0) {
-			synfig::error("Target_LibAVCodec: could not allocate the video frame data");
-			close();
-			return false;
 		}
 
-		// if the output format is not RGB24, then a temporary picture is needed too.
-		if (video_frame->format != AV_PIX_FMT_RGB24) {
-			video_frame_rgb = av_frame_alloc();
-			assert(video_frame_rgb);
-			video_frame_rgb->format = AV_PIX_FMT_RGB24;
-			video_frame_rgb->width  = video_frame->width;
-			video_frame_rgb->height = video_frame->height;
-			if (av_frame_get_buffer(video_frame_rgb, 32) < 0) {
+		// allocate frames
+		for(int i = 0; i < FRAME_QUEUE_SIZE + 1; ++i) {
+			AVFrame *frame = alloc_frame(video_context->pix_fmt, video_context->width, video_context->height);
+			if (!frame) {
+				synfig::error("Target_LibAVCodec: could not allocate the video frame data");
+				close();
+				return false;
+			}
+			frames.push_back(frame);
+			free_frames.push_back(frame);
+		}
+
+		// if the output format is not a planar YUV, then a temporary picture is needed too.
+		if ( video_context->pix_fmt != AV_PIX_FMT_YUV420P
+		  && video_context->pix_fmt != AV_PIX_FMT_YUV444P )
+		{
+			video_frame_yuv = alloc_frame(AV_PIX_FMT_YUV444P, video_context->width, video_context->height);
+			if (!video_frame_yuv) {
 				synfig::error("Target_LibAVCodec: could not allocate the temporary video frame data");
 				close();
 				return false;
 			}
 
 			video_swscale_context = sws_getContext(
-				video_frame_rgb->width,
-				video_frame_rgb->height,
-				(AVPixelFormat)video_frame_rgb->format,
-				video_frame->width,
-				video_frame->height,
-				(AVPixelFormat)video_frame->format,
+				video_frame_yuv->width,
+				video_frame_yuv->height,
+				(AVPixelFormat)video_frame_yuv->format,
+				video_context->width,
+				video_context->height,
+				video_context->pix_fmt,
 				SWS_BICUBIC, NULL, NULL, NULL );
 			if (!video_swscale_context) {
 				synfig::error("Target_LibAVCodec: cannot initialize the conversion context");
@@ -215,6 +374,76 @@ private:
 		return true;
 	}
 
+	//! sends \a frame (or NULL to flush) to the encoder and writes all available packets,
+	//! called from the encoder thread only
+	bool write_frame(AVFrame *frame) {
+		if (avcodec_send_frame(video_context, frame) < 0) {
+			synfig::error("Target_LibAVCodec: error sending a frame for encoding");
+			return false;
+		}
+		while(true) {
+			int res = avcodec_receive_packet(video_context, packet);
+			if (res == AVERROR(EAGAIN) || res == AVERROR_EOF)
+				break;
+			if (res) {
+				synfig::error("Target_LibAVCodec: error during encoding");
+				return false;
+			}
+
+			av_packet_rescale_ts(packet, video_context->time_base, video_stream->time_base);
+			packet->stream_index = video_stream->index;
+
+			res = av_interleaved_write_frame(context, packet);
+			av_packet_unref(packet);
+			if (res < 0) {
+				synfig::error("Target_LibAVCodec: error while writing video frame");
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void encoder_loop() {
+		while(true) {
+			AVFrame *frame = NULL;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cond.wait(lock, [this]{ return stopping || !queued_frames.empty(); });
+				if (queued_frames.empty())
+					break;
+				frame = queued_frames.front();
+				queued_frames.pop_front();
+			}
+
+			// encoder keeps own reference to the frame buffers when it needs them,
+			// so the frame is reusable right after sending
+			bool success = write_frame(frame);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			free_frames.push_back(frame);
+			if (!success) failed = true;
+			cond.notify_all();
+			if (failed) return;
+		}
+
+		// flush delayed frames
+		if (!write_frame(NULL)) {
+			std::lock_guard<std::mutex> lock(mutex);
+			failed = true;
+		}
+	}
+
+	void stop_encoder_thread() {
+		if (!encoder_thread.joinable())
+			return;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		cond.notify_all();
+		encoder_thread.join();
+	}
+
 public:
 	Internal():
 		context(),
@@ -224,56 +453,52 @@ public:
 		video_codec(),
 		video_stream(),
 		video_context(),
-		video_frame(),
-		video_frame_rgb(),
-		video_swscale_context()
+		video_pts(),
+		video_frame_yuv(),
+		video_swscale_context(),
+		stopping(),
+		failed()
 	{ }
 	~Internal() { close(); }
 
-	bool open(const String &filename, const RendDesc &desc) {
+	bool is_failed() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return failed;
+	}
+
+	void set_failed() {
+		std::lock_guard<std::mutex> lock(mutex);
+		failed = true;
+	}
+
+	bool open(const String &filename, const TargetParam &params, const RendDesc &desc) {
 		close();
+		// stays failed if the encoder is not opened
+		failed = true;
 
+		#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
 		if (!av_registered) {
 			av_register_all();
 			av_registered = true;
 		}
+		#endif
 
-		// guess format
-		AVOutputFormat *format = av_guess_format(NULL, filename.c_str(), NULL);
-		if (!format) {
+		// allocate output media context, guess format
+		if (avformat_alloc_output_context2(&context, NULL, NULL, filename.c_str()) < 0 || !context) {
 			synfig::warning("Target_LibAVCodec: unable to guess the output format, defaulting to MPEG");
-			format = av_guess_format("mpeg", NULL, NULL);
-		}
-		if (!format) {
-			synfig::error("Target_LibAVCodec: unable to find 'mpeg' output format");
-			close();
-			return false;
-		}
-
-		// allocate output media context.
-		context = avformat_alloc_context();
-		assert(context);
-		context->oformat = format;
-		if (filename.size() + 1 > sizeof(context->filename)) {
-			synfig::error(
-				"Target_LibAVCodec: filename too long, max length is %d, filename is '%s'",
-				sizeof(context->filename) - 1,
-				filename.c_str() );
-			close();
-			return false;
+			if (avformat_alloc_output_context2(&context, NULL, "mpeg", filename.c_str()) < 0 || !context) {
+				synfig::error("Target_LibAVCodec: unable to find 'mpeg' output format");
+				context = NULL;
+				close();
+				return false;
+			}
 		}
-		memcpy(context->filename, filename.c_str(), filename.size() + 1);
 
 		packet = av_packet_alloc();
 		assert(packet);
 
 		// add video stream
-		if (format->video_codec == AV_CODEC_ID_NONE) {
-			synfig::error("Target_LibAVCodec: selected format (%s) does not support video", format->name);
-			close();
-			return false;
-		}
-		if (!add_video_stream(format->video_codec, desc))
+		if (!add_video_stream(params, desc))
 			return false;
 		if (!open_video_stream())
 			return false;
@@ -282,7 +507,7 @@ public:
 		av_dump_format(context, 0, filename.c_str(), 1);
 
 		// open the output file, if needed
-		if (!(format->flags & AVFMT_NOFILE)) {
+		if (!(context->oformat->flags & AVFMT_NOFILE)) {
 			if (avio_open(&context->pb, filename.c_str(), AVIO_FLAG_WRITE) < 0) {
 				synfig::error("Target_LibAVCodec: could not open file for write: %s", filename.c_str());
 				close();
@@ -290,102 +515,105 @@ public:
 			}
 			file_opened = true;
 		} else {
-	    	synfig::warning("Target_LibAVCodec: selected format (%s) does not write data to file.", format->name);
+			synfig::warning("Target_LibAVCodec: selected format (%s) does not write data to file.", context->oformat->name);
 		}
 
 		// write the stream header, if any.
 		if (avformat_write_header(context, NULL) < 0) {
 			synfig::error("Target_LibAVCodec: could not write header");
 			close();
-            return false;
+			return false;
 		}
+		headers_sent = true;
+
+		stopping = false;
+		failed = false;
+		encoder_thread = std::thread(&Internal::encoder_loop, this);
 
 		return true;
 	}
 
 	bool encode_frame(const Surface &surface, bool last_frame) {
-		assert(context);
-		if (!context) return false;
+		if (is_failed()) return false;
+		if (!context) {
+			synfig::error("Target_LibAVCodec: encoder is not opened");
+			set_failed();
+			return false;
+		}
+
+		// take a free frame, wait for the encoder when all of them are queued
+		AVFrame *frame = NULL;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [this]{ return failed || !free_frames.empty(); });
+			if (!failed) {
+				frame = free_frames.front();
+				free_frames.pop_front();
+			}
+		}
+		if (!frame) {
+			close();
+			return false;
+		}
 
 		// convert frame
 
-		AVFrame *frame_rgb = video_swscale_context ? video_frame_rgb : video_frame;
-		int w = std::min(frame_rgb->width, surface.get_w());
-		int h = std::max(frame_rgb->height, surface.get_h());
+		int w = std::min(frame->width, surface.get_w());
+		int h = std::min(frame->height, surface.get_h());
 		if (w != surface.get_w() || h != surface.get_h())
 			synfig::warning(
 				"Target_LibAVCodec: frame size (%d, %d) does not match to initial RendDesc (%d, %d)",
 				surface.get_w(), surface.get_h(), w, h );
 
-		if (av_frame_make_writable(frame_rgb) < 0) {
-	    	synfig::error("Target_LibAVCodec: could not make frame data writable");
+		if (av_frame_make_writable(frame) < 0) {
+			synfig::error("Target_LibAVCodec: could not make frame data writable");
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				free_frames.push_back(frame);
+			}
+			set_failed();
 			close();
 			return false;
 		}
 
-		color_to_pixelformat(
-			(unsigned char *)frame_rgb->data[0],
-			surface[0],
-			PF_RGB,
-			0,
-			w,
-			h,
-			frame_rgb->linesize[0],
-			surface.get_pitch() );
-
-		if (video_swscale_context)
+		if (video_swscale_context) {
+			convert_frame(*video_frame_yuv, surface, w, h);
 			sws_scale(
 				video_swscale_context,
-				(const uint8_t * const *)video_frame_rgb->data,
-				video_frame_rgb->linesize,
+				(const uint8_t * const *)video_frame_yuv->data,
+				video_frame_yuv->linesize,
 				0,
-				video_frame->height,
-				video_frame->data,
-				video_frame->linesize );
-
-		// encode frame
-
-		if (avcodec_send_frame(video_context, video_frame) < 0) {
-			synfig::error("Target_LibAVCodec: error sending a frame for encoding");
-			close();
-			return false;
+				video_frame_yuv->height,
+				frame->data,
+				frame->linesize );
+		} else {
+			convert_frame(*frame, surface, w, h);
 		}
-		while(true) {
-			int res = avcodec_receive_packet(video_context, packet);
-			if (res == AVERROR(EAGAIN) || res == AVERROR_EOF)
-				break;
-			if (res) {
-				synfig::error("Target_LibAVCodec: error during encoding");
-				close();
-				return false;
-			}
-
-			av_packet_rescale_ts(packet, video_context->time_base, video_stream->time_base);
-			packet->stream_index = video_stream->index;
+		frame->pts = video_pts++;
 
-			res = av_interleaved_write_frame(context, packet);
-			av_packet_unref(packet);
-			if (res < 0) {
-				synfig::error("Target_LibAVCodec: error while writing video frame");
-				close();
-				return false;
-			}
-	    }
+		// pass frame to the encoder thread
 
-	    // increment frame counter
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queued_frames.push_back(frame);
+		}
+		cond.notify_all();
 
 		if (last_frame)
-			close();
-		else
-			++video_frame->pts;
-
+			return close();
 		return true;
 	}
 
-	void close() {
+	//! waits for encoder thread, writes trailer and releases all resources,
+	//! returns false if encoding was failed, failure stays until the next open()
+	bool close() {
+		stop_encoder_thread();
+
 		if (headers_sent) {
-			if (av_write_trailer(context) < 0)
+			if (av_write_trailer(context) < 0) {
 				synfig::error("Target_LibAVCodec: could not write format trailer");
+				failed = true;
+			}
 			headers_sent = false;
 		}
 
@@ -394,10 +622,17 @@ public:
 			sws_freeContext(video_swscale_context);
 			video_swscale_context = NULL;
 		}
-		if (video_frame) av_frame_free(&video_frame);
-		if (video_frame_rgb) av_frame_free(&video_frame_rgb);
+		if (video_frame_yuv) av_frame_free(&video_frame_yuv);
+		for(std::vector<AVFrame*>::iterator i = frames.begin(); i != frames.end(); ++i)
+			av_frame_free(&*i);
+		frames.clear();
+		free_frames.clear();
+		queued_frames.clear();
 		video_stream = NULL;
 		video_codec = NULL;
+		video_pts = 0;
+
+		if (packet) av_packet_free(&packet);
 
 		if (context) {
 			if (file_opened) {
@@ -408,6 +643,9 @@ public:
 			avformat_free_context(context);
 			context = NULL;
 		}
+
+		stopping = false;
+		return !failed;
 	}
 };
 
@@ -415,10 +653,11 @@ public:
 
 Target_LibAVCodec::Target_LibAVCodec(
 	const char *filename,
-	const synfig::TargetParam &/*params*/
+	const synfig::TargetParam &params
 ):
 	internal(new Internal()),
-	filename(filename)
+	filename(filename),
+	params(params)
 { }
 
 Target_LibAVCodec::~Target_LibAVCodec()
@@ -462,11 +701,15 @@ Target_LibAVCodec::set_rend_desc(RendDesc *given_desc)
 
 void
 Target_LibAVCodec::end_frame()
-	{ internal->encode_frame(surface, curr_frame_ > desc.get_frame_end()); }
+{
+	// failure stays in internal, so the next start_frame() fails too
+	if (!internal->encode_frame(surface, curr_frame_ > desc.get_frame_end()))
+		set_write_failed();
+}
 
 bool
 Target_LibAVCodec::start_frame(synfig::ProgressCallback */*callback*/)
-	{ return true; }
+	{ return !internal->is_failed(); }
 
 Color*
 Target_LibAVCodec::start_scanline(int scanline)
@@ -479,7 +722,7 @@ Target_LibAVCodec::end_scanline()
 bool Target_LibAVCodec::init(synfig::ProgressCallback */*cb*/)
 {
 	surface.set_wh(desc.get_w(), desc.get_h());
-	if (!internal->open(filename, desc)) {
+	if (!internal->open(filename, params, desc)) {
 		synfig::warning("Target_LibAVCodec: unable to initialize encoders");
 		return false;
 	}
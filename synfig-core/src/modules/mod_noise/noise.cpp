@@ -91,113 +91,33 @@ void
 Noise::compile()
 	{ compiled_gradient.set(param_gradient.get(Gradient()) ); }
 
-inline Color
-Noise::color_func(const Point &point, float pixel_size,Context /*context*/)const
+FractalNoise
+Noise::get_fractal_noise()const
 {
-	Vector size=param_size.get(Vector());
-	RandomNoise random;
-	random.set_seed(param_random.get(int()));
-	int smooth_=param_smooth.get(int());
-	int detail=param_detail.get(int());
-	Real speed=param_speed.get(Real());
-	bool turbulent=param_turbulent.get(bool());
-	bool do_alpha=param_do_alpha.get(bool());
-	bool super_sample=param_super_sample.get(bool());
-	
-
-	Color ret(0,0,0,0);
+	FractalNoise noise;
+	noise.random.set_seed(param_random.get(int()));
+	noise.size=param_size.get(Vector());
+	noise.detail=param_detail.get(int());
+	noise.turbulent=param_turbulent.get(bool());
+	noise.do_alpha=param_do_alpha.get(bool());
+	noise.super_sample=param_super_sample.get(bool());
 
-	float x(point[0]/size[0]*(1<<detail));
-	float y(point[1]/size[1]*(1<<detail));
-	float x2(0),y2(0);
-
-	if(super_sample&&pixel_size)
-	{
-		x2=(point[0]+pixel_size)/size[0]*(1<<detail);
-		y2=(point[1]+pixel_size)/size[1]*(1<<detail);
-	}
+	Real speed=param_speed.get(Real());
+	int smooth=param_smooth.get(int());
+	if (!speed && smooth == (int)RandomNoise::SMOOTH_SPLINE)
+		smooth = (int)RandomNoise::SMOOTH_FAST_SPLINE;
+	noise.smooth=RandomNoise::SmoothType(smooth);
 
-	int i;
 	Time time;
 	time=speed*get_time_mark();
-	int smooth((!speed && smooth_ == (int)RandomNoise::SMOOTH_SPLINE) ? (int)RandomNoise::SMOOTH_FAST_SPLINE : smooth_);
-
-	float ftime(time);
-
-	{
-		float amount=0.0f;
-		float amount2=0.0f;
-		float amount3=0.0f;
-		float alpha=0.0f;
-		for(i=0;i<detail;i++)
-		{
-			amount=random(RandomNoise::SmoothType(smooth),0+(detail-i)*5,x,y,ftime)+amount*0.5;
-			if (amount < -1) amount = -1;
-			if (amount >  1) amount =  1;
-
-			if(super_sample&&pixel_size)
-			{
-				amount2=random(RandomNoise::SmoothType(smooth),0+(detail-i)*5,x2,y,ftime)+amount2*0.5;
-				if (amount2 < -1) amount2 = -1;
-				if (amount2 >  1) amount2 =  1;
-
-				amount3=random(RandomNoise::SmoothType(smooth),0+(detail-i)*5,x,y2,ftime)+amount3*0.5;
-				if (amount3 < -1) amount3 = -1;
-				if (amount3 >  1) amount3 =  1;
-
-				if(turbulent)
-				{
-					amount2=abs(amount2);
-					amount3=abs(amount3);
-				}
-
-				x2*=0.5f;
-				y2*=0.5f;
-			}
-
-			if(do_alpha)
-			{
-				alpha=random(RandomNoise::SmoothType(smooth),3+(detail-i)*5,x,y,ftime)+alpha*0.5;
-				if (alpha < -1) alpha = -1;
-				if (alpha > 1) alpha = 1;
-			}
-
-			if(turbulent)
-			{
-				amount=abs(amount);
-				alpha=abs(alpha);
-			}
-
-			x*=0.5f;
-			y*=0.5f;
-			//ftime*=0.5f;
-		}
-
-		if(!turbulent)
-		{
-			amount=amount/2.0f+0.5f;
-			alpha=alpha/2.0f+0.5f;
-
-			if(super_sample&&pixel_size)
-			{
-				amount2=amount2/2.0f+0.5f;
-				amount3=amount3/2.0f+0.5f;
-			}
-		}
-
-		if(super_sample && pixel_size) {
-			Real da = max(amount3, max(amount,amount2)) - min(amount3, min(amount,amount2));
-			ret = compiled_gradient.average(amount - da, amount + da);
-		} else {
-			ret = compiled_gradient.color(amount);
-		}
-
-		if(do_alpha)
-			ret.set_a(ret.get_a()*(alpha));
-	}
-	return ret;
+	noise.time=float(time);
+	return noise;
 }
 
+inline Color
+Noise::color_func(const Point &point, float pixel_size,Context /*context*/)const
+	{ return get_fractal_noise().color(compiled_gradient, point, pixel_size); }
+
 inline float
 Noise::calc_supersample(const synfig::Point &/*x*/, float /*pw*/,float /*ph*/)const
 {
@@ -381,3 +301,12 @@ Noise::accelerated_render(Context context,Surface *surface,int quality, const Re
 
 	return true;
 }
+
+rendering::Task::Handle
+Noise::build_composite_task_vfunc(ContextParams /* context_params */)const
+{
+	TaskNoise::Handle task(new TaskNoise());
+	task->gradient = compiled_gradient;
+	task->noise = get_fractal_noise();
+	return task;
+}
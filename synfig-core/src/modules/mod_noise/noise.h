@@ -36,6 +36,7 @@
 #include <synfig/gradient.h>
 #include <synfig/time.h>
 #include "random_noise.h"
+#include "tasknoise.h"
 
 /* === M A C R O S ========================================================= */
 
@@ -70,6 +71,7 @@ private:
 	synfig::CompiledGradient compiled_gradient;
 
 	void compile();
+	FractalNoise get_fractal_noise()const;
 	synfig::Color color_func(const synfig::Point &x, float supersample,synfig::Context context)const;
 	float calc_supersample(const synfig::Point &x, float pw,float ph)const;
 
@@ -83,6 +85,9 @@ public:
 	virtual bool accelerated_render(synfig::Context context,synfig::Surface *surface,int quality, const synfig::RendDesc &renddesc, synfig::ProgressCallback *cb)const;
 	synfig::Layer::Handle hit_check(synfig::Context context, const synfig::Point &point)const;
 	virtual Vocab get_param_vocab()const;
+
+protected:
+	virtual synfig::rendering::Task::Handle build_composite_task_vfunc(synfig::ContextParams context_params)const;
 };
 
 /* === E N D =============================================================== */
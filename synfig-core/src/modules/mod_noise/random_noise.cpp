@@ -32,10 +32,23 @@
 
 #include <synfig/general.h>
 #include <synfig/localization.h>
+#include <synfig/color/pixelformat.h>
 #include "random_noise.h"
-#include <synfig/quick_rng.h>
 #include <cmath>
 #include <cstdlib>
+
+#endif
+
+// vectorized interpolation is compiled with function-level target attributes,
+// and selected at runtime like conversions in synfig/color/pixelformat.cpp
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#	define NOISE_SSE2
+#	define NOISE_TARGET(x) __attribute__((target(x)))
+#	include <emmintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#	define NOISE_SSE2
+#	define NOISE_TARGET(x)
+#	include <emmintrin.h>
 #endif
 
 /* === M A C R O S ========================================================= */
@@ -47,6 +60,129 @@
 
 /* === P R O C E D U R E S ================================================= */
 
+#ifdef NOISE_SSE2
+namespace {
+
+NOISE_TARGET("sse2") inline __m128i
+mul_epi32(__m128i a, __m128i b)
+{
+	// SSE2 has no 32-bit multiplication, multiply even and odd lanes separately
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(
+		_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+		_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)) );
+}
+
+NOISE_TARGET("sse2") inline __m128i
+floor_epi32(__m128 x)
+{
+	__m128i i = _mm_cvttps_epi32(x);
+	// truncation rounds negative values up, so subtract one where it happened
+	return _mm_add_epi32(i, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(i), x)));
+}
+
+//! Same as RandomNoise::operator()(subseed, x, y, t) for four points,
+//! seed is (seed of RandomNoise + subseed)*31337 in each lane
+NOISE_TARGET("sse2") inline __m128
+hash4(__m128i seed, __m128i x, __m128i y, __m128i t)
+{
+	__m128i next = _mm_xor_si128(
+		_mm_xor_si128(
+			mul_epi32(_mm_add_epi32(x, y), _mm_set1_epi32(21870)),
+			mul_epi32(_mm_add_epi32(y, t), _mm_set1_epi32(11213)) ),
+		_mm_xor_si128(
+			mul_epi32(_mm_add_epi32(t, x), _mm_set1_epi32(36979)),
+			seed ));
+
+	// quick_rng::f()*2 - 1
+	next = _mm_add_epi32(mul_epi32(next, _mm_set1_epi32(1664525)), _mm_set1_epi32(1013904223));
+	__m128 f = _mm_div_ps(_mm_cvtepi32_ps(_mm_srli_epi32(next, 16)), _mm_set1_ps(65535.f));
+	return _mm_sub_ps(_mm_add_ps(f, f), _mm_set1_ps(1.f));
+}
+
+//! Vectorized part of RandomNoise::sample_row() for linear and cosine smoothing,
+//! \a seed_sum is (seed of RandomNoise + subseed), returns count of processed points.
+//! Operations are the same as in sample(), so results are exactly the same
+template<RandomNoise::SmoothType smooth>
+NOISE_TARGET("sse2") int
+sample_row_sse2(float *dst,int count,unsigned int seed_sum,const float *xf,const float *yf,float tf,int loop)
+{
+	int i = 0;
+	int t((int)floor(tf));
+	int t0 = t, t1 = t + 1;
+	if (loop)
+	{
+		t0 = t % loop;	if (t0 <  0   ) t0 += loop;
+		t1 = t0 + 1;	if (t1 >= loop) t1 -= loop;
+	}
+	const bool flat = (float)t == tf;
+	const float c = tf - t;
+	const float f = 1.0 - c;
+
+	const __m128i seed = _mm_set1_epi32((int)(seed_sum*31337u));
+	const __m128i vt0 = _mm_set1_epi32(t0);
+	const __m128i vt1 = _mm_set1_epi32(t1);
+	const __m128i one_i = _mm_set1_epi32(1);
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 vc = _mm_set1_ps(c);
+	const __m128 vf = _mm_set1_ps(f);
+
+	for(; i + 4 <= count; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(xf + i);
+		const __m128 y = _mm_loadu_ps(yf + i);
+		const __m128i x1 = floor_epi32(x);
+		const __m128i y1 = floor_epi32(y);
+		const __m128i x2 = _mm_add_epi32(x1, one_i);
+		const __m128i y2 = _mm_add_epi32(y1, one_i);
+		__m128 a = _mm_sub_ps(x, _mm_cvtepi32_ps(x1));
+		__m128 b = _mm_sub_ps(y, _mm_cvtepi32_ps(y1));
+
+		if (smooth == RandomNoise::SMOOTH_COSINE)
+		{
+			float aa[4], bb[4];
+			_mm_storeu_ps(aa, a);
+			_mm_storeu_ps(bb, b);
+			for(int j = 0; j < 4; ++j)
+			{
+				aa[j]=(1.0f-cos(aa[j]*PI))*0.5f;
+				bb[j]=(1.0f-cos(bb[j]*PI))*0.5f;
+			}
+			a = _mm_loadu_ps(aa);
+			b = _mm_loadu_ps(bb);
+		}
+
+		const __m128 d = _mm_sub_ps(one, a);
+		const __m128 e = _mm_sub_ps(one, b);
+
+		__m128 v;
+		if (flat)
+		{
+			v =                _mm_mul_ps(hash4(seed, x1, y1, vt0), _mm_mul_ps(d, e));
+			v = _mm_add_ps(v, _mm_mul_ps(hash4(seed, x2, y1, vt0), _mm_mul_ps(a, e)));
+			v = _mm_add_ps(v, _mm_mul_ps(hash4(seed, x1, y2, vt0), _mm_mul_ps(d, b)));
+			v = _mm_add_ps(v, _mm_mul_ps(hash4(seed, x2, y2, vt0), _mm_mul_ps(a, b)));
+		}
+		else
+		{
+			v =                _mm_mul_ps(hash4(seed, x1, y1, vt0), _mm_mul_ps(_mm_mul_ps(d, e), vf));
+			v = _mm_add_ps(v, _mm_mul_ps(hash4(seed, x2, y1, vt0), _mm_mul_ps(_mm_mul_ps(a, e), vf)));
+			v = _mm_add_ps(v, _mm_mul_ps(hash4(seed, x1, y2, vt0), _mm_mul_ps(_mm_mul_ps(d, b), vf)));
+			v = _mm_add_ps(v, _mm_mul_ps(hash4(seed, x2, y2, vt0), _mm_mul_ps(_mm_mul_ps(a, b), vf)));
+			v = _mm_add_ps(v, _mm_mul_ps(hash4(seed, x1, y1, vt1), _mm_mul_ps(_mm_mul_ps(d, e), vc)));
+			v = _mm_add_ps(v, _mm_mul_ps(hash4(seed, x2, y1, vt1), _mm_mul_ps(_mm_mul_ps(a, e), vc)));
+			v = _mm_add_ps(v, _mm_mul_ps(hash4(seed, x1, y2, vt1), _mm_mul_ps(_mm_mul_ps(d, b), vc)));
+			v = _mm_add_ps(v, _mm_mul_ps(hash4(seed, x2, y2, vt1), _mm_mul_ps(_mm_mul_ps(a, b), vc)));
+		}
+		_mm_storeu_ps(dst + i, v);
+	}
+	return i;
+}
+
+} // end of anonimous namespace
+#endif
+
 /* === M E T H O D S ======================================================= */
 
 void
@@ -55,26 +191,9 @@ RandomNoise::set_seed(int x)
 	seed_=x;
 }
 
+template<RandomNoise::SmoothType smooth>
 float
-RandomNoise::operator()(const int salt,const int x,const int y,const int t)const
-{
-	static const unsigned int a(21870);
-	static const unsigned int b(11213);
-	static const unsigned int c(36979);
-	static const unsigned int d(31337);
-
-	quick_rng rng(
-		( static_cast<unsigned int>(x+y)        * a ) ^
-		( static_cast<unsigned int>(y+t)        * b ) ^
-		( static_cast<unsigned int>(t+x)        * c ) ^
-		( static_cast<unsigned int>(seed_+salt) * d )
-	);
-
-	return rng.f() * 2.0f - 1.0f;
-}
-
-float
-RandomNoise::operator()(SmoothType smooth,int subseed,float xf,float yf,float tf,int loop)const
+RandomNoise::sample(int subseed,float xf,float yf,float tf,int loop)const
 {
 	int x((int)floor(xf));
 	int y((int)floor(yf));
@@ -323,3 +442,43 @@ RandomNoise::operator()(SmoothType smooth,int subseed,float xf,float yf,float tf
 		return (*this)(subseed,x,y,t0);
 	}
 }
+
+template<RandomNoise::SmoothType smooth>
+void
+RandomNoise::sample_row(float *dst,int count,int subseed,const float *xf,const float *yf,float tf,int loop)const
+{
+	int i = 0;
+
+#ifdef NOISE_SSE2
+	if ((smooth == SMOOTH_LINEAR || smooth == SMOOTH_COSINE) && synfig::get_pixelformat_simd() >= synfig::PF_SIMD_SSE2)
+		i = sample_row_sse2<smooth>(dst, count, static_cast<unsigned int>(seed_+subseed), xf, yf, tf, loop);
+#endif
+
+	for(; i < count; ++i)
+		dst[i] = sample<smooth>(subseed, xf[i], yf[i], tf, loop);
+}
+
+float
+RandomNoise::operator()(SmoothType smooth,int subseed,float xf,float yf,float tf,int loop)const
+{
+	switch(smooth)
+	{
+	case SMOOTH_CUBIC:       return sample<SMOOTH_CUBIC>(subseed,xf,yf,tf,loop);
+	case SMOOTH_FAST_SPLINE: return sample<SMOOTH_FAST_SPLINE>(subseed,xf,yf,tf,loop);
+	case SMOOTH_SPLINE:      return sample<SMOOTH_SPLINE>(subseed,xf,yf,tf,loop);
+	case SMOOTH_COSINE:      return sample<SMOOTH_COSINE>(subseed,xf,yf,tf,loop);
+	case SMOOTH_LINEAR:      return sample<SMOOTH_LINEAR>(subseed,xf,yf,tf,loop);
+	default:                 return sample<SMOOTH_DEFAULT>(subseed,xf,yf,tf,loop);
+	}
+}
+
+#define INSTANCE(smooth) \
+	template float RandomNoise::sample<smooth>(int,float,float,float,int)const; \
+	template void RandomNoise::sample_row<smooth>(float*,int,int,const float*,const float*,float,int)const;
+INSTANCE(RandomNoise::SMOOTH_DEFAULT)
+INSTANCE(RandomNoise::SMOOTH_LINEAR)
+INSTANCE(RandomNoise::SMOOTH_COSINE)
+INSTANCE(RandomNoise::SMOOTH_SPLINE)
+INSTANCE(RandomNoise::SMOOTH_CUBIC)
+INSTANCE(RandomNoise::SMOOTH_FAST_SPLINE)
+#undef INSTANCE
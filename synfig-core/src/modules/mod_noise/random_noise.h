@@ -28,6 +28,8 @@
 
 /* === H E A D E R S ======================================================= */
 
+#include <synfig/quick_rng.h>
+
 /* === M A C R O S ========================================================= */
 
 /* === T Y P E D E F S ===================================================== */
@@ -54,8 +56,35 @@ public:
 		SMOOTH_FAST_SPLINE	= 5,
 	};
 
-	float operator()(int subseed,int x,int y=0, int t=0)const;
+	float operator()(int subseed,int x,int y=0, int t=0)const
+	{
+		static const unsigned int a(21870);
+		static const unsigned int b(11213);
+		static const unsigned int c(36979);
+		static const unsigned int d(31337);
+
+		quick_rng rng(
+			( static_cast<unsigned int>(x+y)         * a ) ^
+			( static_cast<unsigned int>(y+t)         * b ) ^
+			( static_cast<unsigned int>(t+x)         * c ) ^
+			( static_cast<unsigned int>(seed_+subseed) * d )
+		);
+
+		return rng.f() * 2.0f - 1.0f;
+	}
+
 	float operator()(SmoothType smooth,int subseed,float x,float y=0,float t=0,int loop=0)const;
+
+	//! Same as operator()(smooth, subseed, x, y, t, loop), but type of smoothing
+	//! is known at compile time, so callers may choose it once for many samples.
+	//! Instantiated for all values of SmoothType in random_noise.cpp
+	template<SmoothType smooth>
+	float sample(int subseed,float x,float y=0,float t=0,int loop=0)const;
+
+	//! Fills dst by sample<smooth>(subseed, x[i], y[i], t, loop) for count points,
+	//! linear and cosine smoothing are vectorized
+	template<SmoothType smooth>
+	void sample_row(float *dst,int count,int subseed,const float *x,const float *y,float t=0,int loop=0)const;
 };
 
 /* === E N D =============================================================== */
@@ -0,0 +1,291 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file mod_noise/tasknoise.cpp
+**	\brief TaskNoise
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <synfig/surface.h>
+
+#include <synfig/rendering/common/task/taskblend.h>
+#include <synfig/rendering/software/task/tasksw.h>
+
+#include "tasknoise.h"
+
+#endif
+
+using namespace synfig;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+namespace {
+
+class TaskNoiseSW: public TaskNoise, public rendering::TaskSW,
+	public rendering::TaskInterfaceBlendToTarget,
+	public rendering::TaskInterfaceSplit
+{
+public:
+	typedef etl::handle<TaskNoiseSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	virtual void on_target_set_as_source() {
+		Task::Handle &subtask = sub_task(0);
+		if ( subtask
+		  && subtask->target_surface == target_surface
+		  && !Color::is_straight(blend_method) )
+		{
+			trunc_by_bounds();
+			subtask->source_rect = source_rect;
+			subtask->target_rect = target_rect;
+		}
+	}
+
+	virtual Color::BlendMethodFlags get_supported_blend_methods() const
+		{ return Color::BLEND_METHODS_ALL; }
+
+private:
+	// type of smoothing is a template parameter,
+	// so innermost loops have no switch and RandomNoise is specialized for it
+	template<RandomNoise::SmoothType type>
+	void fill(synfig::Surface &surface, Vector p, const Vector &dx, const Vector &dy, float pixel_size) const
+	{
+		ColorReal amount = blend ? this->amount : ColorReal(1.0);
+		bool straight = !blend || (blend_method == Color::BLEND_STRAIGHT && approximate_equal_lp(amount, ColorReal(1.0)));
+
+		int tw = target_rect.get_width();
+		std::vector<Color> colors(straight ? 0 : tw);
+		for(int iy = target_rect.miny; iy < target_rect.maxy; ++iy, p += dy) {
+			Color *row = &surface[iy][target_rect.minx];
+			if (straight) {
+				noise.fill_row<type>(row, tw, gradient, p, dx, pixel_size);
+			} else {
+				noise.fill_row<type>(&colors.front(), tw, gradient, p, dx, pixel_size);
+				const Color *c = &colors.front();
+				for(Color *end = row + tw; row < end; ++row, ++c)
+					*row = Color::blend(*c, *row, amount, blend_method);
+			}
+		}
+	}
+
+public:
+	virtual bool run(RunParams&) const {
+		if (!is_valid())
+			return true;
+
+		Vector ppu = get_pixels_per_unit();
+
+		Matrix bounds_transfromation;
+		bounds_transfromation.m00 = ppu[0];
+		bounds_transfromation.m11 = ppu[1];
+		bounds_transfromation.m20 = target_rect.minx - ppu[0]*source_rect.minx;
+		bounds_transfromation.m21 = target_rect.miny - ppu[1]*source_rect.miny;
+
+		Matrix matrix = bounds_transfromation * transformation->matrix;
+		Matrix inv_matrix = matrix.get_inverted();
+
+		Vector dx = inv_matrix.axis_x();
+		Vector dy = inv_matrix.axis_y();
+		Vector p = inv_matrix.get_transformed( Vector((Real)target_rect.minx, (Real)target_rect.miny) );
+		float pixel_size = (float)((dx.mag() + dy.mag())*0.5);
+
+		LockWrite la(this);
+		if (!la)
+			return false;
+		synfig::Surface &surface = la->get_surface();
+
+		switch(noise.smooth) {
+		case RandomNoise::SMOOTH_CUBIC:
+			fill<RandomNoise::SMOOTH_CUBIC>(surface, p, dx, dy, pixel_size); break;
+		case RandomNoise::SMOOTH_FAST_SPLINE:
+			fill<RandomNoise::SMOOTH_FAST_SPLINE>(surface, p, dx, dy, pixel_size); break;
+		case RandomNoise::SMOOTH_SPLINE:
+			fill<RandomNoise::SMOOTH_SPLINE>(surface, p, dx, dy, pixel_size); break;
+		case RandomNoise::SMOOTH_COSINE:
+			fill<RandomNoise::SMOOTH_COSINE>(surface, p, dx, dy, pixel_size); break;
+		case RandomNoise::SMOOTH_LINEAR:
+			fill<RandomNoise::SMOOTH_LINEAR>(surface, p, dx, dy, pixel_size); break;
+		default:
+			fill<RandomNoise::SMOOTH_DEFAULT>(surface, p, dx, dy, pixel_size); break;
+		}
+
+		return true;
+	}
+};
+
+rendering::Task::Token TaskNoiseSW::token(
+	DescReal<TaskNoiseSW, TaskNoise>("NoiseSW") );
+
+} // end of anonimous namespace
+
+/* === M E T H O D S ======================================================= */
+
+template<RandomNoise::SmoothType type>
+void
+FractalNoise::fill_row(
+	Color *dst,
+	int count,
+	const CompiledGradient &gradient,
+	const Point &p,
+	const Vector &dx,
+	float pixel_size ) const
+{
+	// octaves are calculated for chunk of pixels at once,
+	// so RandomNoise may process several points in parallel
+	const int chunk = 64;
+	float x[chunk], y[chunk], x2[chunk], y2[chunk], value[chunk];
+	float amount[chunk], amount2[chunk], amount3[chunk], alpha[chunk];
+
+	const bool super = super_sample && pixel_size;
+	const int scale = 1 << detail;
+
+	Point point = p;
+	for(int begin = 0; begin < count; begin += chunk, dst += chunk) {
+		const int n = std::min(chunk, count - begin);
+
+		for(int i = 0; i < n; ++i, point += dx) {
+			x[i] = point[0]/size[0]*scale;
+			y[i] = point[1]/size[1]*scale;
+			if (super) {
+				x2[i] = (point[0]+pixel_size)/size[0]*scale;
+				y2[i] = (point[1]+pixel_size)/size[1]*scale;
+			}
+			amount[i] = amount2[i] = amount3[i] = alpha[i] = 0.0f;
+		}
+
+		for(int octave = 0; octave < detail; ++octave) {
+			const int subseed = (detail - octave)*5;
+
+			random.sample_row<type>(value, n, subseed, x, y, time);
+			for(int i = 0; i < n; ++i) {
+				amount[i] = value[i] + amount[i]*0.5;
+				if (amount[i] < -1) amount[i] = -1;
+				if (amount[i] >  1) amount[i] =  1;
+			}
+
+			if (super) {
+				random.sample_row<type>(value, n, subseed, x2, y, time);
+				for(int i = 0; i < n; ++i) {
+					amount2[i] = value[i] + amount2[i]*0.5;
+					if (amount2[i] < -1) amount2[i] = -1;
+					if (amount2[i] >  1) amount2[i] =  1;
+				}
+
+				random.sample_row<type>(value, n, subseed, x, y2, time);
+				for(int i = 0; i < n; ++i) {
+					amount3[i] = value[i] + amount3[i]*0.5;
+					if (amount3[i] < -1) amount3[i] = -1;
+					if (amount3[i] >  1) amount3[i] =  1;
+				}
+
+				for(int i = 0; i < n; ++i) {
+					if (turbulent) {
+						amount2[i] = std::fabs(amount2[i]);
+						amount3[i] = std::fabs(amount3[i]);
+					}
+					x2[i] *= 0.5f;
+					y2[i] *= 0.5f;
+				}
+			}
+
+			if (do_alpha) {
+				random.sample_row<type>(value, n, subseed + 3, x, y, time);
+				for(int i = 0; i < n; ++i) {
+					alpha[i] = value[i] + alpha[i]*0.5;
+					if (alpha[i] < -1) alpha[i] = -1;
+					if (alpha[i] >  1) alpha[i] =  1;
+				}
+			}
+
+			for(int i = 0; i < n; ++i) {
+				if (turbulent) {
+					amount[i] = std::fabs(amount[i]);
+					alpha[i] = std::fabs(alpha[i]);
+				}
+				x[i] *= 0.5f;
+				y[i] *= 0.5f;
+			}
+		}
+
+		for(int i = 0; i < n; ++i) {
+			if (!turbulent) {
+				amount[i] = amount[i]/2.0f + 0.5f;
+				alpha[i] = alpha[i]/2.0f + 0.5f;
+				if (super) {
+					amount2[i] = amount2[i]/2.0f + 0.5f;
+					amount3[i] = amount3[i]/2.0f + 0.5f;
+				}
+			}
+
+			Color &c = dst[i];
+			if (super) {
+				Real da = std::max(amount3[i], std::max(amount[i], amount2[i]))
+						- std::min(amount3[i], std::min(amount[i], amount2[i]));
+				c = gradient.average(amount[i] - da, amount[i] + da);
+			} else {
+				c = gradient.color(amount[i]);
+			}
+
+			if (do_alpha)
+				c.set_a(c.get_a()*alpha[i]);
+		}
+	}
+}
+
+Color
+FractalNoise::color(const CompiledGradient &gradient, const Point &point, float pixel_size) const
+{
+	Color c;
+	switch(smooth) {
+	case RandomNoise::SMOOTH_CUBIC:
+		fill_row<RandomNoise::SMOOTH_CUBIC>(&c, 1, gradient, point, Vector(), pixel_size); break;
+	case RandomNoise::SMOOTH_FAST_SPLINE:
+		fill_row<RandomNoise::SMOOTH_FAST_SPLINE>(&c, 1, gradient, point, Vector(), pixel_size); break;
+	case RandomNoise::SMOOTH_SPLINE:
+		fill_row<RandomNoise::SMOOTH_SPLINE>(&c, 1, gradient, point, Vector(), pixel_size); break;
+	case RandomNoise::SMOOTH_COSINE:
+		fill_row<RandomNoise::SMOOTH_COSINE>(&c, 1, gradient, point, Vector(), pixel_size); break;
+	case RandomNoise::SMOOTH_LINEAR:
+		fill_row<RandomNoise::SMOOTH_LINEAR>(&c, 1, gradient, point, Vector(), pixel_size); break;
+	default:
+		fill_row<RandomNoise::SMOOTH_DEFAULT>(&c, 1, gradient, point, Vector(), pixel_size); break;
+	}
+	return c;
+}
+
+rendering::Task::Token TaskNoise::token(
+	DescAbstract<TaskNoise>("Noise") );
+
+/* === E N T R Y P O I N T ================================================= */
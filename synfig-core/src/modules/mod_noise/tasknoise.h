@@ -0,0 +1,104 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file mod_noise/tasknoise.h
+**	\brief TaskNoise Header
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_MOD_NOISE_TASKNOISE_H
+#define __SYNFIG_MOD_NOISE_TASKNOISE_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <synfig/color.h>
+#include <synfig/gradient.h>
+#include <synfig/vector.h>
+
+#include <synfig/rendering/task.h>
+#include <synfig/rendering/common/task/tasktransformation.h>
+
+#include "random_noise.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+//! Sum of octaves of RandomNoise mapped to gradient,
+//! evaluated in the same way by Noise layer and by TaskNoise
+class FractalNoise
+{
+public:
+	RandomNoise random;
+	synfig::Vector size;
+	RandomNoise::SmoothType smooth;
+	int detail;
+	float time;
+	bool turbulent;
+	bool do_alpha;
+	bool super_sample;
+
+	FractalNoise():
+		size(1.0, 1.0),
+		smooth(RandomNoise::SMOOTH_COSINE),
+		detail(4),
+		time(),
+		turbulent(),
+		do_alpha(),
+		super_sample()
+	{ random.set_seed(0); }
+
+	//! Fills row of count colors for points p, p + dx, p + dx*2, ...,
+	//! pixel_size is used for supersampling
+	template<RandomNoise::SmoothType type>
+	void fill_row(
+		synfig::Color *dst,
+		int count,
+		const synfig::CompiledGradient &gradient,
+		const synfig::Point &p,
+		const synfig::Vector &dx,
+		float pixel_size ) const;
+
+	//! Color of point, type of smoothing is selected at runtime
+	synfig::Color color(const synfig::CompiledGradient &gradient, const synfig::Point &point, float pixel_size) const;
+};
+
+
+//! Fills whole plane by noise gradient
+class TaskNoise: public synfig::rendering::Task,
+	public synfig::rendering::TaskInterfaceTransformation
+{
+public:
+	typedef etl::handle<TaskNoise> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	synfig::CompiledGradient gradient;
+	FractalNoise noise;
+	synfig::rendering::Holder<synfig::rendering::TransformationAffine> transformation;
+
+	virtual synfig::rendering::Transformation::Handle get_transformation() const
+		{ return transformation.handle(); }
+};
+
+/* === E N D =============================================================== */
+
+#endif
@@ -33,6 +33,7 @@
 #endif
 
 #include "trgt_openexr.h"
+#include <synfig/general.h>
 #include <ETL/stringf>
 #include <cstdio>
 #include <algorithm>
@@ -119,9 +120,9 @@ exr_trgt::start_frame(synfig::ProgressCallback *cb)
 	exr_file=new Imf::RgbaOutputFile(frame_name.c_str(),w,h,Imf::WRITE_RGBA,desc.get_pixel_aspect());
 	if(buffer_color) delete [] buffer_color;
 	buffer_color=new Color[w];
-	//if(buffer) delete [] buffer;
-	//buffer=new Imf::Rgba[w];
-	out_surface.set_wh(w,h);
+	// rows are written to the file one by one, so the whole frame is never kept in memory
+	if(buffer) delete [] buffer;
+	buffer=new Imf::Rgba[w];
 
 	return true;
 }
@@ -130,12 +131,7 @@ void
 exr_trgt::end_frame()
 {
 	if(exr_file)
-	{
-		exr_file->setFrameBuffer(out_surface[0],1,desc.get_w());
-		exr_file->writePixels(desc.get_h());
-
 		delete exr_file;
-	}
 
 	exr_file=0;
 
@@ -158,8 +154,7 @@ exr_trgt::end_scanline()
 	int i;
 	for(i=0;i<desc.get_w();i++)
 	{
-//		Imf::Rgba &rgba=buffer[i];
-		Imf::Rgba &rgba=out_surface[scanline][i];
+		Imf::Rgba &rgba=buffer[i];
 		Color &color=buffer_color[i];
 		rgba.r=color.get_r();
 		rgba.g=color.get_g();
@@ -167,8 +162,17 @@ exr_trgt::end_scanline()
 		rgba.a=color.get_a();
 	}
 
-    //exr_file->setFrameBuffer(buffer,1,desc.get_w());
-	//exr_file->writePixels(1);
+	// frame buffer is addressed by absolute row number
+	exr_file->setFrameBuffer(buffer - (size_t)scanline*desc.get_w(),1,desc.get_w());
+	try
+	{
+		exr_file->writePixels(1);
+	}
+	catch(const std::exception &e)
+	{
+		synfig::error("exr_trgt: %s", e.what());
+		return false;
+	}
 
 	return true;
 }
@@ -36,6 +36,7 @@
 #include <synfig/general.h>
 
 #include <glib/gstdio.h>
+#include <sigc++/bind.h>
 #include "trgt_png.h"
 #include <png.h>
 #include <ETL/stringf>
@@ -61,48 +62,84 @@ SYNFIG_TARGET_SET_EXT(png_trgt,"png");
 SYNFIG_TARGET_SET_VERSION(png_trgt,"0.1");
 SYNFIG_TARGET_SET_CVS_ID(png_trgt,"$Id$");
 
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+struct png_trgt::Frame
+{
+	//! empty for stdout
+	String filename;
+	int width;
+	int height;
+	bool alpha;
+	int x_res;
+	int y_res;
+	String title;
+	String description;
+	int compression;
+	int filter;
+	//! converted pixels of the whole frame, empty when rows are written directly
+	std::vector<unsigned char> pixels;
+
+	//! file being written, opened by open_file()
+	FILE *file;
+	png_structp png_ptr;
+	png_infop info_ptr;
+	int rows_written;
+
+	Frame(): width(), height(), alpha(), x_res(), y_res(), compression(-1), filter(PNG_FILTER_NONE),
+		file(), png_ptr(), info_ptr(), rows_written() { }
+	~Frame() { png_trgt::destroy_file(*this); }
+	size_t get_stride() const { return (size_t)(alpha ? 4 : 3)*width; }
+};
+
+/* === P R O C E D U R E S ================================================= */
+
+static int
+parse_filter(const String &filter)
+{
+	if (filter.empty() || filter == "none") return PNG_FILTER_NONE;
+	if (filter == "sub")   return PNG_FILTER_SUB;
+	if (filter == "up")    return PNG_FILTER_UP;
+	if (filter == "avg")   return PNG_FILTER_AVG;
+	if (filter == "paeth") return PNG_FILTER_PAETH;
+	if (filter == "all")   return PNG_ALL_FILTERS;
+	synfig::warning("png_trgt: unknown filter '%s', rows will not be filtered", filter.c_str());
+	return PNG_FILTER_NONE;
+}
+
 /* === M E T H O D S ======================================================= */
 
 void
 png_trgt::png_out_error(png_struct *png_data,const char *msg)
 {
-	png_trgt *me=(png_trgt*)png_get_error_ptr(png_data);
-	synfig::error(strprintf("png_trgt: error: %s",msg));
-	me->ready=false;
+	Frame *frame=(Frame*)png_get_error_ptr(png_data);
+	synfig::error(strprintf("png_trgt: error: %s: %s",frame->filename.c_str(),msg));
+	longjmp(png_jmpbuf(png_data), 1);
 }
 
 void
 png_trgt::png_out_warning(png_struct *png_data,const char *msg)
 {
-	png_trgt *me=(png_trgt*)png_get_error_ptr(png_data);
-	synfig::warning(strprintf("png_trgt: warning: %s",msg));
-	me->ready=false;
+	Frame *frame=(Frame*)png_get_error_ptr(png_data);
+	synfig::warning(strprintf("png_trgt: warning: %s: %s",frame->filename.c_str(),msg));
 }
 
 
 //Target *png_trgt::New(const char *filename){	return new png_trgt(filename);}
 
 png_trgt::png_trgt(const char *Filename, const synfig::TargetParam &params):
-	file(NULL),
-	png_ptr(NULL),
-	info_ptr(NULL),
 	multi_image(),
-	ready(false),
+	failed(),
 	imagecount(),
+	scanline(),
 	filename(Filename),
-	buffer(NULL),
-	color_buffer(NULL),
-	sequence_separator(params.sequence_separator)
+	sequence_separator(params.sequence_separator),
+	compression(params.compression),
+	filter(parse_filter(params.png_filter))
 { }
 
 png_trgt::~png_trgt()
-{
-	if(file)
-		fclose(file);
-	file=NULL;
-	delete [] buffer;
-	delete [] color_buffer;
-}
+	{ }
 
 bool
 png_trgt::set_rend_desc(RendDesc *given_desc)
@@ -118,93 +155,62 @@ png_trgt::set_rend_desc(RendDesc *given_desc)
 }
 
 void
-png_trgt::end_frame()
+png_trgt::destroy_file(Frame &frame)
 {
-	if(ready && file)
-	{
-		png_write_end(png_ptr,info_ptr);
-		png_destroy_write_struct(&png_ptr, &info_ptr);
-	}
-
-	if(file && file!=stdout)
-		fclose(file);
-	file=NULL;
-	imagecount++;
-	ready=false;
+	if (frame.png_ptr)
+		png_destroy_write_struct(&frame.png_ptr, frame.info_ptr ? &frame.info_ptr : (png_infopp)NULL);
+	frame.png_ptr = NULL;
+	frame.info_ptr = NULL;
+	if (frame.file && frame.file != stdout)
+		fclose(frame.file);
+	frame.file = NULL;
 }
 
 bool
-png_trgt::start_frame(synfig::ProgressCallback *callback)
+png_trgt::open_file(Frame &frame)
 {
-	int w=desc.get_w(),h=desc.get_h();
-
-	if(file && file!=stdout)
-		fclose(file);
-	if(filename=="-")
-	{
-		if(callback)callback->task(strprintf("(stdout) %d",imagecount).c_str());
-		file=stdout;
-	}
-	else if(multi_image)
-	{
-		String newfilename(filename_sans_extension(filename) +
-						   sequence_separator +
-						   etl::strprintf("%04d",imagecount) +
-						   filename_extension(filename));
-		file=g_fopen(newfilename.c_str(),POPEN_BINARY_WRITE_TYPE);
-		if(callback)callback->task(newfilename);
-	}
-	else
+	frame.file = frame.filename.empty()
+	           ? stdout
+	           : g_fopen(frame.filename.c_str(),POPEN_BINARY_WRITE_TYPE);
+	if (!frame.file)
 	{
-		file=g_fopen(filename.c_str(),POPEN_BINARY_WRITE_TYPE);
-		if(callback)callback->task(filename);
-	}
-
-	if(!file)
+		synfig::error("png_trgt: unable to open file: %s", frame.filename.c_str());
 		return false;
+	}
 
-	delete [] buffer;
-	buffer=new unsigned char[4*w];
-
-	delete [] color_buffer;
-	color_buffer=new Color[w];
-
-	png_ptr=png_create_write_struct(PNG_LIBPNG_VER_STRING, (png_voidp)this,png_out_error, png_out_warning);
-	if (!png_ptr)
+	frame.png_ptr=png_create_write_struct(PNG_LIBPNG_VER_STRING, (png_voidp)&frame,png_out_error, png_out_warning);
+	frame.info_ptr=frame.png_ptr ? png_create_info_struct(frame.png_ptr) : NULL;
+	if (!frame.png_ptr || !frame.info_ptr)
 	{
 		synfig::error("Unable to setup PNG struct");
-		fclose(file);
+		destroy_file(frame);
 		return false;
 	}
 
-	info_ptr= png_create_info_struct(png_ptr);
-	if (!info_ptr)
+	// png_out_error() jumps here
+	if (setjmp(png_jmpbuf(frame.png_ptr)))
 	{
-		synfig::error("Unable to setup PNG info struct");
-		fclose(file);
-		png_destroy_write_struct(&png_ptr,(png_infopp)NULL);
+		destroy_file(frame);
 		return false;
 	}
 
-	if (setjmp(png_jmpbuf(png_ptr)))
-	{
-		synfig::error("Unable to setup longjump");
-		png_destroy_write_struct(&png_ptr, &info_ptr);
-		fclose(file);
-		return false;
-	}
-	png_init_io(png_ptr,file);
-	png_set_filter(png_ptr,0,PNG_FILTER_NONE);
+	png_structp png_ptr = frame.png_ptr;
+	png_infop info_ptr = frame.info_ptr;
 
-	setjmp(png_jmpbuf(png_ptr));
-	if (get_alpha_mode()==TARGET_ALPHA_MODE_KEEP)
-		png_set_IHDR(png_ptr,info_ptr,w,h,8,PNG_COLOR_TYPE_RGBA,PNG_INTERLACE_NONE,PNG_COMPRESSION_TYPE_DEFAULT,PNG_FILTER_TYPE_DEFAULT);
-	else
-		png_set_IHDR(png_ptr,info_ptr,w,h,8,PNG_COLOR_TYPE_RGB,PNG_INTERLACE_NONE,PNG_COMPRESSION_TYPE_DEFAULT,PNG_FILTER_TYPE_DEFAULT);
+	png_init_io(png_ptr,frame.file);
+	png_set_filter(png_ptr,0,frame.filter);
+	if (frame.compression >= 0)
+		png_set_compression_level(png_ptr,std::min(frame.compression, 9));
+
+	png_set_IHDR(
+		png_ptr, info_ptr,
+		frame.width, frame.height, 8,
+		frame.alpha ? PNG_COLOR_TYPE_RGBA : PNG_COLOR_TYPE_RGB,
+		PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT );
 
 	// Write the physical size
-	png_set_pHYs(png_ptr,info_ptr,round_to_int(desc.get_x_res()),round_to_int(desc.get_y_res()),PNG_RESOLUTION_METER);
-	
+	png_set_pHYs(png_ptr,info_ptr,frame.x_res,frame.y_res,PNG_RESOLUTION_METER);
+
 	// Explicit set gamma value to 2.2 (it's a default value)
 	png_set_gAMA(png_ptr,info_ptr,1/2.2);
 
@@ -219,12 +225,12 @@ png_trgt::start_frame(synfig::ProgressCallback *callback)
 
 	comments[0].compression = PNG_TEXT_COMPRESSION_NONE;
 	comments[0].key         = title;
-	comments[0].text        = const_cast<char *>(get_canvas()->get_name().c_str());
+	comments[0].text        = const_cast<char *>(frame.title.c_str());
 	comments[0].text_length = strlen(comments[0].text);
 
 	comments[1].compression = PNG_TEXT_COMPRESSION_NONE;
 	comments[1].key         = description;
-	comments[1].text        = const_cast<char *>(get_canvas()->get_description().c_str());
+	comments[1].text        = const_cast<char *>(frame.description.c_str());
 	comments[1].text_length = strlen(comments[1].text);
 
 	comments[2].compression = PNG_TEXT_COMPRESSION_NONE;
@@ -236,27 +242,175 @@ png_trgt::start_frame(synfig::ProgressCallback *callback)
 
 	png_write_info_before_PLTE(png_ptr, info_ptr);
 	png_write_info(png_ptr, info_ptr);
-	ready=true;
 	return true;
 }
 
-Color *
-png_trgt::start_scanline(int /*scanline*/)
+bool
+png_trgt::write_row(Frame &frame, const unsigned char *row)
 {
-	return color_buffer;
+	if (!frame.png_ptr)
+		return false;
+
+	// png_out_error() jumps here
+	if (setjmp(png_jmpbuf(frame.png_ptr)))
+	{
+		destroy_file(frame);
+		return false;
+	}
+
+	png_write_row(frame.png_ptr, const_cast<png_bytep>(row));
+	++frame.rows_written;
+	return true;
 }
 
 bool
-png_trgt::end_scanline()
+png_trgt::close_file(Frame &frame)
+{
+	if (!frame.png_ptr)
+		return false;
+
+	// png_out_error() jumps here
+	if (setjmp(png_jmpbuf(frame.png_ptr)))
+	{
+		destroy_file(frame);
+		return false;
+	}
+
+	png_write_end(frame.png_ptr,frame.info_ptr);
+	png_destroy_write_struct(&frame.png_ptr, &frame.info_ptr);
+	frame.png_ptr = NULL;
+	frame.info_ptr = NULL;
+
+	FILE *file = frame.file;
+	frame.file = NULL;
+	if (file==stdout)
+		fflush(file);
+	else
+	if (fclose(file))
+	{
+		synfig::error("png_trgt: unable to write file: %s", frame.filename.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool
+png_trgt::write_frame(std::shared_ptr<Frame> frame)
+{
+	if (!open_file(*frame))
+		return false;
+
+	size_t stride = frame->get_stride();
+	for(int y = 0; y < frame->height; ++y)
+		if (!write_row(*frame, &frame->pixels[y*stride]))
+			return false;
+
+	return close_file(*frame);
+}
+
+void
+png_trgt::end_frame()
+{
+	if (frame)
+	{
+		if (frame->pixels.empty())
+			failed = !close_file(*frame) || failed;
+		else
+			failed = !write_frame_async(
+				sigc::bind(sigc::ptr_fun(&png_trgt::write_frame), frame),
+				frame->pixels.size() ) || failed;
+	}
+	frame.reset();
+	imagecount++;
+}
+
+bool
+png_trgt::start_frame(synfig::ProgressCallback *callback)
 {
-	if(!file || !ready)
+	// stop at the first frame which was not written
+	if (failed)
 		return false;
 
-	PixelFormat pf = get_alpha_mode()==TARGET_ALPHA_MODE_KEEP ? PF_RGB|PF_A : PF_RGB;
-	color_to_pixelformat(buffer, color_buffer, pf, 0, desc.get_w());
+	int w=desc.get_w(),h=desc.get_h();
+
+	frame = std::make_shared<Frame>();
+	if(filename=="-")
+	{
+		if(callback)callback->task(strprintf("(stdout) %d",imagecount).c_str());
+	}
+	else if(multi_image)
+	{
+		frame->filename = filename_sans_extension(filename) +
+						  sequence_separator +
+						  etl::strprintf("%04d",imagecount) +
+						  filename_extension(filename);
+		if(callback)callback->task(frame->filename);
+	}
+	else
+	{
+		frame->filename = filename;
+		if(callback)callback->task(filename);
+	}
 
-	setjmp(png_jmpbuf(png_ptr));
-	png_write_row(png_ptr,buffer);
+	frame->width       = w;
+	frame->height      = h;
+	frame->alpha       = get_alpha_mode()==TARGET_ALPHA_MODE_KEEP;
+	frame->x_res       = round_to_int(desc.get_x_res());
+	frame->y_res       = round_to_int(desc.get_y_res());
+	frame->title       = get_canvas()->get_name();
+	frame->description = get_canvas()->get_description();
+	frame->compression = compression;
+	frame->filter      = filter;
+
+	// frames written to stdout must keep their order, and frames rendered
+	// by bands must stay within the memory limit, so their rows are
+	// compressed and written directly
+	size_t frame_size = frame->get_stride()*(size_t)h;
+	if (!frame->filename.empty() && can_write_frame_async(frame_size))
+	{
+		frame->pixels.resize(frame_size);
+	}
+	else
+	{
+		row_buffer.resize(frame->get_stride());
+		if (!open_file(*frame))
+		{
+			frame.reset();
+			failed = true;
+			return false;
+		}
+	}
 
+	color_buffer.resize(w);
 	return true;
 }
+
+Color *
+png_trgt::start_scanline(int scanline)
+{
+	this->scanline=scanline;
+	return &color_buffer.front();
+}
+
+bool
+png_trgt::end_scanline()
+{
+	if(!frame || scanline < 0 || scanline >= frame->height)
+		return false;
+
+	PixelFormat pf = frame->alpha ? PF_RGB|PF_A : PF_RGB;
+	if (!frame->pixels.empty())
+	{
+		color_to_pixelformat(&frame->pixels[(size_t)scanline*frame->get_stride()], &color_buffer.front(), pf, 0, frame->width);
+		return true;
+	}
+
+	// rows are written directly, so they must come in order
+	if (scanline != frame->rows_written)
+	{
+		synfig::error("png_trgt: unexpected order of rows in %s", frame->filename.c_str());
+		return false;
+	}
+	color_to_pixelformat(&row_buffer.front(), &color_buffer.front(), pf, 0, frame->width);
+	return write_row(*frame, &row_buffer.front());
+}
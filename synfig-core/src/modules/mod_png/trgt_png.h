@@ -34,6 +34,8 @@
 #include <synfig/string.h>
 #include <synfig/targetparam.h>
 #include <cstdio>
+#include <memory>
+#include <vector>
 
 /* === M A C R O S ========================================================= */
 
@@ -45,19 +47,33 @@ class png_trgt : public synfig::Target_Scanline
 {
 	SYNFIG_TARGET_MODULE_EXT
 private:
-	FILE *file;
-	//int w,h;
-	png_structp png_ptr;
-	png_infop info_ptr;
+	//! Converted pixels of the frame and everything needed to write it,
+	//! frame is compressed and written in background by write_frame(),
+	//! or row by row by end_scanline() when it doesn't fit into memory
+	struct Frame;
 
 	static void png_out_error(png_struct *png,const char *msg);
 	static void png_out_warning(png_struct *png,const char *msg);
-	bool multi_image,ready;
+
+	//! Opens the file and writes the header
+	static bool open_file(Frame &frame);
+	static bool write_row(Frame &frame, const unsigned char *row);
+	//! Finishes the file, returns \c false if it was not written
+	static bool close_file(Frame &frame);
+	//! Releases libpng structs and closes the file without finishing it
+	static void destroy_file(Frame &frame);
+	static bool write_frame(std::shared_ptr<Frame> frame);
+
+	bool multi_image,failed;
 	int imagecount;
+	int scanline;
 	synfig::String filename;
-	unsigned char *buffer;
-	synfig::Color *color_buffer;
+	std::shared_ptr<Frame> frame;
+	std::vector<synfig::Color> color_buffer;
+	std::vector<unsigned char> row_buffer;
 	synfig::String sequence_separator;
+	int compression;
+	int filter;
 public:
 	png_trgt(const char *filename, const synfig::TargetParam& /* params */);
 	virtual ~png_trgt();
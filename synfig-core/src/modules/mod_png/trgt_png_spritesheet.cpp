@@ -37,6 +37,7 @@
 
 #include <synfig/localization.h>
 #include <synfig/general.h>
+#include <synfig/filesystemtemporary.h>
 
 #include <glib/gstdio.h>
 #include "trgt_png_spritesheet.h"
@@ -53,6 +54,9 @@
 
 /* === M A C R O S ========================================================= */
 
+//! The default user limit of libpng for width and height of image
+#define MAX_SHEET_SIDE 1000000
+
 using namespace synfig;
 using namespace std;
 using namespace etl;
@@ -73,6 +77,7 @@ png_trgt_spritesheet::png_out_error(png_struct *png_data,const char *msg)
     png_trgt_spritesheet *me=(png_trgt_spritesheet*)png_get_error_ptr(png_data);
     synfig::error(strprintf("png_trgt_spritesheet: error: %s",msg));
     me->ready=false;
+    longjmp(png_jmpbuf(png_data), 1);
 }
 
 void
@@ -85,14 +90,14 @@ png_trgt_spritesheet::png_out_warning(png_struct *png_data,const char *msg)
 
 bool png_trgt_spritesheet::is_final_image_size_acceptable() const
 {
-	return !(sheet_width * sheet_height > 5000 * 2000);
+	return sheet_width <= MAX_SHEET_SIDE && sheet_height <= MAX_SHEET_SIDE;
 }
 
 string png_trgt_spritesheet::get_image_size_error_message() const
 {
 	return strprintf(
-				_("The image is too large. It's size must be not more than 5000*2000=10000000 px. Currently it's %d*%d=%d px."),
-				sheet_width, sheet_height, sheet_width * sheet_height);
+				_("The image is too large. Its width and height must be not more than %d px. Currently it's %d*%d px."),
+				MAX_SHEET_SIDE, sheet_width, sheet_height);
 }
 
 png_trgt_spritesheet::png_trgt_spritesheet(const char *Filename, const synfig::TargetParam &params):
@@ -105,15 +110,12 @@ png_trgt_spritesheet::png_trgt_spritesheet(const char *Filename, const synfig::T
 	cur_row(0),
 	cur_col(0),
 	params(params),
-	color_data(0),
 	sheet_width(0),
 	sheet_height(0),
 	in_file_pointer(0),
 	out_file_pointer(0),
-	cur_out_image_row(0),
 	filename(Filename),
-	sequence_separator(params.sequence_separator),
-	overflow_buff(0)
+	sequence_separator(params.sequence_separator)
 {
 	cout << "png_trgt_spritesheet() " << params.offset_x << " " << params.offset_y << endl;
 }
@@ -123,14 +125,69 @@ png_trgt_spritesheet::~png_trgt_spritesheet()
 	cout << "~png_trgt_spritesheet()" << endl;
 	if (ready)
 		write_png_file ();
-	if (color_data)
+	close_scratch();
+	if (in_image.png_ptr)
+		png_destroy_read_struct(&in_image.png_ptr, &in_image.info_ptr, NULL);
+	if (in_file_pointer)
+		fclose(in_file_pointer);
+}
+
+bool
+png_trgt_spritesheet::open_scratch()
+{
+	close_scratch();
+	scratch_filename = FileSystemTemporary::generate_system_temporary_filename("spritesheet");
+	scratch.open(scratch_filename.c_str(), ios::in | ios::out | ios::binary | ios::trunc);
+	if (!scratch.is_open())
+	{
+		synfig::error("png_trgt_spritesheet: unable to create temporary file %s", scratch_filename.c_str());
+		scratch_filename.clear();
+		return false;
+	}
+	return true;
+}
+
+void
+png_trgt_spritesheet::close_scratch()
+{
+	if (scratch.is_open())
+		scratch.close();
+	if (!scratch_filename.empty())
+		g_remove(scratch_filename.c_str());
+	scratch_filename.clear();
+}
+
+bool
+png_trgt_spritesheet::write_scratch(unsigned int x, unsigned int y, const unsigned char *data, unsigned int width)
+{
+	scratch.clear();
+	scratch.seekp(4*((streamoff)y*sheet_width + x));
+	scratch.write((const char*)data, 4*(streamsize)width);
+	if (!scratch)
+	{
+		synfig::error("png_trgt_spritesheet: unable to write temporary file %s", scratch_filename.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool
+png_trgt_spritesheet::read_scratch(unsigned int y, unsigned char *data)
+{
+	// pixels which were never written are transparent,
+	// file may be shorter than the sheet or have holes
+	memset(data, 0, 4*(size_t)sheet_width);
+	scratch.clear();
+	scratch.seekg(4*(streamoff)y*sheet_width);
+	scratch.read((char*)data, 4*(streamsize)sheet_width);
+	bool bad = scratch.bad();
+	scratch.clear();
+	if (bad)
 	{
-		for (unsigned int i = 0; i < sheet_height; i++)
-			delete []color_data[i];
-		delete []color_data;
+		synfig::error("png_trgt_spritesheet: unable to read temporary file %s", scratch_filename.c_str());
+		return false;
 	}
-	if (overflow_buff)
-		delete []overflow_buff;
+	return true;
 }
 
 bool
@@ -143,8 +200,6 @@ png_trgt_spritesheet::set_rend_desc(RendDesc *given_desc)
     lastimage=desc.get_frame_end();
     numimages = (lastimage - imagecount) + 1;		
 
-	overflow_buff = new Color[desc.get_w()];
-	
 	//Reset on uninitialized values
 	if ((params.columns == 0) || (params.rows == 0))
 	{
@@ -176,7 +231,10 @@ png_trgt_spritesheet::set_rend_desc(RendDesc *given_desc)
 		{
 			is_loaded = load_png_file();
 			if (!is_loaded)
+			{
 				fclose(in_file_pointer);
+				in_file_pointer = NULL;
+			}
 		}
 	}
 		
@@ -194,13 +252,11 @@ png_trgt_spritesheet::set_rend_desc(RendDesc *given_desc)
 	
 	cout << "Sheet size: " << sheet_width << "x" << sheet_height << endl;
 
-	cout << "Color size: " << sizeof(Color) << endl;
-	
-	color_data = new Color*[sheet_height];
-	if (color_data)
-		for (unsigned int i = 0; i < sheet_height; i++)
-			color_data[i] = new Color[sheet_width];
-	
+	color_buffer.assign(desc.get_w(), Color());
+	row_buffer.assign(4*(size_t)sheet_width, 0);
+	if (!open_scratch())
+		return false;
+
 	if (is_loaded)
 		ready = read_png_file();
 	else
@@ -242,7 +298,7 @@ bool
 png_trgt_spritesheet::start_frame(synfig::ProgressCallback *callback)
 {
 	synfig::info("start_frame()");
-	if(!color_data) {
+	if(!scratch.is_open()) {
 		if (callback && !is_final_image_size_acceptable())
 			callback->error(get_image_size_error_message());
 		return false;
@@ -257,22 +313,29 @@ png_trgt_spritesheet::start_frame(synfig::ProgressCallback *callback)
 Color *
 png_trgt_spritesheet::start_scanline(int /*scanline*/)
 {
-	unsigned int y = cur_y + params.offset_y + cur_row * desc.get_h();
-	unsigned int x = cur_col * desc.get_w() + params.offset_x;
-	if ((x + desc.get_w() > sheet_width) || (y > sheet_height) || !color_data)
-	{
-		cout << "Buffer overflow. x: " << x << " y: " << y << endl; 
-		//TODO: Fix exception processing outside the module.
-		return overflow_buff; //Spike. Bad exception processing
-	}
-    return &color_data[y][x];
+	return color_buffer.empty() ? NULL : &color_buffer.front();
 }
 
 bool
 png_trgt_spritesheet::end_scanline()
 {
+	unsigned int y = cur_y + params.offset_y + cur_row * desc.get_h();
+	unsigned int x = cur_col * desc.get_w() + params.offset_x;
 	cur_y++;
-    return true;
+	if ((x + desc.get_w() > sheet_width) || (y >= sheet_height) || !scratch.is_open())
+	{
+		cout << "Buffer overflow. x: " << x << " y: " << y << endl;
+		return true;
+	}
+
+	// convert to 8-bit right away, the sheet is never kept as synfig::Color
+	color_to_pixelformat(
+		&row_buffer.front(),
+		&color_buffer.front(),
+		PF_RGB | PF_A,
+		0,
+		desc.get_w() );
+	return write_scratch(x, y, &row_buffer.front(), desc.get_w());
 }
 
 //The func only loads file. Reading into the buffer in read_png_file().
@@ -324,72 +387,71 @@ png_trgt_spritesheet::load_png_file()
     in_image.color_type = png_get_color_type(in_image.png_ptr, in_image.info_ptr);
     in_image.bit_depth = png_get_bit_depth(in_image.png_ptr, in_image.info_ptr);
 
+    if (in_image.bit_depth == 16)
+        png_set_strip_16(in_image.png_ptr);
+    png_set_interlace_handling(in_image.png_ptr);
     png_read_update_info(in_image.png_ptr, in_image.info_ptr);
 
 
-    /* read file */
-    if (setjmp(png_jmpbuf(in_image.png_ptr)))
-	{
-        synfig::error("[read_png_file] Error during read_image");
-		return false;
-	}
-
 	return true;
 }
 
+//Copies the loaded file into the temporary file of the sheet.
 bool 
 png_trgt_spritesheet::read_png_file()
 {
 	cout << "read_png_file()" << endl;
-	//Byte buffer for png data
-	png_bytep * row_pointers;
-    row_pointers = new png_bytep[in_image.height];
-    for (unsigned int y = 0; y < in_image.height; y++)
-            row_pointers[y] = new png_byte[png_get_rowbytes(in_image.png_ptr,in_image.info_ptr)];
-	cout << "row_pointers created" << endl;
-	
-	png_read_image(in_image.png_ptr, row_pointers);
-	cout << "image read" << endl;
-	
-    if (png_get_color_type(in_image.png_ptr, in_image.info_ptr) == PNG_COLOR_TYPE_RGB)
+	bool success = false;
+	std::vector<png_byte> image;
+	std::vector<png_bytep> row_pointers;
+
+	if (setjmp(png_jmpbuf(in_image.png_ptr)))
 	{
-        synfig::error("[process_file] input file is PNG_COLOR_TYPE_RGB but must be PNG_COLOR_TYPE_RGBA "
-               "(lacks the alpha channel)");
-		return false;
+		synfig::error("[read_png_file] Error during read_image");
+		success = false;
 	}
-
-    if (png_get_color_type(in_image.png_ptr, in_image.info_ptr) != PNG_COLOR_TYPE_RGBA)
+	else
+	if (in_image.color_type == PNG_COLOR_TYPE_RGB)
 	{
-        synfig::error("[process_file] color_type of input file must be PNG_COLOR_TYPE_RGBA (%d) (is %d)",
-			PNG_COLOR_TYPE_RGBA, png_get_color_type(in_image.png_ptr, in_image.info_ptr));
-		return false;
+		synfig::error("[process_file] input file is PNG_COLOR_TYPE_RGB but must be PNG_COLOR_TYPE_RGBA "
+			"(lacks the alpha channel)");
 	}
-
-	cout << "colors checked" << endl;
-
-	//From png bytes to synfig::Color conversion
-	const ColorReal k = 1/255.0;
-    for (unsigned int y = 0; y < in_image.height; y++) 
+	else
+	if (in_image.color_type != PNG_COLOR_TYPE_RGBA)
 	{
-        png_byte* row = row_pointers[y];
-        for (unsigned int x = 0; x < in_image.width; x++) 
+		synfig::error("[process_file] color_type of input file must be PNG_COLOR_TYPE_RGBA (%d) (is %d)",
+			PNG_COLOR_TYPE_RGBA, in_image.color_type);
+	}
+	else
+	if (png_get_interlace_type(in_image.png_ptr, in_image.info_ptr) != PNG_INTERLACE_NONE)
+	{
+		// rows of interlaced image are complete only after the last pass,
+		// so such image is read whole, but still as 8-bit pixels
+		size_t row_size = 4*(size_t)in_image.width;
+		image.resize(row_size*in_image.height);
+		row_pointers.resize(in_image.height);
+		for (unsigned int y = 0; y < in_image.height; y++)
+			row_pointers[y] = &image[row_size*y];
+		png_read_image(in_image.png_ptr, &row_pointers.front());
+		success = true;
+		for (unsigned int y = 0; y < in_image.height && success; y++)
+			success = write_scratch(0, y, row_pointers[y], in_image.width);
+	}
+	else
+	{
+		// row_buffer is wide enough, sheet is not narrower than the loaded image
+		success = true;
+		for (unsigned int y = 0; y < in_image.height && success; y++)
 		{
-            png_byte* ptr = &(row[x*4]);
-			color_data[y][x].set_r(ptr[0]*k);
-			color_data[y][x].set_g(ptr[1]*k);
-			color_data[y][x].set_b(ptr[2]*k);
-			color_data[y][x].set_a(ptr[3]*k);
-        }
-    }
+			png_read_row(in_image.png_ptr, &row_buffer.front(), NULL);
+			success = write_scratch(0, y, &row_buffer.front(), in_image.width);
+		}
+	}
 
-	cout << "colors converted" << endl;
-	
-    for (unsigned int y = 0; y < in_image.height; y++)
-            delete []row_pointers[y];
-    
-	delete[] row_pointers;
-	cout << "row_pointers deleted" << endl;
-	return true;
+	png_destroy_read_struct(&in_image.png_ptr, &in_image.info_ptr, NULL);
+	fclose(in_file_pointer);
+	in_file_pointer = NULL;
+	return success;
 }
 
 bool 
@@ -398,13 +460,18 @@ png_trgt_spritesheet::write_png_file()
 	cout << "write_png_file()" << endl;
 	png_structp png_ptr;
 	png_infop info_ptr;
-	unsigned char buffer [4 * sheet_width];
+	bool alpha = get_alpha_mode() == TARGET_ALPHA_MODE_KEEP;
 
 	
     if (filename == "-")
     	out_file_pointer=stdout;
     else
     	out_file_pointer=g_fopen(filename.c_str(), POPEN_BINARY_WRITE_TYPE);
+    if (!out_file_pointer)
+    {
+        synfig::error("png_trgt_spritesheet: unable to open %s for writing", filename.c_str());
+        return false;
+    }
 
 	
     png_ptr=png_create_write_struct(PNG_LIBPNG_VER_STRING, (png_voidp)this,png_out_error, png_out_warning);
@@ -439,14 +506,11 @@ png_trgt_spritesheet::write_png_file()
     png_init_io(png_ptr,out_file_pointer);
     png_set_filter(png_ptr,0,PNG_FILTER_NONE);
 
-	
-    setjmp(png_jmpbuf(png_ptr));
-
 	png_set_IHDR(png_ptr,info_ptr,
 	             sheet_width,
 	             sheet_height,
 	             8,
-	             (get_alpha_mode()==TARGET_ALPHA_MODE_KEEP)?PNG_COLOR_TYPE_RGBA:PNG_COLOR_TYPE_RGB,
+	             alpha?PNG_COLOR_TYPE_RGBA:PNG_COLOR_TYPE_RGB,
 	             PNG_INTERLACE_NONE,
 	             PNG_COMPRESSION_TYPE_DEFAULT,
 	             PNG_FILTER_TYPE_DEFAULT);
@@ -483,20 +547,25 @@ png_trgt_spritesheet::write_png_file()
     png_write_info_before_PLTE(png_ptr, info_ptr);
     png_write_info(png_ptr, info_ptr);
 
-    //Writing spritesheet into png image
-	for (cur_out_image_row = 0; cur_out_image_row < sheet_height; cur_out_image_row++)
+    //Streaming spritesheet into png image row by row
+	for (unsigned int y = 0; y < sheet_height; y++)
 	{
-		color_to_pixelformat(
-			buffer,
-			color_data[cur_out_image_row],
-            //PF_RGB|(get_alpha_mode()==TARGET_ALPHA_MODE_KEEP)?PF_A:PF_RGB, //Note: PF_RGB == 0
-			(get_alpha_mode() == TARGET_ALPHA_MODE_KEEP) ? PF_RGB | PF_A : PF_RGB, //Note: PF_RGB == 0
-			0,
-			sheet_width );
-		setjmp(png_jmpbuf(png_ptr));
-		png_write_row(png_ptr,buffer);
+		unsigned char *row = &row_buffer.front();
+		if (!read_scratch(y, row))
+		{
+			png_destroy_write_struct(&png_ptr, &info_ptr);
+			fclose(out_file_pointer);
+			out_file_pointer=NULL;
+			// don't leave truncated sheet
+			if (filename != "-")
+				g_remove(filename.c_str());
+			return false;
+		}
+		if (!alpha)
+			for (unsigned int x = 0; x < sheet_width; x++)
+				memmove(row + 3*x, row + 4*x, 3);
+		png_write_row(png_ptr,row);
 	}
-	cur_out_image_row = 0;
     if(out_file_pointer)
     {
         png_write_end(png_ptr,info_ptr);
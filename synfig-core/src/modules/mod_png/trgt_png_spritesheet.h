@@ -38,6 +38,8 @@
 #include <synfig/string.h>
 #include <synfig/targetparam.h>
 #include <cstdio>
+#include <fstream>
+#include <vector>
 
 /* === M A C R O S ========================================================= */
 
@@ -55,7 +57,9 @@ private:
 			width(0),
 			height(0),
 			color_type(0),
-			bit_depth(0){}
+			bit_depth(0),
+			png_ptr(NULL),
+			info_ptr(NULL){}
 		unsigned int width;
 		unsigned int height;
 		png_byte color_type;
@@ -75,20 +79,32 @@ private:
 	unsigned int cur_row;
 	unsigned int cur_col;
 	synfig::TargetParam params;
-	synfig::Color ** color_data;
 	unsigned int sheet_width;
 	unsigned int sheet_height;
 	FILE * in_file_pointer;
 	FILE * out_file_pointer;
-	unsigned int cur_out_image_row;
 	PngImage in_image;
 	synfig::String filename;
 	synfig::String sequence_separator;
-	synfig::Color * overflow_buff;
+
+	//! Scanline of the current frame
+	std::vector<synfig::Color> color_buffer;
+	//! Row converted to 8-bit RGBA
+	std::vector<unsigned char> row_buffer;
+
+	//! Whole sheet is assembled in temporary file as 8-bit RGBA rows,
+	//! so only one row is kept in memory, sheet size is limited by disk space
+	synfig::String scratch_filename;
+	std::fstream scratch;
 
 	bool is_final_image_size_acceptable() const;
 	std::string get_image_size_error_message() const;
 
+	bool open_scratch();
+	void close_scratch();
+	bool write_scratch(unsigned int x, unsigned int y, const unsigned char *data, unsigned int width);
+	bool read_scratch(unsigned int y, unsigned char *data);
+
 public:
 	png_trgt_spritesheet(const char *filename, const synfig::TargetParam& /* params */);
 	virtual ~png_trgt_spritesheet();
@@ -32,6 +32,7 @@
 
 #include <cassert>
 #include <cstring>
+#include <mutex>
 
 #include <sigc++/bind.h>
 
@@ -50,9 +51,11 @@
 #include "valuenode_registry.h"
 
 #include "debug/measure.h"
+#include "debug/trace.h"
 #include "layers/layer_pastecanvas.h"
 #include "valuenodes/valuenode_const.h"
 #include "valuenodes/valuenode_scale.h"
+#include "rendering/common/task/tasklayer.h"
 #include "rendering/common/task/taskpixelprocessor.h"
 
 #endif
@@ -83,8 +86,36 @@ int _CanvasCounter::counter(0);
 
 /* === G L O B A L S ======================================================= */
 
+namespace {
+	std::mutex external_cache_mutex;
+	bool external_cache_enabled = false;
+	std::map<String, Canvas::Handle> external_cache;
+}
+
 /* === P R O C E D U R E S ================================================= */
 
+static void
+cache_external_canvas(const String &file_name, const Canvas::Handle &canvas)
+{
+	std::lock_guard<std::mutex> lock(external_cache_mutex);
+	if (external_cache_enabled)
+		external_cache[etl::absolute_path(file_name)] = canvas;
+}
+
+//! Checks if task tree renders some of layers by TaskLayer, i.e. refers to the live canvas
+static bool
+contains_legacy_layers(const rendering::Task::Handle &task)
+{
+	if (!task)
+		return false;
+	if (rendering::TaskLayer::Handle::cast_dynamic(task))
+		return true;
+	for(rendering::Task::List::const_iterator i = task->sub_tasks.begin(); i != task->sub_tasks.end(); ++i)
+		if (contains_legacy_layers(*i))
+			return true;
+	return false;
+}
+
 /* === M E T H O D S ======================================================= */
 
 Canvas::Canvas(const String &id):
@@ -317,6 +348,24 @@ Canvas::build_rendering_task(const ContextParams &context_params) const
 	return task;
 }
 
+rendering::Task::Handle
+Canvas::build_rendering_task_snapshot(
+	const ContextParams &context_params,
+	Time t,
+	Real outline_grow,
+	bool sync_time,
+	bool &out_is_snapshot )
+{
+	if (sync_time || get_time() != t) {
+		set_time(t);
+		load_resources(t);
+	}
+	set_outline_grow(outline_grow);
+	rendering::Task::Handle task = build_rendering_task(context_params);
+	out_is_snapshot = !contains_legacy_layers(task);
+	return task;
+}
+
 
 const ValueNodeList &
 Canvas::value_node_list()const
@@ -424,6 +473,7 @@ Canvas::set_time(Time t)const
 		#ifdef DEBUG_SET_TIME_MEASURE
 		debug::Measure measure("Canvas::set_time", true);
 		#endif
+		debug::Trace::Scope trace("canvas", "Canvas::set_time");
 
 #if 0
 		if(is_root())
@@ -446,6 +496,7 @@ Canvas::set_time(Time t)const
 void
 Canvas::load_resources(Time t)const
 {
+	debug::Trace::Scope trace("canvas", "Canvas::load_resources");
 	get_independent_context().load_resources(t);
 }
 
@@ -722,6 +773,7 @@ Canvas::surefind_canvas(const String &id, String &warnings)
 			if(!external_canvas)
 				throw runtime_error(errors);
 			externals_[file_name]=external_canvas;
+			cache_external_canvas(file_name, external_canvas);
 		}
 
 		return Handle::cast_const(external_canvas.constant()->find_canvas(external_id, warnings));
@@ -808,6 +860,7 @@ Canvas::find_canvas(const String &id, String &warnings)const
 			if(!external_canvas)
 				throw runtime_error(errors);
 			externals_[file_name]=external_canvas;
+			cache_external_canvas(file_name, external_canvas);
 		}
 
 		return Handle::cast_const(external_canvas.constant()->find_canvas(external_id, warnings));
@@ -844,6 +897,23 @@ Canvas::find_canvas(const String &id, String &warnings)const
 	return child_canvas->find_canvas(string(id,id.find_first_of(':')+1), warnings);
 }
 
+String
+Canvas::get_external_file_name(const String &id)const
+{
+	if(is_inline() && parent_)
+		return parent_->get_external_file_name(id);
+
+	// "#canvas" and "canvas" refer to this file
+	String::size_type pos = id.find_first_of('#');
+	if(pos == String::npos || pos == 0)
+		return String();
+
+	String file_name = unix_to_local_path(String(id, 0, pos));
+	if(!is_absolute_path(file_name))
+		file_name = get_file_path()+ETL_DIRECTORY_SEPARATOR+file_name;
+	return get_file_name() == file_name ? String() : file_name;
+}
+
 Canvas::Handle
 Canvas::create()
 {
@@ -1673,6 +1743,32 @@ Canvas::register_external_canvas(String file_name, Handle canvas)
 	externals_[file_name] = canvas;
 }
 
+void
+Canvas::set_external_cache_enabled(bool x)
+{
+	std::lock_guard<std::mutex> lock(external_cache_mutex);
+	external_cache_enabled = x;
+}
+
+bool
+Canvas::get_external_cache_enabled()
+{
+	std::lock_guard<std::mutex> lock(external_cache_mutex);
+	return external_cache_enabled;
+}
+
+void
+Canvas::clear_external_cache()
+{
+	// canvases are released outside of the lock,
+	// their destruction may close other external canvases
+	std::map<String, Handle> cache;
+	{
+		std::lock_guard<std::mutex> lock(external_cache_mutex);
+		cache.swap(external_cache);
+	}
+}
+
 #ifdef _DEBUG
 void
 Canvas::show_externals(String file, int line, String text) const
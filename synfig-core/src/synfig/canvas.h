@@ -555,6 +555,10 @@ public:
 	*/
 	ConstHandle find_canvas(const String &id, String &warnings)const;
 
+	//! Returns the absolute file name of the external file referenced by \a id ("file.sif#canvas").
+	//! Returns an empty string if \a id refers to a canvas of this file
+	String get_external_file_name(const String &id)const;
+
 	//! Returns the file path from the file name
 	String get_file_path()const;
 
@@ -607,6 +611,25 @@ public:
 
 	//! Creates sorted context and builds task for rendering based on it with applied gamma
 	rendering::Task::Handle build_rendering_task(const ContextParams &context_params) const;
+
+	//! Evaluates the canvas at time \a t and builds task for rendering of this frame
+	/*! When \a sync_time is false and the canvas is already at \a t, time is not set again
+	**	(see Target::get_avoid_time_sync()).
+	**	\a out_is_snapshot is set to true when the returned task tree doesn't refer
+	**	to the mutable state of the canvas: native tasks copy their parameters, so
+	**	subsequent calls of set_time() don't affect them, and such snapshots of several
+	**	frames may be rendered simultaneously. Legacy layers (TaskLayer) are rendered
+	**	by clones which still read the live canvas, its value nodes and sub-canvases,
+	**	so the task with them must be finished before the next set_time().
+	**	Only the returned task tree is thread-safe, calls of this function
+	**	should be serialized like calls of set_time().
+	**	\see build_rendering_task() */
+	rendering::Task::Handle build_rendering_task_snapshot(
+		const ContextParams &context_params,
+		Time t,
+		Real outline_grow,
+		bool sync_time,
+		bool &out_is_snapshot );
 	
 	int indexof(const const_iterator &iter) const;
 	iterator byindex(int index);
@@ -666,6 +689,14 @@ public:
 	//! Stores the external canvas by its file name and the Canvas handle
 	void register_external_canvas(String file, Handle canvas);
 
+	//! Enables the process-wide cache of external canvases.
+	//! Cached canvases stay loaded when the documents which refer them are closed,
+	//! so the next documents of a batch reuse them instead of parsing the files again.
+	static void set_external_cache_enabled(bool x);
+	static bool get_external_cache_enabled();
+	//! Releases all canvases kept by the cache of external canvases
+	static void clear_external_cache();
+
 	//! Set/Get members for the outline grow value
 	Real get_outline_grow()const;
 	void set_outline_grow(Real x);
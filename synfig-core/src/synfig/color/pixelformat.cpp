@@ -26,9 +26,53 @@
 
 #include "pixelformat.h"
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+// SSE2 and AVX2 kernels are compiled with function-level target attributes,
+// so the rest of library may be built for any baseline x86 processor,
+// and the instruction set is selected at runtime
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#	define PIXELFORMAT_SSE2
+#	define PIXELFORMAT_AVX2
+#	define PIXELFORMAT_TARGET(x) __attribute__((target(x)))
+#	include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#	define PIXELFORMAT_SSE2
+#	define PIXELFORMAT_TARGET(x)
+#	include <emmintrin.h>
+#endif
 
 using namespace synfig;
 
+namespace {
+	PixelFormatSimd
+	detect_simd()
+	{
+		const char *disable = getenv("SYNFIG_DISABLE_SIMD");
+		if (disable && *disable && strcmp(disable, "0") != 0)
+			return PF_SIMD_NONE;
+		#if defined(PIXELFORMAT_AVX2)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) return PF_SIMD_AVX2;
+		if (__builtin_cpu_supports("sse2")) return PF_SIMD_SSE2;
+		#elif defined(PIXELFORMAT_SSE2)
+		return PF_SIMD_SSE2;
+		#endif
+		return PF_SIMD_NONE;
+	}
+
+	PixelFormatSimd
+	supported_simd()
+		{ static const PixelFormatSimd level = detect_simd(); return level; }
+
+	PixelFormatSimd&
+	current_simd()
+		{ static PixelFormatSimd level = supported_simd(); return level; }
+} // namespace
+
 namespace {
 	struct Color2PFParams {
 		unsigned char *dst;
@@ -200,6 +244,214 @@ namespace {
 	}
 
 
+	// Row kernels for the most common formats: RGB, BGR, RGBA, BGRA
+	// and premulted RGBA, BGRA. Every kernel gives exactly the same result
+	// as the scalar functions above, and uses them to process a tail of row.
+
+	typedef unsigned char* (*Color2PFRowFunc)(unsigned char*, const Color*, int);
+
+	enum Color2PFMode {
+		C2PF_SIMPLE,  //!< same as color2pf_simple()
+		C2PF_WIDE,    //!< same as color2pf() without premult
+		C2PF_PREMULT  //!< same as color2pf() with premult
+	};
+
+	template<int mode, bool bgr, bool alpha>
+	static inline unsigned char*
+	color2pf_row_scalar(unsigned char *dst, const Color *src, int width) {
+		for(int i = 0; i < width; ++i)
+			dst = mode == C2PF_SIMPLE
+			    ? color2pf_simple<bgr, alpha, false>(dst, src[i], NULL)
+			    : color2pf<false, false, bgr, alpha, false, mode == C2PF_PREMULT>(dst, src[i], NULL);
+		return dst;
+	}
+
+#ifdef PIXELFORMAT_SSE2
+	//! converts one pixel (r, g, b, a) into four integer channels in order of output bytes
+	template<int mode, bool bgr>
+	PIXELFORMAT_TARGET("sse2") static inline __m128i
+	color2pf_sse2(__m128 p) {
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 mask_a = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+
+		// NaN goes to zero here, because _mm_max_ps returns second operand for NaN
+		__m128 c = _mm_min_ps(_mm_max_ps(p, _mm_setzero_ps()), one);
+		__m128i i;
+		if (mode == C2PF_SIMPLE) {
+			// Color::clamped() replaces NaN by 0.5, and by 1 for alpha
+			const __m128 nan = _mm_cmpunord_ps(p, p);
+			c = _mm_or_ps(_mm_andnot_ps(nan, c), _mm_and_ps(nan, _mm_setr_ps(0.5f, 0.5f, 0.5f, 1.f)));
+			i = _mm_cvttps_epi32(_mm_mul_ps(c, _mm_set1_ps(ColorReal(255.9))));
+		} else {
+			const ColorReal kc = ColorReal(65535.99), ka = ColorReal(255.99);
+			i = _mm_cvttps_epi32(_mm_mul_ps(c, _mm_setr_ps(kc, kc, kc, ka)));
+			if (mode == C2PF_WIDE) {
+				const __m128i mask_ai = _mm_castps_si128(mask_a);
+				i = _mm_or_si128(_mm_andnot_si128(mask_ai, _mm_srli_epi32(i, 8)), _mm_and_si128(mask_ai, i));
+			} else {
+				// all products are integers less than 2^24, so float calculations are exact
+				const __m128 f = _mm_cvtepi32_ps(i);
+				__m128 ai = _mm_shuffle_ps(f, f, _MM_SHUFFLE(3, 3, 3, 3));
+				ai = _mm_mul_ps(_mm_add_ps(ai, one), _mm_set1_ps(1.f/65536.f));
+				const __m128 k = _mm_or_ps(_mm_andnot_ps(mask_a, ai), _mm_and_ps(mask_a, one));
+				i = _mm_cvttps_epi32(_mm_mul_ps(f, k));
+			}
+		}
+		if (bgr) i = _mm_shuffle_epi32(i, _MM_SHUFFLE(3, 0, 1, 2));
+		return i;
+	}
+
+	template<int mode, bool bgr, bool alpha>
+	PIXELFORMAT_TARGET("sse2") static unsigned char*
+	color2pf_row_sse2(unsigned char *dst, const Color *src, int width) {
+		const float *s = reinterpret_cast<const float*>(src);
+		int i = 0;
+		for(; i + 4 <= width; i += 4, s += 16) {
+			const __m128i p0 = color2pf_sse2<mode, bgr>(_mm_loadu_ps(s));
+			const __m128i p1 = color2pf_sse2<mode, bgr>(_mm_loadu_ps(s + 4));
+			const __m128i p2 = color2pf_sse2<mode, bgr>(_mm_loadu_ps(s + 8));
+			const __m128i p3 = color2pf_sse2<mode, bgr>(_mm_loadu_ps(s + 12));
+			const __m128i b = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+			if (alpha) {
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), b);
+				dst += 16;
+			} else {
+				// overlapped writes of 4-byte pixels, the fourth byte is overwritten by the next pixel
+				int v[4] = {
+					_mm_cvtsi128_si32(b),
+					_mm_cvtsi128_si32(_mm_srli_si128(b, 4)),
+					_mm_cvtsi128_si32(_mm_srli_si128(b, 8)),
+					_mm_cvtsi128_si32(_mm_srli_si128(b, 12)) };
+				memcpy(dst, &v[0], 4);
+				memcpy(dst + 3, &v[1], 4);
+				memcpy(dst + 6, &v[2], 4);
+				memcpy(dst + 9, &v[3], 3);
+				dst += 12;
+			}
+		}
+		return color2pf_row_scalar<mode, bgr, alpha>(dst, src + i, width - i);
+	}
+#endif
+
+#ifdef PIXELFORMAT_AVX2
+	//! same as color2pf_sse2(), but for two pixels at once
+	template<int mode, bool bgr>
+	PIXELFORMAT_TARGET("avx2") static inline __m256i
+	color2pf_avx2(__m256 p) {
+		const __m256 one = _mm256_set1_ps(1.f);
+
+		__m256 c = _mm256_min_ps(_mm256_max_ps(p, _mm256_setzero_ps()), one);
+		__m256i i;
+		if (mode == C2PF_SIMPLE) {
+			const __m256 nan = _mm256_cmp_ps(p, p, _CMP_UNORD_Q);
+			c = _mm256_blendv_ps(c, _mm256_setr_ps(0.5f, 0.5f, 0.5f, 1.f, 0.5f, 0.5f, 0.5f, 1.f), nan);
+			i = _mm256_cvttps_epi32(_mm256_mul_ps(c, _mm256_set1_ps(ColorReal(255.9))));
+		} else {
+			const ColorReal kc = ColorReal(65535.99), ka = ColorReal(255.99);
+			i = _mm256_cvttps_epi32(_mm256_mul_ps(c, _mm256_setr_ps(kc, kc, kc, ka, kc, kc, kc, ka)));
+			if (mode == C2PF_WIDE) {
+				i = _mm256_blend_epi32(_mm256_srli_epi32(i, 8), i, 0x88);
+			} else {
+				const __m256 f = _mm256_cvtepi32_ps(i);
+				__m256 ai = _mm256_shuffle_ps(f, f, _MM_SHUFFLE(3, 3, 3, 3));
+				ai = _mm256_mul_ps(_mm256_add_ps(ai, one), _mm256_set1_ps(1.f/65536.f));
+				i = _mm256_cvttps_epi32(_mm256_mul_ps(f, _mm256_blend_ps(ai, one, 0x88)));
+			}
+		}
+		if (bgr) i = _mm256_shuffle_epi32(i, _MM_SHUFFLE(3, 0, 1, 2));
+		return i;
+	}
+
+	template<int mode, bool bgr, bool alpha>
+	PIXELFORMAT_TARGET("avx2") static unsigned char*
+	color2pf_row_avx2(unsigned char *dst, const Color *src, int width) {
+		// packs work inside of 128-bit lanes, so pixels are interleaved after packing
+		const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+		const float *s = reinterpret_cast<const float*>(src);
+		int i = 0;
+		for(; i + 8 <= width; i += 8, s += 32) {
+			const __m256i p0 = color2pf_avx2<mode, bgr>(_mm256_loadu_ps(s));
+			const __m256i p1 = color2pf_avx2<mode, bgr>(_mm256_loadu_ps(s + 8));
+			const __m256i p2 = color2pf_avx2<mode, bgr>(_mm256_loadu_ps(s + 16));
+			const __m256i p3 = color2pf_avx2<mode, bgr>(_mm256_loadu_ps(s + 24));
+			__m256i b = _mm256_packus_epi16(_mm256_packs_epi32(p0, p1), _mm256_packs_epi32(p2, p3));
+			b = _mm256_permutevar8x32_epi32(b, order);
+			if (alpha) {
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), b);
+				dst += 32;
+			} else {
+				const __m256i drop_a = _mm256_setr_epi8(
+					0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+					0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1 );
+				b = _mm256_shuffle_epi8(b, drop_a);
+				b = _mm256_permutevar8x32_epi32(b, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm256_castsi256_si128(b));
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + 16), _mm256_extracti128_si256(b, 1));
+				dst += 24;
+			}
+		}
+		return color2pf_row_scalar<mode, bgr, alpha>(dst, src + i, width - i);
+	}
+#endif
+
+	template<int mode, bool bgr, bool alpha>
+	static Color2PFRowFunc
+	color2pf_row_func(PixelFormatSimd level) {
+		#ifdef PIXELFORMAT_AVX2
+		if (level >= PF_SIMD_AVX2) return color2pf_row_avx2<mode, bgr, alpha>;
+		#endif
+		#ifdef PIXELFORMAT_SSE2
+		if (level >= PF_SIMD_SSE2) return color2pf_row_sse2<mode, bgr, alpha>;
+		#endif
+		return NULL;
+	}
+
+	static Color2PFRowFunc
+	color2pf_row_func(PixelFormat pf, bool with_gamma) {
+		PixelFormatSimd level = get_pixelformat_simd();
+		if ( level == PF_SIMD_NONE
+		  || FLAGS(pf, PF_RAW_COLOR)
+		  || FLAGS(pf, PF_GRAY)
+		  || FLAGS(pf, PF_A_START) )
+			return NULL;
+
+		bool bgr   = FLAGS(pf, PF_BGR);
+		bool alpha = FLAGS(pf, PF_A);
+		if (FLAGS(pf, PF_A_PREMULT))
+			return bgr ? color2pf_row_func<C2PF_PREMULT, true,  true >(level)
+			           : color2pf_row_func<C2PF_PREMULT, false, true >(level);
+		if (with_gamma) {
+			if (alpha)
+				return bgr ? color2pf_row_func<C2PF_WIDE, true,  true >(level)
+				           : color2pf_row_func<C2PF_WIDE, false, true >(level);
+			return     bgr ? color2pf_row_func<C2PF_WIDE, true,  false>(level)
+			               : color2pf_row_func<C2PF_WIDE, false, false>(level);
+		}
+		if (alpha)
+			return bgr ? color2pf_row_func<C2PF_SIMPLE, true,  true >(level)
+			           : color2pf_row_func<C2PF_SIMPLE, false, true >(level);
+		return     bgr ? color2pf_row_func<C2PF_SIMPLE, true,  false>(level)
+		               : color2pf_row_func<C2PF_SIMPLE, false, false>(level);
+	}
+
+	static unsigned char*
+	color2pf_image_rows(Color2PFRowFunc func, Color2PFParams params) {
+		// gamma is applied by the scalar code into a temporary row
+		std::vector<Color> row(params.gamma ? std::max(params.width, 0) : 0);
+		while(params.height-- > 0) {
+			const Color *src = params.src;
+			if (!row.empty()) {
+				for(int i = 0; i < params.width; ++i)
+					row[i] = params.gamma->apply(src[i]);
+				src = &row.front();
+			}
+			params.dst = func(params.dst, src, params.width) + params.dst_stride_extra;
+			params.src += params.width + params.src_stride_extra;
+		}
+		return params.dst;
+	}
+
+
 	template<bool with_gamma, bool gray, bool bgr>
 	static inline unsigned char*
 	color2pf_image_partauto(const Color2PFParams &params) {
@@ -220,6 +472,8 @@ namespace {
 	color2pf_image_auto(const Color2PFParams &params) {
 		if (FLAGS(params.pf, PF_RAW_COLOR))
 			return color2pf_image<color2pf_raw>(params);
+		if (Color2PFRowFunc func = color2pf_row_func(params.pf, (bool)params.gamma))
+			return color2pf_image_rows(func, params);
 
 		bool with_gamma    = (bool)params.gamma;
 		bool gray          = FLAGS(params.pf, PF_GRAY);
@@ -346,6 +600,142 @@ namespace {
 	}
 
 
+	// Row kernels for RGB, BGR, RGBA, BGRA and premulted RGBA, BGRA,
+	// results are the same as for pf2color()
+
+	typedef const unsigned char* (*PF2ColorRowFunc)(Color*, const unsigned char*, int);
+
+	template<bool bgr, bool alpha, bool alpha_premult>
+	static inline const unsigned char*
+	pf2color_row_scalar(Color *dst, const unsigned char *src, int width) {
+		for(int i = 0; i < width; ++i)
+			src = pf2color<false, bgr, alpha, false, alpha_premult>(dst[i], src);
+		return src;
+	}
+
+#ifdef PIXELFORMAT_SSE2
+	//! converts four integer channels in order of input bytes into Color
+	template<bool bgr, bool alpha, bool alpha_premult>
+	PIXELFORMAT_TARGET("sse2") static inline __m128
+	pf2color_sse2(__m128i i) {
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 mask_a = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+
+		if (bgr) i = _mm_shuffle_epi32(i, _MM_SHUFFLE(3, 0, 1, 2));
+		__m128 f = _mm_mul_ps(_mm_cvtepi32_ps(i), _mm_set1_ps(ColorReal(1.0/255.0)));
+		if (!alpha)
+			f = _mm_or_ps(_mm_andnot_ps(mask_a, f), _mm_and_ps(mask_a, one));
+		if (alpha && alpha_premult) {
+			// see Color::demult_alpha()
+			const __m128 a = _mm_shuffle_ps(f, f, _MM_SHUFFLE(3, 3, 3, 3));
+			const __m128 inva = _mm_div_ps(one, a);
+			f = _mm_mul_ps(f, _mm_or_ps(_mm_andnot_ps(mask_a, inva), _mm_and_ps(mask_a, one)));
+			f = _mm_andnot_ps(_mm_cmpeq_ps(a, _mm_setzero_ps()), f);
+		}
+		return f;
+	}
+
+	template<bool bgr, bool alpha, bool alpha_premult>
+	PIXELFORMAT_TARGET("sse2") static const unsigned char*
+	pf2color_row_sse2(Color *dst, const unsigned char *src, int width) {
+		const __m128i zero = _mm_setzero_si128();
+		float *d = reinterpret_cast<float*>(dst);
+		int i = 0;
+		if (alpha) {
+			for(; i + 4 <= width; i += 4, src += 16, d += 16) {
+				const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+				const __m128i lo = _mm_unpacklo_epi8(b, zero);
+				const __m128i hi = _mm_unpackhi_epi8(b, zero);
+				_mm_storeu_ps(d,      pf2color_sse2<bgr, alpha, alpha_premult>(_mm_unpacklo_epi16(lo, zero)));
+				_mm_storeu_ps(d + 4,  pf2color_sse2<bgr, alpha, alpha_premult>(_mm_unpackhi_epi16(lo, zero)));
+				_mm_storeu_ps(d + 8,  pf2color_sse2<bgr, alpha, alpha_premult>(_mm_unpacklo_epi16(hi, zero)));
+				_mm_storeu_ps(d + 12, pf2color_sse2<bgr, alpha, alpha_premult>(_mm_unpackhi_epi16(hi, zero)));
+			}
+		} else {
+			for(; i < width; ++i, src += 3, d += 4) {
+				const __m128i b = _mm_cvtsi32_si128(src[0] | (src[1] << 8) | (src[2] << 16));
+				_mm_storeu_ps(d, pf2color_sse2<bgr, alpha, alpha_premult>(
+					_mm_unpacklo_epi16(_mm_unpacklo_epi8(b, zero), zero) ));
+			}
+		}
+		return pf2color_row_scalar<bgr, alpha, alpha_premult>(dst + i, src, width - i);
+	}
+#endif
+
+#ifdef PIXELFORMAT_AVX2
+	//! same as pf2color_sse2(), but for two pixels at once
+	template<bool bgr, bool alpha_premult>
+	PIXELFORMAT_TARGET("avx2") static inline __m256
+	pf2color_avx2(__m256i i) {
+		const __m256 one = _mm256_set1_ps(1.f);
+
+		if (bgr) i = _mm256_shuffle_epi32(i, _MM_SHUFFLE(3, 0, 1, 2));
+		__m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(i), _mm256_set1_ps(ColorReal(1.0/255.0)));
+		if (alpha_premult) {
+			const __m256 a = _mm256_shuffle_ps(f, f, _MM_SHUFFLE(3, 3, 3, 3));
+			f = _mm256_mul_ps(f, _mm256_blend_ps(_mm256_div_ps(one, a), one, 0x88));
+			f = _mm256_andnot_ps(_mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_EQ_OQ), f);
+		}
+		return f;
+	}
+
+	//! only formats with alpha, formats without alpha are handled by SSE2 version
+	template<bool bgr, bool alpha_premult>
+	PIXELFORMAT_TARGET("avx2") static const unsigned char*
+	pf2color_row_avx2(Color *dst, const unsigned char *src, int width) {
+		float *d = reinterpret_cast<float*>(dst);
+		int i = 0;
+		for(; i + 4 <= width; i += 4, src += 16, d += 16) {
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+			_mm256_storeu_ps(d,     pf2color_avx2<bgr, alpha_premult>(_mm256_cvtepu8_epi32(b)));
+			_mm256_storeu_ps(d + 8, pf2color_avx2<bgr, alpha_premult>(_mm256_cvtepu8_epi32(_mm_srli_si128(b, 8))));
+		}
+		return pf2color_row_scalar<bgr, true, alpha_premult>(dst + i, src, width - i);
+	}
+#endif
+
+	template<bool bgr, bool alpha, bool alpha_premult>
+	static PF2ColorRowFunc
+	pf2color_row_func(PixelFormatSimd level) {
+		#ifdef PIXELFORMAT_AVX2
+		if (alpha && level >= PF_SIMD_AVX2) return pf2color_row_avx2<bgr, alpha_premult>;
+		#endif
+		#ifdef PIXELFORMAT_SSE2
+		if (level >= PF_SIMD_SSE2) return pf2color_row_sse2<bgr, alpha, alpha_premult>;
+		#endif
+		return NULL;
+	}
+
+	static PF2ColorRowFunc
+	pf2color_row_func(PixelFormat pf) {
+		PixelFormatSimd level = get_pixelformat_simd();
+		if ( level == PF_SIMD_NONE
+		  || FLAGS(pf, PF_RAW_COLOR)
+		  || FLAGS(pf, PF_GRAY)
+		  || FLAGS(pf, PF_A_START) )
+			return NULL;
+
+		bool bgr = FLAGS(pf, PF_BGR);
+		if (FLAGS(pf, PF_A_PREMULT))
+			return bgr ? pf2color_row_func<true,  true,  true >(level)
+			           : pf2color_row_func<false, true,  true >(level);
+		if (FLAGS(pf, PF_A))
+			return bgr ? pf2color_row_func<true,  true,  false>(level)
+			           : pf2color_row_func<false, true,  false>(level);
+		return     bgr ? pf2color_row_func<true,  false, false>(level)
+		               : pf2color_row_func<false, false, false>(level);
+	}
+
+	static const unsigned char*
+	pf2color_image_rows(PF2ColorRowFunc func, PF2ColorParams params) {
+		while(params.height-- > 0) {
+			params.src = func(params.dst, params.src, params.width) + params.src_stride_extra;
+			params.dst += params.width + params.dst_stride_extra;
+		}
+		return params.src;
+	}
+
+
 	template<bool gray, bool bgr>
 	static inline const unsigned char*
 	pf2color_image_partauto(const PF2ColorParams &params) {
@@ -365,6 +755,8 @@ namespace {
 	pf2color_image_auto(const PF2ColorParams &params) {
 		if (FLAGS(params.pf, PF_RAW_COLOR))
 			return pf2color_image<pf2color_raw>(params);
+		if (PF2ColorRowFunc func = pf2color_row_func(params.pf))
+			return pf2color_image_rows(func, params);
 		if (FLAGS(params.pf, PF_GRAY))
 			return pf2color_image_partauto<true,  false>(params);
 		if (FLAGS(params.pf, PF_BGR))
@@ -374,6 +766,16 @@ namespace {
 };
 
 
+PixelFormatSimd
+synfig::get_pixelformat_simd()
+	{ return current_simd(); }
+
+
+PixelFormatSimd
+synfig::set_pixelformat_simd(PixelFormatSimd level)
+	{ return current_simd() = std::min(level, supported_simd()); }
+
+
 //! Returns the size of bytes of pixel in given PixelFormat
 size_t
 synfig::pixel_size(PixelFormat x)
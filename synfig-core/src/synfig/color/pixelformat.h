@@ -57,6 +57,22 @@ enum
 
 typedef unsigned int PixelFormat;
 
+//! Instruction sets which may be used by pixel format conversions
+enum PixelFormatSimd
+{
+    PF_SIMD_NONE = 0,
+    PF_SIMD_SSE2 = 1,
+    PF_SIMD_AVX2 = 2
+};
+
+//! Returns the instruction set used by color_to_pixelformat() and pixelformat_to_color().
+//! It is detected at runtime, environment variable SYNFIG_DISABLE_SIMD forces scalar code.
+PixelFormatSimd get_pixelformat_simd();
+
+//! Limits the instruction set used by conversions, intended for tests and benchmarks.
+//! Returns the selected instruction set, it may be lower than requested if CPU doesn't support it.
+PixelFormatSimd set_pixelformat_simd(PixelFormatSimd level);
+
 //! Returns the size of bytes of pixel in given PixelFormat
 size_t pixel_size(PixelFormat x);
 
@@ -44,6 +44,8 @@
 
 #include "layers/layer_pastecanvas.h"
 
+#include "debug/trace.h"
+
 #include "rendering/task.h"
 
 #endif
@@ -56,37 +58,10 @@ using namespace synfig;
 
 /* === M A C R O S ========================================================= */
 
-// #define SYNFIG_PROFILE_LAYERS
 // #define SYNFIG_DEBUG_LAYERS
 
 /* === G L O B A L S ======================================================= */
 
-#ifdef SYNFIG_PROFILE_LAYERS
-#include <ETL/clock>
-static int depth(0);
-static std::map<String,float> time_table;
-static std::map<String,int> run_table;
-static etl::clock profile_timer;
-static String curr_layer;
-static void
-_print_profile_report()
-{
-	synfig::info(">>>> Profile Report: (Times are in msecs)");
-	std::map<String,float>::iterator iter;
-	float total_time(0);
-	for(iter=time_table.begin();iter!=time_table.end();++iter)
-	{
-		String layer(iter->first);
-		float time(iter->second);
-		int runs(run_table[layer]);
-		total_time+=time;
-		synfig::info(" Layer \"%s\",\tExecs: %03d, Avg Time: %05.1f, Total Time: %05.1f",layer.c_str(),runs,time/runs*1000,time*1000);
-	}
-	synfig::info("Total Time: %f seconds", total_time);
-	synfig::info("<<<< End of Profile Report");
-}
-#endif	// SYNFIG_PROFILE_LAYERS
-
 /* === P R O C E D U R E S ================================================= */
 
 /* === M E T H O D S ======================================================= */
@@ -105,6 +80,9 @@ IndependentContext::set_time(Time time, bool force)const
 	}
 	if (!*context) return;
 
+	// values shared by layers are evaluated once for the whole tree
+	ValueNode::EvaluationCache cache;
+
 	Layer::Handle layer(*context);
 	++context;
 	Glib::Threads::RWLock::WriterLock lock(layer->get_rw_lock());
@@ -284,17 +262,6 @@ Context::hit_check(const Point &pos)const
 bool
 Context::accelerated_render(Surface *surface,int quality, const RendDesc &renddesc, ProgressCallback *cb) const
 {
-#ifdef SYNFIG_PROFILE_LAYERS
-	String layer_name(curr_layer);
-	//sum the pre-work done by layer above us... (curr_layer is layer above us...)
-	if(depth>0)
-	{
-		time_table[curr_layer]+=profile_timer();
-		//if(run_table.count(curr_layer))run_table[curr_layer]++;
-		//	else run_table[curr_layer]=1;
-	}
-#endif	// SYNFIG_PROFILE_LAYERS
-	
 	const Rect bbox(renddesc.get_rect());
 	const Matrix &transfromation_matrix(renddesc.get_transformation_matrix());
 	// this is going to be set to true if this layer contributes
@@ -352,9 +319,6 @@ Context::accelerated_render(Surface *surface,int quality, const RendDesc &rendde
 		surface->set_wh(renddesc.get_w(),renddesc.get_h());
 		// and clear the surface
 		surface->clear();
-#ifdef SYNFIG_PROFILE_LAYERS
-		profile_timer.reset();
-#endif	// SYNFIG_PROFILE_LAYERS
 		return true;
 	}
 	
@@ -365,12 +329,9 @@ Context::accelerated_render(Surface *surface,int quality, const RendDesc &rendde
 	try {
 		// lock the context for reading
 		Glib::Threads::RWLock::ReaderLock lock((*context)->get_rw_lock());
-#ifdef SYNFIG_PROFILE_LAYERS
-		//go down one layer :P
-		depth++;
-		curr_layer=(*context)->get_name();	//make sure the layer inside is referring to the correct layer outside
-		profile_timer.reset(); 										// +
-#endif	// SYNFIG_PROFILE_LAYERS
+		debug::Trace::Scope trace;
+		if (debug::Trace::is_enabled())
+			trace.start("layer", (*context)->get_non_empty_description());
 		bool ret;
 		// this layer doesn't draw anything onto the canvas we're
 		// rendering, but it uses straight blending, so we need to render
@@ -392,17 +353,6 @@ Context::accelerated_render(Surface *surface,int quality, const RendDesc &rendde
 		}
 		else
 			ret = (*context)->accelerated_render(context.get_next(),surface,quality,renddesc, cb);
-#ifdef SYNFIG_PROFILE_LAYERS
-		//post work for the previous layer
-		time_table[curr_layer]+=profile_timer();							//-
-		if(run_table.count(curr_layer))run_table[curr_layer]++;
-		else run_table[curr_layer]=1;
-		depth--;
-		curr_layer = layer_name; //we are now onto this layer (make sure the post gets recorded correctly...
-		//print out the table it we're done...
-		if(depth==0) _print_profile_report(),time_table.clear(),run_table.clear();
-		profile_timer.reset();												//+
-#endif	// SYNFIG_PROFILE_LAYERS
 		return ret;
 	}
 	catch(std::bad_alloc&)
@@ -426,15 +376,6 @@ Context::accelerated_render(Surface *surface,int quality, const RendDesc &rendde
 bool
 Context::accelerated_cairorender(cairo_t *cr,int quality, const RendDesc &renddesc, ProgressCallback *cb) const
 {
-#ifdef SYNFIG_PROFILE_LAYERS
-	String layer_name(curr_layer);
-	//sum the pre-work done by layer above us... (curr_layer is layer above us...)
-	if(depth>0)
-	{
-		time_table[curr_layer]+=profile_timer();
-	}
-#endif	// SYNFIG_PROFILE_LAYERS
-	
 	Context context(*this);
 	// Run all layers until context is empty
 	for(;!(context)->empty();++context)
@@ -454,9 +395,6 @@ Context::accelerated_cairorender(cairo_t *cr,int quality, const RendDesc &rendde
 		// clear the surface
 		cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
 		cairo_paint(cr);
-#ifdef SYNFIG_PROFILE_LAYERS
-		profile_timer.reset();
-#endif	// SYNFIG_PROFILE_LAYERS
 		return true;
 	}
 	
@@ -467,29 +405,15 @@ Context::accelerated_cairorender(cairo_t *cr,int quality, const RendDesc &rendde
 	try {
 		// lock the context for reading
 		Glib::Threads::RWLock::ReaderLock lock((*context)->get_rw_lock());
-#ifdef SYNFIG_PROFILE_LAYERS
-		//go down one layer :P
-		depth++;
-		curr_layer=(*context)->get_name();	//make sure the layer inside is referring to the correct layer outside
-		profile_timer.reset(); 										// +
-#endif	// SYNFIG_PROFILE_LAYERS
+		debug::Trace::Scope trace;
+		if (debug::Trace::is_enabled())
+			trace.start("layer", (*context)->get_non_empty_description());
 		bool ret;
 		// this layer doesn't draw anything onto the canvas we're
 		// rendering, but it uses straight blending, so we need to render
 		// the stuff under us and then blit transparent pixels over it
 		// using the appropriate 'amount'
 		ret = (*context)->accelerated_cairorender(context.get_next(),cr,quality,renddesc, cb);
-#ifdef SYNFIG_PROFILE_LAYERS
-		//post work for the previous layer
-		time_table[curr_layer]+=profile_timer();							//-
-		if(run_table.count(curr_layer))run_table[curr_layer]++;
-		else run_table[curr_layer]=1;
-		depth--;
-		curr_layer = layer_name; //we are now onto this layer (make sure the post gets recorded correctly...
-		//print out the table it we're done...
-		if(depth==0) _print_profile_report(),time_table.clear(),run_table.clear();
-		profile_timer.reset();												//+
-#endif	// SYNFIG_PROFILE_LAYERS
 		return ret;
 	}
 	catch(std::bad_alloc&)
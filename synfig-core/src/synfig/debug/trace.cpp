@@ -0,0 +1,195 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file debug/trace.cpp
+**	\brief Trace
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <vector>
+
+#include <synfig/general.h>
+
+#include "trace.h"
+
+#endif
+
+/* === U S I N G =========================================================== */
+
+using namespace synfig;
+using namespace debug;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+
+struct Event
+{
+	const char *category;
+	String name;
+	long long begin;
+	long long end;
+};
+
+//! Each thread writes to own buffer, so threads are not waiting for each other
+struct Buffer
+{
+	std::mutex mutex;
+	int thread_id;
+	std::vector<Event> events;
+	Buffer(): thread_id() { }
+};
+
+std::mutex buffers_mutex;
+// buffers are not deleted when thread finishes, events must outlive threads
+std::list<Buffer> buffers;
+thread_local Buffer *thread_buffer = nullptr;
+
+Buffer&
+get_buffer()
+{
+	if (!thread_buffer) {
+		std::lock_guard<std::mutex> lock(buffers_mutex);
+		buffers.emplace_back();
+		thread_buffer = &buffers.back();
+		thread_buffer->thread_id = (int)buffers.size();
+	}
+	return *thread_buffer;
+}
+
+void
+write_string(std::ostream &stream, const String &str)
+{
+	stream << '"';
+	for(String::const_iterator i = str.begin(); i != str.end(); ++i) {
+		unsigned char c = *i;
+		if (c == '"' || c == '\\') {
+			stream << '\\' << c;
+		} else
+		if (c < 0x20) {
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\u%04x", c);
+			stream << buf;
+		} else {
+			stream << c;
+		}
+	}
+	stream << '"';
+}
+
+} // end of anonimous namespace
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+std::atomic<bool> Trace::enabled(false);
+
+long long
+Trace::now()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+void
+Trace::add(const char *category, const String &name, long long begin, long long end)
+{
+	if (!is_enabled()) return;
+	Buffer &buffer = get_buffer();
+	Event event = { category, name, begin, end };
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+	buffer.events.push_back(event);
+}
+
+void
+Trace::start()
+{
+	std::lock_guard<std::mutex> lock(buffers_mutex);
+	for(std::list<Buffer>::iterator i = buffers.begin(); i != buffers.end(); ++i) {
+		std::lock_guard<std::mutex> buffer_lock(i->mutex);
+		i->events.clear();
+	}
+	enabled = true;
+}
+
+void
+Trace::stop()
+	{ enabled = false; }
+
+bool
+Trace::save(const String &filename)
+{
+	std::ofstream stream(filename.c_str());
+	if (!stream) {
+		error("Trace: cannot open file '%s' for writing", filename.c_str());
+		return false;
+	}
+
+	long long origin = -1;
+	std::lock_guard<std::mutex> lock(buffers_mutex);
+	for(std::list<Buffer>::iterator i = buffers.begin(); i != buffers.end(); ++i) {
+		std::lock_guard<std::mutex> buffer_lock(i->mutex);
+		for(std::vector<Event>::const_iterator j = i->events.begin(); j != i->events.end(); ++j)
+			if (origin < 0 || j->begin < origin) origin = j->begin;
+	}
+
+	stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	for(std::list<Buffer>::iterator i = buffers.begin(); i != buffers.end(); ++i) {
+		std::lock_guard<std::mutex> buffer_lock(i->mutex);
+		if (i->events.empty()) continue;
+
+		stream << (first ? "\n" : ",\n");
+		first = false;
+		stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i->thread_id
+			   << ",\"args\":{\"name\":\"thread " << i->thread_id << "\"}}";
+
+		for(std::vector<Event>::const_iterator j = i->events.begin(); j != i->events.end(); ++j) {
+			stream << ",\n{\"name\":";
+			write_string(stream, j->name);
+			stream << ",\"cat\":";
+			write_string(stream, j->category);
+			stream << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << i->thread_id
+				   << ",\"ts\":" << (j->begin - origin)
+				   << ",\"dur\":" << (j->end - j->begin) << "}";
+		}
+	}
+	stream << "\n]}\n";
+
+	if (!stream) {
+		error("Trace: cannot write file '%s'", filename.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,105 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file debug/trace.h
+**	\brief Trace Header
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_DEBUG_TRACE_H
+#define __SYNFIG_DEBUG_TRACE_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <atomic>
+
+#include <synfig/string.h>
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig {
+namespace debug {
+
+//! Collects durations of rendering stages from all threads
+//! and saves them in Chrome trace format (chrome://tracing, Perfetto).
+//! Does nothing until start() is called.
+class Trace {
+private:
+	static std::atomic<bool> enabled;
+
+	static void add(const char *category, const String &name, long long begin, long long end);
+
+public:
+	//! Measures time from construction to destruction
+	class Scope {
+	private:
+		const char *category;
+		String name;
+		long long begin;
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	public:
+		Scope(): category(), begin(-1) { }
+		//! Only constant names here, so nothing is allocated when tracing is disabled,
+		//! build other names after is_enabled() check and pass them to start()
+		Scope(const char *category, const char *name): Scope()
+			{ start(category, name); }
+		~Scope()
+			{ if (begin >= 0) add(category, name, begin, now()); }
+
+		void start(const char *category, const char *name)
+			{ if (is_enabled() && begin < 0) start(category, String(name)); }
+
+		//! Starts measure, useful when name is expensive to build
+		//! and should be built only when tracing is enabled
+		void start(const char *category, const String &name)
+		{
+			if (!is_enabled() || begin >= 0) return;
+			this->category = category;
+			this->name = name;
+			begin = now();
+		}
+	};
+
+	static bool is_enabled()
+		{ return enabled.load(std::memory_order_relaxed); }
+
+	//! Current time in microseconds
+	static long long now();
+
+	//! Clears collected events and starts collecting
+	static void start();
+	static void stop();
+
+	//! Saves collected events as JSON file
+	static bool save(const String &filename);
+};
+
+}; // END of namespace debug
+}; // END of namespace synfig
+
+/* === E N D =============================================================== */
+
+#endif
@@ -34,8 +34,12 @@
 #include <cstdlib>
 
 #include <algorithm>
+#include <climits>
+#include <condition_variable>
 #include <functional>
+#include <list>
 #include <map>
+#include <mutex>
 
 #include <glibmm.h>
 
@@ -46,6 +50,9 @@
 #include "importer.h"
 #include "string.h"
 #include "surface.h"
+#include "threadpool.h"
+
+#include <synfig/debug/trace.h>
 
 #include <synfig/rendering/software/surfacesw.h>
 #include <synfig/rendering/software/surfaceswpacked.h>
@@ -54,15 +61,169 @@
 
 /* === M A C R O S ========================================================= */
 
+#define DEFAULT_FRAME_CACHE_LIMIT (512*1024*1024)
+#define DEFAULT_PREFETCH_FRAMES   4
+
 /* === G L O B A L S ======================================================= */
 
 using namespace etl;
 using namespace std;
 using namespace synfig;
 
+namespace {
+
+//! Decoded frames of animated importers, shared by all importers.
+//! Least recently used frames are dropped when memory limit is exceeded.
+class FrameCache
+{
+public:
+	struct Key
+	{
+		const Importer *importer;
+		Time::ticks_type ticks;
+
+		Key(const Importer *importer, Time::ticks_type ticks):
+			importer(importer), ticks(ticks) { }
+		Key(const Importer *importer, const Time &time):
+			importer(importer), ticks(time.ticks()) { }
+
+		bool operator<(const Key &other) const
+			{ return importer < other.importer || (importer == other.importer && ticks < other.ticks); }
+	};
+
+private:
+	typedef std::list<Key> LruList;
+
+	struct Entry
+	{
+		//! null while frame is decoding
+		rendering::Surface::Handle surface;
+		size_t size;
+		LruList::iterator lru;
+		Entry(): size(0) { }
+	};
+
+	typedef std::map<Key, Entry> Map;
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	Map entries;
+	LruList lru;
+	size_t size;
+	size_t limit;
+
+	void evict()
+	{
+		while(size > limit && !lru.empty()) {
+			Map::iterator i = entries.find(lru.front());
+			assert(i != entries.end() && i->second.surface);
+			size -= i->second.size;
+			entries.erase(i);
+			lru.pop_front();
+		}
+	}
+
+public:
+	FrameCache(): size(0), limit(DEFAULT_FRAME_CACHE_LIMIT) { }
+
+	size_t get_limit()
+		{ std::lock_guard<std::mutex> lock(mutex); return limit; }
+
+	void set_limit(size_t x)
+		{ std::lock_guard<std::mutex> lock(mutex); limit = x; evict(); }
+
+	//! Returns true and the frame if it is in cache.
+	//! Waits while frame is decoding by other thread.
+	//! Otherwise reserves the entry and returns false,
+	//! so caller should decode the frame and call end() or cancel().
+	bool begin(const Key &key, rendering::Surface::Handle &surface)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while(true) {
+			Map::iterator i = entries.find(key);
+			if (i == entries.end())
+				{ entries[key]; return false; }
+			if (i->second.surface) {
+				lru.splice(lru.end(), lru, i->second.lru);
+				surface = i->second.surface;
+				return true;
+			}
+			cond.wait(lock);
+		}
+	}
+
+	//! Reserves the entry if frame is not cached and not decoding now
+	bool try_begin(const Key &key)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!limit || entries.count(key)) return false;
+		entries[key];
+		return true;
+	}
+
+	void end(const Key &key, const rendering::Surface::Handle &surface)
+	{
+		assert(surface);
+		std::lock_guard<std::mutex> lock(mutex);
+		Entry &entry = entries[key];
+		assert(!entry.surface);
+		entry.surface = surface;
+		entry.size = surface->get_buffer_size();
+		entry.lru = lru.insert(lru.end(), key);
+		size += entry.size;
+		evict();
+		cond.notify_all();
+	}
+
+	void cancel(const Key &key)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Map::iterator i = entries.find(key);
+		if (i != entries.end() && !i->second.surface)
+			entries.erase(i);
+		cond.notify_all();
+	}
+
+	//! Drops all frames of importer, importer should not have decoding frames
+	void forget(const Importer *importer)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Map::iterator i = entries.lower_bound(Key(importer, LLONG_MIN));
+		while(i != entries.end() && i->first.importer == importer) {
+			if (i->second.surface) {
+				size -= i->second.size;
+				lru.erase(i->second.lru);
+			}
+			entries.erase(i++);
+		}
+	}
+};
+
+rendering::Surface::Handle
+create_surface(const Surface &surface)
+{
+	rendering::Surface::Handle result;
+	const char *s = getenv("SYNFIG_PACK_IMAGES");
+	if (s == nullptr || atoi(s) != 0)
+		result = new rendering::SurfaceSWPacked();
+	else
+		result = new rendering::SurfaceSW();
+
+	if (surface.is_valid())
+		result->assign(surface[0], surface.get_w(), surface.get_h());
+	return result;
+}
+
+} // end of anonimous namespace
+
 Importer::Book* synfig::Importer::book_;
 
 static map<FileSystem::Identifier,Importer::LooseHandle> *__open_importers;
+static std::mutex __open_importers_mutex;
+
+static FrameCache *__frame_cache;
+static size_t __frame_cache_limit = DEFAULT_FRAME_CACHE_LIMIT;
+static int __prefetch_frames = DEFAULT_PREFETCH_FRAMES;
 
 /* === P R O C E D U R E S ================================================= */
 
@@ -73,6 +234,13 @@ Importer::subsys_init()
 {
 	book_=new Book();
 	__open_importers=new map<FileSystem::Identifier,Importer::LooseHandle>();
+
+	if (const char *s = getenv("SYNFIG_IMPORTER_CACHE_SIZE"))
+		__frame_cache_limit = (size_t)std::max(0, atoi(s))*1024*1024;
+	if (const char *s = getenv("SYNFIG_IMPORTER_PREFETCH"))
+		__prefetch_frames = std::max(0, atoi(s));
+	__frame_cache = new FrameCache();
+	__frame_cache->set_limit(__frame_cache_limit);
 	return true;
 }
 
@@ -81,9 +249,30 @@ Importer::subsys_stop()
 {
 	delete book_;
 	delete __open_importers;
+	delete __frame_cache;
+	__frame_cache = nullptr;
 	return true;
 }
 
+void
+Importer::set_frame_cache_limit(size_t limit)
+{
+	__frame_cache_limit = limit;
+	if (__frame_cache) __frame_cache->set_limit(limit);
+}
+
+size_t
+Importer::get_frame_cache_limit()
+	{ return __frame_cache_limit; }
+
+void
+Importer::set_prefetch_frames(int count)
+	{ __prefetch_frames = std::max(0, count); }
+
+int
+Importer::get_prefetch_frames()
+	{ return __prefetch_frames; }
+
 Importer::Book&
 Importer::book()
 {
@@ -101,6 +290,8 @@ Importer::open(const FileSystem::Identifier &identifier, bool force)
 		return nullptr;
 	}
 
+	std::lock_guard<std::mutex> lock(__open_importers_mutex);
+
 	// If we already have an importer open under that filename,
 	// then use it instead.
 	if(__open_importers->count(identifier))
@@ -141,10 +332,13 @@ Importer::open(const FileSystem::Identifier &identifier, bool force)
 
 void Importer::forget(const FileSystem::Identifier &identifier)
 {
+	std::lock_guard<std::mutex> lock(__open_importers_mutex);
 	__open_importers->erase(identifier);
 }
 
 Importer::Importer(const FileSystem::Identifier &identifier):
+	last_time_(Time::begin()),
+	prefetching_(false),
 	identifier(identifier)
 {
 }
@@ -152,31 +346,115 @@ Importer::Importer(const FileSystem::Identifier &identifier):
 
 Importer::~Importer()
 {
+	if (__frame_cache)
+		__frame_cache->forget(this);
+
 	// Remove ourselves from the open importer list
+	std::lock_guard<std::mutex> lock(__open_importers_mutex);
 	map<FileSystem::Identifier,Importer::LooseHandle>::iterator iter;
 	for(iter=__open_importers->begin();iter!=__open_importers->end();)
 		if(iter->second==this)
 			__open_importers->erase(iter++); else ++iter;
 }
 
-rendering::Surface::Handle
-Importer::get_frame(const RendDesc & /* renddesc */, const Time &time)
+bool
+Importer::load_frame(Surface &surface, const RendDesc &renddesc, Time time, ProgressCallback *callback)
 {
-	if (last_surface_ && last_surface_->is_exists() && !is_animated())
-		return last_surface_;
+	std::lock_guard<std::mutex> lock(decode_mutex_);
+	debug::Trace::Scope trace;
+	if (debug::Trace::is_enabled())
+		trace.start("importer", strprintf("decode %s at %f", identifier.filename.c_str(), (double)time));
+	return get_frame(surface, renddesc, time, callback);
+}
 
+rendering::Surface::Handle
+Importer::decode_frame(const RendDesc &renddesc, const Time &time)
+{
 	Surface surface;
-	if(!get_frame(surface, RendDesc(), time))
+	if (!load_frame(surface, renddesc, time))
 		warning(strprintf("Unable to get frame from \"%s\"", identifier.filename.c_str()));
+	return create_surface(surface);
+}
 
-	const char *s = getenv("SYNFIG_PACK_IMAGES");
-	if (s == nullptr || atoi(s) != 0)
-		last_surface_ = new rendering::SurfaceSWPacked();
-	else
-		last_surface_ = new rendering::SurfaceSW();
+void
+Importer::prefetch(const RendDesc &renddesc, const Time &time)
+{
+	float fps = renddesc.get_frame_rate();
+	int count = __prefetch_frames;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	Time prev_time = last_time_;
+	last_time_ = time;
+
+	// prefetch only when frames are requested one by one in forward direction
+	if (fps <= 0 || count <= 0 || prefetching_)
+		return;
+	Time step(1.0/fps);
+	if (!(time > prev_time) || time - prev_time > 2.0*step + Time::epsilon())
+		return;
+
+	prefetching_ = true;
+	ThreadPool::instance().enqueue(
+		sigc::bind(sigc::ptr_fun(&Importer::prefetch_frames), Handle(this), renddesc, Time(time + step), step, count) );
+}
 
-	if (surface.is_valid())
-		last_surface_->assign(surface[0], surface.get_w(), surface.get_h());
+void
+Importer::prefetch_frames(Handle importer, RendDesc renddesc, Time time, Time step, int count)
+{
+	// decode frames in order, sequential decoders (like video) cannot seek back cheaply
+	if (FrameCache *cache = __frame_cache) {
+		for(int i = 0; i < count; ++i, time = time + step) {
+			FrameCache::Key key(importer.get(), time);
+			if (!cache->try_begin(key))
+				continue;
+			rendering::Surface::Handle surface;
+			try {
+				surface = importer->decode_frame(renddesc, time);
+			} catch(...) {
+				cache->cancel(key);
+				break;
+			}
+			cache->end(key, surface);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(importer->mutex_);
+	importer->prefetching_ = false;
+}
+
+rendering::Surface::Handle
+Importer::get_frame(const RendDesc &renddesc, const Time &time)
+{
+	if (!is_animated()) {
+		std::lock_guard<std::mutex> lock(decode_mutex_);
+		if (!last_surface_ || !last_surface_->is_exists()) {
+			debug::Trace::Scope trace;
+			if (debug::Trace::is_enabled())
+				trace.start("importer", "decode " + identifier.filename);
+			Surface surface;
+			if(!get_frame(surface, RendDesc(), time))
+				warning(strprintf("Unable to get frame from \"%s\"", identifier.filename.c_str()));
+			last_surface_ = create_surface(surface);
+		}
+		return last_surface_;
+	}
+
+	FrameCache *cache = __frame_cache;
+	if (!cache || !cache->get_limit())
+		return decode_frame(renddesc, time);
+
+	FrameCache::Key key(this, time);
+	rendering::Surface::Handle surface;
+	if (!cache->begin(key, surface)) {
+		try {
+			surface = decode_frame(renddesc, time);
+		} catch(...) {
+			cache->cancel(key);
+			throw;
+		}
+		cache->end(key, surface);
+	}
 
-	return last_surface_;
+	prefetch(renddesc, time);
+	return surface;
 }
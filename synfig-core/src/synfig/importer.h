@@ -30,6 +30,7 @@
 #include <cstdio>
 
 #include <map>
+#include <mutex>
 
 #include <ETL/handle>
 
@@ -148,6 +149,18 @@ public:
 private:
 	rendering::Surface::Handle last_surface_;
 
+	//! Decoders are not thread-safe, only one get_frame() call per importer at once
+	std::mutex decode_mutex_;
+
+	std::mutex mutex_;
+	//! Time of the last requested frame, used to detect sequential playback
+	Time last_time_;
+	bool prefetching_;
+
+	rendering::Surface::Handle decode_frame(const RendDesc &renddesc, const Time &time);
+	void prefetch(const RendDesc &renddesc, const Time &time);
+	static void prefetch_frames(Handle importer, RendDesc renddesc, Time time, Time step, int count);
+
 protected:
 
 	Importer(const FileSystem::Identifier &identifier);
@@ -167,14 +180,29 @@ public:
 	*/
 	virtual bool get_frame(Surface &surface, const RendDesc &renddesc, Time time, ProgressCallback *callback=nullptr) = 0;
 
+	//! Gets a frame through the frame cache.
+	//! For animated importers, requests of subsequent frames also start
+	//! background decoding of the next frames.
 	virtual rendering::Surface::Handle get_frame(const RendDesc &renddesc, const Time &time);
 
+	//! Calls get_frame() under the importer lock, so it may be called from several threads
+	bool load_frame(Surface &surface, const RendDesc &renddesc, Time time, ProgressCallback *callback=nullptr);
+
 	//! Returns \c true if the importer pays attention to the \a time parameter of get_frame()
 	virtual bool is_animated() { return false; }
 
 	//! Attempts to open \a filename, and returns a handle to the associated Importer
 	static Handle open(const FileSystem::Identifier &identifier, bool force=false);
 	static void forget(const FileSystem::Identifier &identifier);
+
+	//! Memory limit in bytes for the decoded frames of all animated importers,
+	//! zero disables the frame cache and prefetching
+	static void set_frame_cache_limit(size_t limit);
+	static size_t get_frame_cache_limit();
+
+	//! Count of frames to decode in background ahead of sequential playback
+	static void set_prefetch_frames(int count);
+	static int get_prefetch_frames();
 };
 
 }; // END of namespace synfig
@@ -90,6 +90,7 @@ Layer_PasteCanvas::Layer_PasteCanvas(Real amount, Color::BlendMethod blend_metho
 	Layer_Composite(amount, blend_method),
 	param_origin(Point()),
 	param_transformation(Transformation()),
+	sub_canvas_static(false),
 	param_time_dilation(Real(1)),
 	param_time_offset(Time(0)),
 	param_outline_grow(Real(0)),
@@ -117,6 +118,8 @@ Layer_PasteCanvas::~Layer_PasteCanvas()
 String
 Layer_PasteCanvas::get_local_name()const
 {
+	if(!sub_canvas_id.empty())
+		return get_canvas() ? get_canvas()->get_external_file_name(sub_canvas_id) : sub_canvas_id;
 	if(!sub_canvas || sub_canvas->is_inline()) return String();
 	if(sub_canvas->get_root()==get_canvas()->get_root()) return sub_canvas->get_id();
 	return sub_canvas->get_file_name();
@@ -162,7 +165,7 @@ Layer_PasteCanvas::get_param_vocab()const
 		.set_local_name(_("Outline Grow"))
 		.set_description(_("Exponential value to grow children Outline layers width"))
 	);
-	if(sub_canvas && !(sub_canvas->is_inline()))
+	if(!sub_canvas_id.empty() || (sub_canvas && !(sub_canvas->is_inline())))
 	{
 		ret.back().hidden();
 	}
@@ -226,6 +229,9 @@ Layer_PasteCanvas::childs_changed()
 void
 Layer_PasteCanvas::set_sub_canvas(etl::handle<synfig::Canvas> x)
 {
+	// canvas replaces the one which is not loaded yet
+	sub_canvas_id.clear();
+
 	if (sub_canvas)
 		remove_child(sub_canvas.get());
 
@@ -258,6 +264,64 @@ Layer_PasteCanvas::set_sub_canvas(etl::handle<synfig::Canvas> x)
 		on_canvas_set();
 }
 
+void
+Layer_PasteCanvas::set_sub_canvas_id(const String &x, bool is_static)
+{
+	set_sub_canvas(0);
+	sub_canvas_id = x;
+	sub_canvas_static = is_static;
+}
+
+bool
+Layer_PasteCanvas::load_sub_canvas()const
+{
+	if (sub_canvas_id.empty())
+		return true;
+
+	// forget the id before loading, so failed file will not be loaded again
+	String id;
+	std::swap(id, sub_canvas_id);
+	return load_sub_canvas(id);
+}
+
+bool
+Layer_PasteCanvas::load_sub_canvas(const String &id)const
+{
+	if (!get_canvas())
+	{
+		synfig::error("Layer_PasteCanvas: cannot load canvas '%s' of layer without parent canvas", id.c_str());
+		return false;
+	}
+
+	try
+	{
+		String warnings;
+		Canvas::Handle canvas = get_canvas()->surefind_canvas(id, warnings);
+		if (!warnings.empty())
+			synfig::warning("%s", warnings.c_str());
+		if (!canvas)
+		{
+			synfig::error("Layer_PasteCanvas: failed to load subcanvas '%s'", id.c_str());
+			return false;
+		}
+		// the same as parser does for loaded canvas
+		ValueBase value(canvas);
+		value.set_static(sub_canvas_static);
+		const_cast<Layer_PasteCanvas*>(this)->set_param("canvas", value);
+	}
+	catch(const std::exception &x)
+	{
+		synfig::error("Layer_PasteCanvas: %s", x.what());
+		return false;
+	}
+
+	// apply state which was skipped while canvas was not loaded
+	sub_canvas->set_outline_grow(get_outline_grow_mark() + param_outline_grow.get(Real()));
+	if (get_time_mark() != Time::end())
+		set_sub_canvas_time(get_time_mark()*param_time_dilation.get(Real()) + param_time_offset.get(Time()));
+	return true;
+}
+
 // when a pastecanvas that contains another pastecanvas is copy/pasted
 // from one document to another, only the outermost pastecanvas was
 // getting its renddesc set to match that of its new parent.  this
@@ -308,6 +372,7 @@ Layer_PasteCanvas::set_time_vfunc(IndependentContext context, Time time)const
 {
 	context.set_time(time);
 
+	load_sub_canvas();
 	if (!sub_canvas)
 		return;
 	if (depth == MAX_DEPTH)
@@ -316,7 +381,14 @@ Layer_PasteCanvas::set_time_vfunc(IndependentContext context, Time time)const
 
 	Real time_dilation = param_time_dilation.get(Real());
 	Time time_offset = param_time_offset.get(Time());
-	sub_canvas->set_time(time*time_dilation + time_offset);
+	set_sub_canvas_time(time*time_dilation + time_offset);
+}
+
+void
+Layer_PasteCanvas::set_sub_canvas_time(Time time)const
+{
+	if (sub_canvas)
+		sub_canvas->set_time(time);
 }
 
 void
@@ -324,6 +396,7 @@ Layer_PasteCanvas::load_resources_vfunc(IndependentContext context, Time time)co
 {
 	context.load_resources(time);
 
+	load_sub_canvas();
 	if (!sub_canvas)
 		return;
 	if (depth == MAX_DEPTH)
@@ -340,6 +413,7 @@ Layer_PasteCanvas::set_outline_grow_vfunc(IndependentContext context, Real outli
 {
 	context.set_outline_grow(outline_grow);
 
+	// not loaded canvas will take outline grow while loading
 	if (!sub_canvas)
 		return;
 	if (depth == MAX_DEPTH)
@@ -407,11 +481,11 @@ Layer_PasteCanvas::get_bounding_rect_context_dependent(const ContextParams &cont
 	if (!sub_canvas)
 		return Rect::zero();
 
-	ContextParams subparams(context_params);
-	apply_z_range_to_params(subparams);
+	CanvasBase context_queue;
+	context_queue.push_back(Layer::Handle());
 
 	CanvasBase queue;
-	Context subcontext = sub_canvas->get_context_sorted(subparams, queue);
+	Context subcontext = build_context_queue(Context(context_queue.begin(), context_params), queue);
 
 	return get_summary_transformation().transform_bounds(
 			subcontext.get_full_bounding_rect() );
@@ -437,6 +511,7 @@ Layer_PasteCanvas::get_times_vfunc(Node::time_set &set) const
 	Time time_offset=param_time_offset.get(Time());
 
 	Node::time_set tset;
+	load_sub_canvas();
 	if(sub_canvas) tset = sub_canvas->get_times();
 
 	Node::time_set::iterator i = tset.begin(), end = tset.end();
@@ -463,6 +538,7 @@ Layer_PasteCanvas::get_times_vfunc(Node::time_set &set) const
 void
 Layer_PasteCanvas::fill_sound_processor(SoundProcessor &soundProcessor) const
 {
+	if (active()) load_sub_canvas();
 	if (active() && sub_canvas) sub_canvas->fill_sound_processor(soundProcessor);
 }
 
@@ -62,6 +62,10 @@ private:
 	ValueBase param_transformation;
 	//! Parameter: (etl::loose_handle<synfig::Canvas>) The canvas parameter
 	etl::loose_handle<synfig::Canvas> sub_canvas;
+	//! Id of canvas of other file ("file.sif#canvas") which is not loaded yet
+	mutable String sub_canvas_id;
+	//! Static flag of canvas parameter, applied when canvas is loaded
+	bool sub_canvas_static;
 	//! Parameter: (Real) Time dilation of the paste canvas layer
 	ValueBase param_time_dilation;
 	//! Parameter: (Time) Time offset of the paste canvas layer
@@ -108,6 +112,8 @@ private:
 	bool extra_reference;
 
 	void childs_changed();
+	//! Loads canvas by id, called by load_sub_canvas()
+	bool load_sub_canvas(const String &id)const;
 
 	/*
  -- ** -- S I G N A L S -------------------------------------------------------
@@ -138,10 +144,27 @@ public:
 
 	//! Gets the canvas parameter. It is called sub_canvas to avoid confusion
 	//! with the get_canvas from the Layer class.
+	//! Canvas of other file which is not loaded yet is null here, see load_sub_canvas()
 	etl::handle<synfig::Canvas> get_sub_canvas()const { return sub_canvas; }
 	//! Sets the canvas parameter.
 	//! \see get_sub_canvas()
 	void set_sub_canvas(etl::handle<synfig::Canvas> x);
+	//! Sets the id of canvas of other file, which will be loaded
+	//! when the layer needs it first time. \see load_sub_canvas()
+	void set_sub_canvas_id(const String &x, bool is_static = false);
+	//! Gets the id of canvas which is not loaded yet
+	const String& get_sub_canvas_id()const { return sub_canvas_id; }
+	//! Gets the static flag of canvas which is not loaded yet
+	bool get_sub_canvas_static()const { return sub_canvas_static; }
+	//! Loads the canvas set by set_sub_canvas_id().
+	//! Parser is not thread-safe, so it is called only on the thread which
+	//! owns the document: by set_time(), load_resources() and by traversals of
+	//! the whole document (get_times(), fill_sound_processor()), which targets
+	//! run before the first frame. Other methods (get_param(), rendering,
+	//! bounds, hit check) may run on other threads, they treat not loaded
+	//! canvas as absent.
+	//! Returns false if canvas cannot be loaded
+	bool load_sub_canvas()const;
 	//! Gets time dilation parameter
 	Real get_time_dilation()const { return param_time_dilation.get(Real()); }
 	//! Gets time offset parameter
@@ -188,6 +211,8 @@ public:
 
 protected:
 	virtual Context build_context_queue(Context context, CanvasBase &out_queue)const;
+	//! Sets the time of layers of sub canvas (\a time is already dilated and offset)
+	virtual void set_sub_canvas_time(Time time)const;
 
 	//! Sets the time of the Paste Canvas Layer and those under it
 	virtual void set_time_vfunc(IndependentContext context, Time time)const;
@@ -148,6 +148,51 @@ Layer_Switch::get_current_layer()const
 }
 
 
+Context
+Layer_Switch::build_context_queue(Context context, CanvasBase &out_queue)const
+{
+	// optimized layer already has only the layers in z range
+	if (optimized())
+		return Layer_PasteCanvas::build_context_queue(context, out_queue);
+
+	ContextParams params(context.get_params());
+	apply_z_range_to_params(params);
+
+	out_queue.clear();
+	if (Layer::Handle layer = get_current_layer())
+		out_queue.push_back(layer);
+	out_queue.push_back(Layer::Handle());
+	return Context(out_queue.begin(), params);
+}
+
+void
+Layer_Switch::set_sub_canvas_time(Time time)const
+{
+	Layer::Handle layer = get_current_layer();
+	if (!layer)
+		return;
+
+	CanvasBase queue;
+	queue.push_back(layer);
+	queue.push_back(Layer::Handle());
+	IndependentContext(queue.begin()).set_time(time);
+}
+
+void
+Layer_Switch::load_resources_vfunc(IndependentContext context, Time time)const
+{
+	context.load_resources(time);
+
+	Layer::Handle layer = get_current_layer();
+	if (!layer)
+		return;
+
+	CanvasBase queue;
+	queue.push_back(layer);
+	queue.push_back(Layer::Handle());
+	IndependentContext(queue.begin()).load_resources(time*get_time_dilation() + get_time_offset());
+}
+
 void
 Layer_Switch::apply_z_range_to_params(ContextParams &cp)const
 {
@@ -86,6 +86,16 @@ public:
 
 	//! Sets z_range* fields of specified ContextParams \a cp
 	virtual void apply_z_range_to_params(ContextParams &cp)const;
+
+protected:
+	//! Context of the current layer only, other layers are not rendered,
+	//! so bounds, hit check and rendering task don't visit them
+	virtual Context build_context_queue(Context context, CanvasBase &out_queue)const;
+	//! Sets time only for the current layer, others are not rendered,
+	//! so external canvases of them are not loaded
+	virtual void set_sub_canvas_time(Time time)const;
+	//! Loads external resources only for the current layer, others are not rendered
+	virtual void load_resources_vfunc(IndependentContext context, Time time)const;
 }; // END of class Layer_Switch
 
 }; // END of namespace synfig
@@ -38,7 +38,6 @@
 #include <synfig/localization.h>
 
 #include "filesystemnative.h"
-#include <synfig/rendering/software/surfacesw.h>
 
 
 #endif
@@ -199,15 +198,9 @@ ListImporter::get_sub_importer(const RendDesc &renddesc, Time time, ProgressCall
 bool
 ListImporter::get_frame(Surface &surface, const RendDesc &renddesc, Time time, ProgressCallback *cb)
 {
+	// sub-importers may be shared with other layers, so use locked call
 	Importer::Handle importer = get_sub_importer(renddesc, time, cb);
-	return importer && importer->get_frame(surface, renddesc, 0, cb);
-}
-
-rendering::Surface::Handle
-ListImporter::get_frame(const RendDesc &renddesc, const Time &time)
-{
-	Importer::Handle importer = get_sub_importer(renddesc, time, NULL);
-	return importer ? importer->get_frame(renddesc, 0) : new rendering::SurfaceSW();
+	return importer && importer->load_frame(surface, renddesc, 0, cb);
 }
 
 bool
@@ -38,12 +38,16 @@
 #include <cstdlib>
 #include <cstring>
 
+#include <algorithm>
+#include <exception>
 #include <iostream>
 #include <map>
 #include <vector>
 #include <stdexcept>
 
 #include <libxml++/libxml++.h>
+#include <libxml/parser.h>
+#include <libxml/SAX2.h>
 #include <sigc++/bind.h>
 
 #include <ETL/stringf>
@@ -2753,8 +2757,48 @@ CanvasParser::parse_canvas_bones(xmlpp::Element *element,Canvas::Handle canvas)
 	return bone_list;
 }
 
+struct CanvasParser::LayerContext
+{
+	Layer::Handle layer;
+	Canvas::Handle canvas;
+	String type;
+	String version;
+
+	// Load old groups
+	bool old_pastecanvas;
+	ValueNode::Handle origin_node;
+	ValueNode_Composite::Handle transformation_node;
+	ValueNode_Add::Handle offset_node;
+	ValueNode_Scale::Handle scale_scalar_node;
+	ValueNode_Exp::Handle scale_node;
+	bool origin_const, focus_const, zoom_const;
+
+	LayerContext():
+		old_pastecanvas(false), origin_const(true), focus_const(true), zoom_const(true) { }
+};
+
 Layer::Handle
 CanvasParser::parse_layer(xmlpp::Element *element,Canvas::Handle canvas)
+{
+	LayerContext context;
+	parse_layer_begin(element, canvas, context);
+	if (!context.layer)
+		return Layer::Handle();
+
+	xmlpp::Element::NodeList list = element->get_children();
+	for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
+	{
+		xmlpp::Element *child(dynamic_cast<xmlpp::Element*>(*iter));
+		if(child)
+			parse_layer_child(child, context);
+	}
+
+	parse_layer_end(element, context);
+	return context.layer;
+}
+
+void
+CanvasParser::parse_layer_begin(xmlpp::Element *element,Canvas::Handle canvas,LayerContext &context)
 {
 
 	assert(element->get_name()=="layer");
@@ -2763,11 +2807,12 @@ CanvasParser::parse_layer(xmlpp::Element *element,Canvas::Handle canvas)
 	if(!element->get_attribute("type"))
 	{
 		error(element,_("Missing \"type\" attribute to \"layer\" element"));
-		return Layer::Handle();
+		return;
 	}
-	if(element->get_attribute("type")->get_value() == "filled_rectangle")
+	context.type = element->get_attribute("type")->get_value();
+	if(context.type == "filled_rectangle")
 	layer=Layer::create("rectangle");
-	else layer=Layer::create(element->get_attribute("type")->get_value());
+	else layer=Layer::create(context.type);
 	layer->set_canvas(canvas);
 
 	if(element->get_attribute("group"))
@@ -2798,263 +2843,306 @@ CanvasParser::parse_layer(xmlpp::Element *element,Canvas::Handle canvas)
 	if(element->get_attribute("exclude_from_rendering"))
 		layer->set_exclude_from_rendering(!is_false(element->get_attribute("exclude_from_rendering")->get_value()));
 
+	context.layer = layer;
+	context.canvas = canvas;
+	context.version = version;
+
 	// Load old groups
 	etl::handle<Layer_PasteCanvas> layer_pastecanvas = etl::handle<Layer_Group>::cast_dynamic(layer);
-	bool old_pastecanvas = layer_pastecanvas && version=="0.1";
-	ValueNode::Handle origin_node;
-	ValueNode_Composite::Handle transformation_node;
-	ValueNode_Add::Handle offset_node;
-	ValueNode_Scale::Handle scale_scalar_node;
-	ValueNode_Exp::Handle scale_node;
-	bool origin_const=true, focus_const=true, zoom_const=true;
-	if (old_pastecanvas) {
-		transformation_node = ValueNode_Composite::create(ValueBase(Transformation()), canvas);
-		layer->connect_dynamic_param("transformation", ValueNode::Handle(transformation_node));
+	context.old_pastecanvas = layer_pastecanvas && version=="0.1";
+	if (context.old_pastecanvas) {
+		context.transformation_node = ValueNode_Composite::create(ValueBase(Transformation()), canvas);
+		layer->connect_dynamic_param("transformation", ValueNode::Handle(context.transformation_node));
 
-		offset_node = ValueNode_Add::create(ValueBase(Vector(0,0)));
-		transformation_node->set_link("offset", offset_node);
+		context.offset_node = ValueNode_Add::create(ValueBase(Vector(0,0)));
+		context.transformation_node->set_link("offset", context.offset_node);
 
-		origin_node = offset_node->get_link("rhs");
-		layer->connect_dynamic_param("origin", ValueNode::Handle(origin_node));
+		context.origin_node = context.offset_node->get_link("rhs");
+		layer->connect_dynamic_param("origin", ValueNode::Handle(context.origin_node));
 
-		scale_scalar_node = ValueNode_Scale::create(ValueBase(Vector(1,1)));
-		transformation_node->set_link("scale", scale_scalar_node);
+		context.scale_scalar_node = ValueNode_Scale::create(ValueBase(Vector(1,1)));
+		context.transformation_node->set_link("scale", context.scale_scalar_node);
 
-		scale_node = ValueNode_Exp::create(ValueBase(Real(1)));
-		scale_scalar_node->set_link("scalar", scale_node);
+		context.scale_node = ValueNode_Exp::create(ValueBase(Real(1)));
+		context.scale_scalar_node->set_link("scalar", context.scale_node);
 	}
+}
 
-	xmlpp::Element::NodeList list = element->get_children();
-	for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
+void
+CanvasParser::parse_layer_child(xmlpp::Element *child,LayerContext &context,const ValueBase &value)
+{
+	const Layer::Handle &layer = context.layer;
+	const Canvas::Handle &canvas = context.canvas;
+	const bool old_pastecanvas = context.old_pastecanvas;
+	ValueNode::Handle &origin_node = context.origin_node;
+	const ValueNode_Add::Handle &offset_node = context.offset_node;
+	const ValueNode_Exp::Handle &scale_node = context.scale_node;
+	bool &origin_const = context.origin_const;
+	bool &focus_const = context.focus_const;
+	bool &zoom_const = context.zoom_const;
+
+	if(child->get_name()=="name")
+		warning(child,_("<name> entry for <layer> is not yet supported. Ignoring..."));
+	else
+	if(child->get_name()=="desc")
+		warning(child,_("<desc> entry for <layer> is not yet supported. Ignoring..."));
+	else
+	if(child->get_name()=="param")
 	{
-		xmlpp::Element *child(dynamic_cast<xmlpp::Element*>(*iter));
-		if(!child)
-			continue;
-		else
-		if(child->get_name()=="name")
-			warning(child,_("<name> entry for <layer> is not yet supported. Ignoring..."));
-		else
-		if(child->get_name()=="desc")
-			warning(child,_("<desc> entry for <layer> is not yet supported. Ignoring..."));
-		else
-		if(child->get_name()=="param")
+		xmlpp::Element::NodeList list = child->get_children();
+
+		if(!child->get_attribute("name"))
 		{
-			xmlpp::Element::NodeList list = child->get_children();
+			error(child,_("Missing \"name\" attribute for <param>."));
+			return;
+		}
 
-			if(!child->get_attribute("name"))
-			{
-				error(child,_("Missing \"name\" attribute for <param>."));
-				continue;
-			}
+		String param_name=child->get_attribute("name")->get_value();
 
-			String param_name=child->get_attribute("name")->get_value();
+		// SVN r2013 and r2014 renamed all 'pos' and 'offset' parameters to 'origin'
+		// 'pos' and 'offset' will appear in old .sif files; handle them correctly
+		if (param_name == "pos" || param_name == "offset")
+			param_name = "origin";
 
-			// SVN r2013 and r2014 renamed all 'pos' and 'offset' parameters to 'origin'
-			// 'pos' and 'offset' will appear in old .sif files; handle them correctly
-			if (param_name == "pos" || param_name == "offset")
-				param_name = "origin";
+		if(child->get_attribute("use"))
+		{
+			// If the "use" attribute is used, then the
+			// element should be empty. Warn the user if
+			// we find otherwise.
+			if(!list.empty())
+				warning(child,_("Found \"use\" attribute for <param>, but it wasn't empty. Ignoring contents..."));
 
-			if(child->get_attribute("use"))
+			String str=	child->get_attribute("use")->get_value();
+
+			if (str.empty())
+				error(child,_("Empty use=\"\" value in <param>"));
+			else if(layer->get_param(param_name).get_type()==type_canvas)
 			{
-				// If the "use" attribute is used, then the
-				// element should be empty. Warn the user if
-				// we find otherwise.
-				if(!list.empty())
-					warning(child,_("Found \"use\" attribute for <param>, but it wasn't empty. Ignoring contents..."));
+				// postpone loading of other file until the layer needs it,
+				// missing files are still reported while parsing
+				if (lazy_externals_ && param_name == "canvas")
+				{
+					String file_name = canvas->get_external_file_name(str);
+					Layer_PasteCanvas::Handle paste = Layer_PasteCanvas::Handle::cast_dynamic(layer);
+					if ( paste
+					  && !file_name.empty()
+					  && !get_open_canvas_map().count(etl::absolute_path(file_name))
+					  && canvas->get_file_system()
+					  && canvas->get_file_system()->is_file(file_name) )
+					{
+						paste->set_sub_canvas_id(str, parse_static(child));
+						return;
+					}
+				}
 
-				String str=	child->get_attribute("use")->get_value();
+				String warnings;
+				Canvas::Handle c(canvas->surefind_canvas(str, warnings));
+				warnings_text += warnings;
+				if(!c) error(child,strprintf(_("Failed to load subcanvas '%s'"), str.c_str()));
+				if(!layer->set_param(param_name,c))
+					error(child,_("Layer rejected canvas link"));
+				//Parse the static option and sets it to the canvas ValueBase
+				ValueBase v=layer->get_param(param_name);
+				v.set_static(parse_static(child));
+				layer->set_param(param_name, v);
+			}
+			else
+			try
+			{
+				handle<ValueNode> value_node=canvas->surefind_value_node(str);
+				if(PlaceholderValueNode::Handle::cast_dynamic(value_node))
+					throw Exception::IDNotFound("parse_layer()");
 
-				if (str.empty())
-					error(child,_("Empty use=\"\" value in <param>"));
-				else if(layer->get_param(param_name).get_type()==type_canvas)
+				// Assign the value_node to the dynamic parameter list
+				if (param_name == "segment_list" && (layer->get_name() == "region" || layer->get_name() == "outline"))
 				{
-					String warnings;
-					Canvas::Handle c(canvas->surefind_canvas(str, warnings));
-					warnings_text += warnings;
-					if(!c) error((*iter),strprintf(_("Failed to load subcanvas '%s'"), str.c_str()));
-					if(!layer->set_param(param_name,c))
-						error((*iter),_("Layer rejected canvas link"));
-					//Parse the static option and sets it to the canvas ValueBase
-					ValueBase v=layer->get_param(param_name);
-					v.set_static(parse_static(child));
-					layer->set_param(param_name, v);
+					synfig::warning("%s: Updated valuenode connection to use the \"bline\" parameter instead of \"segment_list\".",
+									layer->get_name().c_str());
+					param_name = "bline";
 				}
-				else
-				try
-				{
-					handle<ValueNode> value_node=canvas->surefind_value_node(str);
-					if(PlaceholderValueNode::Handle::cast_dynamic(value_node))
-						throw Exception::IDNotFound("parse_layer()");
 
-					// Assign the value_node to the dynamic parameter list
-					if (param_name == "segment_list" && (layer->get_name() == "region" || layer->get_name() == "outline"))
+				// NB: this part of code has copy below
+				bool processed = false;
+				if (old_pastecanvas)
+				{
+					processed = true;
+					if (param_name == "origin")
 					{
-						synfig::warning("%s: Updated valuenode connection to use the \"bline\" parameter instead of \"segment_list\".",
-										layer->get_name().c_str());
-						param_name = "bline";
+						origin_const = false;
+						offset_node->set_link("lhs", value_node);
 					}
-
-					// NB: this part of code has copy below
-					bool processed = false;
-					if (old_pastecanvas)
+					else
+					if (param_name == "focus")
 					{
-						processed = true;
-						if (param_name == "origin")
-						{
-							origin_const = false;
-							offset_node->set_link("lhs", value_node);
-						}
-						else
-						if (param_name == "focus")
-						{
-							focus_const = false;
-							origin_node = value_node;
-							layer->connect_dynamic_param("origin_node", ValueNode::Handle(origin_node));
-							offset_node->set_link("rhs", value_node);
-						}
-						else
-						if (param_name == "zoom")
-						{
-							zoom_const = false;
-							scale_node->set_link("exp", value_node);
-						}
-						else
-							processed = false;
+						focus_const = false;
+						origin_node = value_node;
+						layer->connect_dynamic_param("origin_node", ValueNode::Handle(origin_node));
+						offset_node->set_link("rhs", value_node);
 					}
-
-					if (!processed) layer->connect_dynamic_param(param_name,value_node);
-    			}
-				catch(Exception::IDNotFound&)
-				{
-					error(child,strprintf(_("Unknown ID (%s) referenced in parameter \"%s\""),str.c_str(), param_name.c_str()));
+					else
+					if (param_name == "zoom")
+					{
+						zoom_const = false;
+						scale_node->set_link("exp", value_node);
+					}
+					else
+						processed = false;
 				}
 
-				continue;
+				if (!processed) layer->connect_dynamic_param(param_name,value_node);
+    			}
+			catch(Exception::IDNotFound&)
+			{
+				error(child,strprintf(_("Unknown ID (%s) referenced in parameter \"%s\""),str.c_str(), param_name.c_str()));
 			}
 
-			xmlpp::Element::NodeList::iterator iter;
+			return;
+		}
 
-			// Search for the first non-text XML element
-			for(iter = list.begin(); iter != list.end(); ++iter)
-				if(dynamic_cast<xmlpp::Element*>(*iter))
-					break;
-				//if(!(!dynamic_cast<xmlpp::Element*>(*iter) && (*iter)->get_name()=="text"||(*iter)->get_name()=="comment"   )) break;
+		xmlpp::Element::NodeList::iterator iter;
 
-			if(iter==list.end())
+		// Search for the first non-text XML element
+		for(iter = list.begin(); iter != list.end(); ++iter)
+			if(dynamic_cast<xmlpp::Element*>(*iter))
+				break;
+			//if(!(!dynamic_cast<xmlpp::Element*>(*iter) && (*iter)->get_name()=="text"||(*iter)->get_name()=="comment"   )) break;
+
+		if(iter==list.end())
+		{
+			error(child,_("<param> is either missing its contents, or missing a \"use\" attribute."));
+			return;
+		}
+
+		ValueBase data;
+		handle<ValueNode> value_node;
+
+		// The value may be already parsed while streaming (see StreamParser)
+		if(value.is_valid())
+		{
+			data=value;
+		}
+		else
+		// If we recognize the element name as a
+		// ValueBase, then treat is at one
+		if(/*(*iter)->get_name()!="canvas" && */ValueBase::ident_type((*iter)->get_name()) != type_nil && !dynamic_cast<xmlpp::Element*>(*iter)->get_attribute("guid"))
+		{
+			data=parse_value(dynamic_cast<xmlpp::Element*>(*iter),canvas);
+
+			if(!data.is_valid())
 			{
-				error(child,_("<param> is either missing its contents, or missing a \"use\" attribute."));
-				continue;
+				error((*iter),_("Bad data for <param>"));
+				return;
 			}
+		}
+		else	// ... otherwise, we assume that it is a ValueNode
+		{
+			value_node=parse_value_node(dynamic_cast<xmlpp::Element*>(*iter),canvas);
 
-			ValueBase data;
-			handle<ValueNode> value_node;
-
-			// If we recognize the element name as a
-			// ValueBase, then treat is at one
-			if(/*(*iter)->get_name()!="canvas" && */ValueBase::ident_type((*iter)->get_name()) != type_nil && !dynamic_cast<xmlpp::Element*>(*iter)->get_attribute("guid"))
+			if(!value_node)
 			{
-				data=parse_value(dynamic_cast<xmlpp::Element*>(*iter),canvas);
+				error((*iter),_("Bad data for <param>"));
+				return;
+			}
+		}
 
-				if(!data.is_valid())
-				{
-					error((*iter),_("Bad data for <param>"));
-					continue;
-				}
+		// NB: this part of code has copy above
+		bool processed = false;
+		if (old_pastecanvas)
+		{
+			processed = true;
+			bool is_const = !value_node;
+			ValueNode::Handle node = value_node ? value_node : ValueNode_Const::create(data,canvas);
+			if (param_name == "origin")
+			{
+				// ice0: check here 
+				if (!is_const) origin_const = false;
+				offset_node->set_link("lhs", node);
 			}
-			else	// ... otherwise, we assume that it is a ValueNode
+			else
+			if (param_name == "focus")
 			{
-				value_node=parse_value_node(dynamic_cast<xmlpp::Element*>(*iter),canvas);
-
-				if(!value_node)
-				{
-					error((*iter),_("Bad data for <param>"));
-					continue;
-				}
+				if (!is_const) focus_const = false;
+				origin_node = node;
+				layer->connect_dynamic_param("origin_node", ValueNode::Handle(origin_node));
+				offset_node->set_link("rhs", node);
 			}
-
-			// NB: this part of code has copy above
-			bool processed = false;
-			if (old_pastecanvas)
+			else
+			if (param_name == "zoom")
 			{
-				processed = true;
-				bool is_const = !value_node;
-				ValueNode::Handle node = value_node ? value_node : ValueNode_Const::create(data,canvas);
-				if (param_name == "origin")
-				{
-					// ice0: check here 
-					if (!is_const) origin_const = false;
-					offset_node->set_link("lhs", node);
-				}
-				else
-				if (param_name == "focus")
-				{
-					if (!is_const) focus_const = false;
-					origin_node = node;
-					layer->connect_dynamic_param("origin_node", ValueNode::Handle(origin_node));
-					offset_node->set_link("rhs", node);
-				}
-				else
-				if (param_name == "zoom")
-				{
-					if (!is_const) zoom_const = false;
-					scale_node->set_link("exp", node);
-				}
-				else
-					processed = false;
+				if (!is_const) zoom_const = false;
+				scale_node->set_link("exp", node);
 			}
+			else
+				processed = false;
+		}
 
-			if (!processed)
-			{
-				if (value_node) {
-					// Assign the value_node to the dynamic parameter list
-					layer->connect_dynamic_param(param_name,value_node);
-				} else {
-					// Set the layer's parameter, and make sure that
-					// the layer linked it
-					if(!layer->set_param(param_name,data))
-					{
-						// TODO(ice0): Add normal version comparision function (check glib)
-						// TODO(ice0): Remove stubs after updating image files (.sif)
-						if (param_name == "loopyness" && layer->get_name() == "outline" && (layer->get_version() == "0.3")) {
-							continue;
-						}
+		if (!processed)
+		{
+			if (value_node) {
+				// Assign the value_node to the dynamic parameter list
+				layer->connect_dynamic_param(param_name,value_node);
+			} else {
+				// Set the layer's parameter, and make sure that
+				// the layer linked it
+				if(!layer->set_param(param_name,data))
+				{
+					// TODO(ice0): Add normal version comparision function (check glib)
+					// TODO(ice0): Remove stubs after updating image files (.sif)
+					if (param_name == "loopyness" && layer->get_name() == "outline" && (layer->get_version() == "0.3")) {
+						return;
+					}
 
-						if (param_name == "falloff" && layer->get_name() == "circle" && (layer->get_version() == "0.2")) {
-							continue;
-						}
+					if (param_name == "falloff" && layer->get_name() == "circle" && (layer->get_version() == "0.2")) {
+						return;
+					}
 
-						if (param_name == "fast" && layer->get_name() == "advanced_outline" && (layer->get_version() == "0.3")) {
-							continue;
-						}
+					if (param_name == "fast" && layer->get_name() == "advanced_outline" && (layer->get_version() == "0.3")) {
+						return;
+					}
 
-						if (param_name == "enable_transformation" && layer->get_name() == "group" && (layer->get_version() == "0.3")) {
-							continue;
-						}
+					if (param_name == "enable_transformation" && layer->get_name() == "group" && (layer->get_version() == "0.3")) {
+						return;
+					}
 
 
-						warning((*iter),strprintf(_("Layer '%s' rejected value for parameter '%s'"),
-												  element->get_attribute("type")->get_value().c_str(),
-												  param_name.c_str()));
-						continue;
-					}
+					warning((*iter),strprintf(_("Layer '%s' rejected value for parameter '%s'"),
+											  context.type.c_str(),
+											  param_name.c_str()));
+					return;
 				}
 			}
-
-			// Warn if there is trash after the param value
-			for(iter++; iter != list.end(); ++iter)
-				if(dynamic_cast<xmlpp::Element*>(*iter))
-					warning((*iter),strprintf(_("Unexpected element <%s> after <param> data, ignoring..."),(*iter)->get_name().c_str()));
-			continue;
-		}
-		else
-		{
-			printf("%s:%d\n", __FILE__, __LINE__);
-			error_unexpected_element(child,child->get_name());
 		}
+
+		// Warn if there is trash after the param value
+		for(iter++; iter != list.end(); ++iter)
+			if(dynamic_cast<xmlpp::Element*>(*iter))
+				warning((*iter),strprintf(_("Unexpected element <%s> after <param> data, ignoring..."),(*iter)->get_name().c_str()));
+		return;
+	}
+	else
+	{
+		printf("%s:%d\n", __FILE__, __LINE__);
+		error_unexpected_element(child,child->get_name());
 	}
+}
+
+void
+CanvasParser::parse_layer_end(xmlpp::Element *element,LayerContext &context)
+{
+	const Layer::Handle &layer = context.layer;
+	const Canvas::Handle &canvas = context.canvas;
+	const String &version = context.version;
+	const ValueNode::Handle &origin_node = context.origin_node;
+	const ValueNode_Composite::Handle &transformation_node = context.transformation_node;
+	const ValueNode_Add::Handle &offset_node = context.offset_node;
+	const ValueNode_Scale::Handle &scale_scalar_node = context.scale_scalar_node;
+	const ValueNode_Exp::Handle &scale_node = context.scale_node;
+	const bool origin_const = context.origin_const;
+	const bool focus_const = context.focus_const;
+	const bool zoom_const = context.zoom_const;
 
 	// Simplify old pastecanvas conversion
-	if (old_pastecanvas) {
+	if (context.old_pastecanvas) {
 		bool focus_zero = focus_const && (*origin_node)(0).get(Vector()) == Vector(0,0);
 		bool zoom_zero = zoom_const && (*scale_node->get_link("exp"))(0).get(Real()) == 0;
 		if (origin_const && focus_const && zoom_const)
@@ -3132,11 +3220,30 @@ CanvasParser::parse_layer(xmlpp::Element *element,Canvas::Handle canvas)
 	}
 
 	layer->reset_version();
-	return layer;
 }
 
 Canvas::Handle
 CanvasParser::parse_canvas(xmlpp::Element *element,Canvas::Handle parent,bool inline_,const FileSystem::Identifier &identifier,String filename)
+{
+	bool existing = false;
+	Canvas::Handle canvas = parse_canvas_begin(element,parent,inline_,identifier,filename,existing);
+	if(!canvas || existing)
+		return canvas;
+
+	xmlpp::Element::NodeList list = element->get_children();
+	for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
+	{
+		xmlpp::Element *child(dynamic_cast<xmlpp::Element*>(*iter));
+		if(child)
+			parse_canvas_child(child,canvas);
+	}
+
+	parse_canvas_end(element,canvas);
+	return canvas;
+}
+
+Canvas::Handle
+CanvasParser::parse_canvas_begin(xmlpp::Element *element,Canvas::Handle parent,bool inline_,const FileSystem::Identifier &identifier,String filename,bool &existing)
 {
 
 	if(element->get_name()!="canvas")
@@ -3184,7 +3291,10 @@ CanvasParser::parse_canvas(xmlpp::Element *element,Canvas::Handle parent,bool in
 	{
 		GUID guid(element->get_attribute("guid")->get_value());
 		if(guid_cast<Canvas>(guid))
+		{
+			existing=true;
 			return guid_cast<Canvas>(guid);
+		}
 		else
 			canvas->set_guid(guid);
 	}
@@ -3303,152 +3413,149 @@ CanvasParser::parse_canvas(xmlpp::Element *element,Canvas::Handle parent,bool in
 	}
 
 	canvas->rend_desc().set_flags(RendDesc::PX_ASPECT|RendDesc::IM_SPAN);
+	return canvas;
+}
 
-	list<ValueNode::Handle> bone_list;
-	xmlpp::Element::NodeList list = element->get_children();
-	for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
+void
+CanvasParser::parse_canvas_child(xmlpp::Element *child,Canvas::Handle canvas)
+{
+	if(child->get_name()=="defs")
 	{
-		xmlpp::Element *child(dynamic_cast<xmlpp::Element*>(*iter));
-		if(child)
+		if(canvas->is_inline())
+			error(child,_("Group canvases cannot have a <defs> section"));
+		parse_canvas_defs(child, canvas);
+	}
+	else
+	if(child->get_name()=="bones")
+	{
+		if(canvas->is_inline())
+			error(child,_("Inline canvas cannot have a <bones> section"));
+		parse_canvas_bones(child, canvas);
+	}
+	else
+	if(child->get_name()=="keyframe")
+	{
+		if(canvas->is_inline())
 		{
-			if(child->get_name()=="defs")
-			{
-				if(canvas->is_inline())
-					error(child,_("Group canvases cannot have a <defs> section"));
-				parse_canvas_defs(child, canvas);
-			}
-			else
-			if(child->get_name()=="bones")
-			{
-				if(canvas->is_inline())
-					error(child,_("Inline canvas cannot have a <bones> section"));
-				bone_list = parse_canvas_bones(child, canvas);
-			}
-			else
-			if(child->get_name()=="keyframe")
-			{
-				if(canvas->is_inline())
-				{
-					warning(child,_("Group canvases cannot have keyframes"));
-					continue;
-				}
+			warning(child,_("Group canvases cannot have keyframes"));
+			return;
+		}
 
-				canvas->keyframe_list().add(parse_keyframe(child,canvas));
-				canvas->keyframe_list().sync();
-			}
-			else
-			if(child->get_name()=="meta")
-			{
-				if(canvas->is_inline())
-				{
-					warning(child,_("Group canvases cannot have metadata"));
-					continue;
-				}
+		canvas->keyframe_list().add(parse_keyframe(child,canvas));
+		canvas->keyframe_list().sync();
+	}
+	else
+	if(child->get_name()=="meta")
+	{
+		if(canvas->is_inline())
+		{
+			warning(child,_("Group canvases cannot have metadata"));
+			return;
+		}
 
-				if(!child->get_attribute("name"))
-				{
-					warning(child,_("<meta> must have a name"));
-					continue;
-				}
+		if(!child->get_attribute("name"))
+		{
+			warning(child,_("<meta> must have a name"));
+			return;
+		}
 
-				if(!child->get_attribute("content"))
-				{
-					warning(child,_("<meta> must have content"));
-					continue;
-				}
-				
-				// In Synfig prior to version 1.0 we have messed decimal separator:
-				// some files use ".", but other ones use ","/
-				// Let's try to put a workaround for that.
-				std::vector<String> replacelist;
-				replacelist.push_back("background_first_color");
-				replacelist.push_back("background_second_color");
-				replacelist.push_back("background_size");
-				replacelist.push_back("grid_color");
-				replacelist.push_back("grid_size");
-				replacelist.push_back("jack_offset");
-				String content;
-				content=child->get_attribute("content")->get_value();
-				if(std::find(replacelist.begin(), replacelist.end(), child->get_attribute("name")->get_value()) != replacelist.end()) 
-				{
-					size_t index = 0;
-					while (true) {
-					     /* Locate the substring to replace. */
-					     index = content.find(",", index);
-					     if (index == string::npos) break;
+		if(!child->get_attribute("content"))
+		{
+			warning(child,_("<meta> must have content"));
+			return;
+		}
+		
+		// In Synfig prior to version 1.0 we have messed decimal separator:
+		// some files use ".", but other ones use ","/
+		// Let's try to put a workaround for that.
+		std::vector<String> replacelist;
+		replacelist.push_back("background_first_color");
+		replacelist.push_back("background_second_color");
+		replacelist.push_back("background_size");
+		replacelist.push_back("grid_color");
+		replacelist.push_back("grid_size");
+		replacelist.push_back("jack_offset");
+		String content;
+		content=child->get_attribute("content")->get_value();
+		if(std::find(replacelist.begin(), replacelist.end(), child->get_attribute("name")->get_value()) != replacelist.end()) 
+		{
+			size_t index = 0;
+			while (true) {
+			     /* Locate the substring to replace. */
+			     index = content.find(",", index);
+			     if (index == string::npos) break;
 
-					     /* Make the replacement. */
-					     content.replace(index, 1, ".");
+			     /* Make the replacement. */
+			     content.replace(index, 1, ".");
 
-					     /* Advance index forward so the next iteration doesn't pick it up as well. */
-					     index += 1;
-					}
-					
-				}
-				canvas->set_meta_data(child->get_attribute("name")->get_value(),content);
+			     /* Advance index forward so the next iteration doesn't pick it up as well. */
+			     index += 1;
 			}
-			else if(child->get_name()=="name")
-			{
-				xmlpp::Element::NodeList list = child->get_children();
+			
+		}
+		canvas->set_meta_data(child->get_attribute("name")->get_value(),content);
+	}
+	else if(child->get_name()=="name")
+	{
+		xmlpp::Element::NodeList list = child->get_children();
 
-				// If we don't have any name, warn
-				if(list.empty())
-					warning(child,_("blank \"name\" entity"));
+		// If we don't have any name, warn
+		if(list.empty())
+			warning(child,_("blank \"name\" entity"));
 
-				string tmp;
-				for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
-					if(dynamic_cast<xmlpp::TextNode*>(*iter))tmp+=dynamic_cast<xmlpp::TextNode*>(*iter)->get_content();
-				canvas->set_name(tmp);
-			}
-			else
-			if(child->get_name()=="desc")
-			{
+		string tmp;
+		for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
+			if(dynamic_cast<xmlpp::TextNode*>(*iter))tmp+=dynamic_cast<xmlpp::TextNode*>(*iter)->get_content();
+		canvas->set_name(tmp);
+	}
+	else
+	if(child->get_name()=="desc")
+	{
 
-				xmlpp::Element::NodeList list = child->get_children();
+		xmlpp::Element::NodeList list = child->get_children();
 
-				// If we don't have any description, warn
-				if(list.empty())
-					warning(child,_("blank \"desc\" entity"));
+		// If we don't have any description, warn
+		if(list.empty())
+			warning(child,_("blank \"desc\" entity"));
 
-				string tmp;
-				for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
-					if(dynamic_cast<xmlpp::TextNode*>(*iter))tmp+=dynamic_cast<xmlpp::TextNode*>(*iter)->get_content();
-				canvas->set_description(tmp);
-			}
-			else
-			if(child->get_name()=="author")
-			{
+		string tmp;
+		for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
+			if(dynamic_cast<xmlpp::TextNode*>(*iter))tmp+=dynamic_cast<xmlpp::TextNode*>(*iter)->get_content();
+		canvas->set_description(tmp);
+	}
+	else
+	if(child->get_name()=="author")
+	{
 
-				xmlpp::Element::NodeList list = child->get_children();
+		xmlpp::Element::NodeList list = child->get_children();
 
-				// If we don't have any description, warn
-				if(list.empty())
-					warning(child,_("blank \"author\" entity"));
+		// If we don't have any description, warn
+		if(list.empty())
+			warning(child,_("blank \"author\" entity"));
 
-				string tmp;
-				for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
-					if(dynamic_cast<xmlpp::TextNode*>(*iter))tmp+=dynamic_cast<xmlpp::TextNode*>(*iter)->get_content();
-				canvas->set_author(tmp);
-			}
-			else
-			if(child->get_name()=="layer")
-			{
-				//if(canvas->is_inline())
-				//	canvas->push_front(parse_layer(child,canvas->parent()));
-				//else
-					canvas->push_front(parse_layer(child,canvas));
-			}
-			else
-			{
-				printf("%s:%d\n", __FILE__, __LINE__);
-				error_unexpected_element(child,child->get_name());
-			}
-		}
-//		else
-//		if((child->get_name()=="text"||child->get_name()=="comment") && child->has_child_text())
-//			continue;
+		string tmp;
+		for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
+			if(dynamic_cast<xmlpp::TextNode*>(*iter))tmp+=dynamic_cast<xmlpp::TextNode*>(*iter)->get_content();
+		canvas->set_author(tmp);
+	}
+	else
+	if(child->get_name()=="layer")
+	{
+		//if(canvas->is_inline())
+		//	canvas->push_front(parse_layer(child,canvas->parent()));
+		//else
+			canvas->push_front(parse_layer(child,canvas));
+	}
+	else
+	{
+		printf("%s:%d\n", __FILE__, __LINE__);
+		error_unexpected_element(child,child->get_name());
 	}
+}
 
+void
+CanvasParser::parse_canvas_end(xmlpp::Element *element,Canvas::Handle canvas)
+{
 	if(canvas->value_node_list().placeholder_count())
 	{
 		String nodes;
@@ -3465,7 +3572,259 @@ CanvasParser::parse_canvas(xmlpp::Element *element,Canvas::Handle parent,bool in
 	}
 
 	canvas->set_version(CURRENT_CANVAS_VERSION);
-	return canvas;
+}
+
+//! Builds canvas while the XML document is read.
+//! Canvases, layers and their params are created from start tags,
+//! other elements (values, value nodes, defs, etc.) are collected into
+//! small subtrees which are parsed by the usual functions and freed when
+//! closed. So memory is used only for the currently parsed element
+//! and its ancestors instead of the whole document tree.
+class CanvasParser::StreamParser: public xmlpp::SaxParser
+{
+private:
+	enum FrameType
+	{
+		FRAME_CANVAS,
+		FRAME_LAYER,
+		FRAME_PARAM
+	};
+
+	//! Currently opened canvas, layer or param element
+	struct Frame
+	{
+		FrameType type;
+		xmlpp::Element *element;
+		//! true if contents of element should be ignored
+		//! (canvas is already loaded or layer was not created)
+		bool skip;
+		//! true if param has child elements
+		bool has_children;
+		Canvas::Handle canvas;
+		LayerContext layer;
+		//! value of param which was streamed (inline canvas)
+		ValueBase value;
+
+		Frame(FrameType type, xmlpp::Element *element):
+			type(type), element(element), skip(false), has_children(false) { }
+	};
+
+	CanvasParser &parser;
+	const FileSystem::Identifier &identifier;
+	const String &path;
+
+	xmlpp::Document document;
+	std::vector<Frame> frames;
+	//! current element of subtree which is collected completely
+	xmlpp::Element *leaf;
+	int leaf_depth;
+	String text;
+
+	Canvas::Handle canvas;
+	std::exception_ptr exception;
+
+	xmlpp::Element* create_element(xmlpp::Element *parent, const Glib::ustring &name, const AttributeList &attributes)
+	{
+		xmlpp::Element *element = parent ? parent->add_child(name) : document.create_root_node(name);
+		for(AttributeList::const_iterator i = attributes.begin(); i != attributes.end(); ++i)
+			element->set_attribute(i->name, i->value);
+		// keep line numbers for error messages
+		element->cobj()->line = (unsigned short)std::min(xmlSAX2GetLineNumber(context_), 65535);
+		return element;
+	}
+
+	void flush_text()
+	{
+		if (text.empty()) return;
+		if (leaf_depth)
+			leaf->add_child_text(text);
+		else
+		if (!frames.empty() && frames.back().type == FRAME_PARAM)
+			frames.back().element->add_child_text(text);
+		text.clear();
+	}
+
+	void fail()
+	{
+		if (!exception)
+			exception = std::current_exception();
+		xmlStopParser(context_);
+	}
+
+	void start_element(const Glib::ustring &name, const AttributeList &attributes)
+	{
+		flush_text();
+
+		if (leaf_depth)
+		{
+			leaf = create_element(leaf, name, attributes);
+			++leaf_depth;
+			return;
+		}
+
+		if (frames.empty())
+		{
+			Frame frame(FRAME_CANVAS, create_element(NULL, name, attributes));
+			bool existing = false;
+			frame.canvas = parser.parse_canvas_begin(frame.element, 0, false, identifier, path, existing);
+			frame.skip = !frame.canvas || existing;
+			frames.push_back(frame);
+			return;
+		}
+
+		Frame &top = frames.back();
+		xmlpp::Element *element = create_element(top.element, name, attributes);
+		bool first_child = !top.has_children;
+		top.has_children = true;
+
+		if (!top.skip)
+		{
+			if (top.type == FRAME_CANVAS && name == "layer")
+			{
+				Frame frame(FRAME_LAYER, element);
+				parser.parse_layer_begin(element, top.canvas, frame.layer);
+				frame.skip = !frame.layer.layer;
+				frames.push_back(frame);
+				return;
+			}
+
+			if (top.type == FRAME_LAYER && name == "param")
+			{
+				frames.push_back(Frame(FRAME_PARAM, element));
+				return;
+			}
+
+			// inline canvas, see parse_layer_child() and parse_value()
+			if ( top.type == FRAME_PARAM
+			  && first_child
+			  && name == "canvas"
+			  && top.element->get_attribute("name")
+			  && !top.element->get_attribute("use")
+			  && !element->get_attribute("guid") )
+			{
+				Canvas::Handle parent = frames[frames.size() - 2].layer.canvas;
+				Frame frame(FRAME_CANVAS, element);
+				bool existing = false;
+				frame.canvas = parser.parse_canvas_begin(element, parent, true, identifier, path, existing);
+				frame.skip = !frame.canvas || existing;
+				frames.push_back(frame);
+				return;
+			}
+		}
+
+		leaf = element;
+		leaf_depth = 1;
+	}
+
+	void end_element()
+	{
+		flush_text();
+
+		if (leaf_depth)
+		{
+			xmlpp::Element *element = leaf;
+			leaf = dynamic_cast<xmlpp::Element*>(leaf->get_parent());
+			if (--leaf_depth)
+				return;
+
+			Frame &top = frames.back();
+			// contents of param is parsed when param is closed
+			if (top.type == FRAME_PARAM)
+				return;
+			if (!top.skip)
+			{
+				if (top.type == FRAME_CANVAS)
+					parser.parse_canvas_child(element, top.canvas);
+				else
+					parser.parse_layer_child(element, top.layer);
+			}
+			top.element->remove_child(element);
+			return;
+		}
+
+		Frame frame = frames.back();
+		frames.pop_back();
+		if (frames.empty())
+		{
+			if (!frame.skip)
+				parser.parse_canvas_end(frame.element, frame.canvas);
+			canvas = frame.canvas;
+			return;
+		}
+
+		Frame &top = frames.back();
+		switch(frame.type)
+		{
+		case FRAME_CANVAS:
+			if (!frame.skip)
+				parser.parse_canvas_end(frame.element, frame.canvas);
+			top.value.set(frame.canvas);
+			top.value.set_static(parser.parse_static(frame.element));
+			// keep empty element, it will be found as value of param
+			return;
+		case FRAME_LAYER:
+			if (!frame.skip)
+				parser.parse_layer_end(frame.element, frame.layer);
+			top.canvas->push_front(frame.layer.layer);
+			break;
+		case FRAME_PARAM:
+			parser.parse_layer_child(frame.element, top.layer, frame.value);
+			break;
+		}
+		top.element->remove_child(frame.element);
+	}
+
+protected:
+	virtual void on_start_element(const Glib::ustring &name, const AttributeList &attributes)
+	{
+		if (exception) return;
+		try { start_element(name, attributes); } catch(...) { fail(); }
+	}
+
+	virtual void on_end_element(const Glib::ustring &/* name */)
+	{
+		if (exception) return;
+		try { end_element(); } catch(...) { fail(); }
+	}
+
+	virtual void on_characters(const Glib::ustring &characters)
+	{
+		if (exception) return;
+		if (leaf_depth || (!frames.empty() && frames.back().type == FRAME_PARAM))
+			text += characters;
+	}
+
+	virtual void on_error(const Glib::ustring &text)
+	{
+		if (exception) return;
+		try { throw runtime_error(path + ": " + text); } catch(...) { fail(); }
+	}
+
+public:
+	StreamParser(CanvasParser &parser, const FileSystem::Identifier &identifier, const String &path):
+		parser(parser), identifier(identifier), path(path), leaf(NULL), leaf_depth(0) { }
+
+	Canvas::Handle parse(std::istream &stream)
+	{
+		try
+		{
+			parse_stream(stream);
+		}
+		catch(...)
+		{
+			if (!exception) throw;
+		}
+		if (exception)
+			std::rethrow_exception(exception);
+		return canvas;
+	}
+};
+
+Canvas::Handle
+CanvasParser::parse_canvas_stream(std::istream &stream,const FileSystem::Identifier &identifier,const String &path)
+{
+	StreamParser parser(*this, identifier, path);
+	return parser.parse(stream);
 }
 
 void
@@ -3514,31 +3873,39 @@ CanvasParser::parse_from_file_as(const FileSystem::Identifier &identifier,const
 			if (filename_extension(identifier.filename) == ".sifz")
 				stream = FileSystem::ReadStream::Handle(new ZReadStream(stream));
 
-			xmlpp::DomParser parser;
-			parser.parse_stream(*stream);
-			stream.reset();
-			if(parser)
+			Canvas::Handle canvas;
+			if (streaming_)
+			{
+				canvas = parse_canvas_stream(*stream,identifier,as);
+				stream.reset();
+			}
+			else
 			{
-				Canvas::Handle canvas(parse_canvas(parser.get_document()->get_root_node(),0,false,identifier,as));
-				if (!canvas) return canvas;
-				register_canvas_in_map(canvas, as);
+				xmlpp::DomParser parser;
+				parser.parse_stream(*stream);
+				stream.reset();
+				if(parser)
+					canvas = parse_canvas(parser.get_document()->get_root_node(),0,false,identifier,as);
+			}
 
-				const ValueNodeList& value_node_list(canvas->value_node_list());
+			if (!canvas) return canvas;
+			register_canvas_in_map(canvas, as);
 
-				again:
-				ValueNodeList::const_iterator iter;
-				for(iter=value_node_list.begin();iter!=value_node_list.end();++iter)
+			const ValueNodeList& value_node_list(canvas->value_node_list());
+
+			again:
+			ValueNodeList::const_iterator iter;
+			for(iter=value_node_list.begin();iter!=value_node_list.end();++iter)
+			{
+				ValueNode::Handle value_node(*iter);
+				if(value_node->is_exported() && value_node->get_id().find("Unnamed")==0)
 				{
-					ValueNode::Handle value_node(*iter);
-					if(value_node->is_exported() && value_node->get_id().find("Unnamed")==0)
-					{
-						canvas->remove_value_node(value_node, true);
-						goto again;
-					}
+					canvas->remove_value_node(value_node, true);
+					goto again;
 				}
-
-				return canvas;
 			}
+
+			return canvas;
 		} else {
 			throw runtime_error(String("  * ") + _("Can't find linked file") + " \"" + identifier.filename + "\"");
 		}
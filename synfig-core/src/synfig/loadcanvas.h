@@ -29,6 +29,8 @@
 
 /* === H E A D E R S ======================================================= */
 
+#include <istream>
+
 #include "string.h"
 #include "canvas.h"
 #include "valuenode.h"
@@ -84,6 +86,15 @@ private:
 	String warnings_text;
 	//! Seems not to be used
 	GUID guid_;
+	//! True if file is parsed while reading, without building of the whole XML tree
+	bool streaming_;
+	//! True if canvases of other files are loaded when the layer needs them first time
+	bool lazy_externals_;
+
+	//! State of layer while its parameters are parsed
+	struct LayerContext;
+	//! SAX parser which builds canvas from the stream
+	class StreamParser;
 
 	/*
  --	** -- C O N S T R U C T O R S ---------------------------------------------
@@ -95,7 +106,9 @@ public:
 		max_warnings_	(1000),
 		total_warnings_	(0),
 		total_errors_	(0),
-		allow_errors_	(false)
+		allow_errors_	(false),
+		streaming_		(true),
+		lazy_externals_	(true)
 	{ }
 
 	/*
@@ -113,6 +126,23 @@ public:
 	//! Returns the maximum number of warnings before a fatal_error is thrown
 	int get_max_warnings() { return max_warnings_; }
 
+	//! Sets streaming mode of parse_from_file_as().
+	//! In streaming mode layers and value nodes are created while the file is read,
+	//! only the currently parsed element (with its ancestors) is kept in memory.
+	//! Otherwise the whole document tree is built first.
+	CanvasParser &set_streaming(bool x) { streaming_=x; return *this; }
+
+	//! Returns true if files are parsed in streaming mode
+	bool get_streaming()const { return streaming_; }
+
+	//! Sets lazy loading of external canvases.
+	//! When enabled, the group layers which use canvas of other file only remember
+	//! its id, the file is loaded when the layer is rendered first time.
+	CanvasParser &set_lazy_externals(bool x) { lazy_externals_=x; return *this; }
+
+	//! Returns true if external canvases are loaded lazily
+	bool get_lazy_externals()const { return lazy_externals_; }
+
 	//! Returns the number of errors in the last parse
 	int error_count()const { return total_errors_; }
 
@@ -163,6 +193,14 @@ private:
 
 	//! Canvas Parsing Function
 	Canvas::Handle parse_canvas(xmlpp::Element *node,Canvas::Handle parent=0,bool inline_=false,const FileSystem::Identifier &identifier = FileSystemNative::instance()->get_identifier(std::string()),String path=".");
+	//! Creates canvas from attributes of canvas element, \a existing is set if canvas with the same GUID is already loaded
+	Canvas::Handle parse_canvas_begin(xmlpp::Element *node,Canvas::Handle parent,bool inline_,const FileSystem::Identifier &identifier,String path,bool &existing);
+	//! Parses child element of canvas (layer, defs, keyframe, metadata, etc.)
+	void parse_canvas_child(xmlpp::Element *node,Canvas::Handle canvas);
+	//! Finishes canvas when all children are parsed
+	void parse_canvas_end(xmlpp::Element *node,Canvas::Handle canvas);
+	//! Parses canvas from the stream of XML data without building of the whole document tree
+	Canvas::Handle parse_canvas_stream(std::istream &stream,const FileSystem::Identifier &identifier,const String &path);
 	//! Canvas definitions Parsing Function (exported value nodes and exported canvases)
 	void parse_canvas_defs(xmlpp::Element *node,Canvas::Handle canvas);
 
@@ -170,6 +208,12 @@ private:
 
 	//! Layer Parsing Function
 	etl::handle<Layer> parse_layer(xmlpp::Element *node,Canvas::Handle canvas);
+	//! Creates layer from attributes of layer element
+	void parse_layer_begin(xmlpp::Element *node,Canvas::Handle canvas,LayerContext &context);
+	//! Parses child element of layer, \a value is the already parsed value of <param> (if valid)
+	void parse_layer_child(xmlpp::Element *node,LayerContext &context,const ValueBase &value=ValueBase());
+	//! Finishes layer when all parameters are parsed
+	void parse_layer_end(xmlpp::Element *node,LayerContext &context);
 	//! Generic Value Base Parsing Function
 	ValueBase parse_value(xmlpp::Element *node,Canvas::Handle canvas);
 	//! Generic Value Node Parsing Function
@@ -388,6 +388,8 @@ synfig::Main::~Main()
 
 	// Add deinitialization after this point
 
+	Canvas::clear_external_cache();
+
 	if(!get_open_canvas_map().empty())
 	{
 		synfig::warning("Canvases still open!");
@@ -0,0 +1,400 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/common/optimizer/optimizerrendercache.cpp
+**	\brief OptimizerRenderCache
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <map>
+
+#include <synfig/general.h>
+#include <synfig/localization.h>
+
+#include <synfig/blinepoint.h>
+#include <synfig/canvas.h>
+#include <synfig/dashitem.h>
+#include <synfig/gradient.h>
+#include <synfig/layers/layer_bitmap.h>
+#include <synfig/matrix.h>
+#include <synfig/segment.h>
+#include <synfig/transformation.h>
+#include <synfig/value.h>
+#include <synfig/widthpoint.h>
+
+#include "optimizerrendercache.h"
+
+#include "../rendercache.h"
+#include "../task/taskblend.h"
+#include "../task/taskblur.h"
+#include "../task/taskcontour.h"
+#include "../task/tasklayer.h"
+#include "../task/taskpixelprocessor.h"
+#include "../task/taskrendercache.h"
+#include "../task/tasktransformation.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+// bump when task fields or rendering results change in incompatible way
+#define RENDER_CACHE_KEY_VERSION "synfig-render-cache-1"
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+
+//! tasks with lower weight are cheaper to render than to load from disk
+const int min_weight = 16;
+const int min_area = 32*32;
+
+const int weight_layer = 16;
+const int weight_blur = 16;
+const int weight_default = 1;
+
+class KeyBuilder
+{
+public:
+	struct Info {
+		bool hashable;
+		int weight;
+		RenderCache::Key key;
+		Info(): hashable(), weight() { }
+	};
+
+private:
+	typedef std::map<const Task*, Info> Map;
+	Map infos;
+
+	static void add(RenderCache::Hasher &h, const Matrix &m)
+	{
+		for(int i = 0; i < 3; ++i)
+			for(int j = 0; j < 3; ++j)
+				h.add(m.m[i][j]);
+	}
+
+	static bool add(RenderCache::Hasher &h, const ValueBase &value)
+	{
+		Type &type = value.get_type();
+		h.add(type.description.name);
+
+		if (type == type_bool)
+			h.add(value.get(bool()));
+		else
+		if (type == type_integer)
+			h.add(value.get(int()));
+		else
+		if (type == type_real)
+			h.add(value.get(Real()));
+		else
+		if (type == type_time)
+			h.add((Real)value.get(Time()));
+		else
+		if (type == type_angle)
+			h.add((Real)Angle::rad(value.get(Angle())).get());
+		else
+		if (type == type_vector)
+			h.add(value.get(Vector()));
+		else
+		if (type == type_color)
+			h.add(value.get(Color()));
+		else
+		if (type == type_string)
+			h.add(value.get(String()));
+		else
+		if (type == type_matrix)
+			add(h, value.get(Matrix()));
+		else
+		if (type == type_transformation)
+			add(h, value.get(synfig::Transformation()).get_matrix());
+		else
+		if (type == type_segment) {
+			const Segment &s = value.get(Segment());
+			h.add(s.p1); h.add(s.t1); h.add(s.p2); h.add(s.t2);
+		} else
+		if (type == type_bline_point) {
+			const BLinePoint &p = value.get(BLinePoint());
+			h.add(p.get_vertex());
+			h.add(p.get_tangent1());
+			h.add(p.get_tangent2());
+			h.add(p.get_width());
+			h.add(p.get_origin());
+			h.add(p.get_split_tangent_both());
+			h.add(p.get_merge_tangent_both());
+		} else
+		if (type == type_width_point) {
+			const WidthPoint &p = value.get(WidthPoint());
+			h.add(p.get_position());
+			h.add(p.get_width());
+			h.add(p.get_side_type_before());
+			h.add(p.get_side_type_after());
+			h.add(p.get_dash());
+			h.add(p.get_lower_bound());
+			h.add(p.get_upper_bound());
+		} else
+		if (type == type_dash_item) {
+			const DashItem &d = value.get(DashItem());
+			h.add(d.get_offset());
+			h.add(d.get_length());
+			h.add(d.get_side_type_before());
+			h.add(d.get_side_type_after());
+		} else
+		if (type == type_gradient) {
+			const Gradient &g = value.get(Gradient());
+			h.add((int)g.size());
+			for(Gradient::const_iterator i = g.begin(); i != g.end(); ++i)
+				{ h.add(i->pos); h.add(i->color); }
+		} else
+		if (type == type_list) {
+			const ValueBase::List &list = value.get_list();
+			h.add((int)list.size());
+			for(ValueBase::List::const_iterator i = list.begin(); i != list.end(); ++i)
+				if (!add(h, *i)) return false;
+		} else
+		if (type == type_nil) {
+			// nothing to add
+		} else {
+			// canvases, bones and others may change without changing of value
+			return false;
+		}
+
+		h.add(value.get_static());
+		return true;
+	}
+
+	static bool add(RenderCache::Hasher &h, const Layer &layer)
+	{
+		// pixels of bitmap layers are not the part of parameters
+		if (dynamic_cast<const Layer_Bitmap*>(&layer))
+			return false;
+
+		h.add(layer.get_name());
+		h.add(layer.get_version());
+		h.add((Real)layer.get_time_mark());
+		h.add(layer.get_outline_grow_mark());
+		if (layer.get_canvas())
+			h.add(layer.get_canvas()->rend_desc().get_gamma().get());
+
+		Layer::ParamList params = layer.get_param_list();
+		h.add((int)params.size());
+		for(Layer::ParamList::const_iterator i = params.begin(); i != params.end(); ++i) {
+			h.add(i->first);
+			if (!add(h, i->second))
+				return false;
+		}
+		return true;
+	}
+
+	//! adds fields of task, returns false for unknown tasks
+	static bool add_fields(RenderCache::Hasher &h, const Task &task, int &weight)
+	{
+		const Task::Token::Handle token = task.get_token();
+		h.add(token->name);
+		weight = weight_default;
+
+		if (token == TaskList::token.handle()) {
+			// sub-tasks only
+		} else
+		if (token == TaskBlend::token.handle()) {
+			const TaskBlend &blend = dynamic_cast<const TaskBlend&>(task);
+			h.add((int)blend.blend_method);
+			h.add(blend.amount);
+		} else
+		if (token == TaskBlur::token.handle()) {
+			const TaskBlur &blur = dynamic_cast<const TaskBlur&>(task);
+			h.add((int)blur.blur.type);
+			h.add(blur.blur.size);
+			weight = weight_blur;
+		} else
+		if (token == TaskContour::token.handle()) {
+			const TaskContour &contour = dynamic_cast<const TaskContour&>(task);
+			if (!contour.contour) return false;
+			h.add(contour.detail);
+			h.add(contour.allow_antialias);
+			add(h, contour.transformation->matrix);
+			h.add(contour.contour->closed());
+			h.add(contour.contour->invert);
+			h.add(contour.contour->antialias);
+			h.add((int)contour.contour->winding_style);
+			h.add(contour.contour->color);
+			const Contour::ChunkList &chunks = contour.contour->get_chunks();
+			h.add((int)chunks.size());
+			for(Contour::ChunkList::const_iterator i = chunks.begin(); i != chunks.end(); ++i)
+				{ h.add((int)i->type); h.add(i->p1); h.add(i->pp0); h.add(i->pp1); }
+		} else
+		if (token == TaskTransformationAffine::token.handle()) {
+			const TaskTransformationAffine &transformation = dynamic_cast<const TaskTransformationAffine&>(task);
+			h.add((int)transformation.interpolation);
+			h.add(transformation.supersample);
+			add(h, transformation.transformation->matrix);
+		} else
+		if (token == TaskPixelGamma::token.handle()) {
+			const TaskPixelGamma &gamma = dynamic_cast<const TaskPixelGamma&>(task);
+			h.add(gamma.gamma.get_r());
+			h.add(gamma.gamma.get_g());
+			h.add(gamma.gamma.get_b());
+		} else
+		if (token == TaskPixelColorMatrix::token.handle()) {
+			const TaskPixelColorMatrix &matrix = dynamic_cast<const TaskPixelColorMatrix&>(task);
+			for(int i = 0; i < 5; ++i)
+				for(int j = 0; j < 5; ++j)
+					h.add(matrix.matrix.m[i][j]);
+		} else
+		if (token == TaskLayer::token.handle()) {
+			const TaskLayer &layer = dynamic_cast<const TaskLayer&>(task);
+			if (!layer.layer || !add(h, *layer.layer)) return false;
+			weight = weight_layer;
+		} else {
+			// surfaces, meshes and tasks from modules
+			return false;
+		}
+
+		return true;
+	}
+
+public:
+	const Info& build(const Task::Handle &task)
+	{
+		Map::iterator found = infos.find(task.get());
+		if (found != infos.end())
+			return found->second;
+
+		Info info;
+		RenderCache::Hasher h;
+		h.add(RENDER_CACHE_KEY_VERSION);
+		#ifdef VERSION
+		h.add(VERSION);
+		#endif
+
+		if ( task
+		  && task->is_valid()
+		  && add_fields(h, *task, info.weight) )
+		{
+			info.hashable = true;
+			h.add(task->source_rect);
+			h.add(task->target_rect);
+			h.add(task->target_surface->get_size());
+			h.add((int)task->sub_tasks.size());
+			for(Task::List::const_iterator i = task->sub_tasks.begin(); i != task->sub_tasks.end(); ++i) {
+				h.add((bool)*i);
+				if (!*i) continue;
+				const Info &sub_info = build(*i);
+				if (!sub_info.hashable)
+					{ info.hashable = false; break; }
+				info.weight += sub_info.weight;
+				h.add(sub_info.key);
+			}
+			info.key = h.get_key();
+		}
+
+		return infos[task.get()] = info;
+	}
+};
+
+Task::Handle
+process(
+	KeyBuilder &builder,
+	const RenderCache::Handle &cache,
+	const Task::Handle &task,
+	bool root )
+{
+	if ( !task
+	  || task.type_is<TaskSurface>()
+	  || task.type_is<TaskRenderCache>() )
+		return task;
+
+	const KeyBuilder::Info &info = builder.build(task);
+	bool cacheable = !root
+		          && info.hashable
+		          && info.weight >= min_weight
+		          && task->target_rect.get_width()*task->target_rect.get_height() >= min_area;
+
+	if (cacheable) {
+		RectInt rect;
+		if (SurfaceResource::Handle surface = cache->load(info.key, rect)) {
+			TaskSurface::Handle task_surface = new TaskSurface();
+			task_surface->assign_target(*task);
+			task_surface->target_surface = surface;
+			return task_surface;
+		}
+	}
+
+	// process sub-tasks
+	Task::Handle new_task = task;
+	for(Task::List::const_iterator i = task->sub_tasks.begin(); i != task->sub_tasks.end(); ++i) {
+		Task::Handle sub_task = process(builder, cache, *i, false);
+		if (sub_task != *i) {
+			if (new_task == task) new_task = task->clone();
+			new_task->sub_tasks[i - task->sub_tasks.begin()] = sub_task;
+		}
+	}
+
+	if (!cacheable)
+		return new_task;
+
+	// render sub-tree into private surface and store the result
+	TaskRenderCache::Handle task_cache = new TaskRenderCache();
+	task_cache->cache = cache;
+	task_cache->key = info.key;
+	task_cache->source_rect = new_task->source_rect;
+	task_cache->target_rect = new_task->target_rect;
+	task_cache->target_surface = new SurfaceResource();
+	task_cache->target_surface->create(
+		new_task->target_surface->get_width(),
+		new_task->target_surface->get_height() );
+	task_cache->sub_task() = new_task;
+	return task_cache;
+}
+
+} // end of anonimous namespace
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+OptimizerRenderCache::OptimizerRenderCache()
+{
+	category_id = CATEGORY_ID_COORDS;
+	depends_from = CATEGORY_BEGIN;
+	for_list = true;
+}
+
+void
+OptimizerRenderCache::run(const RunParams& params) const
+{
+	const RenderCache::Handle &cache = RenderCache::get_instance();
+	if (!cache || !params.list)
+		return;
+
+	KeyBuilder builder;
+	for(Task::List::iterator i = params.list->begin(); i != params.list->end(); ++i)
+		*i = process(builder, cache, *i, true);
+}
+
+/* === E N T R Y P O I N T ================================================= */
@@ -29,11 +29,17 @@
 #	include <config.h>
 #endif
 
+#include <algorithm>
+#include <map>
+#include <vector>
+
 #include <synfig/general.h>
 #include <synfig/localization.h>
 
 #include "optimizersplit.h"
 
+#include "../../taskcost.h"
+
 #endif
 
 using namespace synfig;
@@ -47,7 +53,11 @@ using namespace rendering;
 
 /* === M E T H O D S ======================================================= */
 
-OptimizerSplit::OptimizerSplit()
+const Real OptimizerSplit::min_piece_cost = 1e-3;
+const int OptimizerSplit::min_piece_rows = 8;
+
+OptimizerSplit::OptimizerSplit(int threads):
+	threads(threads)
 {
 	category_id = CATEGORY_ID_LIST;
 	depends_from = CATEGORY_SPECIALIZED;
@@ -55,35 +65,79 @@ OptimizerSplit::OptimizerSplit()
 }
 
 void
-OptimizerSplit::run(const RunParams &params) const
+OptimizerSplit::split(Task::List &list, Task::List::iterator &i, int count) const
 {
-	if (!params.list) return;
-	const int min_area = 256*256;
-	for(Task::List::iterator i = params.list->begin(); i != params.list->end(); ++i)
+	Task::Handle task = (*i)->clone();
+	if (TaskInterfaceSplit *split_interface = task.type_pointer<TaskInterfaceSplit>())
+		split_interface->on_split();
+
+	RectInt r = task->target_rect;
+	int h = r.get_height();
+	for(int j = 0; j < count; ++j)
 	{
-		if (TaskInterfaceSplit *split = i->type_pointer<TaskInterfaceSplit>())
-		if (split->is_splittable())
-		{
-			RectInt r = (*i)->target_rect;
-			int w = r.maxx - r.minx;
-			int h = r.maxy - r.miny;
-			int t = std::min(h/10, w*h/min_area);
-			if (t >= 2)
-			{
-				int hh = h/t;
-				int y = r.miny;
-				for(int j = 1; j < t; ++j, y += hh)
-				{
-					Task::Handle task = (*i)->clone();
-					task->trunc_target_rect( RectInt(r.minx, y, r.maxx, y + hh) );
-					i = params.list->insert(i, task);
-					++i;
-				}
-				*i = (*i)->clone();
-				(*i)->trunc_target_rect( RectInt(r.minx, y, r.maxx, r.maxy) );
-				apply(params);
+		RectInt rect(r.minx, r.miny + h*j/count, r.maxx, r.miny + h*(j + 1)/count);
+		Task::Handle piece = task->clone();
+		piece->trunc_target_rect(rect);
+
+		// sub-task which was drawn to the same surface covers whole rect,
+		// so give each strip own copy with the same area, otherwise
+		// strips will wait for each other (see Task::allow_run_before())
+		for(Task::List::iterator k = piece->sub_tasks.begin(); k != piece->sub_tasks.end(); ++k)
+			if (*k && (*k)->target_surface == task->target_surface) {
+				*k = (*k)->clone();
+				(*k)->trunc_target_rect(rect);
 			}
-		}
+
+		if (j + 1 < count)
+			{ i = list.insert(i, piece); ++i; }
+		else
+			*i = piece;
+	}
+}
+
+void
+OptimizerSplit::run(const RunParams &params) const
+{
+	if (!params.list || threads < 2) return;
+	Task::List &list = *params.list;
+
+	// tasks which draws to the same surface usually depends from each other,
+	// so count chains of tasks by target surfaces, and the longest chain
+	// is a critical path of the list
+	typedef std::map<SurfaceResource::Handle, Real> ChainMap;
+	ChainMap chains;
+	std::vector<Real> costs(list.size());
+	Real total = 0.0, critical = 0.0;
+	for(size_t i = 0; i < list.size(); ++i) {
+		if (!list[i] || !list[i]->is_valid()) continue;
+		costs[i] = TaskCost::estimate(*list[i]);
+		total += costs[i];
+		critical = std::max(critical, chains[list[i]->target_surface] += costs[i]);
+	}
+	if (critical < 2.0*min_piece_cost) return;
+
+	// independent chains are processed simultaneously,
+	// give each chain its share of threads
+	Real parallelism = total/critical;
+	int slots = std::max(1, (int)round(threads/parallelism));
+	if (slots < 2) return;
+
+	std::vector<Real>::const_iterator cost = costs.begin();
+	for(Task::List::iterator i = list.begin(); i != list.end(); ++i, ++cost)
+	{
+		if (*cost < 2.0*min_piece_cost) continue;
+		TaskInterfaceSplit *split_interface = i->type_pointer<TaskInterfaceSplit>();
+		if (!split_interface || !split_interface->is_splittable()) continue;
+
+		int count = std::min(slots, (int)(*cost/min_piece_cost));
+		count = std::min(count, (*i)->target_rect.get_height()/min_piece_rows);
+		if (count < 2) continue;
+
+		// keep iterator of costs in sync with list
+		size_t index = cost - costs.begin();
+		split(list, i, count);
+		costs.insert(costs.begin() + index, count - 1, 0.0);
+		cost = costs.begin() + index + count - 1;
 	}
 }
 
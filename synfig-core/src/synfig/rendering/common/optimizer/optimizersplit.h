@@ -40,10 +40,24 @@ namespace synfig
 namespace rendering
 {
 
+//! Splits heavy tasks into horizontal strips, which may be processed by different threads.
+//! Number of strips depends on estimated cost of task (see TaskCost)
+//! and on parallelism already available in the list.
 class OptimizerSplit: public Optimizer
 {
 public:
-	OptimizerSplit();
+	//! Strip should not be faster than this time in seconds, to keep overhead of queue low
+	static const Real min_piece_cost;
+	//! Minimal height of strip in pixels
+	static const int min_piece_rows;
+
+private:
+	int threads;
+
+	void split(Task::List &list, Task::List::iterator &i, int count) const;
+
+public:
+	explicit OptimizerSplit(int threads);
 	virtual void run(const RunParams &params) const;
 };
 
@@ -0,0 +1,98 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/common/optimizer/optimizersurfacestorage.cpp
+**	\brief OptimizerSurfaceStorage
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <vector>
+
+#include <synfig/general.h>
+
+#include "optimizersurfacestorage.h"
+
+#include "../task/taskblend.h"
+#include "../task/tasktransformation.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+OptimizerSurfaceStorage::OptimizerSurfaceStorage(const Surface::Token::Handle &token):
+	token(token)
+{
+	category_id = CATEGORY_ID_SPECIALIZED;
+	depends_from = CATEGORY_COORDS;
+	for_task = true;
+}
+
+void
+OptimizerSurfaceStorage::run(const RunParams &params) const
+{
+	if ( !token
+	  || !params.ref_task.type_is<TaskSurface>()
+	  || !params.parent
+	  || !( params.parent->ref_task.type_is<TaskTransformation>()
+	     || params.parent->ref_task.type_is<TaskBlend>() ))
+		return;
+
+	// only filled surfaces may be sources,
+	// blank ones are targets of other tasks which are not rendered yet
+	const SurfaceResource::Handle &resource = params.ref_task->target_surface;
+	if (!resource || !resource->is_exists() || resource->is_blank())
+		return;
+
+	// already replaced by this optimizer
+	std::vector<Surface::Token::Handle> tokens;
+	if (resource->get_tokens(tokens) && tokens.size() == 1 && tokens.front() == token)
+		return;
+
+	// compact copy is kept next to the source surface of the shared resource,
+	// so it is reused by the next frames and dropped when the source is written
+	SurfaceResource::LockReadBase lock(resource);
+	if (!lock.convert(token)) {
+		synfig::warning("OptimizerSurfaceStorage: cannot convert surface to '%s'", token->name.c_str());
+		return;
+	}
+
+	// tasks of this renderer read private resource with the compact copy only,
+	// other renderers still find the source surface in the shared resource
+	TaskSurface::Handle surface = TaskSurface::Handle::cast_dynamic(params.ref_task->clone());
+	surface->target_surface = new SurfaceResource(lock.get_handle());
+	apply(params, surface);
+}
+
+/* === E N T R Y P O I N T ================================================= */
@@ -0,0 +1,61 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/common/optimizer/optimizersurfacestorage.h
+**	\brief OptimizerSurfaceStorage Header
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_OPTIMIZERSURFACESTORAGE_H
+#define __SYNFIG_RENDERING_OPTIMIZERSURFACESTORAGE_H
+
+/* === H E A D E R S ======================================================= */
+
+#include "../../optimizer.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+
+//! Keeps persistent sources (bitmaps etc.) in compact surface format,
+//! so tasks which support this format read less memory every frame.
+//! Converted copy stays in SurfaceResource next to the source surface
+//! until the source changes, tasks of the renderer get private resource
+//! with this copy only, so other renderers are not affected.
+class OptimizerSurfaceStorage: public Optimizer
+{
+public:
+	const Surface::Token::Handle token;
+	explicit OptimizerSurfaceStorage(const Surface::Token::Handle &token);
+	virtual void run(const RunParams &params) const;
+};
+
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
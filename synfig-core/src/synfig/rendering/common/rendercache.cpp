@@ -0,0 +1,423 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/common/rendercache.cpp
+**	\brief RenderCache
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include <algorithm>
+#include <vector>
+
+#include <fcntl.h>
+#include <glib/gstdio.h>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <synfig/general.h>
+#include <synfig/localization.h>
+#include <synfig/filesystemnative.h>
+
+#include "rendercache.h"
+
+#include "../software/surfacesw.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+#define CACHE_FILE_EXT ".cache"
+#define CACHE_TEMP_EXT ".tmp"
+//! Temporary files older than this (in seconds) are left by crashed processes
+#define CACHE_TEMP_EXPIRE (60*60)
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+
+const char header_magic[4] = { 'S', 'F', 'R', 'C' };
+const int header_version = 1;
+
+struct Header {
+	char magic[4];
+	int32_t version;
+	int32_t surface_width;
+	int32_t surface_height;
+	int32_t minx, miny, maxx, maxy;
+};
+
+int
+get_process_id()
+{
+#ifdef _WIN32
+	return _getpid();
+#else
+	return (int)getpid();
+#endif
+}
+
+//! Read-only view of whole file, memory mapped when possible
+class MappedFile {
+private:
+	const char *data;
+	size_t size;
+#ifdef _WIN32
+	std::vector<char> buffer;
+#endif
+
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+public:
+	explicit MappedFile(const String &filename):
+		data(), size()
+	{
+		GStatBuf st;
+		if (g_stat(filename.c_str(), &st) || st.st_size <= 0)
+			return;
+#ifdef _WIN32
+		FILE *f = g_fopen(filename.c_str(), "rb");
+		if (!f) return;
+		buffer.resize((size_t)st.st_size);
+		if (fread(&buffer.front(), 1, buffer.size(), f) == buffer.size())
+			{ data = &buffer.front(); size = buffer.size(); }
+		fclose(f);
+#else
+		int fd = g_open(filename.c_str(), O_RDONLY, 0);
+		if (fd < 0) return;
+		void *ptr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (ptr != MAP_FAILED)
+			{ data = (const char*)ptr; size = (size_t)st.st_size; }
+#endif
+	}
+
+	~MappedFile()
+	{
+#ifndef _WIN32
+		if (data) munmap((void*)data, size);
+#endif
+	}
+
+	const char* get_data() const { return data; }
+	size_t get_size() const { return size; }
+};
+
+inline uint64_t
+mix(uint64_t x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdull;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ull;
+	x ^= x >> 33;
+	return x;
+}
+
+bool
+ends_with(const String &str, const char *suffix)
+{
+	size_t len = strlen(suffix);
+	return str.size() >= len && str.compare(str.size() - len, len, suffix) == 0;
+}
+
+} // end of anonimous namespace
+
+RenderCache::Handle RenderCache::instance;
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+String
+RenderCache::Key::get_string() const
+	{ return etl::strprintf("%016llx%016llx", (unsigned long long)hi, (unsigned long long)lo); }
+
+bool
+RenderCache::Key::from_string(const String &str, Key &out_key)
+{
+	if (str.size() != 32) return false;
+	uint64_t v[2] = { 0, 0 };
+	for(int i = 0; i < 32; ++i) {
+		char c = str[i];
+		int d = c >= '0' && c <= '9' ? c - '0'
+			  : c >= 'a' && c <= 'f' ? c - 'a' + 10
+			  : -1;
+		if (d < 0) return false;
+		v[i/16] = (v[i/16] << 4) | (uint64_t)d;
+	}
+	out_key = Key(v[0], v[1]);
+	return true;
+}
+
+
+RenderCache::Hasher::Hasher():
+	a(0xcbf29ce484222325ull), b(0x9e3779b97f4a7c15ull) { }
+
+void
+RenderCache::Hasher::add(const void *data, size_t size)
+{
+	// two independent streams: FNV-1a and multiply-rotate
+	const unsigned char *p = (const unsigned char*)data;
+	for(const unsigned char *end = p + size; p != end; ++p) {
+		a = (a ^ *p)*0x100000001b3ull;
+		b = (b + *p + 1)*0x9e3779b97f4a7c15ull;
+		b = (b << 27) | (b >> 37);
+	}
+}
+
+RenderCache::Key
+RenderCache::Hasher::get_key() const
+	{ return Key(mix(a ^ mix(b)), mix(b + a)); }
+
+
+RenderCache::RenderCache(const String &path, long long max_size):
+	path(path),
+	max_size(std::max(0ll, max_size)),
+	temp_index()
+{
+	stats.max_size = this->max_size;
+	if ( !FileSystemNative::instance()->is_directory(path)
+	  && !FileSystemNative::instance()->directory_create(path) )
+		synfig::warning("RenderCache: cannot create directory '%s'", path.c_str());
+	scan();
+	std::lock_guard<std::mutex> lock(mutex);
+	evict();
+}
+
+String
+RenderCache::get_filename(const Key &key) const
+	{ return path + ETL_DIRECTORY_SEPARATOR + key.get_string() + CACHE_FILE_EXT; }
+
+void
+RenderCache::scan()
+{
+	FileSystem::FileList files;
+	if (!FileSystemNative::instance()->directory_scan(path, files))
+		return;
+
+	// restore LRU order from modification times of files
+	std::vector< std::pair<long long, std::pair<Key, long long> > > found;
+	for(FileSystem::FileList::const_iterator i = files.begin(); i != files.end(); ++i) {
+		String filename = path + ETL_DIRECTORY_SEPARATOR + *i;
+		if (ends_with(*i, CACHE_TEMP_EXT)) {
+			// other processes may write their entries right now,
+			// so remove only files abandoned long ago
+			GStatBuf st;
+			if (!g_stat(filename.c_str(), &st) && st.st_mtime + CACHE_TEMP_EXPIRE < time(NULL))
+				FileSystemNative::instance()->file_remove(filename);
+			continue;
+		}
+		Key key;
+		if ( !ends_with(*i, CACHE_FILE_EXT)
+		  || !Key::from_string(i->substr(0, i->size() - strlen(CACHE_FILE_EXT)), key) )
+			continue;
+		GStatBuf st;
+		if (g_stat(filename.c_str(), &st))
+			continue;
+		found.push_back(std::make_pair((long long)st.st_mtime, std::make_pair(key, (long long)st.st_size)));
+	}
+	std::sort(found.begin(), found.end());
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for(size_t i = 0; i < found.size(); ++i)
+		touch(found[i].second.first, found[i].second.second);
+}
+
+void
+RenderCache::touch(const Key &key, long long size)
+{
+	Map::iterator i = entries.find(key);
+	if (i == entries.end()) {
+		Entry &entry = entries[key];
+		entry.size = size;
+		entry.lru = lru.insert(lru.begin(), key);
+		stats.size += size;
+		++stats.entries;
+	} else {
+		stats.size += size - i->second.size;
+		i->second.size = size;
+		lru.splice(lru.begin(), lru, i->second.lru);
+	}
+}
+
+void
+RenderCache::remove(const Key &key)
+{
+	Map::iterator i = entries.find(key);
+	if (i == entries.end()) return;
+	stats.size -= i->second.size;
+	--stats.entries;
+	lru.erase(i->second.lru);
+	entries.erase(i);
+	FileSystemNative::instance()->file_remove(get_filename(key));
+}
+
+void
+RenderCache::evict()
+{
+	while(stats.size > max_size && !lru.empty()) {
+		Key key = lru.back(); // copy, remove() erases the list item
+		remove(key);
+		++stats.evictions;
+	}
+}
+
+SurfaceResource::Handle
+RenderCache::load(const Key &key, RectInt &out_rect)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Map::iterator i = entries.find(key);
+		if (i == entries.end())
+			{ ++stats.misses; return SurfaceResource::Handle(); }
+		lru.splice(lru.begin(), lru, i->second.lru);
+	}
+
+	String filename = get_filename(key);
+	SurfaceSW::Handle surface;
+	{
+		MappedFile file(filename);
+		const Header *header = (const Header*)file.get_data();
+		if ( header
+		  && file.get_size() >= sizeof(Header)
+		  && !memcmp(header->magic, header_magic, sizeof(header_magic))
+		  && header->version == header_version
+		  && header->surface_width > 0
+		  && header->surface_height > 0 )
+		{
+			RectInt rect(header->minx, header->miny, header->maxx, header->maxy);
+			if ( rect.is_valid()
+			  && etl::contains(RectInt(0, 0, header->surface_width, header->surface_height), rect)
+			  && file.get_size() == sizeof(Header) + (size_t)rect.get_width()*rect.get_height()*sizeof(Color) )
+			{
+				surface = new SurfaceSW();
+				if (surface->create(header->surface_width, header->surface_height)) {
+					synfig::Surface &dst = surface->get_surface();
+					const Color *src = (const Color*)(file.get_data() + sizeof(Header));
+					for(int y = rect.miny; y < rect.maxy; ++y, src += rect.get_width())
+						memcpy(&dst[y][rect.minx], src, rect.get_width()*sizeof(Color));
+					surface->touch();
+					out_rect = rect;
+				} else {
+					surface.reset();
+				}
+			}
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!surface) {
+		synfig::warning("RenderCache: broken entry '%s' removed", filename.c_str());
+		remove(key);
+		++stats.misses;
+		return SurfaceResource::Handle();
+	}
+	g_utime(filename.c_str(), NULL);
+	++stats.hits;
+	return new SurfaceResource(surface);
+}
+
+bool
+RenderCache::store(
+	const Key &key,
+	const VectorInt &surface_size,
+	const RectInt &rect,
+	const synfig::Surface &surface )
+{
+	if ( !rect.is_valid()
+	  || !etl::contains(RectInt(VectorInt::zero(), surface_size), rect)
+	  || rect.maxx > surface.get_w()
+	  || rect.maxy > surface.get_h() )
+		return false;
+
+	long long size = sizeof(Header) + (long long)rect.get_width()*rect.get_height()*sizeof(Color);
+	if (size > max_size)
+		return false;
+
+	String temp_filename;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (entries.count(key))
+			return true; // already stored by another task
+		// name is unique between processes which share the cache directory
+		temp_filename = get_filename(key) + etl::strprintf(".%d.%lld", get_process_id(), temp_index++) + CACHE_TEMP_EXT;
+	}
+
+	Header header;
+	memcpy(header.magic, header_magic, sizeof(header.magic));
+	header.version = header_version;
+	header.surface_width = surface_size[0];
+	header.surface_height = surface_size[1];
+	header.minx = rect.minx;
+	header.miny = rect.miny;
+	header.maxx = rect.maxx;
+	header.maxy = rect.maxy;
+
+	// write to temporary file and rename it, so readers never see partial entries
+	FILE *f = g_fopen(temp_filename.c_str(), "wb");
+	if (!f) {
+		synfig::warning("RenderCache: cannot write file '%s'", temp_filename.c_str());
+		return false;
+	}
+	bool success = fwrite(&header, sizeof(header), 1, f) == 1;
+	for(int y = rect.miny; success && y < rect.maxy; ++y)
+		success = fwrite(&surface[y][rect.minx], sizeof(Color), rect.get_width(), f) == (size_t)rect.get_width();
+	success = !fclose(f) && success;
+
+	String filename = get_filename(key);
+	if (!success || !FileSystemNative::instance()->file_rename(temp_filename, filename)) {
+		FileSystemNative::instance()->file_remove(temp_filename);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	touch(key, size);
+	++stats.stores;
+	evict();
+	return true;
+}
+
+RenderCache::Statistics
+RenderCache::get_statistics() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+/* === E N T R Y P O I N T ================================================= */
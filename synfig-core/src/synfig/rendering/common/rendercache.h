@@ -0,0 +1,188 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/common/rendercache.h
+**	\brief RenderCache Header
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_RENDERCACHE_H
+#define __SYNFIG_RENDERING_RENDERCACHE_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <cstdint>
+
+#include <list>
+#include <map>
+#include <mutex>
+
+#include <synfig/string.h>
+#include <synfig/surface.h>
+
+#include "../surface.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+
+//! Persistent storage of rendered surfaces, keyed by hash of task-tree.
+//! Each entry is a separate file in the cache directory,
+//! entries are evicted in least-recently-used order when the total size exceeds the limit.
+class RenderCache: public etl::shared_object
+{
+public:
+	typedef etl::handle<RenderCache> Handle;
+
+	//! 128-bit hash of task-tree
+	struct Key {
+		uint64_t hi, lo;
+
+		Key(): hi(), lo() { }
+		Key(uint64_t hi, uint64_t lo): hi(hi), lo(lo) { }
+
+		bool operator< (const Key &other) const
+			{ return hi < other.hi || (hi == other.hi && lo < other.lo); }
+		bool operator== (const Key &other) const
+			{ return hi == other.hi && lo == other.lo; }
+		bool operator!= (const Key &other) const
+			{ return !(*this == other); }
+
+		String get_string() const;
+		static bool from_string(const String &str, Key &out_key);
+	};
+
+	//! Incremental builder of Key
+	class Hasher {
+	private:
+		uint64_t a, b;
+	public:
+		Hasher();
+
+		void add(const void *data, size_t size);
+		void add(int x)
+			{ add(&x, sizeof(x)); }
+		void add(bool x)
+			{ add(x ? 1 : 0); }
+		void add(Real x)
+			{ if (x == 0.0) x = 0.0; add(&x, sizeof(x)); } // -0.0 and 0.0 are same
+		void add(float x)
+			{ add(Real(x)); }
+		void add(const Vector &x)
+			{ add(x[0]); add(x[1]); }
+		void add(const VectorInt &x)
+			{ add(x[0]); add(x[1]); }
+		void add(const Rect &x)
+			{ add(x.minx); add(x.miny); add(x.maxx); add(x.maxy); }
+		void add(const RectInt &x)
+			{ add(x.minx); add(x.miny); add(x.maxx); add(x.maxy); }
+		void add(const Color &x)
+			{ add(x.get_r()); add(x.get_g()); add(x.get_b()); add(x.get_a()); }
+		void add(const String &x)
+			{ add((int)x.size()); add(x.c_str(), x.size()); }
+		void add(const char *x)
+			{ add(String(x)); }
+		void add(const Key &x)
+			{ add(&x.hi, sizeof(x.hi)); add(&x.lo, sizeof(x.lo)); }
+
+		Key get_key() const;
+	};
+
+	struct Statistics {
+		long long hits;
+		long long misses;
+		long long stores;
+		long long evictions;
+		long long entries;
+		long long size;
+		long long max_size;
+		Statistics(): hits(), misses(), stores(), evictions(), entries(), size(), max_size() { }
+	};
+
+private:
+	typedef std::list<Key> LruList;
+
+	struct Entry {
+		long long size;
+		LruList::iterator lru;
+		Entry(): size() { }
+	};
+
+	typedef std::map<Key, Entry> Map;
+
+	const String path;
+	const long long max_size;
+
+	mutable std::mutex mutex;
+	Map entries;
+	LruList lru; //!< most recently used at the front
+	Statistics stats;
+	long long temp_index;
+
+	static Handle instance;
+
+	String get_filename(const Key &key) const;
+	void scan();
+	void touch(const Key &key, long long size);
+	void remove(const Key &key);
+	void evict();
+
+public:
+	//! Opens (and creates if need) cache in directory \a path,
+	//! \a max_size is limit of total size of cache files in bytes
+	RenderCache(const String &path, long long max_size);
+
+	const String& get_path() const { return path; }
+	long long get_max_size() const { return max_size; }
+
+	//! Returns new surface of size stored in cache for \a key,
+	//! cached pixels placed into \a out_rect of surface.
+	//! Returns empty handle if entry is not found.
+	SurfaceResource::Handle load(const Key &key, RectInt &out_rect);
+
+	//! Stores pixels of \a rect from \a surface,
+	//! \a surface_size is a size of whole surface which will be returned by load()
+	bool store(
+		const Key &key,
+		const VectorInt &surface_size,
+		const RectInt &rect,
+		const synfig::Surface &surface );
+
+	Statistics get_statistics() const;
+
+	//! Cache used by renderers, may be empty
+	static const Handle& get_instance()
+		{ return instance; }
+	static void set_instance(const Handle &cache)
+		{ instance = cache; }
+};
+
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
@@ -49,13 +49,23 @@ public:
 	static Token token;
 	virtual Token::Handle get_token() const { return token.handle(); }
 
+	//! Preferred way to collect coverage of pixels (see software::Contour::Rasterizer)
+	enum Rasterizer
+	{
+		RASTERIZER_DEFAULT,      //!< the same for all tasks, may be set by environment variable
+		RASTERIZER_AUTO,         //!< choose by size of target rect
+		RASTERIZER_SORTED,
+		RASTERIZER_ACCUMULATION  //!< faster for contours with many edges in each row
+	};
+
 public:
 	Contour::Handle contour;
 	Real detail;
 	bool allow_antialias;
+	Rasterizer rasterizer;
 	Holder<TransformationAffine> transformation;
 
-	TaskContour(): detail(1.0), allow_antialias(true) { }
+	TaskContour(): detail(1.0), allow_antialias(true), rasterizer(RASTERIZER_DEFAULT) { }
 
 	virtual Rect calc_bounds() const;
 
@@ -0,0 +1,73 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/common/task/taskrendercache.h
+**	\brief TaskRenderCache Header
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_TASKRENDERCACHE_H
+#define __SYNFIG_RENDERING_TASKRENDERCACHE_H
+
+/* === H E A D E R S ======================================================= */
+
+#include "../../task.h"
+#include "../rendercache.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+
+//! Copies result of sub-task into own target and puts it into RenderCache.
+//! Sub-task always draws into the private surface,
+//! so stored pixels never contain anything else.
+class TaskRenderCache: public Task
+{
+public:
+	typedef etl::handle<TaskRenderCache> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	RenderCache::Handle cache;
+	RenderCache::Key key;
+
+	virtual int get_pass_subtask_index() const
+		{ return sub_task() ? PASSTO_THIS_TASK : PASSTO_NO_TASK; }
+
+	const Task::Handle& sub_task() const { return Task::sub_task(0); }
+	Task::Handle& sub_task() { return Task::sub_task(0); }
+
+	VectorInt get_offset() const;
+
+	virtual Rect calc_bounds() const;
+};
+
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
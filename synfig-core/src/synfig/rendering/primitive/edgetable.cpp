@@ -0,0 +1,256 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/primitive/edgetable.cpp
+**	\brief EdgeTable
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+#include "edgetable.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+namespace {
+
+//! Traces contour in the same way as Polyspan, but collects segments instead of drawing
+class SegmentCollector
+{
+private:
+	EdgeTable::SegmentList &segments;
+	const RectInt &window;
+	const Real detail;
+
+	Point current;
+	Point close_point;
+	Point pending;
+	bool has_pending;
+	bool opened;
+
+	//! size of bounding box, see Polyspan::max_edges_cubic()
+	static Real max_edges(const Point &a, const Point &b, const Point &c, const Point &d)
+	{
+		const Real x0 = std::min(std::min(a[0], b[0]), std::min(c[0], d[0]));
+		const Real x1 = std::max(std::max(a[0], b[0]), std::max(c[0], d[0]));
+		const Real y0 = std::min(std::min(a[1], b[1]), std::min(c[1], d[1]));
+		const Real y1 = std::max(std::max(a[1], b[1]), std::max(c[1], d[1]));
+		return std::max(x1 - x0, y1 - y0);
+	}
+
+	void add(const Contour::Chunk &chunk)
+	{
+		EdgeTable::Segment segment;
+		segment.p0 = current;
+		segment.chunk = chunk;
+		segment.top = std::min(std::min(current[1], chunk.p1[1]), std::min(chunk.pp0[1], chunk.pp1[1]));
+		segment.bottom = std::max(std::max(current[1], chunk.p1[1]), std::max(chunk.pp0[1], chunk.pp1[1]));
+
+		// horizontal segments and segments out of rows of window have no cover
+		if ( segment.top != segment.bottom
+		  && segment.bottom >= window.miny
+		  && segment.top < window.maxy )
+			segments.push_back(segment);
+
+		current = chunk.p1;
+		opened = true;
+	}
+
+	void finish_line()
+		{ if (has_pending) line_to(pending, 0.0); }
+
+public:
+	SegmentCollector(EdgeTable::SegmentList &segments, const RectInt &window, Real detail):
+		segments(segments),
+		window(window),
+		detail(std::max(Real(0.0), detail)),
+		has_pending(false),
+		opened(false)
+	{ }
+
+	void line_to(const Point &p, Real detail)
+	{
+		if (detail) {
+			if (max_edges(p, p, current, current) <= detail*0.5)
+				{ pending = p; has_pending = true; return; }
+			if (has_pending)
+				{ line_to(pending, 0.0); line_to(p, detail); return; }
+		}
+		has_pending = false;
+		add(Contour::Chunk(Contour::LINE, p));
+	}
+
+	void line_to(const Point &p)
+		{ line_to(p, detail); }
+
+	void conic_to(const Point &p, const Point &pp0)
+	{
+		if (max_edges(p, pp0, current, current) <= detail*0.5)
+			{ pending = p; has_pending = true; return; }
+		finish_line();
+		add(Contour::Chunk(Contour::CONIC, p, pp0));
+	}
+
+	void cubic_to(const Point &p, const Point &pp0, const Point &pp1)
+	{
+		if (max_edges(p, pp0, pp1, current) <= detail*0.5)
+			{ pending = p; has_pending = true; return; }
+		finish_line();
+		add(Contour::Chunk(Contour::CUBIC, p, pp0, pp1));
+	}
+
+	void close()
+	{
+		finish_line();
+		if (opened) {
+			if (current != close_point)
+				line_to(close_point, 0.0);
+			opened = false;
+		}
+	}
+
+	void move_to(const Point &p)
+	{
+		close();
+		current = close_point = p;
+	}
+};
+
+} // end of anonimous namespace
+
+/* === M E T H O D S ======================================================= */
+
+void
+EdgeTable::clear()
+{
+	window = RectInt();
+	detail = 0.0;
+	segments.clear();
+	block_offsets.clear();
+	block_segments.clear();
+}
+
+int
+EdgeTable::get_block(Real y) const
+{
+	Real row = std::floor(y);
+	if (row < window.miny) return 0;
+	if (row >= window.maxy) row = window.maxy - 1;
+	return ((int)row - window.miny)/BLOCK_ROWS;
+}
+
+void
+EdgeTable::build(
+	const Contour::ChunkList &chunks,
+	const Matrix &transform_matrix,
+	const RectInt &window,
+	Real detail )
+{
+	clear();
+	if (!window.is_valid())
+		return;
+	this->window = window;
+	this->detail = detail;
+
+	SegmentCollector collector(segments, window, detail);
+	for(Contour::ChunkList::const_iterator i = chunks.begin(); i != chunks.end(); ++i) {
+		switch(i->type) {
+			case Contour::CLOSE:
+				collector.close();
+				break;
+			case Contour::MOVE:
+				collector.move_to(transform_matrix.get_transformed(i->p1));
+				break;
+			case Contour::LINE:
+				collector.line_to(transform_matrix.get_transformed(i->p1));
+				break;
+			case Contour::CONIC:
+				collector.conic_to(
+					transform_matrix.get_transformed(i->p1),
+					transform_matrix.get_transformed(i->pp0) );
+				break;
+			case Contour::CUBIC:
+				collector.cubic_to(
+					transform_matrix.get_transformed(i->p1),
+					transform_matrix.get_transformed(i->pp0),
+					transform_matrix.get_transformed(i->pp1) );
+				break;
+			default:
+				break;
+		}
+	}
+	collector.close();
+
+	// count segments of each block, then fill the lists,
+	// so each list keeps the order of contour
+	int blocks = (window.maxy - window.miny + BLOCK_ROWS - 1)/BLOCK_ROWS;
+	block_offsets.assign(blocks + 1, 0);
+	for(SegmentList::const_iterator i = segments.begin(); i != segments.end(); ++i)
+		for(int b = get_block(i->top), last = get_block(i->bottom); b <= last; ++b)
+			++block_offsets[b + 1];
+	for(int b = 0; b < blocks; ++b)
+		block_offsets[b + 1] += block_offsets[b];
+
+	block_segments.resize(block_offsets.back());
+	std::vector<int> positions(block_offsets.begin(), block_offsets.end() - 1);
+	for(int index = 0; index < (int)segments.size(); ++index)
+		for(int b = get_block(segments[index].top), last = get_block(segments[index].bottom); b <= last; ++b)
+			block_segments[positions[b]++] = index;
+}
+
+void
+EdgeTable::rasterize(Polyspan &polyspan) const
+{
+	const RectInt &band = polyspan.get_window();
+	int miny = std::max(band.miny, window.miny);
+	int maxy = std::min(band.maxy, window.maxy);
+	if (miny >= maxy || segments.empty())
+		return;
+
+	// segment which crosses several blocks of band is drawn only once,
+	// from the first block where it is visible
+	int first = get_block(miny);
+	int last = get_block(maxy - 1);
+	for(int b = first; b <= last; ++b) {
+		for(int i = block_offsets[b]; i < block_offsets[b + 1]; ++i) {
+			const Segment &segment = segments[block_segments[i]];
+			if (std::max(get_block(segment.top), first) == b)
+				polyspan.draw_segment(segment.p0, segment.chunk, detail);
+		}
+	}
+}
+
+/* === E N T R Y P O I N T ================================================= */
@@ -0,0 +1,107 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/primitive/edgetable.h
+**	\brief EdgeTable Header
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_EDGETABLE_H
+#define __SYNFIG_RENDERING_EDGETABLE_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <vector>
+
+#include <synfig/matrix.h>
+#include <synfig/rect.h>
+
+#include "contour.h"
+#include "polyspan.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+
+//! Segments of contour transformed to pixels and sorted by rows,
+//! so several threads may rasterize bands of rows of the same contour
+//! without walking and transforming of the whole contour by each thread.
+//! Rows of window are grouped into blocks, each block knows indices of
+//! segments which cross it.
+class EdgeTable
+{
+public:
+	enum { BLOCK_ROWS = 16 };
+
+	//! Segment from point p0 to chunk.p1, in pixels
+	struct Segment
+	{
+		Point p0;
+		Contour::Chunk chunk;
+		Real top, bottom;
+	};
+
+	typedef std::vector<Segment> SegmentList;
+
+private:
+	RectInt window;
+	Real detail;
+	SegmentList segments;
+	//! segments of block i are block_segments[block_offsets[i]] ... block_segments[block_offsets[i + 1] - 1]
+	std::vector<int> block_offsets;
+	std::vector<int> block_segments;
+
+	int get_block(Real y) const;
+
+public:
+	EdgeTable(): detail() { }
+
+	void clear();
+
+	//! Transforms chunks and sorts them by blocks of rows of window.
+	//! Short segments are merged in the same way as Polyspan does it while tracing
+	//! the contour (see software::Contour::build_polyspan()), contour is closed at the end.
+	void build(
+		const Contour::ChunkList &chunks,
+		const Matrix &transform_matrix,
+		const RectInt &window,
+		Real detail = 0.25 );
+
+	//! Draws all segments which cross the rows of window of polyspan
+	void rasterize(Polyspan &polyspan) const;
+
+	const RectInt& get_window() const { return window; }
+	Real get_detail() const { return detail; }
+	const SegmentList& get_segments() const { return segments; }
+	bool empty() const { return segments.empty(); }
+};
+
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
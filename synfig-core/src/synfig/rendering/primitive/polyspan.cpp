@@ -35,6 +35,7 @@
 #include "polyspan.h"
 
 #include <cassert>
+#include <limits>
 
 #include <synfig/general.h>
 #include <synfig/localization.h>
@@ -61,7 +62,8 @@ Polyspan::Polyspan():
 	cur_line_y(0.0),
 	close_x(0.0),
 	close_y(0.0),
-	flags(NotSorted)
+	flags(NotSorted),
+	accumulate(false)
 { }
 
 //0 out all the variables involved in processing
@@ -73,6 +75,56 @@ Polyspan::clear()
 	open_index = 0;
 	current.set(0, 0, 0, 0);
 	flags = NotSorted;
+	accumulate = false;
+	accumulation.clear();
+	row_begin.clear();
+	row_end.clear();
+}
+
+void
+Polyspan::init(const RectInt &window, bool accumulate)
+{
+	clear();
+	this->window = window;
+	if (accumulate && window.is_valid()) {
+		this->accumulate = true;
+		int height = window.maxy - window.miny;
+		accumulation.assign((size_t)get_accumulation_stride()*height, 0.f);
+		row_begin.assign(height, std::numeric_limits<int>::max());
+		row_end.assign(height, 0);
+	}
+}
+
+void
+Polyspan::accumulate_mark(const PenMark &mark)
+{
+	if (mark.y < window.miny || mark.y >= window.maxy)
+		return;
+
+	int row = mark.y - window.miny;
+	int width = window.maxx - window.minx;
+	int x = mark.x - window.minx;
+	float *cells = &accumulation[(size_t)row*get_accumulation_stride()];
+	int &begin = row_begin[row];
+	int &end = row_end[row];
+
+	if (x < 0) {
+		// whole cover goes to the first pixel of row
+		cells[0] += (float)mark.cover;
+		begin = 0;
+		if (end < 1) end = 1;
+	} else
+	if (x >= width) {
+		// nothing to draw right of window, but pixels before
+		// should be walked up to the end of the row
+		if (begin > width) begin = width;
+		end = width + 1;
+	} else {
+		cells[x] += (float)(mark.cover - mark.area);
+		cells[x + 1] += (float)mark.area;
+		if (begin > x) begin = x;
+		if (end < x + 2) end = x + 2;
+	}
 }
 
 //add the current cell, but only if there is information to add
@@ -81,6 +133,8 @@ Polyspan::addcurrent()
 {
 	if(current.cover || current.area)
 	{
+		if (accumulate)
+			{ accumulate_mark(current); return; }
 		if (covers.size() == covers.capacity())
 			covers.reserve(covers.size() + 1024*1024);
 		covers.push_back(current);
@@ -166,6 +220,36 @@ Polyspan::encapsulate_current()
 	open_index = covers.size();
 }
 
+void
+Polyspan::draw_segment(const Point &p0, const Contour::Chunk &chunk, Real detail)
+{
+	finish_line();
+	cur_x = clamp_coord(p0[0]);
+	cur_y = clamp_coord(p0[1]);
+	move_pen((int)floor(cur_x), (int)floor(cur_y));
+
+	switch(chunk.type)
+	{
+		case Contour::LINE:
+			line_to(chunk.p1[0], chunk.p1[1], 0.0);
+			break;
+		case Contour::CONIC:
+			conic_to(chunk.p1[0], chunk.p1[1], chunk.pp0[0], chunk.pp0[1], detail);
+			break;
+		case Contour::CUBIC:
+			cubic_to(chunk.p1[0], chunk.p1[1], chunk.pp0[0], chunk.pp0[1], chunk.pp1[0], chunk.pp1[1], detail);
+			break;
+		default:
+			break;
+	}
+	finish_line();
+
+	// segment is complete, there is nothing to close
+	close_x = cur_x;
+	close_y = cur_y;
+	flags &= ~NotClosed;
+}
+
 //move to start a new primitive list (enclose the last primitive if need be)
 void
 Polyspan::move_to(Real x, Real y)
@@ -953,6 +1037,21 @@ Polyspan::extract_alpha(Real area, Contour::WindingStyle winding_style) const
 RectInt
 Polyspan::calc_bounds() const
 {
+	if (accumulate) {
+		RectInt bounds(window.minx, window.miny);
+		bool empty = true;
+		for(int row = 0; row < (int)row_begin.size(); ++row) {
+			if (row_begin[row] >= row_end[row]) continue;
+			RectInt r(
+				window.minx + row_begin[row], window.miny + row,
+				window.minx + row_end[row],   window.miny + row + 1 );
+			if (empty) bounds = r; else bounds |= r;
+			empty = false;
+		}
+		set_intersect(bounds, bounds, window);
+		return bounds;
+	}
+
 	if (covers.empty()) return RectInt(window.minx, window.miny);
 	RectInt bounds(covers.front().x, covers.front().y);
 	for(cover_array::const_iterator i = covers.begin() + 1; i != covers.end(); ++i)
@@ -71,6 +71,7 @@ public:
 	};
 
 	typedef	std::vector<PenMark> cover_array;
+	typedef	std::vector<float> accumulation_array;
 
 	//for assignment to flags value
 	enum PolySpanFlags
@@ -111,6 +112,19 @@ private:
 	//the window that will be drawn (used for clipping)
 	RectInt		    window;
 
+	//dense buffer of signed area used instead of covers in accumulation mode,
+	//row of window is stored as (width + 1) cells, mark at x adds (cover - area)
+	//to cell x and area to cell x + 1, so prefix sum of the row at x
+	//gives the same (cover - area) value as the walk through the sorted marks
+	bool			accumulate;
+	accumulation_array accumulation;
+	//range of touched cells for each row, rows with empty range have no marks
+	std::vector<int> row_begin;
+	std::vector<int> row_end;
+
+	//add mark to the accumulation buffer
+	void accumulate_mark(const PenMark &mark);
+
 	//add the current cell, but only if there is information to add
 	void addcurrent();
 
@@ -136,22 +150,36 @@ public:
 	const RectInt& get_window() const { return window; }
 	const cover_array& get_covers() const { return covers; }
 
+	bool is_accumulated() const { return accumulate; }
+	int get_accumulation_stride() const { return window.maxx - window.minx + 1; }
+	const accumulation_array& get_accumulation() const { return accumulation; }
+	const std::vector<int>& get_row_begin() const { return row_begin; }
+	const std::vector<int>& get_row_end() const { return row_end; }
+
 	bool notclosed() const
 		{ return (flags & NotClosed) || (cur_x != close_x) || (cur_y != close_y); }
 
 	//0 out all the variables involved in processing
 	void clear();
-	void init(const RectInt &window)
-		{ clear(); this->window = window; }
-	void init(int minx, int miny, int maxx, int maxy)
+	//if accumulate is set then marks are summed in the dense buffer of window size
+	//instead of the list of covers, this avoids sorting of marks,
+	//but needs the memory for the whole window
+	void init(const RectInt &window, bool accumulate = false);
+	void init(int minx, int miny, int maxx, int maxy, bool accumulate = false)
 	{
-		clear();
+		RectInt window;
 		window.minx = minx;
 		window.miny = miny;
 		window.maxx = maxx;
 		window.maxy = maxy;
+		init(window, accumulate);
 	}
 
+	//draw single segment (line, conic or cubic) from point p0, which is not connected to others,
+	//the same as if it was drawn while tracing a contour, segments shorter than detail
+	//are expected to be already merged (see EdgeTable)
+	void draw_segment(const Point &p0, const Contour::Chunk &chunk, Real detail = 1.0);
+
 	//close the primitives with a line (or rendering will not work as expected)
 	void close();
 
@@ -159,6 +187,7 @@ public:
 	void merge_all();
 
 	//will sort the marks if they are not sorted
+	//(in accumulation mode just adds the last mark to the buffer)
 	void sort_marks();
 
 	//encapsulate the current sublist of marks (used for drawing)
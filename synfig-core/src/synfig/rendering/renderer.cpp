@@ -42,9 +42,11 @@
 #include <synfig/debug/debugsurface.h>
 #include <synfig/debug/log.h>
 #include <synfig/debug/measure.h>
+#include <synfig/debug/trace.h>
 
 #include "renderer.h"
 #include "renderqueue.h"
+#include "taskcost.h"
 
 #include "software/renderersw.h"
 #include "software/rendererdraftsw.h"
@@ -206,6 +208,7 @@ Renderer::calc_coords(const Task::List &list) const
 	#ifdef DEBUG_OPTIMIZATION_MEASURE
 	debug::Measure t("calc coords");
 	#endif
+	debug::Trace::Scope trace("optimizer", "calc coords");
 	for(Task::List::const_iterator i = list.begin(); i != list.end(); ++i)
 		if (*i) (*i)->touch_coords();
 }
@@ -233,6 +236,7 @@ Renderer::specialize(Task::List &list) const
 	#ifdef DEBUG_OPTIMIZATION_MEASURE
 	debug::Measure t("specialize");
 	#endif
+	debug::Trace::Scope trace("optimizer", "specialize");
 	specialize_recursive(list);
 }
 
@@ -253,6 +257,7 @@ Renderer::linearize(Task::List &list) const
 	#ifdef DEBUG_OPTIMIZATION_MEASURE
 	debug::Measure t("linearize");
 	#endif
+	debug::Trace::Scope trace("optimizer", "linearize");
 
 	// convert task-tree to linear list
 	for(Task::List::iterator i = list.begin(); i != list.end();)
@@ -489,6 +494,7 @@ Renderer::optimize(Task::List &list) const
 	#ifdef DEBUG_TASK_MEASURE
 	debug::Measure t("Renderer::optimize");
 	#endif
+	debug::Trace::Scope trace("optimizer", "Renderer::optimize");
 
 	#ifdef DEBUG_OPTIMIZATION_COUNTERS
 	debug::Log::info("", "optimize %d tasks", count_tasks(list));
@@ -580,6 +586,12 @@ Renderer::optimize(Task::List &list) const
 		debug::Measure t(etl::strprintf("optimize category %d index %d", current_category_id, current_optimizer_index));
 		#endif
 
+		debug::Trace::Scope trace;
+		if (debug::Trace::is_enabled())
+			trace.start("optimizer", simultaneous_run
+				? etl::strprintf("optimize category %d", current_category_id)
+				: etl::strprintf("optimize category %d: %s", current_category_id, typeid(*single.front()).name()) );
+
 		#ifdef DEBUG_OPTIMIZATION_COUNTERS
 		std::atomic<int> calls_count(0), *calls_count_ptr = &calls_count;
 		std::atomic<int> optimizations_count(0), *optimizations_count_ptr = &optimizations_count;
@@ -793,6 +805,8 @@ Renderer::run(const Task::List &list, bool quiet) const
 	if (!quiet) debug::Measure t("Renderer::run");
 	#endif
 
+	debug::Trace::Scope trace("render", "Renderer::run");
+
 	TaskEvent::Handle task_event = new TaskEvent();
 	enqueue(list, task_event, quiet);
 
@@ -800,6 +814,7 @@ Renderer::run(const Task::List &list, bool quiet) const
 		#ifdef DEBUG_TASK_MEASURE
 		if (!quiet) debug::Measure t("run tasks");
 		#endif
+		debug::Trace::Scope trace("render", "wait tasks");
 
 		task_event->wait();
 	}
@@ -988,6 +1003,8 @@ Renderer::initialize()
 	if (const char *s = getenv("SYNFIG_RENDERING_DEBUG_RESULT_IMAGE"))
 		debug_options.result_image = s;
 
+	TaskCost::initialize();
+
 	renderers = new std::map<String, Handle>();
 	queue = new RenderQueue();
 
@@ -1007,6 +1024,8 @@ Renderer::deinitialize()
 
 	delete renderers;
 	delete queue;
+
+	TaskCost::deinitialize();
 }
 
 void
@@ -1034,6 +1053,12 @@ Renderer::get_renderer(const String &name)
 		 : blank;
 }
 
+RenderQueue::Statistics
+Renderer::get_queue_statistics()
+{
+	return queue ? queue->get_statistics() : RenderQueue::Statistics();
+}
+
 const std::map<String, Renderer::Handle>&
 Renderer::get_renderers()
 {
@@ -33,6 +33,7 @@
 #include <atomic>
 
 #include "optimizer.h"
+#include "renderqueue.h"
 
 /* === M A C R O S ========================================================= */
 
@@ -45,8 +46,6 @@ namespace synfig
 namespace rendering
 {
 
-class RenderQueue;
-
 class Renderer: public etl::shared_object
 {
 public:
@@ -183,6 +182,8 @@ public:
 	static const DebugOptions& get_debug_options()
 		{ return debug_options; }
 
+	static RenderQueue::Statistics get_queue_statistics();
+
 	static bool subsys_init()
 		{ initialize(); return true; }
 	static bool subsys_stop()
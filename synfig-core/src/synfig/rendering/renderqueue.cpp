@@ -29,6 +29,7 @@
 #	include <config.h>
 #endif
 
+#include <chrono>
 #include <cstdlib>
 #include <climits>
 
@@ -39,9 +40,14 @@
 #include <synfig/debug/debugsurface.h>
 #include <synfig/debug/log.h>
 #include <synfig/debug/measure.h>
+#include <synfig/debug/trace.h>
+#include <synfig/layer.h>
 
 #include "renderqueue.h"
 #include "renderer.h"
+#include "taskcost.h"
+
+#include "common/task/tasklayer.h"
 
 #endif
 
@@ -56,6 +62,7 @@ using namespace rendering;
 //#define DEBUG_THREAD_TASK
 //#define DEBUG_THREAD_WAIT
 //#define DEBUG_TASK_SURFACE
+//#define DEBUG_THREAD_STATISTICS
 #endif
 
 
@@ -85,7 +92,13 @@ Task::Token TaskSubQueue::token(
 } // end of anonimous namespace
 
 
-RenderQueue::RenderQueue(): started(false) { start(); }
+RenderQueue::RenderQueue():
+	ready_count(0),
+	single_ready_count(0),
+	sleeping_threads(0),
+	last_queue_index(0),
+	started(false)
+	{ start(); }
 RenderQueue::~RenderQueue() { stop(); }
 
 void
@@ -109,25 +122,35 @@ RenderQueue::start()
 	if (count > SYNFIG_RENDERING_MAX_THREADS) count = SYNFIG_RENDERING_MAX_THREADS;
 	if (count < 2) count = 2;
 
+	// queues should be ready before threads will started
+	while((int)queues.size() < count)
+		queues.emplace_back();
+	started = true;
+
 	for(int i = 0; i < count; ++i)
 		threads.push_back(
 			Glib::Threads::Thread::create(
 				sigc::bind(sigc::mem_fun(*this, &RenderQueue::process), i) ));
 	info("rendering threads %d", count);
-	started = true;
 }
 
 void
 RenderQueue::stop()
 {
 	{
-		std::lock_guard<std::mutex> lock(mutex);
+		std::lock_guard<std::mutex> lock(sleep_mutex);
 		started = false;
 		cond.notify_all();
 		single_cond.notify_all();
 	}
 	while(!threads.empty())
 		{ threads.front()->join(); threads.pop_front(); }
+
+	#ifdef DEBUG_THREAD_STATISTICS
+	Statistics s = get_statistics();
+	info( "rendering queue: tasks %lld, local %lld, steals %lld, failed steals %lld, contentions %lld, sleeps %lld",
+		  s.tasks, s.local_pops, s.steals, s.failed_steals, s.contentions, s.sleeps );
+	#endif
 }
 
 void
@@ -151,9 +174,22 @@ RenderQueue::process(int thread_index)
 		}
 
 		bool success = false;
-		try {
-			success = task->run(task->renderer_data.params);
-		} catch(...) { }
+		{
+			debug::Trace::Scope trace;
+			if (debug::Trace::is_enabled()) {
+				String name = task->get_token()->name;
+				if (TaskLayer::Handle task_layer = TaskLayer::Handle::cast_dynamic(task))
+					if (task_layer->layer)
+						name += " " + task_layer->layer->get_non_empty_description();
+				trace.start("task", name);
+			}
+
+			std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			try {
+				success = task->run(task->renderer_data.params);
+			} catch(...) { }
+			TaskCost::add(*task, std::chrono::duration<Real>(std::chrono::steady_clock::now() - begin).count());
+		}
 		if (!success)
 			task->renderer_data.success = false;
 
@@ -191,31 +227,125 @@ RenderQueue::process(int thread_index)
 	}
 }
 
+void
+RenderQueue::lock_counted(std::unique_lock<std::mutex> &lock, int thread_index)
+{
+	if (lock.try_lock()) return;
+	if (thread_index >= 0 && thread_index < (int)queues.size())
+		queues[thread_index].contentions.fetch_add(1, std::memory_order_relaxed);
+	lock.lock();
+}
+
+void
+RenderQueue::push_ready(int thread_index, const Task::Handle &task)
+{
+	// tasks which became ready in worker thread stays in the queue of this thread,
+	// other tasks are distributed between worker threads
+	bool mt = task->get_allow_multithreading();
+	int count = (int)queues.size();
+	int index = !mt ? 0
+	          : thread_index > 0 && thread_index < count ? thread_index
+	          : 1 + (int)((unsigned int)(last_queue_index++) % (unsigned int)(count - 1));
+
+	ThreadQueue &queue = queues[index];
+	{
+		std::unique_lock<std::mutex> queue_lock(queue.mutex, std::defer_lock);
+		lock_counted(queue_lock, thread_index);
+		queue.tasks.push_back(task);
+	}
+	++(mt ? ready_count : single_ready_count);
+}
+
+Task::Handle
+RenderQueue::pop_ready(int thread_index)
+{
+	ThreadQueue &own = queues[thread_index];
+
+	// thread 0 processes single-threaded tasks in order of readiness
+	if (!thread_index) {
+		std::unique_lock<std::mutex> queue_lock(own.mutex, std::defer_lock);
+		lock_counted(queue_lock, thread_index);
+		if (own.tasks.empty()) return Task::Handle();
+		Task::Handle task = own.tasks.front();
+		own.tasks.pop_front();
+		--single_ready_count;
+		own.local_pops.fetch_add(1, std::memory_order_relaxed);
+		return task;
+	}
+
+	// take the last task from own queue, it most likely uses the data just written by this thread
+	{
+		std::unique_lock<std::mutex> queue_lock(own.mutex, std::defer_lock);
+		lock_counted(queue_lock, thread_index);
+		if (!own.tasks.empty()) {
+			Task::Handle task = own.tasks.back();
+			own.tasks.pop_back();
+			--ready_count;
+			own.local_pops.fetch_add(1, std::memory_order_relaxed);
+			return task;
+		}
+	}
+
+	// steal the oldest task from other worker threads
+	int count = (int)queues.size();
+	for(int i = 1; i < count - 1 && ready_count > 0; ++i) {
+		ThreadQueue &victim = queues[1 + (thread_index - 1 + i) % (count - 1)];
+		std::unique_lock<std::mutex> queue_lock(victim.mutex, std::defer_lock);
+		lock_counted(queue_lock, thread_index);
+		if (victim.tasks.empty()) {
+			own.failed_steals.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+		Task::Handle task = victim.tasks.front();
+		victim.tasks.pop_front();
+		--ready_count;
+		own.steals.fetch_add(1, std::memory_order_relaxed);
+		return task;
+	}
+
+	return Task::Handle();
+}
+
+void
+RenderQueue::wakeup(int signals, int single_signals)
+{
+	// ready counters are already incremented,
+	// so thread which is going to sleep will see the new tasks or will be notified
+	if (sleeping_threads <= 0 || (signals <= 0 && single_signals <= 0))
+		return;
+	std::lock_guard<std::mutex> lock(sleep_mutex);
+	while(signals-- > 0) cond.notify_one();
+	while(single_signals-- > 0) single_cond.notify_one();
+}
+
 void
 RenderQueue::done(int thread_index, const Task::Handle &task)
 {
 	assert(task);
 	int single_signals = 0;
 	int signals = 0;
-	std::lock_guard<std::mutex> lock(mutex);
-	for(Task::Set::iterator i = task->renderer_data.back_deps.begin(); i != task->renderer_data.back_deps.end(); ++i)
 	{
-		assert(*i);
-		(*i)->renderer_data.deps.erase(task);
-		if ((*i)->renderer_data.deps.empty())
+		std::unique_lock<std::mutex> graph_lock(mutex, std::defer_lock);
+		lock_counted(graph_lock, thread_index);
+		for(Task::Set::iterator i = task->renderer_data.back_deps.begin(); i != task->renderer_data.back_deps.end(); ++i)
 		{
-			bool mt = (*i)->get_allow_multithreading();
-			TaskQueue &queue = mt ? ready_tasks     : single_ready_tasks;
-			TaskSet   &wait  = mt ? not_ready_tasks : single_not_ready_tasks;
-			wait.erase(*i);
-			queue.push_back(*i);
-			++(mt ? signals : single_signals);
+			assert(*i);
+			(*i)->renderer_data.deps.erase(task);
+			if ((*i)->renderer_data.deps.empty())
+			{
+				bool mt = (*i)->get_allow_multithreading();
+				TaskSet &wait = mt ? not_ready_tasks : single_not_ready_tasks;
+				wait.erase(*i);
+				push_ready(thread_index, *i);
+				++(mt ? signals : single_signals);
+			}
 		}
+		task->renderer_data.back_deps.clear();
 	}
-	task->renderer_data.back_deps.clear();
-	assert( tasks_in_process.count(thread_index) == 1 );
-	tasks_in_process.erase(thread_index);
-	//info("rendering threads used %d", tasks_in_process.size());
+
+	ThreadQueue &own = queues[thread_index];
+	own.current.reset();
+	own.tasks_count.fetch_add(1, std::memory_order_relaxed);
 
 	// limit signals count
 	int threads = get_threads_count() - 1;
@@ -226,39 +356,38 @@ RenderQueue::done(int thread_index, const Task::Handle &task)
 	--(thread_index ? signals : single_signals);
 
 	// wake up
-	while(signals-- > 0) cond.notify_one();
-	while(single_signals-- > 0) single_cond.notify_one();
+	wakeup(signals, single_signals);
 }
 
 Task::Handle
 RenderQueue::get(int thread_index)
 {
-	std::unique_lock<std::mutex> lock(mutex);
+	ThreadQueue &own = queues[thread_index];
+	std::atomic<int> &count = thread_index ? ready_count : single_ready_count;
+	std::condition_variable &thread_cond = thread_index ? cond : single_cond;
 
-	TaskQueue &queue  = thread_index == 0 ? single_ready_tasks     : ready_tasks;
-	TaskQueue &queue2 = thread_index != 0 ? single_ready_tasks     : ready_tasks;
-	TaskSet   &wait   = thread_index == 0 ? single_not_ready_tasks : not_ready_tasks;
 	while(started)
 	{
-		if (!queue.empty())
-		{
-			Task::Handle task = queue.front();
-			queue.pop_front();
-			if (!task) continue;
-			assert( tasks_in_process.count(thread_index) == 0 );
-			tasks_in_process[thread_index] = task;
-			//info("rendering threads used %d", tasks_in_process.size());
-			return task;
-		}
+		if (count > 0)
+			if (Task::Handle task = pop_ready(thread_index))
+			{
+				assert(!own.current);
+				own.current = task;
+				return task;
+			}
 
-		#ifdef DEBUG_THREAD_WAIT
-		if (!wait.empty())
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		if (!started) break;
+		++sleeping_threads;
+		if (count <= 0)
+		{
+			#ifdef DEBUG_THREAD_WAIT
 			info("thread %d: rendering wait for task", thread_index);
-		#endif
-
-		assert( wait.empty() || !tasks_in_process.empty() || !queue2.empty() );
-
-		(thread_index ? cond : single_cond).wait(lock);
+			#endif
+			own.sleeps.fetch_add(1, std::memory_order_relaxed);
+			thread_cond.wait(lock);
+		}
+		--sleeping_threads;
 	}
 	return Task::Handle();
 }
@@ -276,7 +405,8 @@ RenderQueue::fix_task(const Task &task, const Task::RunParams &params)
 int
 RenderQueue::get_threads_count() const
 {
-	return threads.size();
+	// each thread has own queue, and queues are not changed while threads are running
+	return queues.size();
 }
 
 bool
@@ -322,10 +452,13 @@ RenderQueue::remove_orphans()
 {
 	// mutex must be already locked
 
-	for(TaskQueue::iterator i = ready_tasks.begin(); i != ready_tasks.end();)
-		if (remove_if_orphan(*i, true)) ready_tasks.erase(i++); else ++i;
-	for(TaskQueue::iterator i = single_ready_tasks.begin(); i != single_ready_tasks.end();)
-		if (remove_if_orphan(*i, true)) single_ready_tasks.erase(i++); else ++i;
+	for(int index = 0; index < (int)queues.size(); ++index) {
+		ThreadQueue &queue = queues[index];
+		std::atomic<int> &count = index ? ready_count : single_ready_count;
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		for(TaskQueue::iterator i = queue.tasks.begin(); i != queue.tasks.end();)
+			if (remove_if_orphan(*i, true)) { i = queue.tasks.erase(i); --count; } else ++i;
+	}
 
 	for(TaskSet::iterator i = not_ready_tasks.begin(); i != not_ready_tasks.end();)
 		if (remove_if_orphan(*i, true)) not_ready_tasks.erase(i++); else ++i;
@@ -339,21 +472,26 @@ RenderQueue::enqueue(const Task::Handle &task, const Task::RunParams &params)
 {
 	if (!task) return;
 	fix_task(*task, params);
-	std::lock_guard<std::mutex> lock(mutex);
 
 	bool mt = task->get_allow_multithreading();
-	TaskQueue &queue = mt ? ready_tasks     : single_ready_tasks;
-	TaskSet   &wait  = mt ? not_ready_tasks : single_not_ready_tasks;
-	if (task->renderer_data.deps.empty()) {
-		queue.push_back(task);
-		(mt ? cond : single_cond).notify_one();
-	}
-	else
+	bool ready = false;
 	{
-		wait.insert(task);
+		std::lock_guard<std::mutex> lock(mutex);
+		TaskSet &wait = mt ? not_ready_tasks : single_not_ready_tasks;
+		if (task->renderer_data.deps.empty()) {
+			push_ready(-1, task);
+			ready = true;
+		}
+		else
+		{
+			wait.insert(task);
+		}
+
+		remove_orphans();
 	}
 
-	remove_orphans();
+	if (ready)
+		wakeup(mt ? 1 : 0, mt ? 0 : 1);
 }
 
 void
@@ -366,23 +504,26 @@ RenderQueue::enqueue(const Task::List &tasks, const Task::RunParams &params)
 		if (*i) { fix_task(**i, p); ++count; }
 	if (!count) return;
 
-	std::lock_guard<std::mutex> lock(mutex);
 	int single_signals = 0;
 	int signals = 0;
-	for(Task::List::const_iterator i = tasks.begin(); i != tasks.end(); ++i)
 	{
-		if (*i)
+		std::lock_guard<std::mutex> lock(mutex);
+		for(Task::List::const_iterator i = tasks.begin(); i != tasks.end(); ++i)
 		{
-			bool mt = (*i)->get_allow_multithreading();
-			TaskQueue &queue = mt ? ready_tasks     : single_ready_tasks;
-			TaskSet   &wait  = mt ? not_ready_tasks : single_not_ready_tasks;
-			if ((*i)->renderer_data.deps.empty()) {
-				queue.push_back(*i);
-				++(mt ? signals : single_signals);
-			} else {
-				wait.insert(*i);
+			if (*i)
+			{
+				bool mt = (*i)->get_allow_multithreading();
+				TaskSet &wait = mt ? not_ready_tasks : single_not_ready_tasks;
+				if ((*i)->renderer_data.deps.empty()) {
+					push_ready(-1, *i);
+					++(mt ? signals : single_signals);
+				} else {
+					wait.insert(*i);
+				}
 			}
 		}
+
+		remove_orphans();
 	}
 
 	// limit signals count
@@ -391,23 +532,26 @@ RenderQueue::enqueue(const Task::List &tasks, const Task::RunParams &params)
 	if (single_signals > 1) single_signals = 1;
 
 	// wake up
-	while(signals-- > 0) cond.notify_one();
-	while(single_signals-- > 0) single_cond.notify_one();
-
-	remove_orphans();
+	wakeup(signals, single_signals);
 }
 
 bool
 RenderQueue::remove_task(const Task::Handle &task)
 {
+	// mutex must be already locked
+
 	bool found = false;
 	if (task) {
 		bool mt = task->get_allow_multithreading();
-		TaskQueue &queue = mt ? ready_tasks     : single_ready_tasks;
-		TaskSet   &wait  = mt ? not_ready_tasks : single_not_ready_tasks;
-
-		for(TaskQueue::iterator i = queue.begin(); i != queue.end();)
-			if (*i == task) found = true, queue.erase(i++); else ++i;
+		TaskSet &wait = mt ? not_ready_tasks : single_not_ready_tasks;
+		std::atomic<int> &count = mt ? ready_count : single_ready_count;
+
+		for(int index = mt ? 1 : 0; index < (mt ? (int)queues.size() : 1); ++index) {
+			ThreadQueue &queue = queues[index];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			for(TaskQueue::iterator i = queue.tasks.begin(); i != queue.tasks.end();)
+				if (*i == task) { found = true; i = queue.tasks.erase(i); --count; } else ++i;
+		}
 		if (wait.erase(task)) found = true;
 	}
 	return found;
@@ -455,10 +599,29 @@ void
 RenderQueue::clear()
 {
 	std::lock_guard<std::mutex> lock(mutex);
-	ready_tasks.clear();
-	single_ready_tasks.clear();
+	for(int index = 0; index < (int)queues.size(); ++index) {
+		ThreadQueue &queue = queues[index];
+		std::lock_guard<std::mutex> queue_lock(queue.mutex);
+		(index ? ready_count : single_ready_count) -= (int)queue.tasks.size();
+		queue.tasks.clear();
+	}
 	not_ready_tasks.clear();
 	single_not_ready_tasks.clear();
 }
 
+RenderQueue::Statistics
+RenderQueue::get_statistics() const
+{
+	Statistics s;
+	for(std::deque<ThreadQueue>::const_iterator i = queues.begin(); i != queues.end(); ++i) {
+		s.tasks         += i->tasks_count;
+		s.local_pops    += i->local_pops;
+		s.steals        += i->steals;
+		s.failed_steals += i->failed_steals;
+		s.contentions   += i->contentions;
+		s.sleeps        += i->sleeps;
+	}
+	return s;
+}
+
 /* === E N T R Y P O I N T ================================================= */
@@ -30,7 +30,9 @@
 #include <cstdio>
 
 #include <map>
+#include <deque>
 
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
 
@@ -51,27 +53,65 @@ class RenderQueue
 {
 public:
 	typedef std::list<Glib::Threads::Thread*> ThreadList;
-	typedef std::map<int, Task::Handle> ThreadTaskMap;
 	typedef std::set<Task::Handle> TaskSet;
-	typedef std::list<Task::Handle> TaskQueue;
+	typedef std::deque<Task::Handle> TaskQueue;
+
+	//! Scheduler counters, summarized over all threads
+	struct Statistics {
+		long long tasks;         //!< tasks processed
+		long long local_pops;    //!< tasks taken by thread from own queue
+		long long steals;        //!< tasks taken by thread from queue of other thread
+		long long failed_steals; //!< attempts to steal from empty queue
+		long long contentions;   //!< locks which was already taken by other thread
+		long long sleeps;        //!< times when thread had nothing to do and went to sleep
+
+		Statistics():
+			tasks(), local_pops(), steals(), failed_steals(), contentions(), sleeps() { }
+	};
 
 private:
+	//! Ready tasks of one thread and counters of this thread.
+	//! Owner takes tasks from the back, other threads steal them from the front.
+	//! Counters are written only by owner thread.
+	struct ThreadQueue {
+		std::mutex mutex;
+		TaskQueue tasks;
+		Task::Handle current;
+
+		std::atomic<long long> tasks_count;
+		std::atomic<long long> local_pops;
+		std::atomic<long long> steals;
+		std::atomic<long long> failed_steals;
+		std::atomic<long long> contentions;
+		std::atomic<long long> sleeps;
+
+		ThreadQueue():
+			tasks_count(0), local_pops(0), steals(0), failed_steals(0), contentions(0), sleeps(0) { }
+	};
+
 	static int last_batch_index;
 
+	//! protects dependencies of tasks (Task::RendererData::deps and back_deps) and waiting sets
 	std::mutex mutex;
-	std::mutex threads_mutex;
+	//! protects sleeping of threads
+	std::mutex sleep_mutex;
 	std::condition_variable cond;
 	std::condition_variable single_cond;
 
-	TaskQueue ready_tasks;
-	TaskQueue single_ready_tasks;
+	//! Queue with index 0 contains tasks for thread 0 (tasks without multithreading),
+	//! other queues belongs to worker threads with the same indices
+	std::deque<ThreadQueue> queues;
 	TaskSet not_ready_tasks;
 	TaskSet single_not_ready_tasks;
 
-	bool started;
+	std::atomic<int> ready_count;
+	std::atomic<int> single_ready_count;
+	std::atomic<int> sleeping_threads;
+	std::atomic<int> last_queue_index;
+
+	std::atomic<bool> started;
 
 	ThreadList threads;
-	ThreadTaskMap tasks_in_process;
 
 	void start();
 	void stop();
@@ -80,6 +120,11 @@ private:
 	void done(int thread_index, const Task::Handle &task);
 	Task::Handle get(int thread_index);
 
+	void lock_counted(std::unique_lock<std::mutex> &lock, int thread_index);
+	void push_ready(int thread_index, const Task::Handle &task);
+	Task::Handle pop_ready(int thread_index);
+	void wakeup(int signals, int single_signals);
+
 	static void fix_task(const Task &task, const Task::RunParams &params);
 	bool remove_if_orphan(const Task::Handle &task, bool in_queue);
 	void remove_orphans();
@@ -95,6 +140,8 @@ public:
 	void cancel(const Task::Handle &task);
 	void cancel(const Task::List &list);
 	void clear();
+
+	Statistics get_statistics() const;
 };
 
 } /* end namespace rendering */
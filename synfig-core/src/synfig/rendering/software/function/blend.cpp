@@ -0,0 +1,298 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/function/blend.cpp
+**	\brief Blend
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cassert>
+#include <cmath>
+
+#include <synfig/color/colorblendingfunctions.h>
+#include <synfig/color/pixelformat.h>
+
+#include "blend.h"
+
+#endif
+
+// kernels are compiled with function-level target attributes,
+// like conversions in synfig/color/pixelformat.cpp
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#	define BLEND_SSE2
+#	define BLEND_TARGET(x) __attribute__((target(x)))
+#	include <emmintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#	define BLEND_SSE2
+#	define BLEND_TARGET(x)
+#	include <emmintrin.h>
+#endif
+
+using namespace synfig;
+using namespace rendering;
+using namespace software;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+namespace {
+
+typedef Color (*BlendFunc)(Color&, Color&, float);
+
+void
+row_skip(Color*, const Color*, int, ColorReal)
+	{ }
+
+template<BlendFunc func>
+void
+row_generic(Color *dst, const Color *src, int count, ColorReal amount)
+{
+	for(Color *end = dst + count; dst < end; ++dst, ++src) {
+		Color a = *src;
+		*dst = func(a, *dst, amount);
+	}
+}
+
+#ifdef BLEND_SSE2
+// Every kernel repeats operations of the scalar function from
+// colorblendingfunctions.h in the same order, one pixel per register,
+// so results are the same as results of Color::blend()
+
+BLEND_TARGET("sse2") inline __m128
+splat_a(__m128 x)
+	{ return _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 3, 3)); }
+
+//! Returns color channels of x and alpha channel of a
+BLEND_TARGET("sse2") inline __m128
+set_a(__m128 x, __m128 a)
+{
+	const __m128 mask = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+	return _mm_or_ps(_mm_andnot_ps(mask, x), _mm_and_ps(mask, a));
+}
+
+//! Returns x if fabs(a) > COLOR_EPSILON, and Color::alpha() otherwise
+BLEND_TARGET("sse2") inline __m128
+valid_or_alpha(__m128 x, __m128 a)
+{
+	const Color alpha = Color::alpha();
+	const __m128 abs_a = _mm_andnot_ps(_mm_set1_ps(-0.f), a);
+	const __m128 mask = _mm_cmpgt_ps(abs_a, _mm_set1_ps(COLOR_EPSILON));
+	return _mm_or_ps(_mm_and_ps(mask, x), _mm_andnot_ps(mask, _mm_loadu_ps(reinterpret_cast<const float*>(&alpha))));
+}
+
+//! blendfunc_COMPOSITE(), as is alpha of src already multiplied by amount
+BLEND_TARGET("sse2") inline __m128
+composite(__m128 src, __m128 dst, __m128 as)
+{
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 ad = splat_a(dst);
+	const __m128 k = _mm_sub_ps(one, as);
+	const __m128 c = _mm_add_ps(_mm_mul_ps(src, as), _mm_mul_ps(_mm_mul_ps(dst, ad), k));
+	const __m128 a = _mm_add_ps(as, _mm_mul_ps(ad, k));
+	return valid_or_alpha(set_a(_mm_mul_ps(c, _mm_div_ps(one, a)), a), a);
+}
+
+//! blendfunc_STRAIGHT()
+BLEND_TARGET("sse2") inline __m128
+straight(__m128 src, __m128 dst, __m128 amount)
+{
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 as = splat_a(src);
+	const __m128 ad = splat_a(dst);
+	const __m128 a = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(as, ad), amount), ad);
+	const __m128 d = _mm_mul_ps(dst, ad);
+	const __m128 c = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(src, as), d), amount), d);
+	return valid_or_alpha(set_a(_mm_mul_ps(c, _mm_div_ps(one, a)), a), a);
+}
+
+BLEND_TARGET("sse2") inline __m128
+pixel_composite(__m128 src, __m128 dst, __m128 amount)
+	{ return composite(src, dst, _mm_mul_ps(splat_a(src), amount)); }
+
+BLEND_TARGET("sse2") inline __m128
+pixel_straight(__m128 src, __m128 dst, __m128 amount)
+	{ return straight(src, dst, amount); }
+
+BLEND_TARGET("sse2") inline __m128
+pixel_onto(__m128 src, __m128 dst, __m128 amount)
+{
+	const __m128 c = composite(src, set_a(dst, _mm_set1_ps(1.f)), _mm_mul_ps(splat_a(src), amount));
+	return set_a(c, dst);
+}
+
+BLEND_TARGET("sse2") inline __m128
+pixel_straight_onto(__m128 src, __m128 dst, __m128 amount)
+	{ return straight(set_a(src, _mm_mul_ps(src, splat_a(dst))), dst, amount); }
+
+BLEND_TARGET("sse2") inline __m128
+pixel_behind(__m128 src, __m128 dst, __m128 amount)
+{
+	const __m128 as = splat_a(src);
+	const __m128 zero = _mm_cmpeq_ps(as, _mm_setzero_ps());
+	const __m128 a = _mm_or_ps(
+		_mm_and_ps(zero, _mm_mul_ps(_mm_set1_ps(COLOR_EPSILON), amount)),
+		_mm_andnot_ps(zero, _mm_mul_ps(as, amount)) );
+	return composite(dst, set_a(src, a), splat_a(dst));
+}
+
+BLEND_TARGET("sse2") inline __m128
+pixel_add(__m128 src, __m128 dst, __m128 amount)
+{
+	const __m128 ad = splat_a(dst);
+	const __m128 c = _mm_add_ps(_mm_mul_ps(dst, ad), _mm_mul_ps(src, _mm_mul_ps(splat_a(src), amount)));
+	return set_a(c, dst);
+}
+
+//! Expects positive amount, negative one inverts src in blendfunc_MULTIPLY()
+BLEND_TARGET("sse2") inline __m128
+pixel_multiply(__m128 src, __m128 dst, __m128 amount)
+{
+	const __m128 k = _mm_mul_ps(amount, splat_a(src));
+	const __m128 c = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(dst, src), dst), k), dst);
+	return set_a(c, dst);
+}
+
+//! Expects positive amount, negative one inverts src in blendfunc_SCREEN()
+BLEND_TARGET("sse2") inline __m128
+pixel_screen(__m128 src, __m128 dst, __m128 amount)
+{
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 c = _mm_sub_ps(one, _mm_mul_ps(_mm_sub_ps(one, src), _mm_sub_ps(one, dst)));
+	return pixel_onto(set_a(c, src), dst, amount);
+}
+
+BLEND_TARGET("sse2") inline __m128
+pixel_alpha_over(__m128 src, __m128 dst, __m128 amount)
+{
+	const __m128 a = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.f), splat_a(src)), splat_a(dst));
+	return straight(set_a(dst, a), dst, amount);
+}
+
+BLEND_TARGET("sse2") inline __m128
+pixel_alpha(__m128 src, __m128 dst, __m128 amount)
+	{ return straight(set_a(dst, _mm_mul_ps(src, splat_a(dst))), dst, amount); }
+
+template<__m128 func(__m128, __m128, __m128)>
+BLEND_TARGET("sse2") void
+row_sse2(Color *dst, const Color *src, int count, ColorReal amount)
+{
+	const __m128 k = _mm_set1_ps(amount);
+	float *d = reinterpret_cast<float*>(dst);
+	const float *s = reinterpret_cast<const float*>(src);
+	for(float *end = d + 4*count; d < end; d += 4, s += 4)
+		_mm_storeu_ps(d, func(_mm_loadu_ps(s), _mm_loadu_ps(d), k));
+}
+
+//! Composite with amount 1, opaque pixels of src just replace pixels of dst.
+//! It's the same as full formula for any finite dst.
+BLEND_TARGET("sse2") void
+row_composite_one_sse2(Color *dst, const Color *src, int count, ColorReal)
+{
+	float *d = reinterpret_cast<float*>(dst);
+	const float *s = reinterpret_cast<const float*>(src);
+	for(float *end = d + 4*count; d < end; d += 4, s += 4) {
+		const __m128 c = _mm_loadu_ps(s);
+		if (s[3] == 1.f)
+			_mm_storeu_ps(d, c);
+		else
+			_mm_storeu_ps(d, composite(c, _mm_loadu_ps(d), splat_a(c)));
+	}
+}
+
+Blend::RowFunc
+get_row_func_sse2(Color::BlendMethod method, ColorReal amount)
+{
+	switch(method) {
+	case Color::BLEND_COMPOSITE:
+		return amount == ColorReal(1.0) ? row_composite_one_sse2 : row_sse2<pixel_composite>;
+	case Color::BLEND_STRAIGHT:       return row_sse2<pixel_straight>;
+	case Color::BLEND_ONTO:           return row_sse2<pixel_onto>;
+	case Color::BLEND_STRAIGHT_ONTO:  return row_sse2<pixel_straight_onto>;
+	case Color::BLEND_BEHIND:         return row_sse2<pixel_behind>;
+	case Color::BLEND_ADD:            return row_sse2<pixel_add>;
+	case Color::BLEND_MULTIPLY:       return amount < 0 ? NULL : row_sse2<pixel_multiply>;
+	case Color::BLEND_SCREEN:         return amount < 0 ? NULL : row_sse2<pixel_screen>;
+	case Color::BLEND_ALPHA_OVER:     return row_sse2<pixel_alpha_over>;
+	case Color::BLEND_ALPHA:          return row_sse2<pixel_alpha>;
+	default: break;
+	}
+	return NULL;
+}
+#endif
+
+} // end of anonimous namespace
+
+/* === M E T H O D S ======================================================= */
+
+Blend::RowFunc
+Blend::get_row_func(Color::BlendMethod method, ColorReal amount)
+{
+	// Color::blend() returns dst for zero amount for any method
+	if (std::fabs(amount) <= COLOR_EPSILON)
+		return row_skip;
+
+	#ifdef BLEND_SSE2
+	if (get_pixelformat_simd() >= PF_SIMD_SSE2)
+		if (RowFunc func = get_row_func_sse2(method, amount))
+			return func;
+	#endif
+
+	switch(method) {
+	case Color::BLEND_COMPOSITE:       return row_generic< blendfunc_COMPOSITE<Color> >;
+	case Color::BLEND_STRAIGHT:        return row_generic< blendfunc_STRAIGHT<Color> >;
+	case Color::BLEND_ONTO:            return row_generic< blendfunc_ONTO<Color> >;
+	case Color::BLEND_STRAIGHT_ONTO:   return row_generic< blendfunc_STRAIGHT_ONTO<Color> >;
+	case Color::BLEND_BEHIND:          return row_generic< blendfunc_BEHIND<Color> >;
+	case Color::BLEND_SCREEN:          return row_generic< blendfunc_SCREEN<Color> >;
+	case Color::BLEND_OVERLAY:         return row_generic< blendfunc_OVERLAY<Color> >;
+	case Color::BLEND_HARD_LIGHT:      return row_generic< blendfunc_HARD_LIGHT<Color> >;
+	case Color::BLEND_MULTIPLY:        return row_generic< blendfunc_MULTIPLY<Color> >;
+	case Color::BLEND_DIVIDE:          return row_generic< blendfunc_DIVIDE<Color> >;
+	case Color::BLEND_ADD:             return row_generic< blendfunc_ADD<Color> >;
+	case Color::BLEND_ADD_COMPOSITE:   return row_generic< blendfunc_ADD_COMPOSITE<Color> >;
+	case Color::BLEND_SUBTRACT:        return row_generic< blendfunc_SUBTRACT<Color> >;
+	case Color::BLEND_DIFFERENCE:      return row_generic< blendfunc_DIFFERENCE<Color> >;
+	case Color::BLEND_BRIGHTEN:        return row_generic< blendfunc_BRIGHTEN<Color> >;
+	case Color::BLEND_DARKEN:          return row_generic< blendfunc_DARKEN<Color> >;
+	case Color::BLEND_COLOR:           return row_generic< blendfunc_COLOR<Color> >;
+	case Color::BLEND_HUE:             return row_generic< blendfunc_HUE<Color> >;
+	case Color::BLEND_SATURATION:      return row_generic< blendfunc_SATURATION<Color> >;
+	case Color::BLEND_LUMINANCE:       return row_generic< blendfunc_LUMINANCE<Color> >;
+	case Color::BLEND_ALPHA_BRIGHTEN:  return row_generic< blendfunc_ALPHA_BRIGHTEN<Color> >;
+	case Color::BLEND_ALPHA_DARKEN:    return row_generic< blendfunc_ALPHA_DARKEN<Color> >;
+	case Color::BLEND_ALPHA_OVER:      return row_generic< blendfunc_ALPHA_OVER<Color> >;
+	case Color::BLEND_ALPHA:           return row_generic< blendfunc_ALPHA<Color> >;
+	default: break;
+	}
+
+	assert(false);
+	return row_skip;
+}
+
+/* === E N T R Y P O I N T ================================================= */
@@ -0,0 +1,69 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/function/blend.h
+**	\brief Blend Header
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_SOFTWARE_BLEND_H
+#define __SYNFIG_RENDERING_SOFTWARE_BLEND_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <synfig/color.h>
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+namespace software
+{
+
+//! Row kernels for blending, one kernel for each blend method.
+//! Kernel is selected once for whole surface instead of switch by
+//! blend method for each pixel in Color::blend().
+class Blend
+{
+public:
+	//! Blends count colors: dst[i] = Color::blend(src[i], dst[i], amount, method)
+	typedef void (*RowFunc)(Color *dst, const Color *src, int count, ColorReal amount);
+
+	//! Returns kernel which gives the same results as Color::blend().
+	//! Most common methods are vectorized with SSE2 when available,
+	//! see get_pixelformat_simd(). Never returns null.
+	static RowFunc get_row_func(Color::BlendMethod method, ColorReal amount);
+
+	static void blend_row(Color *dst, const Color *src, int count, ColorReal amount, Color::BlendMethod method)
+		{ get_row_func(method, amount)(dst, src, count, amount); }
+};
+
+} /* end namespace software */
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
@@ -51,6 +51,9 @@ using namespace rendering;
 
 /* === G L O B A L S ======================================================= */
 
+// precision of colors is enough for FFT, and single precision is faster
+typedef std::complex<ColorReal> ColorComplex;
+
 /* === P R O C E D U R E S ================================================= */
 
 /* === M E T H O D S ======================================================= */
@@ -306,30 +309,30 @@ software::Blur::blur_fft(const Params &params)
 	const int channels = 4;
 	int rows = FFT::get_valid_count(params.src_rect.get_size()[1]);
 	int cols = FFT::get_valid_count(params.src_rect.get_size()[0]);
-	vector<Complex> surface(rows*cols*channels);
-	vector<Complex> full_pattern;
-	vector<Complex> row_pattern;
-	vector<Complex> col_pattern;
+	vector<ColorComplex> surface(rows*cols*channels);
+	vector<ColorComplex> full_pattern;
+	vector<ColorComplex> row_pattern;
+	vector<ColorComplex> col_pattern;
 	bool full = false;
 	bool cross = false;
 
-	Array<Real, 4> arr_surface((Real*)&surface.front());
+	Array<ColorReal, 4> arr_surface((ColorReal*)&surface.front());
 
 	arr_surface
 		.set_dim(rows, cols*channels*2)
 		.set_dim(cols, channels*2)
 		.set_dim(channels, 2)
 		.set_dim(2, 1);
-	Array<Real, 3> arr_full_pattern;
+	Array<ColorReal, 3> arr_full_pattern;
 	arr_full_pattern
 		.set_dim(rows, 2*cols)
 		.set_dim(cols, 2)
 		.set_dim(2, 1);
-	Array<Real, 2> arr_row_pattern;
+	Array<ColorReal, 2> arr_row_pattern;
 	arr_row_pattern
 		.set_dim(cols, 2)
 		.set_dim(2, 1);
-	Array<Real, 2> arr_col_pattern;
+	Array<ColorReal, 2> arr_col_pattern;
 	arr_col_pattern
 		.set_dim(rows, 2)
 		.set_dim(2, 1);
@@ -346,12 +349,12 @@ software::Blur::blur_fft(const Params &params)
 	case rendering::Blur::FASTGAUSSIAN:
 		row_pattern.resize(cols);
 		col_pattern.resize(rows);
-		arr_row_pattern.pointer = (Real*)&row_pattern.front();
-		arr_col_pattern.pointer = (Real*)&col_pattern.front();
+		arr_row_pattern.pointer = (ColorReal*)&row_pattern.front();
+		arr_col_pattern.pointer = (ColorReal*)&col_pattern.front();
 		break;
 	case rendering::Blur::DISC:
 		full_pattern.resize(rows*cols);
-		arr_full_pattern.pointer = (Real*)&full_pattern.front();
+		arr_full_pattern.pointer = (ColorReal*)&full_pattern.front();
 		break;
 	default:
 		assert(false);
@@ -362,24 +365,24 @@ software::Blur::blur_fft(const Params &params)
 	switch(params.type)
 	{
 	case rendering::Blur::BOX:
-		BlurTemplates::fill_pattern_box(arr_row_pattern.reorder(0), params.amplified_size[0]);
-		BlurTemplates::fill_pattern_box(arr_col_pattern.reorder(0), params.amplified_size[1]);
+		BlurTemplates::fill_pattern_box(arr_row_pattern.reorder(0), (ColorReal)params.amplified_size[0]);
+		BlurTemplates::fill_pattern_box(arr_col_pattern.reorder(0), (ColorReal)params.amplified_size[1]);
 		break;
 	case rendering::Blur::CROSS:
-		BlurTemplates::fill_pattern_box(arr_row_pattern.reorder(0), params.amplified_size[0]);
-		BlurTemplates::fill_pattern_box(arr_col_pattern.reorder(0), params.amplified_size[1]);
+		BlurTemplates::fill_pattern_box(arr_row_pattern.reorder(0), (ColorReal)params.amplified_size[0]);
+		BlurTemplates::fill_pattern_box(arr_col_pattern.reorder(0), (ColorReal)params.amplified_size[1]);
 		cross = true;
 		break;
 	case rendering::Blur::GAUSSIAN:
 	case rendering::Blur::FASTGAUSSIAN:
-		BlurTemplates::fill_pattern_gauss(arr_row_pattern.reorder(0), params.amplified_size[0]);
-		BlurTemplates::fill_pattern_gauss(arr_col_pattern.reorder(0), params.amplified_size[1]);
+		BlurTemplates::fill_pattern_gauss(arr_row_pattern.reorder(0), (ColorReal)params.amplified_size[0]);
+		BlurTemplates::fill_pattern_gauss(arr_col_pattern.reorder(0), (ColorReal)params.amplified_size[1]);
 		break;
 	case rendering::Blur::DISC:
 		BlurTemplates::fill_pattern_2d_disk(
 			arr_full_pattern.reorder(0, 1),
-			params.amplified_size[0],
-			params.amplified_size[1] );
+			(ColorReal)params.amplified_size[0],
+			(ColorReal)params.amplified_size[1] );
 		full = true;
 		break;
 	default:
@@ -393,11 +396,11 @@ software::Blur::blur_fft(const Params &params)
 		BlurTemplates::mirror_pattern_2d( arr_full_pattern.reorder(0, 1) );
 		BlurTemplates::normalize_full_pattern_2d( arr_full_pattern.reorder(0, 1) );
 
-		FFT::fft2d(arr_full_pattern.group_items<Complex>(), false);
-		for(Array<Complex, 3>::Iterator channel(arr_surface.group_items<Complex>().reorder(2, 0, 1)); channel; ++channel)
+		FFT::fft2d(arr_full_pattern.group_items<ColorComplex>(), false);
+		for(Array<ColorComplex, 3>::Iterator channel(arr_surface.group_items<ColorComplex>().reorder(2, 0, 1)); channel; ++channel)
 		{
 			FFT::fft2d(*channel, false);
-			channel->process< std::multiplies<Complex> >(arr_full_pattern.group_items<Complex>());
+			channel->process< std::multiplies<ColorComplex> >(arr_full_pattern.group_items<ColorComplex>());
 			FFT::fft2d(*channel, true);
 		}
 	}
@@ -408,43 +411,43 @@ software::Blur::blur_fft(const Params &params)
 		BlurTemplates::normalize_full_pattern( arr_row_pattern.reorder(0) );
 		BlurTemplates::normalize_full_pattern( arr_col_pattern.reorder(0) );
 
-		vector<Complex> surface_copy;
-		Array<Complex, 3> arr_surface_rows(arr_surface.group_items<Complex>().reorder(2, 0, 1));
-		Array<Complex, 3> arr_surface_cols(arr_surface_rows.reorder(0, 2, 1));
+		vector<ColorComplex> surface_copy;
+		Array<ColorComplex, 3> arr_surface_rows(arr_surface.group_items<ColorComplex>().reorder(2, 0, 1));
+		Array<ColorComplex, 3> arr_surface_cols(arr_surface_rows.reorder(0, 2, 1));
 
 		if (cross)
 		{
-			arr_row_pattern.reorder(0).process< std::multiplies<Real> >(0.5);
-			arr_col_pattern.reorder(0).process< std::multiplies<Real> >(0.5);
+			arr_row_pattern.reorder(0).process< std::multiplies<ColorReal> >(0.5);
+			arr_col_pattern.reorder(0).process< std::multiplies<ColorReal> >(0.5);
 			surface_copy = surface;
 			arr_surface_cols.pointer = &surface_copy.front();
 		}
 
-		FFT::fft(arr_row_pattern.group_items<Complex>(), false);
-		for(Array<Complex, 3>::Iterator channel(arr_surface_rows); channel; ++channel)
+		FFT::fft(arr_row_pattern.group_items<ColorComplex>(), false);
+		for(Array<ColorComplex, 3>::Iterator channel(arr_surface_rows); channel; ++channel)
 		{
 			FFT::fft2d(*channel, false, true, false);
-			for(Array<Complex, 2>::Iterator r(*channel); r; ++r)
-				r->process< std::multiplies<Complex> >(arr_row_pattern.group_items<Complex>());
+			for(Array<ColorComplex, 2>::Iterator r(*channel); r; ++r)
+				r->process< std::multiplies<ColorComplex> >(arr_row_pattern.group_items<ColorComplex>());
 			FFT::fft2d(*channel, true, true, false);
 		}
 
-		FFT::fft(arr_col_pattern.group_items<Complex>(), false);
-		for(Array<Complex, 3>::Iterator channel(arr_surface_cols); channel; ++channel)
+		FFT::fft(arr_col_pattern.group_items<ColorComplex>(), false);
+		for(Array<ColorComplex, 3>::Iterator channel(arr_surface_cols); channel; ++channel)
 		{
 			FFT::fft2d(*channel, false, true, false);
-			for(Array<Complex, 2>::Iterator c(*channel); c; ++c)
-				c->process< std::multiplies<Complex> >(arr_col_pattern.group_items<Complex>());
+			for(Array<ColorComplex, 2>::Iterator c(*channel); c; ++c)
+				c->process< std::multiplies<ColorComplex> >(arr_col_pattern.group_items<ColorComplex>());
 			FFT::fft2d(*channel, true, true, false);
 		}
 
-		arr_surface_rows.process< BlurTemplates::Abs<Complex> >();
+		arr_surface_rows.process< BlurTemplates::Abs<ColorComplex> >();
 		if (cross)
 		{
-			arr_surface_cols.process< BlurTemplates::Abs<Complex> >();
-			arr_surface_rows.split_items<Real>().reorder(0, 1, 2)
-				.process< std::plus<Real> >(
-					arr_surface_cols.split_items<Real>().reorder(0, 2, 1) );
+			arr_surface_cols.process< BlurTemplates::Abs<ColorComplex> >();
+			arr_surface_rows.split_items<ColorReal>().reorder(0, 1, 2)
+				.process< std::plus<ColorReal> >(
+					arr_surface_cols.split_items<ColorReal>().reorder(0, 2, 1) );
 		}
 	}
 
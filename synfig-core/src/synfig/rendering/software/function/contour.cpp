@@ -29,8 +29,13 @@
 #	include <config.h>
 #endif
 
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
 #include "contour.h"
 
+#include <synfig/general.h>
 #include <synfig/debug/debugsurface.h>
 
 #endif
@@ -42,10 +47,150 @@ using namespace rendering;
 
 /* === G L O B A L S ======================================================= */
 
+namespace {
+	//! Larger windows use sorted marks in auto mode, to keep memory of
+	//! accumulation buffer (4 bytes per pixel) in reasonable limits
+	const long long max_accumulation_pixels = 4*1024*1024;
+}
+
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+software::Contour::Rasterizer
+read_rasterizer()
+{
+	const char *s = getenv("SYNFIG_RENDERING_CONTOUR_RASTERIZER");
+	String name = s ? s : "";
+	if (name == "sorted") return software::Contour::RASTERIZER_SORTED;
+	if (name == "accumulation") return software::Contour::RASTERIZER_ACCUMULATION;
+	if (!name.empty() && name != "auto")
+		warning("Unknown contour rasterizer '%s', used 'auto'", name.c_str());
+	return software::Contour::RASTERIZER_AUTO;
+}
+
+class SpanPen
+{
+private:
+	synfig::Surface::alpha_pen p;
+	synfig::Surface::pen sp;
+	bool simple_fill;
+
+public:
+	SpanPen(synfig::Surface &surface, const Color &color, Color::value_type opacity, Color::BlendMethod blend_method, bool simple_fill):
+		p(surface.begin(), opacity, blend_method),
+		sp(surface.begin()),
+		simple_fill(simple_fill)
+	{
+		p.set_value(color);
+		sp.set_value(color);
+	}
+
+	void put_hline(int x, int y, int length)
+	{
+		if (length <= 0) return;
+		if (simple_fill)
+			{ sp.move_to(x, y); sp.put_hline(length); }
+		else
+			{ p.move_to(x, y); p.put_hline(length); }
+	}
+
+	void put_alpha(int x, int y, int length, Color::value_type alpha)
+	{
+		p.move_to(x, y);
+		for(int i = 0; i < length; ++i, p.inc_x())
+			p.put_value_alpha(alpha);
+	}
+};
+
+void
+render_accumulation(
+	synfig::Surface &target_surface,
+	const Polyspan &polyspan,
+	bool invert,
+	bool antialias,
+	rendering::Contour::WindingStyle winding_style,
+	const Color &color,
+	Color::value_type opacity,
+	Color::BlendMethod blend_method,
+	bool simple_fill )
+{
+	// values closer than this to 0 or 1 are rounding errors of summation
+	const Color::value_type precision = 1e-4;
+
+	SpanPen pen(target_surface, color, opacity, blend_method, simple_fill);
+
+	const RectInt &window = polyspan.get_window();
+	const int width = window.maxx - window.minx;
+	const int height = window.maxy - window.miny;
+	const int stride = polyspan.get_accumulation_stride();
+	const Polyspan::accumulation_array &accumulation = polyspan.get_accumulation();
+	const std::vector<int> &row_begin = polyspan.get_row_begin();
+	const std::vector<int> &row_end = polyspan.get_row_end();
+	if (width <= 0 || height <= 0 || accumulation.empty())
+		return;
+
+	for(int row = 0; row < height; ++row) {
+		const int y = window.miny + row;
+		const int begin = row_begin[row];
+		const int end = std::min(row_end[row], width);
+		if (begin >= end) {
+			if (invert) pen.put_hline(window.minx, y, width);
+			continue;
+		}
+		if (invert) pen.put_hline(window.minx, y, begin);
+
+		// prefix sum of signed area gives coverage of each pixel,
+		// it is not changed by empty cells, so they are drawn by runs
+		const float *cells = &accumulation[(size_t)row*stride];
+		Real sum = 0;
+		for(int x = begin; x < end; ) {
+			sum += cells[x];
+			int next = x + 1;
+			while(next < end && !cells[next]) ++next;
+
+			Color::value_type alpha = (Color::value_type)polyspan.extract_alpha(sum, winding_style);
+			if (invert) alpha = 1 - alpha;
+			if (antialias) {
+				if (alpha < precision) alpha = 0; else
+				if (alpha > 1 - precision) alpha = 1;
+			} else {
+				alpha = alpha >= 0.5 ? 1 : 0;
+			}
+
+			if (alpha == 1)
+				pen.put_hline(window.minx + x, y, next - x);
+			else
+			if (alpha > 0)
+				pen.put_alpha(window.minx + x, y, next - x, alpha);
+			x = next;
+		}
+
+		if (invert) pen.put_hline(window.minx + end, y, width - end);
+	}
+}
+
+} // end of anonimous namespace
+
 /* === M E T H O D S ======================================================= */
 
+software::Contour::Rasterizer
+software::Contour::get_default_rasterizer()
+{
+	static Rasterizer rasterizer = read_rasterizer();
+	return rasterizer;
+}
+
+bool
+software::Contour::use_accumulation(const RectInt &window, Rasterizer rasterizer)
+{
+	if (!window.is_valid())
+		return false;
+	if (rasterizer == RASTERIZER_AUTO)
+		return (long long)window.get_width()*window.get_height() <= max_accumulation_pixels;
+	return rasterizer == RASTERIZER_ACCUMULATION;
+}
+
 void
 software::Contour::render_polyspan(
 	synfig::Surface &target_surface,
@@ -60,6 +205,21 @@ software::Contour::render_polyspan(
 	bool simple_fill = (Color::BLEND_METHODS_OVERWRITE_ON_ALPHA_ONE & (1 << blend_method))
 			        && fabsf(1.f - opacity*color.get_a()) <= 1e-6;
 
+	if (polyspan.is_accumulated())
+	{
+		render_accumulation(
+			target_surface,
+			polyspan,
+			invert,
+			antialias,
+			winding_style,
+			color,
+			opacity,
+			blend_method,
+			simple_fill );
+		return;
+	}
+
 	synfig::Surface::alpha_pen p(target_surface.begin(), opacity, blend_method);
 	synfig::Surface::pen sp(target_surface.begin());
 	const RectInt &window = polyspan.get_window();
@@ -314,7 +474,8 @@ software::Contour::render_contour(
 	Color::BlendMethod blend_method )
 {
 	Polyspan polyspan;
-	polyspan.init(0, 0, target_surface.get_w(), target_surface.get_h());
+	RectInt window(0, 0, target_surface.get_w(), target_surface.get_h());
+	polyspan.init(window, use_accumulation(window));
 	build_polyspan(chunks, transform_matrix, polyspan);
 	polyspan.sort_marks();
 
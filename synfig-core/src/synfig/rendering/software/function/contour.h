@@ -48,6 +48,20 @@ namespace software
 class Contour
 {
 public:
+	enum Rasterizer
+	{
+		RASTERIZER_AUTO,         //!< choose by size of window
+		RASTERIZER_SORTED,       //!< sort list of marks, needs memory only for marks
+		RASTERIZER_ACCUMULATION  //!< sum marks in dense buffer, needs memory for whole window
+	};
+
+	//! Default is RASTERIZER_AUTO, may be changed by
+	//! environment variable SYNFIG_RENDERING_CONTOUR_RASTERIZER ("auto", "sorted" or "accumulation")
+	static Rasterizer get_default_rasterizer();
+
+	//! Returns true if polyspan for window should use accumulation buffer (see Polyspan::init())
+	static bool use_accumulation(const RectInt &window, Rasterizer rasterizer = get_default_rasterizer());
+
 	static void render_polyspan(
 		synfig::Surface &target_surface,
 		const Polyspan &polyspan,
@@ -31,8 +31,11 @@
 
 #include <cassert>
 #include <climits>
+#include <cstdlib>
 //#include <ccomplex>
 
+#include <algorithm>
+#include <map>
 #include <mutex>
 
 #include <vector>
@@ -40,6 +43,8 @@
 
 #include <fftw3.h>
 
+#include <synfig/general.h>
+
 #include "fft.h"
 
 #endif
@@ -53,17 +58,254 @@ using namespace rendering;
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+//! Wrappers for FFTW functions of different precisions
+template<typename T>
+class Fftw { };
+
+template<>
+class Fftw<double>
+{
+public:
+	typedef fftw_plan Plan;
+	typedef fftw_complex Complex;
+
+	static const char* wisdom_suffix()
+		{ return ".double"; }
+	static Plan plan(int rank, const fftw_iodim *dims, int howmany_rank, const fftw_iodim *howmany_dims, Complex *x, int sign, unsigned flags)
+		{ return fftw_plan_guru_dft(rank, dims, howmany_rank, howmany_dims, x, x, sign, flags); }
+	static void execute(Plan plan, Complex *x)
+		{ fftw_execute_dft(plan, x, x); }
+	static void destroy(Plan plan)
+		{ fftw_destroy_plan(plan); }
+	static int alignment_of(Complex *x)
+		{ return fftw_alignment_of((double*)x); }
+	static void* malloc(size_t size)
+		{ return fftw_malloc(size); }
+	static void free(void *x)
+		{ fftw_free(x); }
+	static void set_timelimit(double seconds)
+		{ fftw_set_timelimit(seconds); }
+	static bool import_wisdom(const char *filename)
+		{ return fftw_import_wisdom_from_filename(filename); }
+	static bool export_wisdom(const char *filename)
+		{ return fftw_export_wisdom_to_filename(filename); }
+};
+
+template<>
+class Fftw<float>
+{
+public:
+	typedef fftwf_plan Plan;
+	typedef fftwf_complex Complex;
+
+	static const char* wisdom_suffix()
+		{ return ""; }
+	static Plan plan(int rank, const fftw_iodim *dims, int howmany_rank, const fftw_iodim *howmany_dims, Complex *x, int sign, unsigned flags)
+		{ return fftwf_plan_guru_dft(rank, dims, howmany_rank, howmany_dims, x, x, sign, flags); }
+	static void execute(Plan plan, Complex *x)
+		{ fftwf_execute_dft(plan, x, x); }
+	static void destroy(Plan plan)
+		{ fftwf_destroy_plan(plan); }
+	static int alignment_of(Complex *x)
+		{ return fftwf_alignment_of((float*)x); }
+	static void* malloc(size_t size)
+		{ return fftwf_malloc(size); }
+	static void free(void *x)
+		{ fftwf_free(x); }
+	static void set_timelimit(double seconds)
+		{ fftwf_set_timelimit(seconds); }
+	static bool import_wisdom(const char *filename)
+		{ return fftwf_import_wisdom_from_filename(filename); }
+	static bool export_wisdom(const char *filename)
+		{ return fftwf_export_wisdom_to_filename(filename); }
+};
+
+//! Plan may be reused for arrays with the same layout and alignment
+class PlanKey
+{
+public:
+	enum { MaxDims = 2, Size = 4 + 3*MaxDims };
+	int values[Size];
+
+	PlanKey(int rank, const fftw_iodim *dims, int howmany_rank, const fftw_iodim *howmany_dims, int sign, int alignment)
+	{
+		assert(rank + howmany_rank <= MaxDims);
+		std::fill(values, values + Size, 0);
+		int *v = values;
+		*v++ = rank;
+		*v++ = howmany_rank;
+		*v++ = sign;
+		*v++ = alignment;
+		for(int i = 0; i < rank; ++i)
+			{ *v++ = dims[i].n; *v++ = dims[i].is; *v++ = dims[i].os; }
+		for(int i = 0; i < howmany_rank; ++i)
+			{ *v++ = howmany_dims[i].n; *v++ = howmany_dims[i].is; *v++ = howmany_dims[i].os; }
+	}
+
+	bool operator< (const PlanKey &other) const
+		{ return std::lexicographical_compare(values, values + Size, other.values, other.values + Size); }
+};
+
+} // end of anonimous namespace
+
 /* === M E T H O D S ======================================================= */
 
 class software::FFT::Internal
 {
 public:
+	template<typename T>
+	class Plans: public std::map<PlanKey, typename Fftw<T>::Plan>
+	{
+	public:
+		~Plans() { clear_plans(); }
+		void clear_plans()
+		{
+			for(typename Plans::const_iterator i = this->begin(); i != this->end(); ++i)
+				Fftw<T>::destroy(i->second);
+			this->clear();
+		}
+	};
+
 	static std::set<int> counts;
+
+	//! FFTW planner is not thread-safe, so all plans are created under this mutex,
+	//! execution of existing plans is thread-safe
 	static std::mutex mutex;
+	static Plans<double> plans_double;
+	static Plans<float> plans_float;
+	static String wisdom_filename;
+	static bool wisdom_changed;
+
+	static Plans<double>& plans(double*) { return plans_double; }
+	static Plans<float>& plans(float*) { return plans_float; }
+
+	template<typename T>
+	static void init_wisdom()
+	{
+		if (wisdom_filename.empty()) {
+			Fftw<T>::set_timelimit(0.0);
+			return;
+		}
+		// file may not exist at first run
+		Fftw<T>::import_wisdom((wisdom_filename + Fftw<T>::wisdom_suffix()).c_str());
+	}
+
+	template<typename T>
+	static void save_wisdom()
+	{
+		String filename = wisdom_filename + Fftw<T>::wisdom_suffix();
+		if (!Fftw<T>::export_wisdom(filename.c_str()))
+			synfig::warning("FFT: cannot save FFTW wisdom to file: %s", filename.c_str());
+	}
+
+	template<typename T>
+	static typename Fftw<T>::Plan get_plan(
+		int rank, const fftw_iodim *dims,
+		int howmany_rank, const fftw_iodim *howmany_dims,
+		std::complex<T> *x, bool invert )
+	{
+		typedef typename Fftw<T>::Complex FftwComplex;
+		FftwComplex *data = (FftwComplex*)x;
+		int sign = invert ? FFTW_BACKWARD : FFTW_FORWARD;
+		int alignment = Fftw<T>::alignment_of(data);
+		PlanKey key(rank, dims, howmany_rank, howmany_dims, sign, alignment);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		Plans<T> &p = plans((T*)NULL);
+		typename Plans<T>::const_iterator i = p.find(key);
+		if (i != p.end())
+			return i->second;
+
+		typename Fftw<T>::Plan plan;
+		if (wisdom_filename.empty()) {
+			// estimation does not touch the data
+			plan = Fftw<T>::plan(rank, dims, howmany_rank, howmany_dims, data, sign, FFTW_ESTIMATE);
+		} else {
+			// measurement overwrites the data,
+			// so make plan for temporary array with the same layout and alignment
+			size_t count = 1;
+			for(int j = 0; j < rank; ++j)
+				count += (size_t)(dims[j].n - 1)*std::abs(dims[j].is);
+			for(int j = 0; j < howmany_rank; ++j)
+				count += (size_t)(howmany_dims[j].n - 1)*std::abs(howmany_dims[j].is);
+			char *buffer = (char*)Fftw<T>::malloc(count*sizeof(FftwComplex) + alignment);
+			plan = Fftw<T>::plan(rank, dims, howmany_rank, howmany_dims, (FftwComplex*)(buffer + alignment), sign, FFTW_MEASURE);
+			Fftw<T>::free(buffer);
+			wisdom_changed = true;
+		}
+
+		if (plan)
+			p[key] = plan;
+		else
+			synfig::error("FFT: cannot create FFTW plan");
+		return plan;
+	}
+
+	template<typename T>
+	static void fft(const Array<std::complex<T>, 1> &x, bool invert)
+	{
+		if (x.count == 0 || x.count == 1) return;
+
+		assert(is_valid_count(x.count));
+
+		fftw_iodim iodim;
+		iodim.n  = x.count;
+		iodim.is = x.stride;
+		iodim.os = x.stride;
+
+		typename Fftw<T>::Plan plan = get_plan<T>(1, &iodim, 0, NULL, x.pointer, invert);
+		if (!plan) return;
+		Fftw<T>::execute(plan, (typename Fftw<T>::Complex*)x.pointer);
+
+		// divide by count to complete back-FFT
+		if (invert)
+			x.template process< std::multiplies< std::complex<T> > >( std::complex<T>(T(1.0)/(T)x.count) );
+	}
+
+	template<typename T>
+	static void fft2d(const Array<std::complex<T>, 2> &x, bool invert, bool do_rows, bool do_cols)
+	{
+		if (x.count == 0 || x.sub().count == 0) return;
+		if ( (!do_cols || x.count == 1)
+		  && (!do_rows || x.sub().count == 1) )
+			return;
+
+		assert(is_valid_count(x.count) && is_valid_count(x.sub().count));
+
+		if (!do_rows && !do_cols) return;
+
+		fftw_iodim iodim[2];
+		iodim[0].n  = x.sub().count;
+		iodim[0].is = x.sub().stride;
+		iodim[0].os = x.sub().stride;
+		iodim[1].n  = x.count;
+		iodim[1].is = x.stride;
+		iodim[1].os = x.stride;
+
+		typename Fftw<T>::Plan plan = do_rows && do_cols
+		                            ? get_plan<T>(2, iodim, 0, NULL, x.pointer, invert)
+		                            : get_plan<T>(1, &iodim[do_rows ? 0 : 1], 1, &iodim[do_rows ? 1 : 0], x.pointer, invert);
+		if (!plan) return;
+		Fftw<T>::execute(plan, (typename Fftw<T>::Complex*)x.pointer);
+
+		// divide by count to complete back-FFT
+		if (invert)
+		{
+			int count = (do_cols ? x.count : 1)
+				      * (do_rows ? x.sub().count : 1);
+			x.template process< std::multiplies< std::complex<T> > >( std::complex<T>(T(1.0)/(T)count) );
+		}
+	}
 };
 
 std::set<int> software::FFT::Internal::counts;
 std::mutex software::FFT::Internal::mutex;
+software::FFT::Internal::Plans<double> software::FFT::Internal::plans_double;
+software::FFT::Internal::Plans<float> software::FFT::Internal::plans_float;
+String software::FFT::Internal::wisdom_filename;
+bool software::FFT::Internal::wisdom_changed = false;
 
 void
 software::FFT::initialize()
@@ -77,12 +319,25 @@ software::FFT::initialize()
 			for(int c5 = c3; c5 < max5; c5 *= 5)
 				for(int c7 = c5; c7 < max7; c7 *= 7)
 					Internal::counts.insert(c7);
-	fftw_set_timelimit(0.0);
+
+	std::lock_guard<std::mutex> lock(Internal::mutex);
+	const char *s = getenv("SYNFIG_FFTW_WISDOM");
+	Internal::wisdom_filename = s ? s : "";
+	Internal::wisdom_changed = false;
+	Internal::init_wisdom<double>();
+	Internal::init_wisdom<float>();
 }
 
 void
 software::FFT::deinitialize()
 {
+	std::lock_guard<std::mutex> lock(Internal::mutex);
+	Internal::plans_double.clear_plans();
+	Internal::plans_float.clear_plans();
+	if (!Internal::wisdom_filename.empty() && Internal::wisdom_changed) {
+		Internal::save_wisdom<double>();
+		Internal::save_wisdom<float>();
+	}
 	Internal::counts.clear();
 }
 
@@ -107,80 +362,18 @@ software::FFT::is_valid_count(int x)
 
 void
 software::FFT::fft(const Array<Complex, 1> &x, bool invert)
-{
-	if (x.count == 0 || x.count == 1) return;
-
-	assert(is_valid_count(x.count));
-
-	fftw_iodim iodim;
-	iodim.n  = x.count;
-	iodim.is = x.stride;
-	iodim.os = x.stride;
-
-	{
-		std::lock_guard<std::mutex> lock(Internal::mutex);
-		fftw_plan plan = fftw_plan_guru_dft(
-			1, &iodim, 0, NULL,
-			(fftw_complex*)x.pointer, (fftw_complex*)x.pointer,
-			invert ? FFTW_BACKWARD : FFTW_FORWARD, FFTW_ESTIMATE );
-		fftw_execute(plan);
-		fftw_destroy_plan(plan);
-	}
-
-	// divide by count to complete back-FFT
-	if (invert)
-		x.process< std::multiplies<Complex> >( Complex(1.0/(Real)x.count) );
-}
+	{ Internal::fft(x, invert); }
 
 void
 software::FFT::fft2d(const Array<Complex, 2> &x, bool invert, bool do_rows, bool do_cols)
-{
-	if (x.count == 0 || x.sub().count == 0) return;
-	if ( (!do_cols || x.count == 1)
-	  && (!do_rows || x.sub().count == 1) )
-		return;
-
-	assert(is_valid_count(x.count) && is_valid_count(x.sub().count));
-
-	if (!do_rows && !do_cols) return;
+	{ Internal::fft2d(x, invert, do_rows, do_cols); }
 
-	fftw_iodim iodim[2];
-	iodim[0].n  = x.sub().count;
-	iodim[0].is = x.sub().stride;
-	iodim[0].os = x.sub().stride;
-	iodim[1].n  = x.count;
-	iodim[1].is = x.stride;
-	iodim[1].os = x.stride;
-
-	{
-		std::lock_guard<std::mutex> lock(Internal::mutex);
-
-		fftw_plan plan;
-		if (do_rows && do_cols)
-		{
-			plan = fftw_plan_guru_dft(
-				2, iodim, 0, NULL,
-				(fftw_complex*)x.pointer, (fftw_complex*)x.pointer,
-				invert ? FFTW_BACKWARD : FFTW_FORWARD, FFTW_ESTIMATE );
-		}
-		else
-		{
-			plan = fftw_plan_guru_dft(
-				1, &iodim[do_rows ? 0 : 1], 1, &iodim[do_rows ? 1 : 0],
-				(fftw_complex*)x.pointer, (fftw_complex*)x.pointer,
-				invert ? FFTW_BACKWARD : FFTW_FORWARD, FFTW_ESTIMATE );
-		}
-		fftw_execute(plan);
-		fftw_destroy_plan(plan);
-	}
+void
+software::FFT::fft(const Array<ComplexFloat, 1> &x, bool invert)
+	{ Internal::fft(x, invert); }
 
-	// divide by count to complete back-FFT
-	if (invert)
-	{
-		int count = (do_cols ? x.count : 1)
-			      * (do_rows ? x.sub().count : 1);
-		x.process< std::multiplies<Complex> >( Complex(1.0/(Real)count) );
-	}
-}
+void
+software::FFT::fft2d(const Array<ComplexFloat, 2> &x, bool invert, bool do_rows, bool do_cols)
+	{ Internal::fft2d(x, invert, do_rows, do_cols); }
 
 /* === E N T R Y P O I N T ================================================= */
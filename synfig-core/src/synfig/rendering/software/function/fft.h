@@ -27,6 +27,8 @@
 
 /* === H E A D E R S ======================================================= */
 
+#include <complex>
+
 #include "array.h"
 #include <synfig/complex.h>
 
@@ -43,18 +45,29 @@ namespace rendering
 namespace software
 {
 
+//! Fast Fourier transform, based on FFTW.
+//! FFTW plans are cached by size, strides and alignment of arrays,
+//! and executed outside of mutex, so many transforms may run concurrently.
+//! Set SYNFIG_FFTW_WISDOM environment variable to file name
+//! to measure plans carefully and keep measurements between runs.
 class FFT
 {
 private:
 	class Internal;
 
 public:
+	typedef std::complex<float> ComplexFloat;
+
 	static int get_valid_count(int x);
 	static bool is_valid_count(int x);
 
 	static void fft(const Array<Complex, 1> &x, bool invert);
 	static void fft2d(const Array<Complex, 2> &x, bool invert, bool do_rows = true, bool do_cols = true);
 
+	//! Single precision versions, enough for colors
+	static void fft(const Array<ComplexFloat, 1> &x, bool invert);
+	static void fft2d(const Array<ComplexFloat, 2> &x, bool invert, bool do_rows = true, bool do_cols = true);
+
 	static void initialize();
 	static void deinitialize();
 };
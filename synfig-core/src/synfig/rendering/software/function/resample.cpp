@@ -568,4 +568,53 @@ software::Resample::resample(
 }
 
 
+void
+software::Resample::resample(
+	synfig::Surface &dest,
+	const RectInt &dest_bounds,
+	const SurfaceSW8 &src,
+	const RectInt &src_bounds,
+	const Matrix &transformation,
+	Color::Interpolation interpolation,
+	bool blend,
+	ColorReal blend_amount,
+	Color::BlendMethod blend_method )
+{
+	Helper::Generic<SurfaceSW8::reader, SurfaceSW8::reader_cook>::resample_with_downscale(
+		dest,
+		dest_bounds,
+		&src,
+		src_bounds,
+		transformation,
+		interpolation,
+		blend,
+		blend_amount,
+		blend_method );
+}
+
+void
+software::Resample::resample(
+	synfig::Surface &dest,
+	const RectInt &dest_bounds,
+	const SurfaceSWHalf &src,
+	const RectInt &src_bounds,
+	const Matrix &transformation,
+	Color::Interpolation interpolation,
+	bool blend,
+	ColorReal blend_amount,
+	Color::BlendMethod blend_method )
+{
+	Helper::Generic<SurfaceSWHalf::reader, SurfaceSWHalf::reader_cook>::resample_with_downscale(
+		dest,
+		dest_bounds,
+		&src,
+		src_bounds,
+		transformation,
+		interpolation,
+		blend,
+		blend_amount,
+		blend_method );
+}
+
+
 /* === E N T R Y P O I N T ================================================= */
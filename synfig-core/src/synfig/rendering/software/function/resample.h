@@ -30,6 +30,8 @@
 #include <synfig/rect.h>
 #include <synfig/surface.h>
 
+#include "../surfacesw8.h"
+#include "../surfaceswhalf.h"
 #include "../surfaceswpacked.h"
 
 /* === M A C R O S ========================================================= */
@@ -83,6 +85,28 @@ public:
 		bool blend,
 		ColorReal blend_amount,
 		Color::BlendMethod blend_method );
+
+	static void resample(
+		synfig::Surface &dest,
+		const RectInt &dest_bounds,
+		const SurfaceSW8 &src,
+		const RectInt &src_bounds,
+		const Matrix &transformation,
+		Color::Interpolation interpolation,
+		bool blend,
+		ColorReal blend_amount,
+		Color::BlendMethod blend_method );
+
+	static void resample(
+		synfig::Surface &dest,
+		const RectInt &dest_bounds,
+		const SurfaceSWHalf &src,
+		const RectInt &src_bounds,
+		const Matrix &transformation,
+		Color::Interpolation interpolation,
+		bool blend,
+		ColorReal blend_amount,
+		Color::BlendMethod blend_method );
 };
 
 } /* end namespace software */
@@ -33,6 +33,7 @@
 
 #include "rendererlowressw.h"
 
+#include "surfacesw8.h"
 #include "task/tasksw.h"
 
 #include "../common/optimizer/optimizerblendassociative.h"
@@ -41,6 +42,7 @@
 #include "../common/optimizer/optimizerdraft.h"
 #include "../common/optimizer/optimizerlist.h"
 #include "../common/optimizer/optimizersplit.h"
+#include "../common/optimizer/optimizersurfacestorage.h"
 #include "../common/optimizer/optimizertransformation.h"
 #include "../common/optimizer/optimizerpass.h"
 
@@ -73,6 +75,7 @@ RendererLowResSW::RendererLowResSW(int level):
 	register_optimizer(new OptimizerBlendToTarget());
 	register_optimizer(new OptimizerList());
 	register_optimizer(new OptimizerBlendAssociative());
+	register_optimizer(new OptimizerSurfaceStorage(SurfaceSW8::token.handle()));
 	//register_optimizer(new OptimizerSplit());
 }
 
@@ -33,6 +33,7 @@
 
 #include "rendererpreviewsw.h"
 
+#include "surfaceswhalf.h"
 #include  "task/tasksw.h"
 
 #include "../common/optimizer/optimizerblendassociative.h"
@@ -40,6 +41,7 @@
 #include "../common/optimizer/optimizerblendtotarget.h"
 #include "../common/optimizer/optimizerlist.h"
 #include "../common/optimizer/optimizersplit.h"
+#include "../common/optimizer/optimizersurfacestorage.h"
 #include "../common/optimizer/optimizertransformation.h"
 #include "../common/optimizer/optimizerpass.h"
 #include "../common/optimizer/optimizerdraft.h"
@@ -72,7 +74,8 @@ RendererPreviewSW::RendererPreviewSW()
 	register_optimizer(new OptimizerList());
 	register_optimizer(new OptimizerBlendToTarget());
 	register_optimizer(new OptimizerBlendAssociative());
-	//register_optimizer(new OptimizerSplit());
+	register_optimizer(new OptimizerSurfaceStorage(SurfaceSWHalf::token.handle()));
+	register_optimizer(new OptimizerSplit(get_max_simultaneous_threads()));
 }
 
 String RendererPreviewSW::get_name() const
@@ -42,6 +42,7 @@
 #include "../common/optimizer/optimizersplit.h"
 #include "../common/optimizer/optimizertransformation.h"
 #include "../common/optimizer/optimizerpass.h"
+#include "../common/optimizer/optimizerrendercache.h"
 
 #include "function/fft.h"
 
@@ -64,6 +65,7 @@ RendererSW::RendererSW()
 
 	// register optimizers
 	register_optimizer(new OptimizerTransformation());
+	register_optimizer(new OptimizerRenderCache());
 
 	register_optimizer(new OptimizerPass(false));
 	register_optimizer(new OptimizerPass(true));
@@ -71,7 +73,7 @@ RendererSW::RendererSW()
 	register_optimizer(new OptimizerList());
 	register_optimizer(new OptimizerBlendToTarget());
 	register_optimizer(new OptimizerBlendAssociative());
-	//register_optimizer(new OptimizerSplit());
+	register_optimizer(new OptimizerSplit(get_max_simultaneous_threads()));
 }
 
 RendererSW::~RendererSW() { }
@@ -0,0 +1,101 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/surfacesw8.cpp
+**	\brief SurfaceSW8
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <algorithm>
+
+#include "surfacesw8.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+
+rendering::Surface::Token SurfaceSW8::token(
+	Desc<SurfaceSW8>("SurfaceSW8") );
+
+
+bool
+SurfaceSW8::create_vfunc(int width, int height)
+{
+	pixels.assign((size_t)width*height*PixelSize, 0);
+	return true;
+}
+
+bool
+SurfaceSW8::assign_vfunc(const rendering::Surface &surface)
+{
+	int width = surface.get_width();
+	int height = surface.get_height();
+	pixels.resize((size_t)width*height*PixelSize);
+
+	if (const Color *src = surface.get_pixels_pointer()) {
+		color_to_pixelformat(&pixels.front(), src, pixel_format, NULL, width, height);
+		return true;
+	}
+
+	std::vector<Color> data((size_t)width*height);
+	if (!surface.get_pixels(&data.front()))
+		{ pixels.clear(); return false; }
+	color_to_pixelformat(&pixels.front(), &data.front(), pixel_format, NULL, width, height);
+	return true;
+}
+
+bool
+SurfaceSW8::clear_vfunc()
+{
+	std::fill(pixels.begin(), pixels.end(), 0);
+	return true;
+}
+
+bool
+SurfaceSW8::reset_vfunc()
+{
+	std::vector<unsigned char>().swap(pixels);
+	return true;
+}
+
+bool
+SurfaceSW8::get_pixels_vfunc(Color *buffer) const
+{
+	pixelformat_to_color(buffer, &pixels.front(), pixel_format, get_width(), get_height());
+	return true;
+}
+
+/* === E N T R Y P O I N T ================================================= */
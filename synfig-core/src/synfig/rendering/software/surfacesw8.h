@@ -0,0 +1,123 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/surfacesw8.h
+**	\brief SurfaceSW8 Header
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_SURFACESW8_H
+#define __SYNFIG_RENDERING_SURFACESW8_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <vector>
+
+#include <synfig/surface.h>
+#include <synfig/color/pixelformat.h>
+
+#include "../surface.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+
+//! Compact storage of pixels: alpha-premulted RGBA, 8 bits per channel.
+//! Colors are clamped to [0, 1], so it is intended for previews and 8-bit outputs.
+class SurfaceSW8: public Surface
+{
+public:
+	typedef etl::handle<SurfaceSW8> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const
+		{ return token.handle(); }
+
+	enum { PixelSize = 4 };
+	static const PixelFormat pixel_format = PF_RGB|PF_A_PREMULT;
+
+private:
+	std::vector<unsigned char> pixels;
+
+protected:
+	virtual bool create_vfunc(int width, int height);
+	virtual bool assign_vfunc(const Surface &surface);
+	virtual bool clear_vfunc();
+	virtual bool reset_vfunc();
+	virtual bool get_pixels_vfunc(Color *buffer) const;
+
+public:
+	SurfaceSW8()
+		{ }
+	explicit SurfaceSW8(const Surface &other)
+		{ assign(other); }
+
+	const unsigned char* get_row(int y) const
+		{ return &pixels[(size_t)y*get_width()*PixelSize]; }
+	unsigned char* get_row(int y)
+		{ return &pixels[(size_t)y*get_width()*PixelSize]; }
+
+	static void pack_row(unsigned char *dst, const Color *src, int count)
+		{ color_to_pixelformat(dst, src, pixel_format, NULL, count); }
+	static void unpack_row(Color *dst, const unsigned char *src, int count)
+		{ pixelformat_to_color(dst, src, pixel_format, count); }
+
+	void read_row(Color *dst, int x, int y, int count) const
+		{ unpack_row(dst, get_row(y) + x*PixelSize, count); }
+
+	//! Pixels are stored alpha-premulted, so cooked color needs no multiplications
+	static ColorAccumulator get_cooked(const unsigned char *pixel)
+	{
+		const ColorReal k(1.0/255.0);
+		return ColorAccumulator(k*pixel[0], k*pixel[1], k*pixel[2], k*pixel[3]);
+	}
+	static Color get_color(const unsigned char *pixel)
+		{ return ColorPrep::uncook_static(get_cooked(pixel)); }
+
+	template< etl::clamping::func clamp_x = etl::clamping::clamp,
+			  etl::clamping::func clamp_y = etl::clamping::clamp >
+	inline static Color reader(const void *surf, int x, int y)
+	{
+		const SurfaceSW8 &s = *(const SurfaceSW8*)surf;
+		return clamp_x(x, s.get_width()) && clamp_y(y, s.get_height())
+		     ? get_color(s.get_row(y) + x*PixelSize) : Color();
+	}
+
+	template< etl::clamping::func clamp_x = etl::clamping::clamp,
+			  etl::clamping::func clamp_y = etl::clamping::clamp >
+	inline static ColorAccumulator reader_cook(const void *surf, int x, int y)
+	{
+		const SurfaceSW8 &s = *(const SurfaceSW8*)surf;
+		return clamp_x(x, s.get_width()) && clamp_y(y, s.get_height())
+		     ? get_cooked(s.get_row(y) + x*PixelSize) : ColorAccumulator();
+	}
+};
+
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
@@ -0,0 +1,173 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/surfaceswhalf.cpp
+**	\brief SurfaceSWHalf
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <algorithm>
+
+#include <synfig/color/pixelformat.h>
+
+#include "surfaceswhalf.h"
+
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#	include <immintrin.h>
+#	define SURFACESWHALF_F16C
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+
+#ifdef SURFACESWHALF_F16C
+__attribute__((target("avx,f16c")))
+void
+pack_row_f16c(SurfaceSWHalf::Pixel *dst, const Color *src, int count)
+{
+	// one pixel is four channels, so two pixels per instruction
+	const float *s = (const float*)src;
+	uint16_t *d = (uint16_t*)dst;
+	for(int i = count/2; i; --i, s += 8, d += 8)
+		_mm_storeu_si128((__m128i*)d, _mm256_cvtps_ph(_mm256_loadu_ps(s), _MM_FROUND_TO_NEAREST_INT));
+	if (count & 1)
+		_mm_storel_epi64((__m128i*)d, _mm_cvtps_ph(_mm_loadu_ps(s), _MM_FROUND_TO_NEAREST_INT));
+}
+
+__attribute__((target("avx,f16c")))
+void
+unpack_row_f16c(Color *dst, const SurfaceSWHalf::Pixel *src, int count)
+{
+	const uint16_t *s = (const uint16_t*)src;
+	float *d = (float*)dst;
+	for(int i = count/2; i; --i, s += 8, d += 8)
+		_mm256_storeu_ps(d, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)s)));
+	if (count & 1)
+		_mm_storeu_ps(d, _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)s)));
+}
+
+bool
+f16c_supported()
+{
+	// SYNFIG_DISABLE_SIMD turns off all vectorized pixel conversions
+	static const bool supported = get_pixelformat_simd() != PF_SIMD_NONE
+	                           && __builtin_cpu_supports("avx")
+	                           && __builtin_cpu_supports("f16c");
+	return supported;
+}
+#endif
+
+} // end of anonimous namespace
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+
+rendering::Surface::Token SurfaceSWHalf::token(
+	Desc<SurfaceSWHalf>("SurfaceSWHalf") );
+
+
+void
+SurfaceSWHalf::pack_row(Pixel *dst, const Color *src, int count)
+{
+	#ifdef SURFACESWHALF_F16C
+	if (f16c_supported())
+		{ pack_row_f16c(dst, src, count); return; }
+	#endif
+	for(const Color *end = src + count; src < end; ++src, ++dst)
+		*dst = get_pixel(*src);
+}
+
+void
+SurfaceSWHalf::unpack_row(Color *dst, const Pixel *src, int count)
+{
+	#ifdef SURFACESWHALF_F16C
+	if (f16c_supported())
+		{ unpack_row_f16c(dst, src, count); return; }
+	#endif
+	for(const Pixel *end = src + count; src < end; ++src, ++dst)
+		*dst = get_color(*src);
+}
+
+bool
+SurfaceSWHalf::create_vfunc(int width, int height)
+{
+	Pixel zero = {};
+	pixels.assign((size_t)width*height, zero);
+	return true;
+}
+
+bool
+SurfaceSWHalf::assign_vfunc(const rendering::Surface &surface)
+{
+	int width = surface.get_width();
+	int height = surface.get_height();
+	pixels.resize((size_t)width*height);
+
+	if (const Color *src = surface.get_pixels_pointer()) {
+		pack_row(&pixels.front(), src, (int)pixels.size());
+		return true;
+	}
+
+	std::vector<Color> data(pixels.size());
+	if (!surface.get_pixels(&data.front()))
+		{ pixels.clear(); return false; }
+	pack_row(&pixels.front(), &data.front(), (int)pixels.size());
+	return true;
+}
+
+bool
+SurfaceSWHalf::clear_vfunc()
+{
+	Pixel zero = {};
+	std::fill(pixels.begin(), pixels.end(), zero);
+	return true;
+}
+
+bool
+SurfaceSWHalf::reset_vfunc()
+{
+	std::vector<Pixel>().swap(pixels);
+	return true;
+}
+
+bool
+SurfaceSWHalf::get_pixels_vfunc(Color *buffer) const
+{
+	unpack_row(buffer, &pixels.front(), (int)pixels.size());
+	return true;
+}
+
+/* === E N T R Y P O I N T ================================================= */
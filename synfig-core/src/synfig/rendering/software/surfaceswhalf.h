@@ -0,0 +1,183 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/surfaceswhalf.h
+**	\brief SurfaceSWHalf Header
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_SURFACESWHALF_H
+#define __SYNFIG_RENDERING_SURFACESWHALF_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <cstring>
+#include <vector>
+
+#include <stdint.h>
+
+#include <synfig/surface.h>
+
+#include "../surface.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+
+//! Compact storage of pixels: straight RGBA, IEEE 754 half float per channel.
+//! Keeps colors out of [0, 1] range with 11 bits of precision.
+class SurfaceSWHalf: public Surface
+{
+public:
+	typedef etl::handle<SurfaceSWHalf> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const
+		{ return token.handle(); }
+
+	struct Pixel { uint16_t r, g, b, a; };
+
+private:
+	std::vector<Pixel> pixels;
+
+protected:
+	virtual bool create_vfunc(int width, int height);
+	virtual bool assign_vfunc(const Surface &surface);
+	virtual bool clear_vfunc();
+	virtual bool reset_vfunc();
+	virtual bool get_pixels_vfunc(Color *buffer) const;
+
+public:
+	SurfaceSWHalf()
+		{ }
+	explicit SurfaceSWHalf(const Surface &other)
+		{ assign(other); }
+
+	const Pixel* get_row(int y) const
+		{ return &pixels[(size_t)y*get_width()]; }
+	Pixel* get_row(int y)
+		{ return &pixels[(size_t)y*get_width()]; }
+
+	//! Converts row of pixels, uses F16C instructions when CPU supports them
+	static void pack_row(Pixel *dst, const Color *src, int count);
+	static void unpack_row(Color *dst, const Pixel *src, int count);
+
+	void read_row(Color *dst, int x, int y, int count) const
+		{ unpack_row(dst, get_row(y) + x, count); }
+
+	//! Rounds to nearest even, NaN stays NaN, overflow gives infinity
+	static uint16_t float_to_half(float f)
+	{
+		uint32_t x;
+		memcpy(&x, &f, sizeof(x));
+		uint32_t sign = (x >> 16) & 0x8000u;
+		x &= 0x7fffffffu;
+
+		uint32_t h;
+		if (x >= 0x47800000u) {
+			// infinity or NaN
+			h = x > 0x7f800000u ? 0x7e00u : 0x7c00u;
+		} else
+		if (x < 0x38800000u) {
+			// subnormal or zero, FPU rounds mantissa for us
+			float ff;
+			memcpy(&ff, &x, sizeof(ff));
+			ff += 0.5f;
+			memcpy(&x, &ff, sizeof(x));
+			h = x - 0x3f000000u;
+		} else {
+			// normalized, rebias exponent and round to nearest even
+			x += 0xc8000fffu + ((x >> 13) & 1u);
+			h = x >> 13;
+		}
+		return (uint16_t)(h | sign);
+	}
+
+	static float half_to_float(uint16_t h)
+	{
+		uint32_t x = (uint32_t)(h & 0x7fffu) << 13;
+		uint32_t exponent = x & 0x0f800000u;
+		x += 0x38000000u;
+		if (exponent == 0x0f800000u) {
+			// infinity or NaN
+			x += 0x38000000u;
+		} else
+		if (exponent == 0) {
+			// subnormal or zero
+			x += 0x00800000u;
+			float f;
+			memcpy(&f, &x, sizeof(f));
+			f -= 6.10351562e-05f; // 2^-14
+			memcpy(&x, &f, sizeof(x));
+		}
+		x |= (uint32_t)(h & 0x8000u) << 16;
+		float f;
+		memcpy(&f, &x, sizeof(f));
+		return f;
+	}
+
+	static Pixel get_pixel(const Color &color)
+	{
+		Pixel p = {
+			float_to_half(color.get_r()),
+			float_to_half(color.get_g()),
+			float_to_half(color.get_b()),
+			float_to_half(color.get_a()) };
+		return p;
+	}
+	static Color get_color(const Pixel &pixel)
+	{
+		return Color(
+			half_to_float(pixel.r),
+			half_to_float(pixel.g),
+			half_to_float(pixel.b),
+			half_to_float(pixel.a) );
+	}
+
+	template< etl::clamping::func clamp_x = etl::clamping::clamp,
+			  etl::clamping::func clamp_y = etl::clamping::clamp >
+	inline static Color reader(const void *surf, int x, int y)
+	{
+		const SurfaceSWHalf &s = *(const SurfaceSWHalf*)surf;
+		return clamp_x(x, s.get_width()) && clamp_y(y, s.get_height())
+		     ? get_color(s.get_row(y)[x]) : Color();
+	}
+
+	template< etl::clamping::func clamp_x = etl::clamping::clamp,
+			  etl::clamping::func clamp_y = etl::clamping::clamp >
+	inline static ColorAccumulator reader_cook(const void *surf, int x, int y)
+	{
+		const SurfaceSWHalf &s = *(const SurfaceSWHalf*)surf;
+		return clamp_x(x, s.get_width()) && clamp_y(y, s.get_height())
+		     ? ColorPrep::cook_static(get_color(s.get_row(y)[x])) : ColorAccumulator();
+	}
+};
+
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
@@ -29,13 +29,22 @@
 #	include <config.h>
 #endif
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #include <synfig/general.h>
+#include <synfig/color/colorblendingfunctions.h>
 
 #include <synfig/debug/debugsurface.h>
 
 #include "../../common/task/taskblend.h"
 #include "tasksw.h"
 
+#include "../surfacesw8.h"
+#include "../surfaceswhalf.h"
+#include "../function/blend.h"
+
 #endif
 
 using namespace synfig;
@@ -51,6 +60,118 @@ using namespace rendering;
 
 namespace {
 
+//! Straight blending with amount 1 replaces destination by source,
+//! except of transparent pixels, Color::blend() returns Color::alpha() for them
+inline bool
+is_straight_copy(Color::BlendMethod blend_method, Color::value_type amount)
+	{ return blend_method == Color::BLEND_STRAIGHT && amount == Color::value_type(1); }
+
+void
+fix_straight_copy(Color *dst, int count)
+{
+	for(Color *end = dst + count; dst != end; ++dst)
+		if (std::fabs(dst->get_a()) <= COLOR_EPSILON)
+			*dst = Color::alpha();
+}
+
+//! Reads compact source row by row through small buffer, which stays in cache
+template<typename Type>
+void
+blit_rows(
+	synfig::Surface &dst,
+	const RectInt &r,
+	const Type &src,
+	const VectorInt &offset,
+	bool blend,
+	Color::value_type amount,
+	Color::BlendMethod blend_method )
+{
+	const int w = r.get_width();
+	if (!blend || is_straight_copy(blend_method, amount)) {
+		for(int y = r.miny; y < r.maxy; ++y) {
+			src.read_row(&dst[y][r.minx], r.minx + offset[0], y + offset[1], w);
+			if (blend) fix_straight_copy(&dst[y][r.minx], w);
+		}
+		return;
+	}
+
+	std::vector<Color> row(w);
+	software::Blend::RowFunc func = software::Blend::get_row_func(blend_method, amount);
+	for(int y = r.miny; y < r.maxy; ++y) {
+		src.read_row(&row.front(), r.minx + offset[0], y + offset[1], w);
+		func(&dst[y][r.minx], &row.front(), w, amount);
+	}
+}
+
+//! Blends rows of surface by the kernel selected once for whole rect
+void
+blend_rows(
+	synfig::Surface &dst,
+	const RectInt &r,
+	const synfig::Surface &src,
+	const VectorInt &offset,
+	Color::value_type amount,
+	Color::BlendMethod blend_method )
+{
+	const int w = r.get_width();
+	if (is_straight_copy(blend_method, amount)) {
+		for(int y = r.miny; y < r.maxy; ++y) {
+			const Color *s = &src[y + offset[1]][r.minx + offset[0]];
+			std::copy(s, s + w, &dst[y][r.minx]);
+			fix_straight_copy(&dst[y][r.minx], w);
+		}
+		return;
+	}
+
+	software::Blend::RowFunc func = software::Blend::get_row_func(blend_method, amount);
+	for(int y = r.miny; y < r.maxy; ++y)
+		func(&dst[y][r.minx], &src[y + offset[1]][r.minx + offset[0]], w, amount);
+}
+
+//! Blends transparent color, as if there is empty source
+void
+blend_transparent(
+	synfig::Surface &dst,
+	const RectInt &r,
+	Color::value_type amount,
+	Color::BlendMethod blend_method )
+{
+	const int w = r.get_width();
+	const std::vector<Color> row(w, Color(0, 0, 0, 0));
+	software::Blend::RowFunc func = software::Blend::get_row_func(blend_method, amount);
+	for(int y = r.miny; y < r.maxy; ++y)
+		func(&dst[y][r.minx], &row.front(), w, amount);
+}
+
+//! Returns false if source has no compact surface,
+//! or has float one too (then compact copy is made for other renderer)
+bool
+blit_compact(
+	Task::LockReadBase &lock,
+	synfig::Surface &dst,
+	const RectInt &r,
+	const VectorInt &offset,
+	bool blend,
+	Color::value_type amount,
+	Color::BlendMethod blend_method )
+{
+	if (!lock.get_resource() || lock.get_resource()->has_surface<SurfaceSW>())
+		return false;
+	if (lock.convert<SurfaceSW8>(false)) {
+		SurfaceSW8::Handle src = lock.cast<SurfaceSW8>();
+		if (!src) return false;
+		blit_rows(dst, r, *src, offset, blend, amount, blend_method);
+		return true;
+	}
+	if (lock.convert<SurfaceSWHalf>(false)) {
+		SurfaceSWHalf::Handle src = lock.cast<SurfaceSWHalf>();
+		if (!src) return false;
+		blit_rows(dst, r, *src, offset, blend, amount, blend_method);
+		return true;
+	}
+	return false;
+}
+
 class TaskBlendSW: public TaskBlend,
                    public TaskSW,
                    public TaskInterfaceTargetAsSource
@@ -90,22 +211,26 @@ public:
 				etl::set_intersect(ra, ra, r);
 				if (ra.is_valid() && sub_task_a()->target_surface != target_surface)
 				{
-					LockRead la(sub_task_a());
-					if (!la) return false;
-					synfig::Surface &a = la.cast_handle()->get_surface(); // TODO: make blit_to constant
-
 					assert( 0 <= ra.minx && ra.minx < ra.maxx && ra.maxx <= c.get_w()
 						 && 0 <= ra.miny && ra.miny < ra.maxy && ra.miny <= c.get_h() );
-					assert( 0 <= ra.minx + oa[0] && ra.maxx + oa[0] <= a.get_w()
-						 && 0 <= ra.miny + oa[1] && ra.maxy + oa[1] <= a.get_h() );
-
-					synfig::Surface::pen p = c.get_pen(ra.minx, ra.miny);
-					a.blit_to(
-						p,
-						ra.minx + oa[0],
-						ra.miny + oa[1],
-						ra.maxx - ra.minx,
-						ra.maxy - ra.miny );
+
+					LockReadBase la(sub_task_a());
+					if (!blit_compact(la, c, ra, oa, false, amount, blend_method))
+					{
+						if (!la.convert<TargetSurface>()) return false;
+						synfig::Surface &a = la.cast<TargetSurface>()->get_surface(); // TODO: make blit_to constant
+
+						assert( 0 <= ra.minx + oa[0] && ra.maxx + oa[0] <= a.get_w()
+							 && 0 <= ra.miny + oa[1] && ra.maxy + oa[1] <= a.get_h() );
+
+						synfig::Surface::pen p = c.get_pen(ra.minx, ra.miny);
+						a.blit_to(
+							p,
+							ra.minx + oa[0],
+							ra.miny + oa[1],
+							ra.maxx - ra.minx,
+							ra.maxy - ra.miny );
+					}
 				}
 			}
 		}
@@ -121,24 +246,20 @@ public:
 				etl::set_intersect(rb, rb, r);
 				if (rb.is_valid())
 				{
-					LockRead lb(sub_task_b());
-					if (!lb) return false;
-					synfig::Surface &b = lb.cast_handle()->get_surface(); // TODO: make blit_to constant
-
 					assert( 0 <= rb.minx && rb.minx < rb.maxx && rb.maxx <= c.get_w()
 						 && 0 <= rb.miny && rb.miny < rb.maxy && rb.miny <= c.get_h() );
-					assert( 0 <= rb.minx + ob[0] && rb.maxx + ob[0] <= b.get_w()
-						 && 0 <= rb.miny + ob[1] && rb.maxy + ob[1] <= b.get_h() );
-
-					synfig::Surface::alpha_pen ap(c.get_pen(rb.minx, rb.miny));
-					ap.set_blend_method(blend_method);
-					ap.set_alpha(amount);
-					b.blit_to(
-						ap,
-						rb.minx + ob[0],
-						rb.miny + ob[1],
-						rb.maxx - rb.minx,
-						rb.maxy - rb.miny );
+
+					LockReadBase lb(sub_task_b());
+					if (!blit_compact(lb, c, rb, ob, true, amount, blend_method))
+					{
+						if (!lb.convert<TargetSurface>()) return false;
+						const synfig::Surface &b = lb.cast<TargetSurface>()->get_surface();
+
+						assert( 0 <= rb.minx + ob[0] && rb.maxx + ob[0] <= b.get_w()
+							 && 0 <= rb.miny + ob[1] && rb.maxy + ob[1] <= b.get_h() );
+
+						blend_rows(c, rb, b, ob, amount, blend_method);
+					}
 
 					if (ra.is_valid())
 					{
@@ -163,13 +284,7 @@ public:
 					assert( 0 <= fill[i].minx && fill[i].minx < fill[i].maxx && fill[i].maxx <= c.get_w()
 						 && 0 <= fill[i].miny && fill[i].miny < fill[i].maxy && fill[i].miny <= c.get_h() );
 
-					synfig::Surface::alpha_pen ap(
-						c.get_pen(fill[i].minx, fill[i].miny) );
-					ap.set_blend_method(blend_method);
-					ap.set_alpha(amount);
-					c.fill( Color(0, 0, 0, 0), ap,
-							fill[i].maxx - fill[i].minx,
-							fill[i].maxy - fill[i].miny );
+					blend_transparent(c, fill[i], amount, blend_method);
 				}
 			}
 		}
@@ -29,8 +29,11 @@
 #	include <config.h>
 #endif
 
+#include <memory>
+
 #include <synfig/debug/debugsurface.h>
 
+#include "../../primitive/edgetable.h"
 #include "../../primitive/polyspan.h"
 #include "../../common/task/taskcontour.h"
 #include "../../common/task/taskblend.h"
@@ -61,6 +64,77 @@ public:
 	static Token token;
 	virtual Token::Handle get_token() const { return token.handle(); }
 
+private:
+	//! Segments of contour, shared by the pieces of task which was split into
+	//! bands of rows (see OptimizerSplit), so the contour is transformed only once
+	//! and each piece walks only segments which cross its rows.
+	//! Built by on_split() before the pieces are queued, pieces only read it.
+	class SharedEdges
+	{
+	public:
+		//! target rect of the whole task before splitting
+		RectInt window;
+		const Contour *contour;
+		Matrix matrix;
+		Real detail;
+		EdgeTable table;
+
+		SharedEdges(): contour(), detail() { }
+	};
+
+	std::shared_ptr<const SharedEdges> shared_edges;
+
+	Matrix get_matrix() const {
+		Vector ppu = get_pixels_per_unit();
+
+		Matrix bounds_transfromation;
+		bounds_transfromation.m00 = ppu[0];
+		bounds_transfromation.m11 = ppu[1];
+		bounds_transfromation.m20 = target_rect.minx - ppu[0]*source_rect.minx;
+		bounds_transfromation.m21 = target_rect.miny - ppu[1]*source_rect.miny;
+
+		return bounds_transfromation * transformation->matrix;
+	}
+
+	const EdgeTable* get_shared_edges(const Matrix &matrix) const {
+		if (!shared_edges)
+			return NULL;
+		const SharedEdges &edges = *shared_edges;
+		if ( edges.contour != contour.get()
+		  || !(edges.matrix == matrix)
+		  || edges.detail != detail
+		  || !edges.window.contains(target_rect) )
+		{
+			// task was changed after cloning, so the table is not for it
+			return NULL;
+		}
+		return &edges.table;
+	}
+
+	software::Contour::Rasterizer get_rasterizer() const {
+		switch(rasterizer) {
+			case RASTERIZER_AUTO:         return software::Contour::RASTERIZER_AUTO;
+			case RASTERIZER_SORTED:       return software::Contour::RASTERIZER_SORTED;
+			case RASTERIZER_ACCUMULATION: return software::Contour::RASTERIZER_ACCUMULATION;
+			default: break;
+		}
+		return software::Contour::get_default_rasterizer();
+	}
+
+public:
+	virtual void on_split() {
+		shared_edges.reset();
+		if (!is_valid() || !contour)
+			return;
+		std::shared_ptr<SharedEdges> edges = std::make_shared<SharedEdges>();
+		edges->window = target_rect;
+		edges->contour = contour.get();
+		edges->matrix = get_matrix();
+		edges->detail = detail;
+		edges->table.build(contour->get_chunks(), edges->matrix, edges->window, detail);
+		shared_edges = edges;
+	}
+
 	virtual void on_target_set_as_source() {
 		Task::Handle &subtask = sub_task(0);
 		if ( subtask
@@ -82,20 +156,17 @@ public:
 		if (!contour)
 			return false;
 
-		Vector ppu = get_pixels_per_unit();
-
-		Matrix bounds_transfromation;
-		bounds_transfromation.m00 = ppu[0];
-		bounds_transfromation.m11 = ppu[1];
-		bounds_transfromation.m20 = target_rect.minx - ppu[0]*source_rect.minx;
-		bounds_transfromation.m21 = target_rect.miny - ppu[1]*source_rect.miny;
-
-		Matrix matrix = bounds_transfromation * transformation->matrix;
+		Matrix matrix = get_matrix();
 
 		Polyspan polyspan;
-		polyspan.init(target_rect);
-		software::Contour::build_polyspan(contour->get_chunks(), matrix, polyspan, detail);
-		polyspan.close();
+		polyspan.init(target_rect, software::Contour::use_accumulation(target_rect, get_rasterizer()));
+		const EdgeTable *edges = get_shared_edges(matrix);
+		if (edges) {
+			edges->rasterize(polyspan);
+		} else {
+			software::Contour::build_polyspan(contour->get_chunks(), matrix, polyspan, detail);
+			polyspan.close();
+		}
 		polyspan.sort_marks();
 
 		LockWrite la(this);
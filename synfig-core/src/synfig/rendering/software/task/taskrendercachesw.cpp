@@ -0,0 +1,99 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/task/taskrendercachesw.cpp
+**	\brief TaskRenderCacheSW
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cstring>
+
+#include <synfig/general.h>
+
+#include "../../common/task/taskrendercache.h"
+#include "tasksw.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+namespace {
+
+class TaskRenderCacheSW: public TaskRenderCache, public TaskSW
+{
+public:
+	typedef etl::handle<TaskRenderCacheSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	virtual bool run(RunParams&) const {
+		if (!is_valid() || !sub_task() || !sub_task()->is_valid())
+			return true;
+
+		LockRead lsrc(sub_task());
+		if (!lsrc) return false;
+		const synfig::Surface &src = lsrc->get_surface();
+
+		RectInt rd = target_rect;
+		VectorInt offset = get_offset();
+		RectInt rs = sub_task()->target_rect + rd.get_min() + offset;
+		etl::set_intersect(rs, rs, rd);
+		if (rs.is_valid())
+		{
+			LockWrite ldst(this);
+			if (!ldst) return false;
+			synfig::Surface &dst = ldst->get_surface();
+
+			for(int y = rs.miny; y < rs.maxy; ++y)
+				memcpy(
+					&dst[y][rs.minx],
+					&src[y - rd.miny - offset[1]][rs.minx - rd.minx - offset[0]],
+					rs.get_width()*sizeof(Color) );
+		}
+
+		if (cache)
+			cache->store(key, sub_task()->target_surface->get_size(), sub_task()->target_rect, src);
+
+		return true;
+	}
+};
+
+
+Task::Token TaskRenderCacheSW::token(
+	DescReal<TaskRenderCacheSW, TaskRenderCache>("RenderCacheSW") );
+
+} // end of anonimous namespace
+
+/* === E N T R Y P O I N T ================================================= */
@@ -38,6 +38,8 @@
 #include "../../common/task/taskpixelprocessor.h"
 #include "tasksw.h"
 
+#include "../surfacesw8.h"
+#include "../surfaceswhalf.h"
 #include "../surfaceswpacked.h"
 #include "../function/resample.h"
 
@@ -100,6 +102,9 @@ public:
 
 		// resample
 		LockReadBase lsrc(sub_task());
+		// compact copies of shared source are made by preview renderers,
+		// read them only when there is no float surface
+		const bool compact = lsrc.get_resource() && !lsrc.get_resource()->has_surface<TargetSurface>();
 		if (lsrc.convert<SurfaceSWPacked>(false)) {
 			SurfaceSWPacked::Handle src = lsrc.cast<SurfaceSWPacked>();
 			if (!src) return false;
@@ -114,6 +119,34 @@ public:
 				amount,
 				blend_method );
 		} else
+		if (compact && lsrc.convert<SurfaceSW8>(false)) {
+			SurfaceSW8::Handle src = lsrc.cast<SurfaceSW8>();
+			if (!src) return false;
+			software::Resample::resample(
+				ldst->get_surface(),
+				target_rect,
+				*src,
+				sub_task()->target_rect,
+				matrix,
+				interpolation,
+				blend,
+				amount,
+				blend_method );
+		} else
+		if (compact && lsrc.convert<SurfaceSWHalf>(false)) {
+			SurfaceSWHalf::Handle src = lsrc.cast<SurfaceSWHalf>();
+			if (!src) return false;
+			software::Resample::resample(
+				ldst->get_surface(),
+				target_rect,
+				*src,
+				sub_task()->target_rect,
+				matrix,
+				interpolation,
+				blend,
+				amount,
+				blend_method );
+		} else
 		if (lsrc.convert<TargetSurface>()) {
 			TargetSurface::Handle src = lsrc.cast<TargetSurface>();
 			if (!src) return false;
@@ -472,6 +472,10 @@ class TaskInterfaceSplit
 public:
 	virtual bool is_splittable() const
 		{ return true; }
+	//! Called by OptimizerSplit for the copy of task which is cloned into strips,
+	//! so task may prepare data shared by all strips
+	virtual void on_split()
+		{ }
 	virtual ~TaskInterfaceSplit() { }
 };
 
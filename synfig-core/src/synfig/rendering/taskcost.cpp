@@ -0,0 +1,226 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/taskcost.cpp
+**	\brief TaskCost
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <synfig/general.h>
+
+#include "taskcost.h"
+#include "task.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+
+struct Entry {
+	Real pixel_cost;
+	long long count;
+	Entry(): pixel_cost(TaskCost::default_pixel_cost), count() { }
+};
+
+typedef std::map<String, Entry> EntryMap;
+
+//! Measures of task type not merged into entries yet
+struct Sample {
+	Real pixel_cost_sum;
+	long long count;
+	Sample(): pixel_cost_sum(), count() { }
+};
+
+typedef std::map<Task::Token::Handle, Sample> SampleMap;
+
+//! Tasks smaller than this are mostly overhead of queue and don't tell anything about pixels
+const int min_measured_pixels = 1024;
+//! Older measures are forgotten slowly, so estimations follow changes of scene
+const long long max_count = 16;
+
+//! Measures of one thread. Threads of RenderQueue add them without waiting
+//! for each other, and they are merged into entries when costs are read.
+class Bucket {
+public:
+	//! locked by the owner thread and by merge() only
+	std::mutex mutex;
+	SampleMap samples;
+
+	Bucket();
+	~Bucket();
+};
+
+std::mutex mutex;
+EntryMap entries;
+std::vector<Bucket*> buckets;
+//! Some of buckets may have samples
+std::atomic<bool> pending(false);
+String filename;
+bool changed = false;
+
+thread_local Bucket bucket;
+
+//! Applies samples to entries, mutex should be locked
+void
+apply(SampleMap &samples)
+{
+	for(SampleMap::const_iterator i = samples.begin(); i != samples.end(); ++i) {
+		Entry &entry = entries[i->first->name];
+		// the same as adding of each sample, as if they all were equal to their mean
+		long long count = std::min(entry.count + i->second.count, max_count);
+		Real weight = std::min(1.0, (Real)i->second.count/(Real)count);
+		entry.pixel_cost += (i->second.pixel_cost_sum/(Real)i->second.count - entry.pixel_cost)*weight;
+		entry.count = count;
+		changed = true;
+	}
+	samples.clear();
+}
+
+//! Moves samples of all threads into entries, mutex should be locked
+void
+merge()
+{
+	if (!pending.exchange(false))
+		return;
+	for(std::vector<Bucket*>::const_iterator i = buckets.begin(); i != buckets.end(); ++i) {
+		SampleMap samples;
+		{
+			std::lock_guard<std::mutex> lock((*i)->mutex);
+			samples.swap((*i)->samples);
+		}
+		apply(samples);
+	}
+}
+
+Bucket::Bucket()
+{
+	std::lock_guard<std::mutex> lock(::mutex);
+	buckets.push_back(this);
+}
+
+Bucket::~Bucket()
+{
+	std::lock_guard<std::mutex> lock(::mutex);
+	buckets.erase(std::remove(buckets.begin(), buckets.end(), this), buckets.end());
+	apply(samples);
+}
+
+} // end of anonimous namespace
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+const Real TaskCost::default_pixel_cost = 2e-8;
+
+void
+TaskCost::add(const Task &task, Real seconds)
+{
+	if (!task.target_rect.is_valid()) return;
+	long long pixels = (long long)task.target_rect.get_width()*task.target_rect.get_height();
+	if (pixels < min_measured_pixels) return;
+
+	{
+		// nobody but merge() waits for this lock
+		std::lock_guard<std::mutex> lock(bucket.mutex);
+		Sample &sample = bucket.samples[task.get_token()];
+		sample.pixel_cost_sum += seconds/(Real)pixels;
+		++sample.count;
+	}
+	// don't write into shared cache line when it's not needed
+	if (!pending.load(std::memory_order_relaxed))
+		pending.store(true);
+}
+
+Real
+TaskCost::get_pixel_cost(const String &task_name)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	merge();
+	EntryMap::const_iterator i = entries.find(task_name);
+	return i == entries.end() ? default_pixel_cost : i->second.pixel_cost;
+}
+
+Real
+TaskCost::estimate(const Task &task)
+{
+	if (!task.target_rect.is_valid()) return 0.0;
+	Real pixels = (Real)task.target_rect.get_width()*(Real)task.target_rect.get_height();
+	return pixels*get_pixel_cost(task.get_token()->name);
+}
+
+void
+TaskCost::initialize()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	const char *s = getenv("SYNFIG_RENDERING_TASK_COSTS");
+	filename = s ? s : "";
+	if (filename.empty()) return;
+
+	std::ifstream stream(filename.c_str());
+	String name;
+	Entry entry;
+	while(stream >> name >> entry.pixel_cost >> entry.count)
+		if (entry.pixel_cost > 0.0 && entry.count > 0) {
+			entry.count = std::min(entry.count, max_count);
+			entries[name] = entry;
+		}
+	changed = false;
+}
+
+void
+TaskCost::deinitialize()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	merge();
+	if (!filename.empty() && changed) {
+		std::ofstream stream(filename.c_str());
+		stream.precision(6);
+		for(EntryMap::const_iterator i = entries.begin(); i != entries.end(); ++i)
+			stream << i->first << " " << i->second.pixel_cost << " " << i->second.count << std::endl;
+		if (!stream)
+			warning("TaskCost: cannot write file '%s'", filename.c_str());
+	}
+	entries.clear();
+	filename.clear();
+	changed = false;
+}
+
+/* === E N T R Y P O I N T ================================================= */
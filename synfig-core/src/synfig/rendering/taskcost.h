@@ -0,0 +1,75 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/taskcost.h
+**	\brief TaskCost Header
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_TASKCOST_H
+#define __SYNFIG_RENDERING_TASKCOST_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <synfig/real.h>
+#include <synfig/string.h>
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+
+class Task;
+
+//! Estimates run time of tasks by timings of already finished tasks of the same type.
+//! Time of task is assumed proportional to area of its target rect.
+//! Costs may be loaded from file and saved back on exit, file name is given by
+//! environment variable SYNFIG_RENDERING_TASK_COSTS, so one calibration render
+//! seeds the estimations of next runs.
+class TaskCost
+{
+public:
+	//! Cost of pixel for task types which was never measured, in seconds
+	static const Real default_pixel_cost;
+
+	//! Adds measured time of task run, called by RenderQueue for each task
+	static void add(const Task &task, Real seconds);
+
+	//! Estimated time of task run in seconds
+	static Real estimate(const Task &task);
+
+	//! Estimated time of one pixel of task type in seconds
+	static Real get_pixel_cost(const String &task_name);
+
+	static void initialize();
+	static void deinitialize();
+};
+
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
@@ -51,6 +51,7 @@
 #include "time.h"
 #include "keyframe.h"
 #include "layer.h"
+#include "layers/layer_pastecanvas.h"
 #include "string.h"
 #include "paramdesc.h"
 #include "weightedvalue.h"
@@ -881,6 +882,21 @@ xmlpp::Element* encode_layer(xmlpp::Element* root,Layer::ConstHandle layer)
 		else  // Handle normal parameters
 		if(iter->get_critical())
 		{
+			// canvas of other file which is not loaded yet, keep its reference
+			if (iter->get_name() == "canvas")
+			{
+				etl::handle<const Layer_PasteCanvas> paste = etl::handle<const Layer_PasteCanvas>::cast_dynamic(layer);
+				if (paste && !paste->get_sub_canvas_id().empty())
+				{
+					xmlpp::Element *node=root->add_child("param");
+					node->set_attribute("name",iter->get_name());
+					node->set_attribute("use",paste->get_sub_canvas_id());
+					if (paste->get_sub_canvas_static())
+						node->set_attribute("static", "true");
+					continue;
+				}
+			}
+
 			ValueBase value=layer->get_param(iter->get_name());
 			if(!value.is_valid())
 			{
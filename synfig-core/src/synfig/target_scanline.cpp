@@ -31,6 +31,11 @@
 #	include <config.h>
 #endif
 
+#include <algorithm>
+#include <deque>
+
+#include <sigc++/bind.h>
+
 #include "target_scanline.h"
 
 #include "general.h"
@@ -41,6 +46,8 @@
 #include "render.h"
 #include "string.h"
 #include "surface.h"
+#include "threadpool.h"
+#include "debug/trace.h"
 #include "rendering/renderer.h"
 #include "rendering/surface.h"
 #include "rendering/software/surfacesw.h"
@@ -57,24 +64,133 @@ using namespace rendering;
 
 /* === M A C R O S ========================================================= */
 
-#define PIXEL_RENDERING_LIMIT 1500000
+//! Default limit of frame buffer, frames up to 4K UHD are rendered whole,
+//! so common batch resolutions are not split and may be rendered in parallel
+#define DEFAULT_MAX_FRAME_MEMORY (3840ll*2160ll*(long long)sizeof(Color))
 
-#define USE_PIXELRENDERING_LIMIT 1
+//! Default number of frames which may wait for writing in background
+#define DEFAULT_WRITE_QUEUE_SIZE 2
 
 /* === G L O B A L S ======================================================= */
 
 /* === P R O C E D U R E S ================================================= */
 
+static rendering::Task::Handle
+prepare_renderer_task(
+	rendering::Task::Handle task,
+	const etl::handle<rendering::SurfaceResource> &surface,
+	const RendDesc &renddesc )
+{
+	Vector p0 = renddesc.get_tl();
+	Vector p1 = renddesc.get_br();
+	if (p0[0] > p1[0] || p0[1] > p1[1]) {
+		Matrix m;
+		if (p0[0] > p1[0]) { m.m00 = -1.0; m.m20 = p0[0] + p1[0]; std::swap(p0[0], p1[0]); }
+		if (p0[1] > p1[1]) { m.m11 = -1.0; m.m21 = p0[1] + p1[1]; std::swap(p0[1], p1[1]); }
+		TaskTransformationAffine::Handle t = new TaskTransformationAffine();
+		t->transformation->matrix = m;
+		t->sub_task() = task;
+		task = t;
+	}
+
+	task->target_surface = surface;
+	task->target_rect = RectInt( VectorInt(), surface->get_size() );
+	task->source_rect = Rect(p0, p1);
+	return task;
+}
+
 /* === M E T H O D S ======================================================= */
 
 Target_Scanline::Target_Scanline():
-	threads_(2)
+	threads_(2),
+	parallel_frames_(1),
+	max_frame_memory_(DEFAULT_MAX_FRAME_MEMORY),
+	write_queue_size_(DEFAULT_WRITE_QUEUE_SIZE),
+	writes_pending_(0),
+	writes_memory_(0),
+	write_failed_(false),
+	split_to_bands_(false)
 {
 	curr_frame_=0;
 	if (const char *s = getenv("SYNFIG_TARGET_DEFAULT_ENGINE"))
 		set_engine(s);
 }
 
+Target_Scanline::~Target_Scanline()
+	{ wait_frame_writes(); }
+
+void
+Target_Scanline::run_write(sigc::slot<bool> write, size_t size)
+{
+	bool success = false;
+	try {
+		debug::Trace::Scope trace("target", "encode frame");
+		success = write();
+	} catch(...) {
+		synfig::error("Target_Scanline: exception while writing frame");
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(write_mutex_);
+		--writes_pending_;
+		writes_memory_ -= size;
+		if (!success) write_failed_ = true;
+	}
+	write_cond_.notify_all();
+}
+
+bool
+Target_Scanline::can_write_frame_async(size_t size) const
+{
+	return write_queue_size_ > 0
+	    && !split_to_bands_
+	    && (long long)size <= max_frame_memory_;
+}
+
+bool
+Target_Scanline::write_frame_async(const sigc::slot<bool> &write, size_t size)
+{
+	if (write_queue_size_ <= 0)
+	{
+		debug::Trace::Scope trace("target", "encode frame");
+		if (!write())
+			write_failed_ = true;
+		return !write_failed_;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(write_mutex_);
+		// let the thread pool run writes while this thread waits,
+		// buffers of queued frames are limited like the frame memory
+		while( writes_pending_ >= write_queue_size_
+		   || (writes_pending_ > 0 && (long long)(writes_memory_ + size) > max_frame_memory_) )
+			ThreadPool::instance().wait(write_cond_, lock);
+		if (write_failed_)
+			return false;
+		++writes_pending_;
+		writes_memory_ += size;
+	}
+	ThreadPool::instance().enqueue(
+		sigc::bind(sigc::mem_fun(*this, &Target_Scanline::run_write), write, size) );
+	return true;
+}
+
+bool
+Target_Scanline::wait_frame_writes()
+{
+	std::unique_lock<std::mutex> lock(write_mutex_);
+	while(writes_pending_ > 0)
+		ThreadPool::instance().wait(write_cond_, lock);
+	return !write_failed_;
+}
+
+void
+Target_Scanline::set_write_failed()
+{
+	std::lock_guard<std::mutex> lock(write_mutex_);
+	write_failed_ = true;
+}
+
 int
 Target_Scanline::next_frame(Time& time)
 {
@@ -97,33 +213,199 @@ synfig::Target_Scanline::call_renderer(
 		if (!renderer)
 			throw "Renderer '" + get_engine() + "' not found";
 
-		Vector p0 = renddesc.get_tl();
-		Vector p1 = renddesc.get_br();
-		if (p0[0] > p1[0] || p0[1] > p1[1]) {
-			Matrix m;
-			if (p0[0] > p1[0]) { m.m00 = -1.0; m.m20 = p0[0] + p1[0]; std::swap(p0[0], p1[0]); }
-			if (p0[1] > p1[1]) { m.m11 = -1.0; m.m21 = p0[1] + p1[1]; std::swap(p0[1], p1[1]); }
-			TaskTransformationAffine::Handle t = new TaskTransformationAffine();
-			t->transformation->matrix = m;
-			t->sub_task() = task;
-			task = t;
-		}
-
-		task->target_surface = surface;
-		task->target_rect = RectInt( VectorInt(), surface->get_size() );
-		task->source_rect = Rect(p0, p1);
-
 		rendering::Task::List list;
-		list.push_back(task);
+		list.push_back(prepare_renderer_task(task, surface, renddesc));
 		renderer->run(list);
 	}
 	return true;
 }
 
+bool
+synfig::Target_Scanline::render_parallel_frames(ProgressCallback *cb, const ContextParams &context_params, int total_frames)
+{
+	struct Frame {
+		SurfaceResource::Handle surface;
+		TaskEvent::Handle event;
+		bool is_snapshot;
+	};
+
+	rendering::Renderer::Handle renderer = rendering::Renderer::get_renderer(get_engine());
+	if (!renderer)
+		throw "Renderer '" + get_engine() + "' not found";
+
+	std::deque<Frame> frames_in_flight;
+	// frames with legacy layers which read the live canvas while rendering
+	int live_frames = 0;
+	int frames = total_frames;
+	int frames_done = 0;
+	Time t = 0;
+	bool success = true;
+
+	while(success && (frames || !frames_in_flight.empty()))
+	{
+		// build snapshots of next frames while previous ones are rendering,
+		// the canvas can't change its time until the live frames are finished
+		while(frames && !live_frames && (int)frames_in_flight.size() < parallel_frames_)
+		{
+			frames = next_frame(t);
+
+			debug::Trace::Scope trace;
+			if (debug::Trace::is_enabled())
+				trace.start("frame", "build frame " + t.get_string(desc.get_frame_rate()));
+
+			Frame frame;
+			frame.surface = new SurfaceResource();
+			frame.surface->create(desc.get_w(), desc.get_h());
+			frame.event = new TaskEvent();
+
+			rendering::Task::Handle task = canvas->build_rendering_task_snapshot(
+				context_params, t, desc.get_outline_grow(), !get_avoid_time_sync(), frame.is_snapshot );
+			if (!frame.is_snapshot)
+				++live_frames;
+			if (task)
+				renderer->enqueue(prepare_renderer_task(task, frame.surface, desc), frame.event);
+			else
+				frame.event->finish(true);
+			frames_in_flight.push_back(frame);
+		}
+
+		// put the oldest frame onto the target
+		Frame frame = frames_in_flight.front();
+		frames_in_flight.pop_front();
+		frame.event->wait();
+		if (!frame.is_snapshot)
+			--live_frames;
+
+		// If we have a callback, and it returns
+		// false, go ahead and bail. (it may be a user cancel)
+		if (cb && !cb->amount_complete(frames_done, total_frames))
+			{ success = false; break; }
+
+		if (!frame.event->is_done())
+		{
+			if (cb) cb->error(_("Accelerated Renderer Failure"));
+			success = false;
+			break;
+		}
+
+		SurfaceResource::LockRead<SurfaceSW> lock(frame.surface);
+		if (!lock)
+		{
+			if (cb) cb->error(_("Bad surface"));
+			success = false;
+			break;
+		}
+
+		if (!add_frame(&lock->get_surface(), cb))
+		{
+			if (cb) cb->error(_("Unable to put surface on target"));
+			success = false;
+			break;
+		}
+		++frames_done;
+	}
+
+	for(std::deque<Frame>::const_iterator i = frames_in_flight.begin(); i != frames_in_flight.end(); ++i)
+		rendering::Renderer::cancel(i->event);
+	return success;
+}
+
+bool
+synfig::Target_Scanline::render_frame_bands(ProgressCallback *cb, const ContextParams &context_params, bool band_progress)
+{
+	struct Band {
+		SurfaceResource::Handle surface;
+		TaskEvent::Handle event;
+		int top;
+		int height;
+	};
+
+	rendering::Renderer::Handle renderer = rendering::Renderer::get_renderer(get_engine());
+	if (!renderer)
+		throw "Renderer '" + get_engine() + "' not found";
+
+	// two bands are alive at once: one is rendering while the previous one is written
+	int w = desc.get_w();
+	int h = desc.get_h();
+	long long row_memory = (long long)w*sizeof(Color);
+	int band_height = (int)std::max(1ll, std::min((long long)h, max_frame_memory_/(2*row_memory)));
+	int band_count = (h + band_height - 1)/band_height;
+
+	synfig::info("Render split to %d band%s %d pixels tall", band_count, band_count == 1 ? "" : "s", band_height);
+
+	if(!start_frame(cb))
+	{
+		if(cb)
+			cb->error(_("add_frame(): target panic on start_frame()"));
+		return false;
+	}
+
+	std::deque<Band> bands_in_flight;
+	int next_top = 0;
+	bool success = true;
+
+	while(success && (next_top < h || !bands_in_flight.empty()))
+	{
+		while(next_top < h && bands_in_flight.size() < 2)
+		{
+			Band band;
+			band.top = next_top;
+			band.height = std::min(band_height, h - next_top);
+			next_top += band.height;
+
+			RendDesc band_desc = desc;
+			band_desc.set_subwindow(0, band.top, w, band.height);
+
+			band.surface = new SurfaceResource();
+			band.surface->create(w, band.height);
+			band.event = new TaskEvent();
+
+			rendering::Task::Handle task = canvas->build_rendering_task(context_params);
+			if (task)
+				renderer->enqueue(prepare_renderer_task(task, band.surface, band_desc), band.event);
+			else
+				band.event->finish(true);
+			bands_in_flight.push_back(band);
+		}
+
+		Band band = bands_in_flight.front();
+		bands_in_flight.pop_front();
+		band.event->wait();
+
+		if (!band.event->is_done())
+		{
+			if (cb) cb->error(_("Accelerated Renderer Failure"));
+			success = false;
+			break;
+		}
+
+		SurfaceResource::LockRead<SurfaceSW> lock(band.surface);
+		if (!lock)
+		{
+			if (cb) cb->error(_("Bad surface"));
+			success = false;
+			break;
+		}
+
+		debug::Trace::Scope trace("target", "write band");
+		if (!put_scanlines(lock->get_surface(), band.top, cb))
+			{ success = false; break; }
+
+		if (band_progress && cb && !cb->amount_complete(band.top + band.height, h))
+			{ success = false; break; }
+	}
+
+	for(std::deque<Band>::const_iterator i = bands_in_flight.begin(); i != bands_in_flight.end(); ++i)
+		rendering::Renderer::cancel(i->event);
+
+	if (success)
+		end_frame();
+	return success;
+}
+
 bool
 synfig::Target_Scanline::render(ProgressCallback *cb)
 {
-	SuperCallback super_cb;
 	int
 		frames=0,
 		total_frames,
@@ -135,6 +417,10 @@ synfig::Target_Scanline::render(ProgressCallback *cb)
 	assert(canvas);
 	curr_frame_=0;
 
+	// forget errors of the previous render
+	wait_frame_writes();
+	write_failed_=false;
+
 	if( !init() ){
 		if(cb) cb->error(_("Target initialization failure"));
 		return false;
@@ -149,173 +435,41 @@ synfig::Target_Scanline::render(ProgressCallback *cb)
 	total_frames=frame_end-frame_start+1;
 	if(total_frames<=0)total_frames=1;
 
+	// Frames larger than the memory limit are rendered by bands
+	bool split_to_bands = (long long)desc.get_w()*desc.get_h()*(long long)sizeof(Color) > max_frame_memory_;
+	split_to_bands_ = split_to_bands;
+
 	try {
 
-	//synfig::info("1time_set_to %s",t.get_string().c_str());
+	if (parallel_frames_ > 1 && total_frames > 1 && split_to_bands)
+		synfig::warning("Target_Scanline: frame %dx%d doesn't fit into %lld MB of frame memory, it is rendered by bands and frames are not rendered in parallel",
+			desc.get_w(), desc.get_h(), max_frame_memory_/(1024*1024));
 
-	if(total_frames>=1)
+	if (parallel_frames_ > 1 && total_frames > 1 && !split_to_bands)
 	{
-		do{
-			// Grab the time
-			frames=next_frame(t);
+		if (!render_parallel_frames(cb, context_params, total_frames))
+			return false;
+		if (!wait_frame_writes())
+		{
+			if (cb) cb->error(_("Unable to write frame"));
+			return false;
+		}
+		return true;
+	}
 
-			// If we have a callback, and it returns
-			// false, go ahead and bail. (it may be a user cancel)
-			if(cb && !cb->amount_complete(total_frames-frames,total_frames))
-				return false;
+	do{
+		// Grab the time
+		frames=next_frame(t);
+
+		debug::Trace::Scope trace;
+		if (debug::Trace::is_enabled())
+			trace.start("frame", "frame " + t.get_string(desc.get_frame_rate()));
+
+		// If we have a callback, and it returns
+		// false, go ahead and bail. (it may be a user cancel)
+		if(cb && !cb->amount_complete(total_frames-frames,total_frames))
+			return false;
 
-			// Set the time that we wish to render
-			if(!get_avoid_time_sync() || canvas->get_time()!=t) {
-				canvas->set_time(t);
-				canvas->load_resources(t);
-			}
-			canvas->set_outline_grow(desc.get_outline_grow());
-
-			// If quality is set otherwise, then we use the accelerated renderer
-			{
-				#if USE_PIXELRENDERING_LIMIT
-				if(desc.get_w()*desc.get_h() > PIXEL_RENDERING_LIMIT)
-				{
-					SurfaceResource::Handle surface = new SurfaceResource();
-
-					int rowheight = PIXEL_RENDERING_LIMIT/desc.get_w();
-					if (!rowheight) rowheight = 1; // TODO: render partial lines to stay within the limit?
-					int rows = desc.get_h()/rowheight;
-					int lastrowheight = desc.get_h() - rows*rowheight;
-
-					rows++;
-
-					synfig::info("Render split to %d block%s %d pixels tall, and a final block %d pixels tall",
-								 rows-1, rows==2?"":"s", rowheight, lastrowheight);
-
-					// loop through all the full rows
-					if(!start_frame())
-					{
-//						throw(string("add_frame(): target panic on start_frame()"));
-						if(cb)
-							cb->error(_("add_frame(): target panic on start_frame()"));
-						return false;
-					}
-
-					for(int i=0; i < rows; ++i)
-					{
-						surface->reset();
-						RendDesc blockrd = desc;
-
-						//render the strip at the normal size unless it's the last one...
-						if(i == rows-1)
-						{
-							if(!lastrowheight) break;
-							blockrd.set_subwindow(0,i*rowheight,desc.get_w(),lastrowheight);
-						}
-						else
-						{
-							blockrd.set_subwindow(0,i*rowheight,desc.get_w(),rowheight);
-						}
-
-						//synfig::info( " -- block %d/%d left, top, width, height: %d, %d, %d, %d",
-						//	i+1, rows, 0, i*rowheight, blockrd.get_w(), blockrd.get_h() );
-
-						if (!call_renderer(surface, *canvas, context_params, blockrd))
-						{
-							if(cb)cb->error(_("Accelerated Renderer Failure"));
-							return false;
-						} else {
-							SurfaceResource::LockRead<SurfaceSW> lock(surface);
-							if (!lock) {
-								if(cb)cb->error(_("Accelerated Renderer Failure: cannot read surface"));
-								return false;
-							}
-
-							const synfig::Surface &s = lock->get_surface();
-
-							int y;
-							int rowspan=sizeof(Color)*s.get_w();
-							Surface::const_pen pen = s.begin();
-
-							int yoff = i*rowheight;
-
-							for(y = 0; y < blockrd.get_h(); y++, pen.inc_y())
-							{
-								Color *colordata= start_scanline(y + yoff);
-								if(!colordata)
-								{
-//									throw(string("add_frame(): call to start_scanline(y) returned NULL"));
-									if(cb)
-										cb->error(_("add_frame(): call to start_scanline(y) returned NULL"));
-									return false;
-								}
-
-								switch(get_alpha_mode())
-								{
-									case TARGET_ALPHA_MODE_FILL:
-										for(int i = 0; i < s.get_w(); i++)
-											colordata[i] = Color::blend(s[y][i], desc.get_bg_color(), 1.0f);
-										break;
-									case TARGET_ALPHA_MODE_EXTRACT:
-										for(int i = 0; i < s.get_w(); i++)
-										{
-											float a=s[y][i].get_a();
-											colordata[i] = Color(a,a,a,a);
-										}
-										break;
-									case TARGET_ALPHA_MODE_REDUCE:
-										for(int i = 0; i < s.get_w(); i++)
-											colordata[i] = Color(s[y][i].get_r(), s[y][i].get_g(), s[y][i].get_b(), 1.f);
-										break;
-									case TARGET_ALPHA_MODE_KEEP:
-										memcpy(colordata, s[y], rowspan);
-										break;
-								}
-
-								if(!end_scanline())
-								{
-//									throw(string("add_frame(): target panic on end_scanline()"));
-									if(cb)
-										cb->error(_("add_frame(): target panic on end_scanline()"));
-									return false;
-								}
-							}
-						}
-					}
-					surface->reset();
-
-					end_frame();
-
-				}else //use normal rendering...
-				{
-				#endif
-					SurfaceResource::Handle surface = new SurfaceResource();
-
-					if (!call_renderer(surface, *canvas, context_params, desc))
-					{
-						// For some reason, the accelerated renderer failed.
-						if(cb)cb->error(_("Accelerated Renderer Failure"));
-						return false;
-					}
-
-					SurfaceResource::LockRead<SurfaceSW> lock(surface);
-					if(!lock)
-					{
-						if(cb)cb->error(_("Bad surface"));
-						return false;
-					}
-
-					// Put the surface we renderer
-					// onto the target.
-					if(!add_frame(&lock->get_surface(), cb))
-					{
-						if(cb)cb->error(_("Unable to put surface on target"));
-						return false;
-					}
-				#if USE_PIXELRENDERING_LIMIT
-				}
-				#endif
-			}
-		}while(frames);
-	}
-    else
-    {
 		// Set the time that we wish to render
 		if(!get_avoid_time_sync() || canvas->get_time()!=t) {
 			canvas->set_time(t);
@@ -323,153 +477,43 @@ synfig::Target_Scanline::render(ProgressCallback *cb)
 		}
 		canvas->set_outline_grow(desc.get_outline_grow());
 
-		// If quality is set otherwise, then we use the accelerated renderer
+		if (split_to_bands)
 		{
-			#if USE_PIXELRENDERING_LIMIT
-			if(desc.get_w()*desc.get_h() > PIXEL_RENDERING_LIMIT)
-			{
-				SurfaceResource::Handle surface(new SurfaceResource());
-
-				int totalheight = desc.get_h();
-				int rowheight = PIXEL_RENDERING_LIMIT/desc.get_w();
-				if (!rowheight) rowheight = 1; // TODO: render partial lines to stay within the limit?
-				int rows = desc.get_h()/rowheight;
-				int lastrowheight = desc.get_h() - rows*rowheight;
-
-				rows++;
-
-				synfig::info("Render split to %d block%s %d pixels tall, and a final block %d pixels tall",
-							 rows-1, rows==2?"":"s", rowheight, lastrowheight);
-
-				// loop through all the full rows
-				if(!start_frame())
-				{
-//					throw(string("add_frame(): target panic on start_frame()"));
-					if(cb)
-						cb->error(_("add_frame(): target panic on start_frame()"));
-					return false;
-				}
-
-				for(int i=0; i < rows; ++i)
-				{
-					surface->reset();
-					RendDesc blockrd = desc;
-
-					//render the strip at the normal size unless it's the last one...
-					if(i == rows-1)
-					{
-						if(!lastrowheight) break;
-						blockrd.set_subwindow(0,i*rowheight,desc.get_w(),lastrowheight);
-					}
-					else
-					{
-						blockrd.set_subwindow(0,i*rowheight,desc.get_w(),rowheight);
-					}
-
-					//synfig::info( " -- block %d/%d left, top, width, height: %d, %d, %d, %d",
-					//	i+1, rows, 0, i*rowheight, blockrd.get_w(), blockrd.get_h() );
-
-					if (!call_renderer(surface, *canvas, context_params, blockrd))
-					{
-						if(cb)cb->error(_("Accelerated Renderer Failure"));
-						return false;
-					}
-
-					SurfaceResource::LockRead<SurfaceSW> lock(surface);
-
-					if(!lock)
-					{
-						if(cb)cb->error(_("Bad surface"));
-						return false;
-					}
-
-					const synfig::Surface &s = lock->get_surface();
-
-					int y;
-					int rowspan=sizeof(Color)*s.get_w();
-					Surface::const_pen pen = s.begin();
-
-					int yoff = i*rowheight;
-
-					for(y = 0; y < blockrd.get_h(); y++, pen.inc_y())
-					{
-						Color *colordata= start_scanline(y + yoff);
-						if(!colordata)
-						{
-//							throw(string("add_frame(): call to start_scanline(y) returned NULL"));
-							if(cb)
-								cb->error(_("add_frame(): call to start_scanline(y) returned NULL"));
-							return false;
-						}
-
-						switch(get_alpha_mode())
-						{
-							case TARGET_ALPHA_MODE_FILL:
-								for(int i = 0; i < s.get_w(); i++)
-									colordata[i] = Color::blend(s[y][i], desc.get_bg_color(), 1.0f);
-								break;
-							case TARGET_ALPHA_MODE_EXTRACT:
-								for(int i = 0; i < s.get_w(); i++)
-								{
-									float a=s[y][i].get_a();
-									colordata[i] = Color(a,a,a,a);
-								}
-								break;
-							case TARGET_ALPHA_MODE_REDUCE:
-								for(int i = 0; i < s.get_w(); i++)
-									colordata[i] = Color(s[y][i].get_r(), s[y][i].get_g(), s[y][i].get_b(), 1.0f);
-								break;
-							case TARGET_ALPHA_MODE_KEEP:
-								memcpy(colordata,s[y], rowspan);
-								break;
-						}
-
-						if(!end_scanline())
-						{
-//							throw(string("add_frame(): target panic on end_scanline()"));
-							if(cb)
-								cb->error(_("add_frame(): target panic on end_scanline()"));
-							return false;
-						}
-					}
-
-					//I'm done with this part
-					if (cb) cb->amount_complete((i+1)*rowheight, totalheight);
-				}
-				surface->reset();
-
-				end_frame();
-
-			}else
-			{
-			#endif
-				SurfaceResource::Handle surface = new SurfaceResource();
+			// report progress of bands when there is only one frame
+			if (!render_frame_bands(cb, context_params, total_frames == 1))
+				return false;
+			continue;
+		}
 
-				if (!call_renderer(surface, *canvas, context_params, desc))
-				{
-					if(cb)cb->error(_("Accelerated Renderer Failure"));
-					return false;
-				}
+		SurfaceResource::Handle surface = new SurfaceResource();
 
-				SurfaceResource::LockRead<SurfaceSW> lock(surface);
+		if (!call_renderer(surface, *canvas, context_params, desc))
+		{
+			// For some reason, the accelerated renderer failed.
+			if(cb)cb->error(_("Accelerated Renderer Failure"));
+			return false;
+		}
 
-				if(!lock)
-				{
-					if(cb)cb->error(_("Bad surface"));
-					return false;
-				}
+		SurfaceResource::LockRead<SurfaceSW> lock(surface);
+		if(!lock)
+		{
+			if(cb)cb->error(_("Bad surface"));
+			return false;
+		}
 
-				// Put the surface we renderer
-				// onto the target.
-				if(!add_frame(&lock->get_surface(), cb))
-				{
-					if(cb)cb->error(_("Unable to put surface on target"));
-					return false;
-				}
-			#if USE_PIXELRENDERING_LIMIT
-			}
-			#endif
+		// Put the surface we renderer
+		// onto the target.
+		if(!add_frame(&lock->get_surface(), cb))
+		{
+			if(cb)cb->error(_("Unable to put surface on target"));
+			return false;
 		}
+	}while(frames);
+
+	if (!wait_frame_writes())
+	{
+		if (cb) cb->error(_("Unable to write frame"));
+		return false;
 	}
 
 	}
@@ -492,26 +536,13 @@ synfig::Target_Scanline::render(ProgressCallback *cb)
 }
 
 bool
-Target_Scanline::add_frame(const synfig::Surface *surface, ProgressCallback *cb)
+Target_Scanline::put_scanlines(const synfig::Surface &surface, int first_scanline, ProgressCallback *cb)
 {
-	assert(surface);
-
-
-	int y;
-	int rowspan=sizeof(Color)*surface->get_w();
-	Surface::const_pen pen=surface->begin();
+	int rowspan=sizeof(Color)*surface.get_w();
 
-	if(!start_frame(cb))
+	for(int y=0;y<surface.get_h();y++)
 	{
-//		throw(string("add_frame(): target panic on start_frame()"));
-		if (cb)
-			cb->error(_("add_frame(): target panic on start_frame()"));
-		return false;
-	}
-
-	for(y=0;y<surface->get_h();y++,pen.inc_y())
-	{
-		Color *colordata= start_scanline(y);
+		Color *colordata= start_scanline(first_scanline + y);
 		if(!colordata)
 		{
 //			throw(string("add_frame(): call to start_scanline(y) returned NULL"));
@@ -523,22 +554,22 @@ Target_Scanline::add_frame(const synfig::Surface *surface, ProgressCallback *cb)
 		switch(get_alpha_mode())
 		{
 			case TARGET_ALPHA_MODE_FILL:
-				for(int i=0;i<surface->get_w();i++)
-					colordata[i]=Color::blend((*surface)[y][i],desc.get_bg_color(),1.0f);
+				for(int i=0;i<surface.get_w();i++)
+					colordata[i]=Color::blend(surface[y][i],desc.get_bg_color(),1.0f);
 				break;
 			case TARGET_ALPHA_MODE_EXTRACT:
-				for(int i=0;i<surface->get_w();i++)
+				for(int i=0;i<surface.get_w();i++)
 				{
-					float a=(*surface)[y][i].get_a();
+					float a=surface[y][i].get_a();
 					colordata[i] = Color(a,a,a,a);
 				}
 				break;
 			case TARGET_ALPHA_MODE_REDUCE:
-				for(int i = 0; i < surface->get_w(); i++)
-					colordata[i] = Color((*surface)[y][i].get_r(),(*surface)[y][i].get_g(),(*surface)[y][i].get_b(),1.0f);
+				for(int i = 0; i < surface.get_w(); i++)
+					colordata[i] = Color(surface[y][i].get_r(),surface[y][i].get_g(),surface[y][i].get_b(),1.0f);
 				break;
 			case TARGET_ALPHA_MODE_KEEP:
-				memcpy(colordata,(*surface)[y],rowspan);
+				memcpy(colordata,surface[y],rowspan);
 				break;
 		}
 
@@ -551,6 +582,27 @@ Target_Scanline::add_frame(const synfig::Surface *surface, ProgressCallback *cb)
 		}
 	}
 
+	return true;
+}
+
+bool
+Target_Scanline::add_frame(const synfig::Surface *surface, ProgressCallback *cb)
+{
+	assert(surface);
+
+	debug::Trace::Scope trace("target", "write frame");
+
+	if(!start_frame(cb))
+	{
+//		throw(string("add_frame(): target panic on start_frame()"));
+		if (cb)
+			cb->error(_("add_frame(): target panic on start_frame()"));
+		return false;
+	}
+
+	if(!put_scanlines(*surface, 0, cb))
+		return false;
+
 	end_frame();
 
 	return true;
@@ -28,6 +28,11 @@
 
 /* === H E A D E R S ======================================================= */
 
+#include <condition_variable>
+#include <mutex>
+
+#include <sigc++/slot.h>
+
 #include "target.h"
 
 /* === M A C R O S ========================================================= */
@@ -49,20 +54,77 @@ class Target_Scanline : public Target
 	//! Number of threads to use
 	int threads_;
 
+	//! Number of frames which may be rendered simultaneously
+	int parallel_frames_;
+
+	//! Maximum size of frame buffer in bytes,
+	//! larger frames are rendered and put onto the target by horizontal bands
+	long long max_frame_memory_;
+
 	String engine_;
 
+	//! Number of finished frames which may wait for writing in background,
+	//! zero means that frames are written synchronously
+	int write_queue_size_;
+
+	std::mutex write_mutex_;
+	std::condition_variable write_cond_;
+	//! Number of frames passed to the thread pool but not written yet
+	int writes_pending_;
+	//! Size of buffers of frames passed to the thread pool but not written yet
+	size_t writes_memory_;
+	bool write_failed_;
+
+	//! Frame is larger than max_frame_memory_ and it is rendered by bands
+	bool split_to_bands_;
+
+	void run_write(sigc::slot<bool> write, size_t size);
+
 	bool call_renderer(
 		const etl::handle<rendering::SurfaceResource> &surface,
 		Canvas &canvas,
 		const ContextParams &context_params,
 		const RendDesc &renddesc );
 
+	//! Renders frame snapshots concurrently and puts them onto the target in order
+	bool render_parallel_frames(ProgressCallback *cb, const ContextParams &context_params, int total_frames);
+
+	//! Renders current frame by bands and puts each band onto the target when it is ready
+	bool render_frame_bands(ProgressCallback *cb, const ContextParams &context_params, bool band_progress);
+
+	//! Puts rows of the surface onto the target starting from the given scanline
+	bool put_scanlines(const synfig::Surface &surface, int first_scanline, ProgressCallback *cb);
+
+protected:
+	//! Checks if the target may convert the whole frame into own buffer of \a size bytes
+	//! and pass it to write_frame_async(). Frames rendered by bands and frames with
+	//! buffers larger than max frame memory should be written row by row instead.
+	bool can_write_frame_async(size_t size) const;
+
+	//! Passes compression and writing of the finished frame to the thread pool,
+	//! so it runs while the next frame renders. Waits while the write queue is full
+	//! or buffers of the queued frames (\a size bytes for this one) exceed max frame memory.
+	//! The slot must own all data it needs, target continues with the next frames.
+	//! When write queue size is zero, the slot is called immediately.
+	/*! \return \c false if this or one of the previous writes has failed */
+	bool write_frame_async(const sigc::slot<bool> &write, size_t size);
+
+	//! Waits until all frames passed to write_frame_async() are written
+	/*! \return \c false if one of the writes has failed */
+	bool wait_frame_writes();
+
+	//! Marks the frame as not written, for targets which write frames by own means
+	//! in end_frame() and can't return the error from it, render() will report it
+	void set_write_failed();
+
 public:
 	typedef etl::handle<Target_Scanline> Handle;
 	typedef etl::loose_handle<Target_Scanline> LooseHandle;
 	typedef etl::handle<const Target_Scanline> ConstHandle;
 	//! Default constructor (threads = 2 current frame = 0)
 	Target_Scanline();
+	//! Waits for the frames which are still being written
+	virtual ~Target_Scanline();
 
 	//! Renders the canvas to the target
 	virtual bool render(ProgressCallback *cb=NULL);
@@ -102,6 +164,18 @@ public:
 	void set_threads(int x) { threads_=x; }
 	//! Gets the number of threads
 	int get_threads()const { return threads_; }
+	//! Sets the number of frames which may be rendered simultaneously
+	void set_parallel_frames(int x) { parallel_frames_=x; }
+	//! Gets the number of frames which may be rendered simultaneously
+	int get_parallel_frames()const { return parallel_frames_; }
+	//! Sets maximum size of frame buffer in bytes
+	void set_max_frame_memory(long long x) { max_frame_memory_=x; }
+	//! Gets maximum size of frame buffer in bytes
+	long long get_max_frame_memory()const { return max_frame_memory_; }
+	//! Sets the number of finished frames which may wait for writing in background
+	void set_write_queue_size(int x) { write_queue_size_=x; }
+	//! Gets the number of finished frames which may wait for writing in background
+	int get_write_queue_size()const { return write_queue_size_; }
 	//! Gets engine
 	const String& get_engine()const { return engine_; }
 	//! Sets engine
@@ -48,6 +48,7 @@
 #include "surface.h"
 
 #include "debug/measure.h"
+#include "debug/trace.h"
 
 #include "rendering/renderer.h"
 #include "rendering/surface.h"
@@ -274,6 +275,7 @@ synfig::Target_Tile::async_render_tile(
 	}
 
 	// Add the tile to the target
+	debug::Trace::Scope trace("target", "write tile");
 	if (!add_tile(s, rect.minx, rect.miny))
 	{
 		if(cb)cb->error(_("add_tile(): Unable to put surface on target"));
@@ -329,6 +331,10 @@ synfig::Target_Tile::render(ProgressCallback *cb)
 				// Grab the time
 				frames=next_frame(t);
 
+				debug::Trace::Scope trace;
+				if (debug::Trace::is_enabled())
+					trace.start("frame", "frame " + t.get_string(desc.get_frame_rate()));
+
 				curr_tile_=0;
 
 				// If we have a callback, and it returns
@@ -37,6 +37,7 @@
 #include "canvas.h"
 #include "layer.h"
 #include <algorithm>
+#include <atomic>
 
 #endif
 
@@ -52,6 +53,16 @@ using namespace synfig;
 
 static int value_node_count(0);
 
+namespace {
+	//! incremented by every change of ValueNode, caches with other generation are outdated
+	std::atomic<long long> evaluation_generation(0);
+	std::atomic<bool> evaluation_cache_enabled(true);
+	std::atomic<long long> evaluation_hits(0);
+	std::atomic<long long> evaluation_misses(0);
+	std::atomic<long long> evaluation_invalidations(0);
+	thread_local ValueNode::EvaluationCache *current_evaluation_cache = nullptr;
+} // end of anonimous namespace
+
 /* === P R O C E D U R E S ================================================= */
 
 ValueNode::LooseHandle
@@ -68,11 +79,110 @@ ValueNode::breakpoint()
 	return;
 }
 
+ValueNode::EvaluationCache::EvaluationCache():
+	active(!current_evaluation_cache && evaluation_cache_enabled),
+	generation(evaluation_generation)
+{
+	if (active)
+		current_evaluation_cache = this;
+}
+
+ValueNode::EvaluationCache::~EvaluationCache()
+{
+	if (!active)
+		return;
+	current_evaluation_cache = nullptr;
+	evaluation_hits += stats.hits;
+	evaluation_misses += stats.misses;
+	evaluation_invalidations += stats.invalidations;
+}
+
+ValueNode::EvaluationCache*
+ValueNode::EvaluationCache::current()
+	{ return current_evaluation_cache; }
+
+void
+ValueNode::EvaluationCache::check_generation()
+{
+	long long g = evaluation_generation;
+	if (generation == g)
+		return;
+	if (!values.empty())
+		++stats.invalidations;
+	values.clear();
+	generation = g;
+}
+
+const ValueBase*
+ValueNode::EvaluationCache::find(const void *node, Time t, int slot)
+{
+	check_generation();
+	Map::const_iterator i = values.find(Key(node, (Real)t, slot));
+	if (i == values.end())
+		return nullptr;
+	++stats.hits;
+	return &i->second;
+}
+
+void
+ValueNode::EvaluationCache::store(const void *node, Time t, int slot, const ValueBase &value)
+{
+	check_generation();
+	values[Key(node, (Real)t, slot)] = value;
+	++stats.misses;
+}
+
+void
+ValueNode::EvaluationCache::invalidate()
+	{ ++evaluation_generation; }
+
+void
+ValueNode::EvaluationCache::set_enabled(bool x)
+	{ evaluation_cache_enabled = x; }
+
+bool
+ValueNode::EvaluationCache::get_enabled()
+	{ return evaluation_cache_enabled; }
+
+ValueNode::EvaluationCache::Statistics
+ValueNode::EvaluationCache::get_statistics()
+{
+	Statistics stats;
+	stats.hits = evaluation_hits;
+	stats.misses = evaluation_misses;
+	stats.invalidations = evaluation_invalidations;
+	return stats;
+}
+
+void
+ValueNode::EvaluationCache::reset_statistics()
+{
+	evaluation_hits = 0;
+	evaluation_misses = 0;
+	evaluation_invalidations = 0;
+}
+
 ValueNode::ValueNode(Type &type):type(&type)
 {
 	value_node_count++;
 }
 
+ValueBase
+ValueNode::get_value(Time t, bool always_cache)const
+{
+	// node with single parent is evaluated once anyway,
+	// caching of it costs more than evaluation
+	EvaluationCache *cache = EvaluationCache::current();
+	if (!cache || (!always_cache && parent_set.size() < 2 && !is_exported()))
+		return (*this)(t);
+
+	if (const ValueBase *value = cache->find(this, t))
+		return *value;
+	ValueBase value = (*this)(t);
+	cache->store(this, t, EvaluationCache::SLOT_VALUE, value);
+	return value;
+}
+
 bool
 LinkableValueNode::set_link(int i,ValueNode::Handle x)
 {
@@ -130,6 +240,9 @@ ValueNode::~ValueNode()
 {
 	value_node_count--;
 
+	// cache may have the values of other node at the same address later
+	EvaluationCache::invalidate();
+
 	begin_delete();
 }
 
@@ -139,6 +252,8 @@ ValueNode::on_changed()
 	if (getenv("SYNFIG_DEBUG_ON_CHANGED"))
 		printf("%s:%d ValueNode::on_changed()\n", __FILE__, __LINE__);
 
+	EvaluationCache::invalidate();
+
 	etl::loose_handle<Canvas> parent_canvas = get_parent_canvas();
 	if(parent_canvas)
 		do						// signal to all the ancestor canvases
@@ -110,6 +110,77 @@ public:
 
 	static void breakpoint();
 
+	//! Memoizes values of nodes evaluated by the current thread at the same time.
+	//! The first cache created in a thread becomes active until it is destroyed,
+	//! caches created while it is active do nothing, so IndependentContext::set_time()
+	//! evaluates each shared node of the whole tree of layers only once.
+	//! Any change of any ValueNode clears the caches.
+	class EvaluationCache
+	{
+	public:
+		//! Kinds of memoized values of the node
+		enum Slot
+		{
+			SLOT_VALUE = 0,       //!< value returned by operator()(Time)
+			SLOT_BONE_MATRIX = 1  //!< see ValueNode_Bone::get_own_animated_matrix()
+		};
+
+		struct Statistics
+		{
+			long long hits;          //!< evaluations saved
+			long long misses;        //!< evaluations stored into cache
+			long long invalidations; //!< caches cleared by changes of nodes
+			Statistics(): hits(), misses(), invalidations() { }
+		};
+
+	private:
+		struct Key
+		{
+			const void *node;
+			Real time;
+			int slot;
+			Key(const void *node, Real time, int slot): node(node), time(time), slot(slot) { }
+			bool operator<(const Key &other) const
+			{
+				if (node != other.node) return node < other.node;
+				if (slot != other.slot) return slot < other.slot;
+				return time < other.time;
+			}
+		};
+
+		typedef std::map<Key, ValueBase> Map;
+
+		bool active;
+		long long generation;
+		Statistics stats;
+		Map values;
+
+		void check_generation();
+
+	public:
+		EvaluationCache();
+		~EvaluationCache();
+
+		EvaluationCache(const EvaluationCache&) = delete;
+		EvaluationCache& operator=(const EvaluationCache&) = delete;
+
+		//! Returns active cache of the current thread, or null
+		static EvaluationCache* current();
+
+		//! Returns memoized value, or null
+		const ValueBase* find(const void *node, Time t, int slot = SLOT_VALUE);
+		void store(const void *node, Time t, int slot, const ValueBase &value);
+
+		//! Clears all caches, called when any ValueNode is changed or deleted
+		static void invalidate();
+
+		static void set_enabled(bool x);
+		static bool get_enabled();
+
+		static Statistics get_statistics();
+		static void reset_statistics();
+	};
+
 	/*
  --	** -- D A T A -------------------------------------------------------------
 	*/
@@ -196,6 +267,12 @@ public:
 	virtual ValueBase operator()(Time /*t*/)const
 		{ return ValueBase(); }
 
+	//! Returns the value of the ValueNode at time \a t.
+	//! Value of node which is shared by several parents is taken
+	//! from the EvaluationCache of the current thread, if it is active.
+	//! Pass \a always_cache when the caller itself requests the value several times.
+	ValueBase get_value(Time t, bool always_cache = false)const;
+
 	//! \internal Sets the id of the ValueNode
 	void set_id(const String &x);
 
@@ -257,7 +334,6 @@ public:
 	//! Set the default interpolation for Value Nodes
 	virtual void set_interpolation(Interpolation /* i*/) { }
 
-	// TODO: cache of values (we need to fix chain of signals 'changed' in LinkableValueNodes
 	void get_values(std::set<ValueBase> &x) const;
 	void get_value_change_times(std::set<Time> &x) const;
 	void get_values(std::map<Time, ValueBase> &x) const;
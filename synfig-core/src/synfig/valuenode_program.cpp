@@ -0,0 +1,338 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file valuenode_program.cpp
+**	\brief Compiler of ValueNode graphs into flat evaluation programs
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cassert>
+#include <cmath>
+
+#include "valuenode_program.h"
+
+#include "valuenodes/valuenode_add.h"
+#include "valuenodes/valuenode_composite.h"
+#include "valuenodes/valuenode_const.h"
+#include "valuenodes/valuenode_cos.h"
+#include "valuenodes/valuenode_exp.h"
+#include "valuenodes/valuenode_linear.h"
+#include "valuenodes/valuenode_reference.h"
+#include "valuenodes/valuenode_scale.h"
+#include "valuenodes/valuenode_sine.h"
+#include "valuenodes/valuenode_subtract.h"
+
+#endif
+
+/* === U S I N G =========================================================== */
+
+using namespace synfig;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+ValueNodeProgram::Class
+ValueNodeProgram::get_class(Type &type)
+{
+	if (type == type_real)   return CLASS_REAL;
+	if (type == type_angle)  return CLASS_ANGLE;
+	if (type == type_vector) return CLASS_VECTOR;
+	if (type == type_color)  return CLASS_COLOR;
+	return CLASS_NONE;
+}
+
+bool
+ValueNodeProgram::is_operation(const ValueNode::Handle &node)
+{
+	return ValueNode_Add::Handle::cast_dynamic(node)
+	    || ValueNode_Subtract::Handle::cast_dynamic(node)
+	    || ValueNode_Scale::Handle::cast_dynamic(node)
+	    || ValueNode_Linear::Handle::cast_dynamic(node)
+	    || ValueNode_Exp::Handle::cast_dynamic(node)
+	    || ValueNode_Sine::Handle::cast_dynamic(node)
+	    || ValueNode_Cos::Handle::cast_dynamic(node)
+	    || ValueNode_Composite::Handle::cast_dynamic(node);
+}
+
+int
+ValueNodeProgram::new_register(Class type)
+{
+	switch(type) {
+		case CLASS_REAL:   reals.push_back(Real());     return (int)reals.size() - 1;
+		case CLASS_ANGLE:  angles.push_back(Angle());   return (int)angles.size() - 1;
+		case CLASS_VECTOR: vectors.push_back(Vector()); return (int)vectors.size() - 1;
+		case CLASS_COLOR:  colors.push_back(Color());   return (int)colors.size() - 1;
+		default: break;
+	}
+	assert(false);
+	return -1;
+}
+
+void
+ValueNodeProgram::set_register(Class type, int reg, const ValueBase &value)
+{
+	switch(type) {
+		case CLASS_REAL:   reals[reg]   = value.get(Real());   break;
+		case CLASS_ANGLE:  angles[reg]  = value.get(Angle());  break;
+		case CLASS_VECTOR: vectors[reg] = value.get(Vector()); break;
+		case CLASS_COLOR:  colors[reg]  = value.get(Color());  break;
+		default: assert(false); break;
+	}
+}
+
+ValueBase
+ValueNodeProgram::get_register(Class type, int reg) const
+{
+	switch(type) {
+		case CLASS_REAL:   return reals[reg];
+		case CLASS_ANGLE:  return angles[reg];
+		case CLASS_VECTOR: return vectors[reg];
+		case CLASS_COLOR:  return colors[reg];
+		default: break;
+	}
+	assert(false);
+	return ValueBase();
+}
+
+int
+ValueNodeProgram::compile_node(const ValueNode::Handle &node, Class type)
+{
+	Key key(node.get(), type);
+	std::map<Key, int>::const_iterator i = compiled.find(key);
+	if (i != compiled.end())
+		return i->second;
+
+	int reg = -1;
+	if (get_class(node->get_type()) == type) {
+		if (ValueNode_Const::Handle value_node = ValueNode_Const::Handle::cast_dynamic(node)) {
+			reg = new_register(type);
+			set_register(type, reg, value_node->get_value());
+			++optimized_count;
+		} else
+		if (ValueNode_Reference::Handle reference = ValueNode_Reference::Handle::cast_dynamic(node)) {
+			if (ValueNode::Handle link = reference->get_link(0)) {
+				reg = compile_node(link, type);
+				++optimized_count;
+			}
+		} else {
+			reg = compile_operation(node, type);
+			if (reg >= 0) ++optimized_count;
+		}
+	}
+
+	// the same conversion as get() of value returned by operator()
+	if (reg < 0) {
+		reg = new_register(type);
+		instructions.push_back(Instruction(OP_EVAL, type, reg, 0, 0, 0, 0, node.get()));
+		nodes.push_back(node);
+	}
+
+	compiled[key] = reg;
+	return reg;
+}
+
+int
+ValueNodeProgram::compile_operation(const ValueNode::Handle &node, Class type)
+{
+	Opcode op;
+	int count = 0;
+	Class classes[4] = { type, type, CLASS_REAL, CLASS_REAL };
+
+	if (ValueNode_Add::Handle::cast_dynamic(node))
+		{ op = OP_ADD; count = 3; }
+	else
+	if (ValueNode_Subtract::Handle::cast_dynamic(node))
+		{ op = OP_SUBTRACT; count = 3; }
+	else
+	if (ValueNode_Scale::Handle::cast_dynamic(node))
+		{ op = OP_SCALE; count = 2; classes[1] = CLASS_REAL; }
+	else
+	if (ValueNode_Linear::Handle::cast_dynamic(node))
+		{ op = OP_LINEAR; count = 2; }
+	else
+	if (ValueNode_Exp::Handle::cast_dynamic(node) && type == CLASS_REAL)
+		{ op = OP_EXP; count = 2; }
+	else
+	if (ValueNode_Sine::Handle::cast_dynamic(node) && type == CLASS_REAL)
+		{ op = OP_SINE; count = 2; classes[0] = CLASS_ANGLE; }
+	else
+	if (ValueNode_Cos::Handle::cast_dynamic(node) && type == CLASS_REAL)
+		{ op = OP_COSINE; count = 2; classes[0] = CLASS_ANGLE; }
+	else
+	if (ValueNode_Composite::Handle::cast_dynamic(node) && type == CLASS_VECTOR)
+		{ op = OP_COMPOSITE; count = 2; classes[0] = classes[1] = CLASS_REAL; }
+	else
+	if (ValueNode_Composite::Handle::cast_dynamic(node) && type == CLASS_COLOR)
+		{ op = OP_COMPOSITE; count = 4; classes[0] = classes[1] = CLASS_REAL; }
+	else
+		return -1;
+
+	// node with missing links throws from operator(), let it do this
+	LinkableValueNode::Handle linkable = LinkableValueNode::Handle::cast_dynamic(node);
+	ValueNode::Handle links[4];
+	for(int i = 0; i < count; ++i)
+		if (!(links[i] = linkable->get_link(i)))
+			return -1;
+
+	int args[4] = { };
+	for(int i = 0; i < count; ++i)
+		args[i] = compile_node(links[i], classes[i]);
+
+	int reg = new_register(type);
+	instructions.push_back(Instruction(op, type, reg, args[0], args[1], args[2], args[3]));
+	return reg;
+}
+
+void
+ValueNodeProgram::clear()
+{
+	instructions.clear();
+	outputs.clear();
+	compiled.clear();
+	nodes.clear();
+	reals.clear();
+	angles.clear();
+	vectors.clear();
+	colors.clear();
+	optimized_count = 0;
+}
+
+int
+ValueNodeProgram::add(const ValueNode::Handle &node)
+{
+	assert(node);
+	Output output;
+	output.node = node;
+
+	// value of other nodes (constants, animated) may carry static flag
+	// or interpolation, so they are returned as is
+	Class type = get_class(node->get_type());
+	if (type != CLASS_NONE && is_operation(node)) {
+		output.type = type;
+		output.reg = compile_node(node, type);
+	}
+
+	outputs.push_back(output);
+	return (int)outputs.size() - 1;
+}
+
+void
+ValueNodeProgram::run(Time t)
+{
+	for(InstructionList::const_iterator i = instructions.begin(); i != instructions.end(); ++i) {
+		// expressions repeat operator() of nodes, so results are the same
+		switch(i->op) {
+		case OP_EVAL:
+			set_register(i->type, i->dst, (*i->node)(t));
+			break;
+		case OP_ADD:
+			switch(i->type) {
+				case CLASS_REAL:   reals[i->dst]   = (reals[i->a]   + reals[i->b]  )*reals[i->c]; break;
+				case CLASS_ANGLE:  angles[i->dst]  = (angles[i->a]  + angles[i->b] )*reals[i->c]; break;
+				case CLASS_VECTOR: vectors[i->dst] = (vectors[i->a] + vectors[i->b])*reals[i->c]; break;
+				case CLASS_COLOR:  colors[i->dst]  = (colors[i->a]  + colors[i->b] )*reals[i->c]; break;
+				default: break;
+			}
+			break;
+		case OP_SUBTRACT:
+			switch(i->type) {
+				case CLASS_REAL:   reals[i->dst]   = (reals[i->a]   - reals[i->b]  )*reals[i->c]; break;
+				case CLASS_ANGLE:  angles[i->dst]  = (angles[i->a]  - angles[i->b] )*reals[i->c]; break;
+				case CLASS_VECTOR: vectors[i->dst] = (vectors[i->a] - vectors[i->b])*reals[i->c]; break;
+				case CLASS_COLOR:  colors[i->dst]  = (colors[i->a]  - colors[i->b] )*reals[i->c]; break;
+				default: break;
+			}
+			break;
+		case OP_SCALE:
+			switch(i->type) {
+				case CLASS_REAL:   reals[i->dst]   = reals[i->a]*reals[i->b]; break;
+				case CLASS_ANGLE:  angles[i->dst]  = angles[i->a]*reals[i->b]; break;
+				case CLASS_VECTOR: vectors[i->dst] = vectors[i->a]*reals[i->b]; break;
+				case CLASS_COLOR: {
+					Color color(colors[i->a]);
+					Real s(reals[i->b]);
+					color.set_r(color.get_r()*s);
+					color.set_g(color.get_g()*s);
+					color.set_b(color.get_b()*s);
+					colors[i->dst] = color;
+					break;
+				}
+				default: break;
+			}
+			break;
+		case OP_LINEAR:
+			switch(i->type) {
+				case CLASS_REAL:   reals[i->dst]   = reals[i->a]*t + reals[i->b]; break;
+				case CLASS_ANGLE:  angles[i->dst]  = angles[i->a]*t + angles[i->b]; break;
+				case CLASS_VECTOR: vectors[i->dst] = vectors[i->a]*t + vectors[i->b]; break;
+				case CLASS_COLOR:  colors[i->dst]  = colors[i->a]*t + colors[i->b]; break;
+				default: break;
+			}
+			break;
+		case OP_EXP:
+			reals[i->dst] = std::exp(reals[i->a])*reals[i->b];
+			break;
+		case OP_SINE:
+			reals[i->dst] = Angle::sin(angles[i->a]).get()*reals[i->b];
+			break;
+		case OP_COSINE:
+			reals[i->dst] = Angle::cos(angles[i->a]).get()*reals[i->b];
+			break;
+		case OP_COMPOSITE:
+			if (i->type == CLASS_VECTOR) {
+				Vector &v = vectors[i->dst];
+				v[0] = reals[i->a];
+				v[1] = reals[i->b];
+			} else {
+				Color &color = colors[i->dst];
+				color.set_r(reals[i->a]);
+				color.set_g(reals[i->b]);
+				color.set_b(reals[i->c]);
+				color.set_a(reals[i->d]);
+			}
+			break;
+		}
+	}
+
+	for(std::vector<Output>::iterator i = outputs.begin(); i != outputs.end(); ++i)
+		if (i->type == CLASS_NONE)
+			i->value = (*i->node)(t);
+}
+
+ValueBase
+ValueNodeProgram::get(int output) const
+{
+	assert(output >= 0 && output < (int)outputs.size());
+	const Output &o = outputs[output];
+	return o.type == CLASS_NONE ? o.value : get_register(o.type, o.reg);
+}
+
+/* === E N T R Y P O I N T ================================================= */
@@ -0,0 +1,167 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file valuenode_program.h
+**	\brief Compiler of ValueNode graphs into flat evaluation programs
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_VALUENODE_PROGRAM_H
+#define __SYNFIG_VALUENODE_PROGRAM_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "angle.h"
+#include "color.h"
+#include "real.h"
+#include "time.h"
+#include "valuenode.h"
+#include "vector.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig {
+
+/*!	\class ValueNodeProgram
+**	\brief Flat program which evaluates the frozen graphs of ValueNodes.
+**
+**	Nodes of type real, angle, vector and color made of constants, references,
+**	Add, Subtract, Scale, Linear, Exp, Sine, Cos and Composite are lowered into
+**	a list of instructions over typed registers, so they are evaluated without
+**	virtual calls and without ValueBase for intermediate values.
+**	Any other node is called through ValueNode::operator()(Time) by single
+**	instruction, so every graph can be compiled and gives the same values.
+**	Node shared by several outputs or parents is evaluated once per run().
+**
+**	Program doesn't follow changes of nodes: values of constants are copied
+**	while compiling, so compile it again after the graph is edited.
+**
+**	Rendering doesn't use it by itself, it's for callers which evaluate
+**	the same parameters for many frames and opt in explicitly.
+*/
+class ValueNodeProgram
+{
+public:
+	//! Register files
+	enum Class
+	{
+		CLASS_NONE = 0,
+		CLASS_REAL,
+		CLASS_ANGLE,
+		CLASS_VECTOR,
+		CLASS_COLOR
+	};
+
+	enum Opcode
+	{
+		OP_EVAL,           //!< dst = (*node)(t), for nodes without own instructions
+		OP_ADD,            //!< dst = (a + b)*c
+		OP_SUBTRACT,       //!< dst = (a - b)*c
+		OP_SCALE,          //!< dst = a*b, alpha of color is not scaled
+		OP_LINEAR,         //!< dst = a*t + b
+		OP_EXP,            //!< dst = exp(a)*b
+		OP_SINE,           //!< dst = sin(a)*b
+		OP_COSINE,         //!< dst = cos(a)*b
+		OP_COMPOSITE       //!< dst = vector(a, b) or color(a, b, c, d)
+	};
+
+	struct Instruction
+	{
+		Opcode op;
+		Class type; //!< class of dst, and of a and b for arithmetic
+		int dst, a, b, c, d;
+		const ValueNode *node;
+
+		Instruction(Opcode op, Class type, int dst, int a = 0, int b = 0, int c = 0, int d = 0, const ValueNode *node = NULL):
+			op(op), type(type), dst(dst), a(a), b(b), c(c), d(d), node(node) { }
+	};
+
+	typedef std::vector<Instruction> InstructionList;
+
+private:
+	struct Output
+	{
+		Class type;
+		int reg;
+		ValueNode::Handle node; //!< evaluated directly if type has no registers
+		ValueBase value;        //!< value of such node
+		Output(): type(CLASS_NONE), reg() { }
+	};
+
+	typedef std::pair<const ValueNode*, Class> Key;
+
+	InstructionList instructions;
+	std::vector<Output> outputs;
+	std::map<Key, int> compiled;
+	//! keeps alive nodes used by instructions
+	std::vector<ValueNode::Handle> nodes;
+
+	std::vector<Real> reals;
+	std::vector<Angle> angles;
+	std::vector<Vector> vectors;
+	std::vector<Color> colors;
+
+	int optimized_count;
+
+	static Class get_class(Type &type);
+	//! Checks if node is one of operations which have own instructions
+	static bool is_operation(const ValueNode::Handle &node);
+
+	int new_register(Class type);
+	void set_register(Class type, int reg, const ValueBase &value);
+	ValueBase get_register(Class type, int reg) const;
+
+	//! Returns register with value of node converted to the type of class
+	int compile_node(const ValueNode::Handle &node, Class type);
+	//! Emits instructions of known nodes, returns -1 for others
+	int compile_operation(const ValueNode::Handle &node, Class type);
+
+public:
+	ValueNodeProgram(): optimized_count() { }
+
+	void clear();
+
+	//! Adds node to the program, returns the index of output
+	int add(const ValueNode::Handle &node);
+
+	//! Evaluates all outputs at time \a t
+	void run(Time t);
+
+	//! Returns the value of output calculated by last run()
+	ValueBase get(int output) const;
+
+	int output_count() const { return (int)outputs.size(); }
+	const InstructionList& get_instructions() const { return instructions; }
+	//! Count of nodes lowered into own instructions (constants and references included)
+	int get_optimized_count() const { return optimized_count; }
+};
+
+} // END of namespace synfig
+
+/* === E N D =============================================================== */
+
+#endif
@@ -31,6 +31,7 @@
 #endif
 
 #include <cmath>
+#include <cstdint>
 
 #include <algorithm>
 #include <typeinfo>
@@ -289,6 +290,22 @@ public:
 	
 	static int int_premult(const int &x) { return x*(3*256); }
 	static int int_demult(const int &x) { return (x + 3*128)/(3*256); }
+
+	//! Per-thread index of last used segment, looked up by address of interpolator.
+	//! Frames are usually rendered sequentially, so next lookup probably hits the same segment.
+	//! Entry may belong to other (or already deleted) interpolator, so check it before use.
+	static size_t& segment_hint(const void *owner)
+	{
+		struct Entry { const void *owner; size_t index; };
+		static thread_local Entry entries[64];
+		Entry &entry = entries[(reinterpret_cast<uintptr_t>(owner)/sizeof(void*)) % 64];
+		if (entry.owner != owner)
+			{ entry.owner = owner; entry.index = 0; }
+		return entry.index;
+	}
+
+	static bool waypoint_time_less(const Time &t, const Waypoint &waypoint)
+		{ return t < waypoint.get_time(); }
 	
 	template< typename T, T premult(const T&) = pass<T>, T demult(const T&)  = pass<T> >
 	class Hermite: public Interpolator
@@ -345,6 +362,27 @@ public:
 		// Bounds of this curve
 		Time r,s;
 
+		static bool segment_end_less(const Time &t, const PathSegment &segment)
+			{ return t < segment.first.get_s(); }
+
+		//! Returns first segment which ends after the given time
+		typename curve_list_type::const_iterator find_segment(Time t) const
+		{
+			size_t &hint = segment_hint(this);
+			const size_t count = curve_list.size();
+
+			// try the last used segment and the next one
+			for(size_t i = hint; i < count && i <= hint + 1; ++i)
+				if ( t < curve_list[i].first.get_s()
+				  && (i == 0 || !(t < curve_list[i-1].first.get_s())) )
+					{ hint = i; return curve_list.begin() + i; }
+
+			typename curve_list_type::const_iterator iter =
+				std::upper_bound(curve_list.begin(), curve_list.end(), t, segment_end_less);
+			hint = iter - curve_list.begin();
+			return iter;
+		}
+
 	public:
 		Hermite(ValueNode_AnimatedInterfaceConst &node): Interpolator(node) { }
 
@@ -658,12 +696,7 @@ public:
 			if(t>=s)
 				return animated.waypoint_list_.back().get_value(t);
 
-			typename curve_list_type::const_iterator iter;
-
-			// This next line will set iter to the
-			// correct iterator for the given time.
-			for(iter=curve_list.begin();iter<curve_list.end() && t>=iter->first.get_s();++iter)
-				continue;
+			typename curve_list_type::const_iterator iter = find_segment(t);
 			if(iter==curve_list.end())
 				return animated.waypoint_list_.back().get_value(t);
 			return iter->resolve(t);
@@ -749,13 +782,10 @@ public:
 			if(t>=s)
 				return animated.waypoint_list_.back().get_value(t);
 
-			WaypointList::const_iterator iter;
-			WaypointList::const_iterator next;
-
-			// This next line will set iter to the
-			// correct iterator for the given time.
-			for(next=animated.waypoint_list_.begin(),iter=next++;next!=animated.waypoint_list_.end() && t>=next->get_time();iter=next++)
-				continue;
+			// find the last waypoint which is not after the given time
+			WaypointList::const_iterator iter = std::upper_bound(
+				animated.waypoint_list_.begin(), animated.waypoint_list_.end(), t, waypoint_time_less );
+			--iter;
 
 			return iter->get_value(t);
 		}
@@ -840,14 +870,10 @@ public:
 			if(t>s)
 				return animated.waypoint_list_.back().get_value(t);
 
-			WaypointList::const_iterator iter;
-			WaypointList::const_iterator next;
-
-			// This next line will set iter to the
-			// correct iterator for the given time.
-			for(next=animated.waypoint_list_.begin(),iter=next++;next!=animated.waypoint_list_.end() && t>=next->get_time();iter=next++)
-				if(iter->get_time()==t)
-					return iter->get_value(t);
+			// find the last waypoint which is not after the given time
+			WaypointList::const_iterator next = std::upper_bound(
+				animated.waypoint_list_.begin(), animated.waypoint_list_.end(), t, waypoint_time_less );
+			WaypointList::const_iterator iter = next - 1;
 
 			if(iter->get_time()==t)
 				return iter->get_value(t);
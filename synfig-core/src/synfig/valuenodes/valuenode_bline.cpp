@@ -938,7 +938,7 @@ ValueNode_BLine::check_type(Type &type)
 BLinePoint
 ValueNode_BLine::get_blinepoint(std::vector<ListEntry>::const_iterator current, Time t) const
 {
-	BLinePoint bpcurr((*current->value_node)(t).get(BLinePoint()));
+	BLinePoint bpcurr(current->value_node->get_value(t, true).get(BLinePoint()));
 	if(!bpcurr.get_boned_vertex_flag())
 		return bpcurr;
 
@@ -960,8 +960,9 @@ ValueNode_BLine::get_blinepoint(std::vector<ListEntry>::const_iterator current,
 		previous=list.end();
 	previous--;
 
-	bpprev=(*previous->value_node)(t).get(BLinePoint());
-	bpnext=(*next->value_node)(t).get(BLinePoint());
+	// neighbours are evaluated for each boned vertex
+	bpprev=previous->value_node->get_value(t, true).get(BLinePoint());
+	bpnext=next->value_node->get_value(t, true).get(BLinePoint());
 
 	t1=bpcurr.get_tangent1();
 	t2=bpcurr.get_tangent2();
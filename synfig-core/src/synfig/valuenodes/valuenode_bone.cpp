@@ -371,14 +371,27 @@ Matrix
 ValueNode_Bone::get_animated_matrix(Time t, Point child_origin)const
 {
 	Real   scalelx	((*scalelx_	)(t).get(Real ()));
+
+	return get_own_animated_matrix(t)
+		 * Matrix().set_translate(child_origin[0]*scalelx, child_origin[1]);
+}
+
+Matrix
+ValueNode_Bone::get_own_animated_matrix(Time t)const
+{
+	EvaluationCache *cache = EvaluationCache::current();
+	if (cache)
+		if (const ValueBase *value = cache->find(this, t, EvaluationCache::SLOT_BONE_MATRIX))
+			return value->get(Matrix());
+
 	Real   scalex	((*scalex_	)(t).get(Real ()));
 	Angle  angle	((*angle_	)(t).get(Angle()));
 	Point  origin	((*origin_	)(t).get(Point()));
+	Matrix matrix(get_animated_matrix(t, scalex, 1.0, angle, origin, get_parent(t)));
 
-	return get_parent(t)->get_animated_matrix(t, origin)
-		 * Matrix().set_rotate(angle)
-		 * Matrix().set_scale(scalex,1.0)
-		 * Matrix().set_translate(child_origin[0]*scalelx, child_origin[1]);
+	if (cache)
+		cache->store(this, t, EvaluationCache::SLOT_BONE_MATRIX, matrix);
+	return matrix;
 }
 
 Matrix
@@ -446,7 +459,7 @@ ValueNode_Bone::operator()(Time t)const
 	Real   bone_tipwidth		((*tipwidth_)(t).get(Real()));
 	Real   bone_depth			((*depth_)(t).get(Real()));
 	if (getenv("SYNFIG_DEBUG_ANIMATED_MATRIX_CALCULATION")) printf("\n***\n*** %s:%d get_animated_matrix() for %s\n***\n\n", __FILE__, __LINE__, get_bone_name(t).c_str());
-	Matrix bone_animated_matrix	(get_animated_matrix(t, bone_scalex, 1.0, bone_angle, bone_origin, bone_parent));
+	Matrix bone_animated_matrix	(get_own_animated_matrix(t));
 	if (getenv("SYNFIG_DEBUG_ANIMATED_MATRIX_CALCULATION")) printf("\n***\n*** %s:%d get_animated_matrix() for %s done\n***\n\n", __FILE__, __LINE__, get_bone_name(t).c_str());
 #endif
 
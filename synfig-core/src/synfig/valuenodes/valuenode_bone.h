@@ -132,6 +132,10 @@ public:
 private:
 	virtual Matrix get_animated_matrix(Time t, Point child_origin)const;
 	Matrix get_animated_matrix(Time t, Real scalex, Real scaley, Angle angle, Point origin, ValueNode_Bone::ConstHandle parent)const;
+	//! Animated matrix of the bone itself (see Bone::get_animated_matrix()).
+	//! It is memoized in ValueNode::EvaluationCache, so the chain of parents
+	//! is walked once per time for the whole skeleton.
+	Matrix get_own_animated_matrix(Time t)const;
 	ValueNode_Bone::ConstHandle get_parent(Time t)const;
 
 }; // END of class ValueNode_Bone
@@ -111,7 +111,7 @@ ValueNode_Reference::operator()(Time t)const
 	if (getenv("SYNFIG_DEBUG_VALUENODE_OPERATORS"))
 		printf("%s:%d operator()\n", __FILE__, __LINE__);
 
-	return (*link_)(t);
+	return link_->get_value(t);
 }
 
 
@@ -56,6 +56,9 @@ SynfigToolGeneralOptions::SynfigToolGeneralOptions(const char* argv0)
 	_should_be_quiet = false;
 	_should_print_benchmarks = false;
 	_threads = 1;
+	_parallel_frames = 1;
+	_max_frame_memory = 0;
+	_write_queue_size = -1;
 }
 
 std::string SynfigToolGeneralOptions::get_binary_path() const
@@ -73,6 +76,46 @@ void SynfigToolGeneralOptions::set_threads(size_t threads)
 	_threads = threads;
 }
 
+size_t SynfigToolGeneralOptions::get_parallel_frames() const
+{
+	return _parallel_frames;
+}
+
+void SynfigToolGeneralOptions::set_parallel_frames(size_t parallel_frames)
+{
+	_parallel_frames = parallel_frames;
+}
+
+size_t SynfigToolGeneralOptions::get_max_frame_memory() const
+{
+	return _max_frame_memory;
+}
+
+void SynfigToolGeneralOptions::set_max_frame_memory(size_t max_frame_memory)
+{
+	_max_frame_memory = max_frame_memory;
+}
+
+int SynfigToolGeneralOptions::get_write_queue_size() const
+{
+	return _write_queue_size;
+}
+
+void SynfigToolGeneralOptions::set_write_queue_size(int write_queue_size)
+{
+	_write_queue_size = write_queue_size;
+}
+
+std::string SynfigToolGeneralOptions::get_trace_file() const
+{
+	return _trace_file;
+}
+
+void SynfigToolGeneralOptions::set_trace_file(const std::string &trace_file)
+{
+	_trace_file = trace_file;
+}
+
 int SynfigToolGeneralOptions::get_verbosity() const
 {
 	return _verbosity;
@@ -89,6 +89,26 @@ public:
 
 	void set_threads(size_t threads);
 
+	size_t get_parallel_frames() const;
+
+	void set_parallel_frames(size_t parallel_frames);
+
+	//! Maximum size of frame buffer in megabytes, zero means default
+	size_t get_max_frame_memory() const;
+
+	void set_max_frame_memory(size_t max_frame_memory);
+
+	//! Number of rendered frames which may wait for writing in background,
+	//! negative means default of the target
+	int get_write_queue_size() const;
+
+	void set_write_queue_size(int write_queue_size);
+
+	//! File to save rendering trace into, empty means no tracing
+	std::string get_trace_file() const;
+
+	void set_trace_file(const std::string &trace_file);
+
 	int get_verbosity() const;
 
 	void set_verbosity(int verbosity);
@@ -107,6 +127,10 @@ private:
 	std::string _binary_path;
 	int _verbosity;
 	size_t _threads;
+	size_t _parallel_frames;
+	size_t _max_frame_memory;
+	int _write_queue_size;
+	std::string _trace_file;
 	bool _should_be_quiet,
 		 _should_print_benchmarks;
 
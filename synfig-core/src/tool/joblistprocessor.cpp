@@ -53,7 +53,10 @@
 #include <synfig/importer.h>
 #include <synfig/loadcanvas.h>
 #include <synfig/savecanvas.h>
+#include <synfig/valuenode.h>
 #include <synfig/filesystemnative.h>
+#include <synfig/rendering/renderer.h>
+#include <synfig/rendering/common/rendercache.h>
 
 #include "definitions.h"
 #include "job.h"
@@ -73,6 +76,12 @@ void process_job_list(std::list<Job>& job_list, const TargetParam& target_params
 	if (job_list.empty())
 		throw (SynfigToolException(SYNFIGTOOL_BORED, _("Nothing to do!")));
 
+	// documents of several jobs usually share external files (libraries of
+	// characters, backgrounds), so keep them loaded until all jobs are done,
+	// synfig::Main releases the cache on exit
+	if (job_list.size() > 1)
+		Canvas::set_external_cache_enabled(true);
+
 	for(; !job_list.empty(); job_list.pop_front())
 	{
 		if (setup_job(job_list.front(), target_params))
@@ -219,7 +228,16 @@ bool setup_job(Job& job, const TargetParam& target_parameters)
 
 	// Set the threads for the target
 	if (job.target && Target_Scanline::Handle::cast_dynamic(job.target))
+	{
 		Target_Scanline::Handle::cast_dynamic(job.target)->set_threads(SynfigToolGeneralOptions::instance()->get_threads());
+		Target_Scanline::Handle::cast_dynamic(job.target)->set_parallel_frames(SynfigToolGeneralOptions::instance()->get_parallel_frames());
+		if (SynfigToolGeneralOptions::instance()->get_max_frame_memory())
+			Target_Scanline::Handle::cast_dynamic(job.target)->set_max_frame_memory(
+				(long long)SynfigToolGeneralOptions::instance()->get_max_frame_memory()*1024*1024 );
+		if (SynfigToolGeneralOptions::instance()->get_write_queue_size() >= 0)
+			Target_Scanline::Handle::cast_dynamic(job.target)->set_write_queue_size(
+				SynfigToolGeneralOptions::instance()->get_write_queue_size() );
+	}
 
 	return true;
 }
@@ -284,6 +302,31 @@ void process_job (Job& job)
                       << _(": Rendered in ")
                       << duration.count()
                       << _(" seconds.") << std::endl;
+
+            rendering::RenderQueue::Statistics stats = rendering::Renderer::get_queue_statistics();
+            std::cout << _("Rendering tasks: ") << stats.tasks
+                      << _(", local: ") << stats.local_pops
+                      << _(", stolen: ") << stats.steals
+                      << _(", failed steals: ") << stats.failed_steals
+                      << _(", lock contentions: ") << stats.contentions
+                      << _(", thread sleeps: ") << stats.sleeps << std::endl;
+
+            if (rendering::RenderCache::Handle cache = rendering::RenderCache::get_instance())
+            {
+                rendering::RenderCache::Statistics cache_stats = cache->get_statistics();
+                std::cout << _("Render cache hits: ") << cache_stats.hits
+                          << _(", misses: ") << cache_stats.misses
+                          << _(", stored: ") << cache_stats.stores
+                          << _(", evicted: ") << cache_stats.evictions
+                          << _(", entries: ") << cache_stats.entries
+                          << _(", size: ") << cache_stats.size/(1024*1024)
+                          << "/" << cache_stats.max_size/(1024*1024) << _(" MB") << std::endl;
+            }
+
+            ValueNode::EvaluationCache::Statistics value_stats = ValueNode::EvaluationCache::get_statistics();
+            std::cout << _("Value evaluations saved: ") << value_stats.hits
+                      << _(", cached: ") << value_stats.misses
+                      << _(", invalidations: ") << value_stats.invalidations << std::endl;
         }
 	}
 
@@ -57,6 +57,7 @@
 #include <synfig/string.h>
 #include <synfig/paramdesc.h>
 #include <synfig/main.h>
+#include <synfig/debug/trace.h>
 #include <autorevision.h>
 #include "definitions.h"
 #include "progress.h"
@@ -307,6 +308,14 @@ int main(int argc, char* argv[])
 
 		process_job_list(job_list, parser.extract_targetparam());
 
+		std::string trace_file = SynfigToolGeneralOptions::instance()->get_trace_file();
+		if (!trace_file.empty())
+		{
+			synfig::debug::Trace::stop();
+			if (synfig::debug::Trace::save(trace_file))
+				VERBOSE_OUT(1) << _("Trace saved to ") << trace_file << std::endl;
+		}
+
 		return SYNFIGTOOL_OK;
 
     }
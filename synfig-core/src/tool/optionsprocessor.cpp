@@ -49,6 +49,8 @@
 #include <synfig/filesystemgroup.h>
 #include <synfig/filesystemnative.h>
 #include <synfig/filecontainerzip.h>
+#include <synfig/rendering/common/rendercache.h>
+#include <synfig/debug/trace.h>
 
 #include "definitions.h"
 #include "job.h"
@@ -100,9 +102,17 @@ SynfigCommandLineParser::SynfigCommandLineParser() :
 	set_antialias(),
 	set_quality(),
 	set_num_threads(),
+	set_parallel_frames(),
+	set_max_frame_memory(),
+	set_write_queue(-1),
+	set_render_cache(),
+	set_render_cache_size(),
+	set_trace_file(),
 	set_input_file(),
 	set_output_file(),
 	set_sequence_separator(),
+	set_png_compression(-1),
+	set_png_filter(),
 	set_canvas_id(),
 	set_fps(),
 	set_time(),
@@ -158,9 +168,17 @@ SynfigCommandLineParser::SynfigCommandLineParser() :
 	add_option(og_set, "antialias",   'a', set_antialias,	_("Set antialias amount for parametric renderer."), "1..30");
 	//og_set.add_option("quality",     'Q', quality_arg_desc, etl::strprintf(_("Specify image quality for accelerated renderer (Default: %d)"), DEFAULT_QUALITY).c_str(), "NUM");
 	add_option(og_set, "threads",     'T', set_num_threads, _("Enable multithreaded renderer using the specified number of threads"), "NUM");
+	add_option(og_set, "parallel-frames", ' ', set_parallel_frames, _("Render the specified number of frames simultaneously"), "NUM");
+	add_option(og_set, "max-frame-memory", ' ', set_max_frame_memory, _("Render larger frames by bands which use no more than the specified amount of memory"), "MB");
+	add_option(og_set, "write-queue", ' ', set_write_queue, _("Compress and write up to the specified number of rendered frames in background while next frames render (Default: 2, 0 writes frames synchronously)"), "NUM");
+	add_option(og_set, "render-cache", ' ', set_render_cache, _("Reuse unchanged parts of image between renders, cache is stored in the specified directory"), "directory");
+	add_option(og_set, "render-cache-size", ' ', set_render_cache_size, _("Set the size limit of render cache in megabytes (Default: 1024)"), "NUM");
+	add_option(og_set, "trace",       ' ', set_trace_file,	_("Save timings of rendering stages to the specified file in Chrome trace format"), "filename");
 	add_option(og_set, "input-file",  'i', set_input_file, 	_("Specify input filename"), "filename");
 	add_option(og_set, "output-file", 'o', set_output_file, _("Specify output filename"), "filename");
 	add_option(og_set, "sequence-separator", ' ', set_sequence_separator, _("Output file sequence separator string (Use double quotes if you want to use spaces)"), "string");
+	add_option(og_set, "png-compression", ' ', set_png_compression, _("Set compression level of PNG files from 0 (fastest) to 9 (smallest)"), "0..9");
+	add_option(og_set, "png-filter", ' ', set_png_filter, _("Set row filter of PNG files: none, sub, up, avg, paeth or all (Default: none)"), "filter");
 	add_option(og_set, "canvas",      'c', set_canvas_id, 	_("Render the canvas with the given id instead of the root."), "id");
 	add_option(og_set, "fps",         ' ', set_fps, 		_("Set the frame rate"), "NUM");
 	add_option(og_set, "time",        ' ', set_time, 		_("Render a single frame at <seconds>"), "seconds");
@@ -362,6 +380,35 @@ void SynfigCommandLineParser::process_settings_options()
 
 	VERBOSE_OUT(1) << _("Threads set to ")
 				   << SynfigToolGeneralOptions::instance()->get_threads() << std::endl;
+
+	if (set_parallel_frames > 0)
+	{
+		SynfigToolGeneralOptions::instance()->set_parallel_frames(set_parallel_frames);
+	}
+
+	if (set_max_frame_memory > 0)
+	{
+		SynfigToolGeneralOptions::instance()->set_max_frame_memory(set_max_frame_memory);
+	}
+
+	if (set_write_queue >= 0)
+	{
+		SynfigToolGeneralOptions::instance()->set_write_queue_size(set_write_queue);
+	}
+
+	if (!set_render_cache.empty())
+	{
+		long long size = set_render_cache_size > 0 ? set_render_cache_size : 1024;
+		rendering::RenderCache::set_instance(
+			new rendering::RenderCache(set_render_cache, size*1024*1024) );
+		VERBOSE_OUT(1) << _("Render cache directory ") << set_render_cache << std::endl;
+	}
+
+	if (!set_trace_file.empty())
+	{
+		SynfigToolGeneralOptions::instance()->set_trace_file(set_trace_file);
+		debug::Trace::start();
+	}
 }
 
 void SynfigCommandLineParser::process_trivial_info_options()
@@ -675,6 +722,16 @@ TargetParam SynfigCommandLineParser::extract_targetparam()
                        << "'."
 					   << std::endl;
 	}
+	if (set_png_compression >= 0)
+	{
+		params.compression = set_png_compression;
+		VERBOSE_OUT(1) << _("PNG compression level set to: ") << params.compression << std::endl;
+	}
+	if (!set_png_filter.empty())
+	{
+		params.png_filter = set_png_filter;
+		VERBOSE_OUT(1) << _("PNG row filter set to: ") << params.png_filter << std::endl;
+	}
 
 	return params;
 }
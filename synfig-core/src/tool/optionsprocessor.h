@@ -158,9 +158,17 @@ private:
 	int				set_quality;
 //			(",Q", quality_arg_desc->default_value(DEFAULT_QUALITY), )
 	int				set_num_threads;
+	int				set_parallel_frames;
+	int				set_max_frame_memory;
+	int				set_write_queue;
+	Glib::ustring	set_render_cache;
+	int				set_render_cache_size;
+	Glib::ustring	set_trace_file;
 	Glib::ustring	set_input_file;
 	Glib::ustring	set_output_file;
 	Glib::ustring	set_sequence_separator;
+	int				set_png_compression;
+	Glib::ustring	set_png_filter;
 	Glib::ustring	set_canvas_id;
 	double			set_fps;
 	Glib::ustring	set_time;
@@ -0,0 +1,215 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file test/animated.cpp
+**	\brief Test and benchmark for animated value nodes with many waypoints
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+#include <synfig/general.h>
+#include <synfig/real.h>
+#include <synfig/type.h>
+#include <synfig/vector.h>
+#include <synfig/waypoint.h>
+#include <synfig/valuenodes/valuenode_animated.h>
+#include <synfig/valuenodes/valuenode_reference.h>
+
+#endif
+
+/* === U S I N G =========================================================== */
+
+using namespace std;
+using namespace etl;
+using namespace synfig;
+
+/* === M A C R O S ========================================================= */
+
+#define WAYPOINTS_COUNT 10000
+#define WAYPOINTS_STEP  0.1
+#define FPS             24
+
+/* === P R O C E D U R E S ================================================= */
+
+ValueNode_Animated::Handle create_animated()
+{
+	ValueNode_Animated::Handle node = ValueNode_Animated::create(type_vector);
+
+	// fill list directly, new_waypoint() recalculates all curves for each call
+	WaypointList &list = node->editable_waypoint_list();
+	list.reserve(WAYPOINTS_COUNT);
+	srand(0);
+	for(int i = 0; i < WAYPOINTS_COUNT; ++i) {
+		Waypoint waypoint(
+			Vector(rand()%1000 - 500, rand()%1000 - 500),
+			Time(i*WAYPOINTS_STEP) );
+		waypoint.set_parent_value_node(node.get());
+		if (i % 3 == 0) {
+			waypoint.set_before(INTERPOLATION_LINEAR);
+			waypoint.set_after(INTERPOLATION_LINEAR);
+		}
+		list.push_back(waypoint);
+	}
+	node->changed();
+
+	return node;
+}
+
+int test_waypoint_values(const ValueNode_Animated::Handle &node)
+{
+	const WaypointList &list = node->waypoint_list();
+	for(WaypointList::const_iterator i = list.begin(); i != list.end(); ++i) {
+		Vector expected = i->get_value().get(Vector());
+		Vector value = (*node)(i->get_time()).get(Vector());
+		if (!approximate_equal_lp(expected[0], value[0]) || !approximate_equal_lp(expected[1], value[1])) {
+			error("value at waypoint %f is (%f, %f), expected (%f, %f)",
+				(double)i->get_time(), value[0], value[1], expected[0], expected[1]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int test_evaluation_order(const ValueNode_Animated::Handle &node, const vector<Time> &times)
+{
+	// segment lookup caches last used segment,
+	// so the same times in different order must give the same values
+	vector<Vector> forward(times.size());
+	for(size_t i = 0; i < times.size(); ++i)
+		forward[i] = (*node)(times[i]).get(Vector());
+
+	for(size_t i = times.size(); i; --i) {
+		Vector value = (*node)(times[i-1]).get(Vector());
+		if (value != forward[i-1]) {
+			error("backward evaluation at %f differs from forward one", (double)times[i-1]);
+			return 1;
+		}
+	}
+
+	for(size_t i = 0; i < times.size(); ++i) {
+		size_t j = rand() % times.size();
+		Vector value = (*node)(times[j]).get(Vector());
+		if (value != forward[j]) {
+			error("random evaluation at %f differs from forward one", (double)times[j]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int test_evaluation_cache(const ValueNode_Animated::Handle &node)
+{
+	// node shared by two parents is evaluated once per time while cache is active
+	ValueNode_Reference::Handle a(new ValueNode_Reference(ValueNode::Handle(node)));
+	ValueNode_Reference::Handle b(new ValueNode_Reference(ValueNode::Handle(node)));
+	Time time(WAYPOINTS_STEP*1.5);
+	Vector expected = (*node)(time).get(Vector());
+
+	ValueNode::EvaluationCache::reset_statistics();
+	{
+		ValueNode::EvaluationCache cache;
+		Vector va = (*a)(time).get(Vector());
+		Vector vb = (*b)(time).get(Vector());
+		if (va != expected || vb != expected) {
+			error("cached value differs from evaluated one");
+			return 1;
+		}
+
+		// change of node must not give the old value
+		WaypointList &list = node->editable_waypoint_list();
+		Vector previous = list[1].get_value().get(Vector());
+		list[1].set_value(previous + Vector(1.0, 1.0));
+		node->changed();
+		Vector changed = (*a)(time).get(Vector());
+		list[1].set_value(previous);
+		node->changed();
+		if (changed == expected) {
+			error("cache is not cleared when node is changed");
+			return 1;
+		}
+	}
+
+	ValueNode::EvaluationCache::Statistics stats = ValueNode::EvaluationCache::get_statistics();
+	if (stats.hits != 1 || stats.misses != 2 || stats.invalidations != 1) {
+		error("unexpected cache statistics: %lld hits, %lld misses, %lld invalidations",
+			stats.hits, stats.misses, stats.invalidations);
+		return 1;
+	}
+	return 0;
+}
+
+double benchmark(const ValueNode_Animated::Handle &node, const vector<Time> &times)
+{
+	Real sum = 0;
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	for(vector<Time>::const_iterator i = times.begin(); i != times.end(); ++i)
+		sum += (*node)(*i).get(Vector())[0];
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	if (sum == 0.123) info("unused"); // prevent optimizing the loop out
+	return chrono::duration<double, micro>(end - begin).count()/times.size();
+}
+
+/* === E N T R Y P O I N T ================================================= */
+
+int main()
+{
+	Type::subsys_init();
+
+	int failures = 0;
+	try {
+		ValueNode_Animated::Handle node = create_animated();
+
+		vector<Time> frames;
+		for(int i = 0; i < (WAYPOINTS_COUNT - 1)*WAYPOINTS_STEP*FPS; ++i)
+			frames.push_back(Time(i/(Real)FPS));
+		vector<Time> shuffled(frames);
+		for(size_t i = shuffled.size(); i > 1; --i)
+			swap(shuffled[i-1], shuffled[rand() % i]);
+
+		failures += test_waypoint_values(node);
+		failures += test_evaluation_order(node, frames);
+		failures += test_evaluation_cache(node);
+
+		info("%d waypoints, %d frames", WAYPOINTS_COUNT, (int)frames.size());
+		info("sequential frames: %.3f us per frame", benchmark(node, frames));
+		info("random frames:     %.3f us per frame", benchmark(node, shuffled));
+	} catch (...) {
+		error("Some exception has been thrown.");
+		++failures;
+	}
+
+	if (failures)
+		error("Test finished with %i errors", failures);
+	else
+		info("Success");
+
+	Type::subsys_stop();
+
+	return failures ? 1 : 0;
+}
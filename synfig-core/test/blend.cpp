@@ -0,0 +1,146 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file blend.cpp
+**	\brief Test and benchmark of row kernels for blending
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+#include <synfig/color/pixelformat.h>
+#include <synfig/rendering/software/function/blend.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "simd.h"
+
+using namespace std;
+using namespace synfig;
+using namespace synfig::rendering::software;
+
+static const float amounts[] = { 1.f, 0.5f, 0.f, -0.5f, 1.5f };
+static const int amounts_count = sizeof(amounts)/sizeof(amounts[0]);
+
+static void
+fill_colors(vector<Color> &colors)
+{
+	test::fill_random_colors(colors);
+	// special alpha values
+	for(size_t i = 0; i + 8 < colors.size(); i += 8) {
+		colors[i].set_a(0.f);
+		colors[i + 1].set_a(1.f);
+	}
+}
+
+static bool
+same(float a, float b)
+	{ return a == b || (std::isnan(a) && std::isnan(b)); }
+
+static bool
+test_blend(PixelFormatSimd level)
+{
+	const int count = 1000;
+	vector<Color> src(count), dst(count);
+	fill_colors(src);
+	fill_colors(dst);
+	// opaque destination is a common case for fast paths
+	for(int i = 0; i < count; i += 3)
+		dst[i].set_a(1.f);
+
+	set_pixelformat_simd(level);
+	for(int m = 0; m < Color::BLEND_END; ++m) {
+		Color::BlendMethod method = (Color::BlendMethod)m;
+		for(int j = 0; j < amounts_count; ++j) {
+			float amount = amounts[j];
+			vector<Color> actual(dst);
+			Blend::blend_row(&actual.front(), &src.front(), count, amount, method);
+
+			for(int i = 0; i < count; ++i) {
+				Color expected = Color::blend(src[i], dst[i], amount, method);
+				const Color &a = actual[i];
+				if ( !same(expected.get_r(), a.get_r())
+				  || !same(expected.get_g(), a.get_g())
+				  || !same(expected.get_b(), a.get_b())
+				  || !same(expected.get_a(), a.get_a()) )
+				{
+					cerr << "blend: " << test::simd_name(level)
+						 << " result differs from Color::blend(), method " << m
+						 << ", amount " << amount << ", pixel " << i << endl;
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+static void
+benchmark(PixelFormatSimd level)
+{
+	const int width = 2048, height = 512;
+	const double megapixels = double(width)*height/1e6;
+	const Color::BlendMethod methods[] = {
+		Color::BLEND_COMPOSITE, Color::BLEND_STRAIGHT, Color::BLEND_ONTO,
+		Color::BLEND_ADD, Color::BLEND_MULTIPLY, Color::BLEND_SCREEN };
+	const char *method_names[] = { "composite", "straight", "onto", "add", "multiply", "screen" };
+
+	vector<Color> src(width*height), dst(width*height);
+	fill_colors(src);
+	fill_colors(dst);
+
+	set_pixelformat_simd(level);
+	for(int m = 0; m < (int)(sizeof(methods)/sizeof(methods[0])); ++m) {
+		for(int j = 0; j < 2; ++j) {
+			chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+			for(int y = 0; y < height; ++y)
+				Blend::blend_row(&dst[y*width], &src[y*width], width, amounts[j], methods[m]);
+			double kernel = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+			begin = chrono::steady_clock::now();
+			for(int i = 0; i < width*height; ++i)
+				dst[i] = Color::blend(src[i], dst[i], amounts[j], methods[m]);
+			double scalar = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+			cout << "  " << test::simd_name(level) << ", " << method_names[m] << ", amount " << amounts[j]
+				 << ": kernel " << megapixels/kernel << " Mpx/s"
+				 << ", Color::blend " << megapixels/scalar << " Mpx/s" << endl;
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int failures = 0;
+
+	const PixelFormatSimd supported = test::get_supported_simd();
+
+	for(int level = PF_SIMD_NONE; level <= supported; ++level) {
+		srand(0);
+		failures += test_blend((PixelFormatSimd)level);
+	}
+
+	if (test::is_benchmark_requested(argc, argv)) {
+		cout << "throughput, megapixels per second:" << endl;
+		for(int level = PF_SIMD_NONE; level <= std::min(supported, PF_SIMD_SSE2); ++level)
+			benchmark((PixelFormatSimd)level);
+	}
+
+	return failures;
+}
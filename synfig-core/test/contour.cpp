@@ -0,0 +1,359 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file contour.cpp
+**	\brief Test and benchmark of contour rasterizers
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+#include <synfig/surface.h>
+#include <synfig/rendering/primitive/contour.h>
+#include <synfig/rendering/primitive/edgetable.h>
+#include <synfig/rendering/software/function/contour.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace synfig;
+using namespace synfig::rendering;
+
+typedef software::Contour SWContour;
+
+static void
+add_circle(rendering::Contour &contour, const Vector &center, Real radius, bool reverse)
+{
+	const int segments = 8;
+	const Real k = 4.0/3.0*tan(M_PI/(2.0*segments));
+	Real s = reverse ? -1.0 : 1.0;
+	contour.move_to(center + Vector(radius, 0.0));
+	for(int i = 1; i <= segments; ++i) {
+		Real a0 = s*2.0*M_PI*(i - 1)/segments;
+		Real a1 = s*2.0*M_PI*i/segments;
+		Vector p0(cos(a0), sin(a0)), p1(cos(a1), sin(a1));
+		contour.cubic_to(
+			center + p1*radius,
+			center + (p0 + p0.perp()*(s*k))*radius,
+			center + (p1 - p1.perp()*(s*k))*radius );
+	}
+	contour.close();
+}
+
+//! Similar to output of Advanced Outline: both sides of a long wavy stroke
+//! of varying width, with self-intersections and a lot of short segments
+static void
+add_outline(rendering::Contour &contour, int points, Real size, Real turns = 6.0)
+{
+	vector<Vector> left, right;
+	for(int i = 0; i <= points; ++i) {
+		Real t = Real(i)/points;
+		Real a = t*2.0*turns*M_PI;
+		Vector p(
+			size*(0.5 + 0.4*sin(a*1.3)*cos(a*0.21)),
+			size*(0.5 + 0.4*cos(a*0.7)*sin(a*0.17 + 1.0)) );
+		Vector d(
+			size*0.4*(1.3*cos(a*1.3)*cos(a*0.21) - 0.21*sin(a*1.3)*sin(a*0.21)),
+			size*0.4*(-0.7*sin(a*0.7)*sin(a*0.17 + 1.0) + 0.17*cos(a*0.7)*cos(a*0.17 + 1.0)) );
+		Vector n = d.norm().perp();
+		Real width = size*(0.01 + 0.03*(1.0 + sin(t*97.0)));
+		left.push_back(p + n*width);
+		right.push_back(p - n*width);
+	}
+
+	contour.move_to(left.front());
+	for(int i = 1; i + 1 < (int)left.size(); i += 2)
+		contour.conic_to(left[i + 1], left[i]);
+	for(int i = (int)right.size() - 1; i > 0; i -= 2)
+		contour.conic_to(right[i - 1], right[i]);
+	contour.close();
+}
+
+static Real
+difference(const Surface &a, const Surface &b)
+{
+	Real max_diff = 0;
+	for(int y = 0; y < a.get_h(); ++y)
+		for(int x = 0; x < a.get_w(); ++x) {
+			const Color &ca = a[y][x], &cb = b[y][x];
+			max_diff = max(max_diff, (Real)fabs(ca.get_r() - cb.get_r()));
+			max_diff = max(max_diff, (Real)fabs(ca.get_g() - cb.get_g()));
+			max_diff = max(max_diff, (Real)fabs(ca.get_b() - cb.get_b()));
+			max_diff = max(max_diff, (Real)fabs(ca.get_a() - cb.get_a()));
+		}
+	return max_diff;
+}
+
+static void
+render(
+	Surface &surface,
+	const RectInt &window,
+	const rendering::Contour &contour,
+	const Matrix &matrix,
+	bool accumulation,
+	bool invert,
+	bool antialias,
+	rendering::Contour::WindingStyle winding_style,
+	Color::BlendMethod blend_method )
+{
+	Polyspan polyspan;
+	polyspan.init(window, accumulation);
+	SWContour::build_polyspan(contour.get_chunks(), matrix, polyspan);
+	polyspan.close();
+	polyspan.sort_marks();
+	SWContour::render_polyspan(
+		surface, polyspan, invert, antialias, winding_style,
+		Color(0.25, 0.5, 1.0, 1.0), 0.75, blend_method );
+}
+
+static void
+render_band(
+	Surface &surface,
+	const RectInt &band,
+	const EdgeTable &edge_table,
+	bool accumulation,
+	bool invert )
+{
+	Polyspan polyspan;
+	polyspan.init(band, accumulation);
+	edge_table.rasterize(polyspan);
+	polyspan.sort_marks();
+	SWContour::render_polyspan(
+		surface, polyspan, invert, true, rendering::Contour::WINDING_NON_ZERO,
+		Color(0.25, 0.5, 1.0, 1.0), 0.75, Color::BLEND_COMPOSITE );
+}
+
+static void
+make_test_contour(rendering::Contour &contour)
+{
+	add_circle(contour, Vector(40.0, 40.0), 30.0, false);
+	add_circle(contour, Vector(40.0, 40.0), 12.0, true);
+	add_circle(contour, Vector(60.0, 45.0), 20.0, false);
+	add_outline(contour, 400, 100.0);
+}
+
+static bool
+test_rasterizers()
+{
+	rendering::Contour contour;
+	make_test_contour(contour);
+
+	const int w = 100, h = 90;
+	const RectInt windows[] = {
+		RectInt(0, 0, w, h),
+		RectInt(10, 5, 70, 60),  // contour is clipped
+		RectInt(50, 50, 52, 51)  // tiny window
+	};
+	const Matrix matrices[] = {
+		Matrix(),
+		Matrix().set_translate(-20.0, 13.5)*Matrix().set_scale(1.7, 0.9)
+	};
+	const Color::BlendMethod methods[] = { Color::BLEND_COMPOSITE, Color::BLEND_STRAIGHT };
+
+	for(int i = 0; i < (int)(sizeof(windows)/sizeof(windows[0])); ++i)
+	for(int j = 0; j < (int)(sizeof(matrices)/sizeof(matrices[0])); ++j)
+	for(int k = 0; k < (int)(sizeof(methods)/sizeof(methods[0])); ++k)
+	for(int flags = 0; flags < 8; ++flags) {
+		bool invert = flags & 1;
+		bool antialias = flags & 2;
+		rendering::Contour::WindingStyle winding_style = flags & 4
+			? rendering::Contour::WINDING_EVEN_ODD
+			: rendering::Contour::WINDING_NON_ZERO;
+
+		Surface sorted(w, h), accumulated(w, h);
+		sorted.fill(Color(0.0, 0.0, 0.0, 0.5));
+		accumulated.fill(Color(0.0, 0.0, 0.0, 0.5));
+		render(sorted, windows[i], contour, matrices[j], false, invert, antialias, winding_style, methods[k]);
+		render(accumulated, windows[i], contour, matrices[j], true, invert, antialias, winding_style, methods[k]);
+
+		// sums are calculated in different order and precision
+		Real diff = difference(sorted, accumulated);
+		if (diff > 1e-3) {
+			cerr << "contour: accumulation rasterizer differs from sorted one by " << diff
+				 << ", window " << i << ", matrix " << j << ", method " << k
+				 << ", invert " << invert << ", antialias " << antialias
+				 << ", winding " << winding_style << endl;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool
+test_edge_table()
+{
+	rendering::Contour contour;
+	make_test_contour(contour);
+
+	const int w = 100, h = 90;
+	const RectInt windows[] = {
+		RectInt(0, 0, w, h),
+		RectInt(10, 5, 70, 60)
+	};
+	const int band_heights[] = { 1, 7, 16, 33 };
+	const Matrix matrix = Matrix().set_translate(-20.0, 13.5)*Matrix().set_scale(1.7, 0.9);
+
+	// table is built once for whole surface, as TaskContourSW does
+	EdgeTable edge_table;
+	edge_table.build(contour.get_chunks(), matrix, RectInt(0, 0, w, h));
+
+	for(int i = 0; i < (int)(sizeof(windows)/sizeof(windows[0])); ++i)
+	for(int j = 0; j < (int)(sizeof(band_heights)/sizeof(band_heights[0])); ++j)
+	for(int flags = 0; flags < 4; ++flags) {
+		bool accumulation = flags & 1;
+		bool invert = flags & 2;
+		const RectInt &window = windows[i];
+
+		Surface whole(w, h), bands(w, h);
+		whole.fill(Color(0.0, 0.0, 0.0, 0.5));
+		bands.fill(Color(0.0, 0.0, 0.0, 0.5));
+		render(whole, window, contour, matrix, accumulation, invert, true,
+			rendering::Contour::WINDING_NON_ZERO, Color::BLEND_COMPOSITE );
+		for(int y = window.miny; y < window.maxy; y += band_heights[j]) {
+			RectInt band(window.minx, y, window.maxx, min(window.maxy, y + band_heights[j]));
+			render_band(bands, band, edge_table, accumulation, invert);
+		}
+
+		Real diff = difference(whole, bands);
+		if (diff > 1e-3) {
+			cerr << "contour: rasterization by bands differs from whole contour by " << diff
+				 << ", window " << i << ", band height " << band_heights[j]
+				 << ", accumulation " << accumulation << ", invert " << invert << endl;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void
+benchmark_bands(int points, Real turns)
+{
+	const int size = 2048;
+	const int repeats = 5;
+	const int band_counts[] = { 1, 4, 16 };
+	const Real detail = 1.0;
+
+	rendering::Contour contour;
+	add_outline(contour, points, (Real)size, turns);
+	Surface surface(size, size);
+	RectInt window(0, 0, size, size);
+
+	cout << "  outline of " << points << " points, " << turns << " turns, "
+		 << size << "x" << size << ", each band in own thread:" << endl;
+
+	for(int i = 0; i < (int)(sizeof(band_counts)/sizeof(band_counts[0])); ++i) {
+		const int bands = band_counts[i];
+		double seconds[2] = {};
+		for(int mode = 0; mode < 2; ++mode) {
+			for(int j = 0; j < repeats; ++j) {
+				chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+
+				EdgeTable edge_table;
+				if (mode)
+					edge_table.build(contour.get_chunks(), Matrix(), window, detail);
+
+				vector<thread> workers;
+				for(int k = 0; k < bands; ++k) {
+					RectInt band(0, size*k/bands, size, size*(k + 1)/bands);
+					workers.push_back(thread([&, band]() {
+						if (mode) {
+							render_band(surface, band, edge_table, true, false);
+						} else {
+							// each band walks the whole contour
+							Polyspan polyspan;
+							polyspan.init(band, true);
+							SWContour::build_polyspan(contour.get_chunks(), Matrix(), polyspan, detail);
+							polyspan.close();
+							polyspan.sort_marks();
+							SWContour::render_polyspan(
+								surface, polyspan, false, true, rendering::Contour::WINDING_NON_ZERO,
+								Color(0.25, 0.5, 1.0, 1.0), 0.75, Color::BLEND_COMPOSITE );
+						}
+					}));
+				}
+				for(vector<thread>::iterator k = workers.begin(); k != workers.end(); ++k)
+					k->join();
+
+				seconds[mode] += chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+			}
+		}
+		cout << "    " << bands << " bands: contour in each band " << seconds[0]/repeats*1000.0 << " ms"
+			 << ", shared edge table " << seconds[1]/repeats*1000.0 << " ms" << endl;
+	}
+}
+
+static void
+benchmark()
+{
+	const int size = 1024;
+	const int repeats = 10;
+	const int points[] = { 1000, 100000, 100000 };
+	const Real turns[] = { 6.0, 6.0, 200.0 };
+	const char *rasterizer_names[] = { "sorted", "accumulation" };
+
+	for(int i = 0; i < (int)(sizeof(points)/sizeof(points[0])); ++i) {
+		rendering::Contour contour;
+		add_outline(contour, points[i], (Real)size, turns[i]);
+		cout << "  outline of " << points[i] << " points, " << turns[i] << " turns, "
+			 << size << "x" << size << ":" << endl;
+
+		Surface surface(size, size);
+		for(int mode = 0; mode < 2; ++mode) {
+			double build = 0.0, fill = 0.0;
+			for(int j = 0; j < repeats; ++j) {
+				chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+				Polyspan polyspan;
+				polyspan.init(RectInt(0, 0, size, size), mode != 0);
+				SWContour::build_polyspan(contour.get_chunks(), Matrix(), polyspan, 1.0);
+				polyspan.close();
+				chrono::steady_clock::time_point built = chrono::steady_clock::now();
+				polyspan.sort_marks();
+				SWContour::render_polyspan(
+					surface, polyspan, false, true, rendering::Contour::WINDING_NON_ZERO,
+					Color(0.25, 0.5, 1.0, 1.0), 1.0, Color::BLEND_COMPOSITE );
+				chrono::steady_clock::time_point end = chrono::steady_clock::now();
+				build += chrono::duration<double>(built - begin).count();
+				fill += chrono::duration<double>(end - built).count();
+			}
+			cout << "    " << rasterizer_names[mode]
+				 << ": build " << build/repeats*1000.0 << " ms"
+				 << ", sort and fill " << fill/repeats*1000.0 << " ms" << endl;
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int failures = 0;
+
+	failures += test_rasterizers();
+	failures += test_edge_table();
+
+	// benchmark only when requested, it is too slow for regular test run
+	if (argc > 1 && !strcmp(argv[1], "--benchmark")) {
+		cout << "time to rasterize contour:" << endl;
+		benchmark();
+		benchmark_bands(1000000, 6.0);
+		benchmark_bands(100000, 200.0);
+	}
+
+	return failures;
+}
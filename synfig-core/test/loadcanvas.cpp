@@ -0,0 +1,374 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file test/loadcanvas.cpp
+**	\brief Test and benchmark for loading of large documents
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include <ETL/stringf>
+
+#include <synfig/canvas.h>
+#include <synfig/filesystemnative.h>
+#include <synfig/general.h>
+#include <synfig/loadcanvas.h>
+#include <synfig/main.h>
+#include <synfig/savecanvas.h>
+#include <synfig/zstreambuf.h>
+#include <synfig/context.h>
+#include <synfig/layers/layer_pastecanvas.h>
+
+#endif
+
+/* === U S I N G =========================================================== */
+
+using namespace std;
+using namespace etl;
+using namespace synfig;
+
+/* === M A C R O S ========================================================= */
+
+#define GROUPS_COUNT    10
+#define LAYERS_COUNT    20
+#define WAYPOINTS_COUNT 100
+#define FILENAME        "loadcanvas-benchmark.sifz"
+#define LAZY_FILENAME     "loadcanvas-lazy.sif"
+#define EXTERNAL_FILENAME "loadcanvas-external.sif"
+#define SWITCH_FILENAME   "loadcanvas-switch.sif"
+#define ACTIVE_FILENAME   "loadcanvas-active.sif"
+#define INACTIVE_FILENAME "loadcanvas-inactive.sif"
+#define FIRST_FILENAME    "loadcanvas-first.sif"
+#define SECOND_FILENAME   "loadcanvas-second.sif"
+
+/* === P R O C E D U R E S ================================================= */
+
+//! Writes document with groups of solid color layers with baked animation of amount
+void write_document(const String &filename, int groups, int layers, int waypoints)
+{
+	FileSystem::WriteStream::Handle stream =
+		FileSystemNative::instance()->get_write_stream(filename);
+	if (!stream)
+		throw runtime_error("cannot write file " + filename);
+	stream = FileSystem::WriteStream::Handle(new ZWriteStream(stream));
+
+	srand(0);
+	*stream << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	        << "<canvas version=\"1.2\" width=\"480\" height=\"270\" xres=\"2834.645669\" yres=\"2834.645669\""
+	           " gamma-r=\"1.0\" gamma-g=\"1.0\" gamma-b=\"1.0\""
+	           " view-box=\"-4.0 2.25 4.0 -2.25\" antialias=\"1\" fps=\"24.000\""
+	           " begin-time=\"0f\" end-time=\"5s\" bgcolor=\"0.5 0.5 0.5 1.0\">\n"
+	        << "  <name>Benchmark</name>\n"
+	        << "  <defs>\n"
+	        << "    <real id=\"amount\" value=\"0.5000000000\"/>\n"
+	        << "  </defs>\n";
+	for(int g = 0; g < groups; ++g) {
+		*stream << "  <layer type=\"group\" active=\"true\" version=\"0.3\" desc=\"group " << g << "\">\n"
+		        << "    <param name=\"amount\" use=\"amount\"/>\n"
+		        << "    <param name=\"canvas\">\n"
+		        << "      <canvas>\n";
+		for(int l = 0; l < layers; ++l) {
+			*stream << "        <layer type=\"SolidColor\" active=\"true\" version=\"0.1\" desc=\"layer " << l << "\">\n"
+			        << "          <param name=\"amount\">\n"
+			        << "            <animated type=\"real\">\n";
+			for(int w = 0; w < waypoints; ++w)
+				*stream << strprintf(
+					"              <waypoint time=\"%.8fs\" before=\"linear\" after=\"linear\">\n"
+					"                <real value=\"%.10f\"/>\n"
+					"              </waypoint>\n",
+					w/24.0, (rand() % 1000)/1000.0 );
+			*stream << "            </animated>\n"
+			        << "          </param>\n"
+			        << "          <param name=\"color\">\n"
+			        << strprintf(
+			           "            <color><r>%f</r><g>%f</g><b>%f</b><a>1.000000</a></color>\n",
+			           (rand() % 1000)/1000.0, (rand() % 1000)/1000.0, (rand() % 1000)/1000.0 )
+			        << "          </param>\n"
+			        << "        </layer>\n";
+		}
+		*stream << "      </canvas>\n"
+		        << "    </param>\n"
+		        << "  </layer>\n";
+	}
+	*stream << "</canvas>\n";
+}
+
+//! Loads document and returns it saved to string
+int load(const String &filename, bool streaming, String &document)
+{
+	CanvasParser parser;
+	parser.set_allow_errors(true);
+	parser.set_streaming(streaming);
+
+	String errors;
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	Canvas::Handle canvas = parser.parse_from_file_as(
+		FileSystemNative::instance()->get_identifier(filename),
+		absolute_path(filename),
+		errors );
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+	if (!canvas || parser.error_count()) {
+		error("%s loading failed: %s%s", streaming ? "streaming" : "dom",
+			errors.c_str(), parser.get_errors_text().c_str());
+		return 1;
+	}
+
+	info("%s loading: %.1f ms", streaming ? "streaming" : "dom",
+		chrono::duration<double, milli>(end - begin).count());
+	document = canvas_to_string(canvas);
+	return 0;
+}
+
+//! Writes small document with specified layers
+void write_text(const String &filename, const String &layers)
+{
+	FileSystem::WriteStream::Handle stream =
+		FileSystemNative::instance()->get_write_stream(filename);
+	if (!stream)
+		throw runtime_error("cannot write file " + filename);
+	*stream << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	        << "<canvas version=\"1.2\" width=\"480\" height=\"270\" view-box=\"-4.0 2.25 4.0 -2.25\">\n"
+	        << layers
+	        << "</canvas>\n";
+}
+
+//! Checks that canvas of other file is loaded only when group layer needs it
+int test_lazy_external()
+{
+	write_text(EXTERNAL_FILENAME,
+		"  <layer type=\"SolidColor\" active=\"true\" version=\"0.1\"/>\n" );
+	write_text(LAZY_FILENAME,
+		"  <layer type=\"group\" active=\"true\" version=\"0.3\">\n"
+		"    <param name=\"canvas\" use=\"" EXTERNAL_FILENAME "#\"/>\n"
+		"  </layer>\n" );
+
+	int failures = 0;
+	{
+		CanvasParser parser;
+		String errors;
+		Canvas::Handle canvas = parser.parse_from_file_as(
+			FileSystemNative::instance()->get_identifier(LAZY_FILENAME),
+			absolute_path(LAZY_FILENAME),
+			errors );
+		Layer_PasteCanvas::Handle layer = canvas && !canvas->empty()
+		                                ? Layer_PasteCanvas::Handle::cast_dynamic(canvas->front())
+		                                : Layer_PasteCanvas::Handle();
+		if (!layer) {
+			error("lazy loading: cannot load document: %s", errors.c_str());
+			++failures;
+		} else
+		if (layer->get_sub_canvas_id().empty() || get_open_canvas_map().count(absolute_path(EXTERNAL_FILENAME))) {
+			error("lazy loading: external canvas loaded while parsing");
+			++failures;
+		} else {
+			// these may be called from other threads, so they must not load it
+			canvas->build_rendering_task(ContextParams());
+			canvas->get_context(ContextParams()).get_full_bounding_rect();
+			layer->get_param("canvas");
+			if (layer->get_sub_canvas_id().empty() || get_open_canvas_map().count(absolute_path(EXTERNAL_FILENAME))) {
+				error("lazy loading: external canvas loaded outside of set_time()");
+				++failures;
+			}
+
+			canvas->set_time(0);
+			if (!layer->get_sub_canvas_id().empty() || !layer->get_sub_canvas() || layer->get_sub_canvas()->empty()) {
+				error("lazy loading: external canvas is not loaded by set_time()");
+				++failures;
+			}
+		}
+	}
+
+	FileSystemNative::instance()->file_remove(LAZY_FILENAME);
+	FileSystemNative::instance()->file_remove(EXTERNAL_FILENAME);
+	return failures;
+}
+
+//! Checks that Switch layer doesn't load external canvases of inactive alternatives
+int test_switch_external()
+{
+	write_text(ACTIVE_FILENAME,
+		"  <layer type=\"SolidColor\" active=\"true\" version=\"0.1\"/>\n" );
+	write_text(INACTIVE_FILENAME,
+		"  <layer type=\"SolidColor\" active=\"true\" version=\"0.1\"/>\n" );
+	write_text(SWITCH_FILENAME,
+		"  <layer type=\"switch\" active=\"true\" version=\"0.0\">\n"
+		"    <param name=\"layer_name\"><string>active</string></param>\n"
+		"    <param name=\"canvas\">\n"
+		"      <canvas>\n"
+		"        <layer type=\"group\" active=\"true\" version=\"0.3\" desc=\"inactive\">\n"
+		"          <param name=\"canvas\" use=\"" INACTIVE_FILENAME "#\"/>\n"
+		"        </layer>\n"
+		"        <layer type=\"group\" active=\"true\" version=\"0.3\" desc=\"active\">\n"
+		"          <param name=\"canvas\" use=\"" ACTIVE_FILENAME "#\"/>\n"
+		"        </layer>\n"
+		"      </canvas>\n"
+		"    </param>\n"
+		"  </layer>\n" );
+
+	int failures = 0;
+	{
+		CanvasParser parser;
+		String errors;
+		Canvas::Handle canvas = parser.parse_from_file_as(
+			FileSystemNative::instance()->get_identifier(SWITCH_FILENAME),
+			absolute_path(SWITCH_FILENAME),
+			errors );
+		if (!canvas || canvas->empty()) {
+			error("switch: cannot load document: %s", errors.c_str());
+			++failures;
+		} else {
+			// everything which is needed to render a frame
+			canvas->set_time(0);
+			canvas->load_resources(0);
+			canvas->build_rendering_task(ContextParams());
+			canvas->get_context(ContextParams()).get_full_bounding_rect();
+
+			if (!get_open_canvas_map().count(absolute_path(ACTIVE_FILENAME))) {
+				error("switch: external canvas of the current layer is not loaded");
+				++failures;
+			}
+			if (get_open_canvas_map().count(absolute_path(INACTIVE_FILENAME))) {
+				error("switch: external canvas of inactive layer is loaded");
+				++failures;
+			}
+		}
+	}
+
+	FileSystemNative::instance()->file_remove(SWITCH_FILENAME);
+	FileSystemNative::instance()->file_remove(ACTIVE_FILENAME);
+	FileSystemNative::instance()->file_remove(INACTIVE_FILENAME);
+	return failures;
+}
+
+//! Loads document with single group layer and returns canvas of the group
+Canvas::Handle load_group_canvas(const String &filename)
+{
+	CanvasParser parser;
+	String errors;
+	Canvas::Handle canvas = parser.parse_from_file_as(
+		FileSystemNative::instance()->get_identifier(filename),
+		absolute_path(filename),
+		errors );
+	Layer_PasteCanvas::Handle layer = canvas && !canvas->empty()
+	                                ? Layer_PasteCanvas::Handle::cast_dynamic(canvas->front())
+	                                : Layer_PasteCanvas::Handle();
+	if (!layer) {
+		error("external cache: cannot load document %s: %s", filename.c_str(), errors.c_str());
+		return Canvas::Handle();
+	}
+	layer->load_sub_canvas();
+	return layer->get_sub_canvas();
+}
+
+//! Checks that cached external canvas is reused by next document of batch
+int test_external_cache()
+{
+	write_text(EXTERNAL_FILENAME,
+		"  <layer type=\"SolidColor\" active=\"true\" version=\"0.1\"/>\n" );
+	const String layers =
+		"  <layer type=\"group\" active=\"true\" version=\"0.3\">\n"
+		"    <param name=\"canvas\" use=\"" EXTERNAL_FILENAME "#\"/>\n"
+		"  </layer>\n";
+	write_text(FIRST_FILENAME, layers);
+	write_text(SECOND_FILENAME, layers);
+
+	int failures = 0;
+	Canvas::set_external_cache_enabled(true);
+
+	// only address is kept, the first document is closed before the second one is loaded
+	const Canvas *first = load_group_canvas(FIRST_FILENAME).get();
+	if (!first) {
+		error("external cache: external canvas is not loaded by the first document");
+		++failures;
+	} else
+	if (!get_open_canvas_map().count(absolute_path(EXTERNAL_FILENAME))) {
+		error("external cache: external canvas is closed with the first document");
+		++failures;
+	} else
+	if (load_group_canvas(SECOND_FILENAME).get() != first) {
+		error("external cache: second document loaded external canvas again");
+		++failures;
+	}
+
+	Canvas::set_external_cache_enabled(false);
+	Canvas::clear_external_cache();
+	if (get_open_canvas_map().count(absolute_path(EXTERNAL_FILENAME))) {
+		error("external cache: external canvas is not released by clear_external_cache()");
+		++failures;
+	}
+
+	FileSystemNative::instance()->file_remove(FIRST_FILENAME);
+	FileSystemNative::instance()->file_remove(SECOND_FILENAME);
+	FileSystemNative::instance()->file_remove(EXTERNAL_FILENAME);
+	return failures;
+}
+
+/* === E N T R Y P O I N T ================================================= */
+
+int main(int argc, char **argv)
+{
+	// pass scale factor to benchmark larger documents
+	int scale = argc > 1 ? max(1, atoi(argv[1])) : 1;
+
+	int failures = 0;
+	try {
+		Main synfig_main(dirname(argv[0]));
+
+		write_document(FILENAME, GROUPS_COUNT*scale, LAYERS_COUNT, WAYPOINTS_COUNT);
+		info("%d layers, %d waypoints",
+			GROUPS_COUNT*scale*(LAYERS_COUNT + 1), GROUPS_COUNT*scale*LAYERS_COUNT*WAYPOINTS_COUNT);
+
+		// each canvas is released before next loading,
+		// otherwise the same file will be taken from the map of open canvases
+		String dom, streamed;
+		failures += load(FILENAME, false, dom);
+		failures += load(FILENAME, true, streamed);
+		if (!failures && dom != streamed) {
+			error("document loaded in streaming mode differs from the one loaded by DOM parser");
+			++failures;
+		}
+
+		FileSystemNative::instance()->file_remove(FILENAME);
+
+		failures += test_lazy_external();
+		failures += test_switch_external();
+		failures += test_external_cache();
+	} catch (...) {
+		error("Some exception has been thrown.");
+		++failures;
+	}
+
+	if (failures)
+		error("Test finished with %i errors", failures);
+	else
+		info("Success");
+
+	return failures ? 1 : 0;
+}
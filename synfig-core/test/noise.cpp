@@ -0,0 +1,87 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file noise.cpp
+**	\brief Test of vectorized sampling of RandomNoise
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+#include <synfig/color/pixelformat.h>
+#include <modules/mod_noise/random_noise.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "simd.h"
+
+using namespace std;
+using namespace synfig;
+
+//! Times of frames: integer (flat interpolation), fractional and negative
+static const float times[] = { 0.f, 3.f, 0.25f, 2.75f, -1.5f };
+static const int times_count = sizeof(times)/sizeof(times[0]);
+
+template<RandomNoise::SmoothType smooth>
+static bool
+test_sample_row(PixelFormatSimd level, const char *name)
+{
+	// count is not multiple of four, so the scalar tail is checked too
+	const int count = 1003;
+	vector<float> x(count), y(count);
+	for(int i = 0; i < count; ++i) {
+		// negative and integer coordinates check rounding to lower integer
+		x[i] = i % 10 ? test::random_channel()*200.f - 100.f : float(i/10 - 50);
+		y[i] = i % 7  ? test::random_channel()*200.f - 100.f : float(i/7 - 70);
+	}
+
+	RandomNoise random;
+	random.set_seed(12345);
+
+	set_pixelformat_simd(level);
+	vector<float> actual(count);
+	for(int j = 0; j < times_count; ++j) {
+		for(int loop = 0; loop <= 3; loop += 3) {
+			random.sample_row<smooth>(&actual.front(), count, 7, &x.front(), &y.front(), times[j], loop);
+			for(int i = 0; i < count; ++i) {
+				if (actual[i] != random.sample<smooth>(7, x[i], y[i], times[j], loop)) {
+					cerr << "noise: " << test::simd_name(level) << " " << name
+						 << " result differs from sample(), time " << times[j]
+						 << ", loop " << loop << ", point " << i << endl;
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+int main()
+{
+	int failures = 0;
+
+	const PixelFormatSimd supported = test::get_supported_simd();
+
+	for(int level = PF_SIMD_NONE; level <= std::min(supported, PF_SIMD_SSE2); ++level) {
+		srand(0);
+		failures += test_sample_row<RandomNoise::SMOOTH_LINEAR>((PixelFormatSimd)level, "linear");
+		failures += test_sample_row<RandomNoise::SMOOTH_COSINE>((PixelFormatSimd)level, "cosine");
+		failures += test_sample_row<RandomNoise::SMOOTH_CUBIC>((PixelFormatSimd)level, "cubic");
+	}
+
+	return failures;
+}
@@ -0,0 +1,166 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file optimizersplit.cpp
+**	\brief Test of splitting heavy rendering tasks into strips
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+#include <synfig/rendering/taskcost.h>
+#include <synfig/rendering/common/optimizer/optimizersplit.h>
+#include <synfig/rendering/common/task/taskpixelprocessor.h>
+
+#include <iostream>
+
+using namespace std;
+using namespace synfig;
+using namespace synfig::rendering;
+
+//! Task with unmeasured cost, so its estimation depends on area only
+static Task::Handle
+create_task(const SurfaceResource::Handle &surface, const RectInt &rect)
+{
+	TaskPixelGamma::Handle task(new TaskPixelGamma());
+	task->target_surface = surface;
+	task->source_rect = Rect(0.0, 0.0, 1.0, 1.0);
+	task->target_rect = rect;
+	return task;
+}
+
+static SurfaceResource::Handle
+create_surface(int width, int height)
+{
+	SurfaceResource::Handle surface(new SurfaceResource());
+	surface->create(width, height);
+	return surface;
+}
+
+//! Area (in pixels) where task can be split to strips of this count
+static int
+pixels_for_pieces(int count)
+	{ return (int)(count*OptimizerSplit::min_piece_cost/TaskCost::default_pixel_cost) + 1; }
+
+static Task::List
+run_split(const Task::List &orig, int threads)
+{
+	Task::List list(orig);
+	OptimizerSplit optimizer(threads);
+	Optimizer::RunParams params(Optimizer::CATEGORY_ALL, list);
+	optimizer.run(params);
+	return list;
+}
+
+//! Checks that strips cover the rect of task without gaps and overlaps
+static bool
+check_strips(const Task::List &list, const RectInt &rect, int count)
+{
+	if ((int)list.size() != count) {
+		cerr << "expected " << count << " strips, got " << list.size() << endl;
+		return true;
+	}
+	int y = rect.miny;
+	for(Task::List::const_iterator i = list.begin(); i != list.end(); ++i) {
+		const RectInt &r = (*i)->target_rect;
+		if (r.minx != rect.minx || r.maxx != rect.maxx || r.miny != y || r.maxy <= r.miny) {
+			cerr << "strip " << (i - list.begin()) << " doesn't continue the previous one" << endl;
+			return true;
+		}
+		if (r.get_height() < OptimizerSplit::min_piece_rows) {
+			cerr << "strip " << (i - list.begin()) << " is lower than the minimal height" << endl;
+			return true;
+		}
+		y = r.maxy;
+	}
+	if (y != rect.maxy) {
+		cerr << "strips don't cover the whole rect" << endl;
+		return true;
+	}
+	return false;
+}
+
+static int
+test_split()
+{
+	int failures = 0;
+	const int size = 1000;
+	RectInt rect(0, 0, size, size);
+	Task::List list;
+
+	// heavy task is split by number of threads
+	list.push_back(create_task(create_surface(size, size), rect));
+	if (check_strips(run_split(list, 4), rect, 4))
+		{ cerr << "heavy task, 4 threads" << endl; ++failures; }
+
+	// nothing to do with single thread
+	if (check_strips(run_split(list, 1), rect, 1))
+		{ cerr << "heavy task, single thread" << endl; ++failures; }
+
+	// strips must not be faster than min_piece_cost
+	int width = pixels_for_pieces(3)/size + 1;
+	RectInt light_rect(0, 0, width, size);
+	list.clear();
+	list.push_back(create_task(create_surface(width, size), light_rect));
+	if (check_strips(run_split(list, 16), light_rect, 3))
+		{ cerr << "light task, 16 threads" << endl; ++failures; }
+
+	// strips must not be lower than min_piece_rows
+	int rows = 2*OptimizerSplit::min_piece_rows + 1;
+	RectInt wide_rect(0, 0, pixels_for_pieces(16)/rows, rows);
+	list.clear();
+	list.push_back(create_task(create_surface(wide_rect.maxx, rows), wide_rect));
+	if (check_strips(run_split(list, 16), wide_rect, 2))
+		{ cerr << "low task, 16 threads" << endl; ++failures; }
+
+	// small task is not split at all
+	RectInt small_rect(0, 0, 10, 10);
+	list.clear();
+	list.push_back(create_task(create_surface(10, 10), small_rect));
+	if (check_strips(run_split(list, 4), small_rect, 1))
+		{ cerr << "small task, 4 threads" << endl; ++failures; }
+
+	// independent tasks already load all threads
+	list.clear();
+	for(int i = 0; i < 4; ++i)
+		list.push_back(create_task(create_surface(size, size), rect));
+	Task::List result = run_split(list, 4);
+	if (result.size() != list.size())
+		{ cerr << "4 independent tasks, 4 threads: tasks were split" << endl; ++failures; }
+
+	// chain of tasks on the same surface is a critical path, so it gets more threads
+	// than independent task of the same cost
+	SurfaceResource::Handle surface = create_surface(size, size);
+	list.clear();
+	list.push_back(create_task(surface, rect));
+	list.push_back(create_task(surface, rect));
+	list.push_back(create_task(create_surface(size, size), rect));
+	result = run_split(list, 8);
+	int chain_strips = 0, other_strips = 0;
+	for(Task::List::const_iterator i = result.begin(); i != result.end(); ++i)
+		++((*i)->target_surface == surface ? chain_strips : other_strips);
+	if (chain_strips <= other_strips || other_strips < 2)
+		{ cerr << "chain and independent task, 8 threads: " << chain_strips << " and " << other_strips << " strips" << endl; ++failures; }
+
+	return failures;
+}
+
+int main()
+{
+	int failures = test_split();
+	if (failures)
+		cerr << "Test finished with " << failures << " errors" << endl;
+	return failures ? 1 : 0;
+}
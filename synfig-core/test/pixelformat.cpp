@@ -0,0 +1,188 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file pixelformat.cpp
+**	\brief Test and benchmark of pixel format conversions
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+#include <synfig/color/pixelformat.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "simd.h"
+
+using namespace std;
+using namespace synfig;
+
+static const PixelFormat formats[] = {
+	PF_RGB,
+	PF_BGR,
+	PF_RGB|PF_A,
+	PF_BGR|PF_A,
+	PF_RGB|PF_A_PREMULT,
+	PF_BGR|PF_A_PREMULT,
+	PF_RGB|PF_A_START,
+	PF_GRAY
+};
+static const char *format_names[] = {
+	"RGB",
+	"BGR",
+	"RGBA",
+	"BGRA",
+	"RGBA premulted",
+	"BGRA premulted",
+	"ARGB",
+	"gray"
+};
+static const int formats_count = sizeof(formats)/sizeof(formats[0]);
+
+static void
+fill_colors(vector<Color> &colors)
+{
+	test::fill_random_colors(colors);
+	if (colors.size() > 4) {
+		colors[0] = Color(numeric_limits<float>::quiet_NaN(), 0.5f, 0.5f, numeric_limits<float>::quiet_NaN());
+		colors[1] = Color(numeric_limits<float>::infinity(), -numeric_limits<float>::infinity(), 1.f, 1.f);
+		colors[2] = Color(1.f, 1.f, 1.f, 0.f);
+		colors[3] = Color(0.f, 0.f, 0.f, 1.f);
+	}
+}
+
+static bool
+test_color_to_pixelformat(PixelFormatSimd level, const Gamma *gamma)
+{
+	// odd sizes to check tails of rows
+	const int width = 37, height = 5;
+	const int dst_stride = width*4 + 7;
+	const int src_stride = (width + 3)*sizeof(Color);
+
+	vector<Color> src(src_stride/sizeof(Color)*height);
+	fill_colors(src);
+
+	for(int f = 0; f < formats_count; ++f) {
+		vector<unsigned char> expected(dst_stride*height, 0), actual(dst_stride*height, 0);
+
+		set_pixelformat_simd(PF_SIMD_NONE);
+		unsigned char *expected_end = color_to_pixelformat(
+			&expected.front(), &src.front(), formats[f], gamma, width, height, dst_stride, src_stride );
+
+		set_pixelformat_simd(level);
+		unsigned char *actual_end = color_to_pixelformat(
+			&actual.front(), &src.front(), formats[f], gamma, width, height, dst_stride, src_stride );
+
+		if ( expected_end - &expected.front() != actual_end - &actual.front()
+		  || expected != actual )
+		{
+			cerr << "color_to_pixelformat: " << test::simd_name(level)
+				 << " result differs from scalar, format " << format_names[f]
+				 << (gamma ? " with gamma" : "") << endl;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool
+test_pixelformat_to_color(PixelFormatSimd level)
+{
+	const int width = 37, height = 5;
+	const int src_stride = width*4 + 7;
+	const int dst_stride = (width + 3)*sizeof(Color);
+
+	vector<unsigned char> src(src_stride*height);
+	for(vector<unsigned char>::iterator i = src.begin(); i != src.end(); ++i)
+		*i = (unsigned char)(rand() & 0xff);
+	src[3] = 0; // zero alpha for premulted formats
+
+	for(int f = 0; f < formats_count; ++f) {
+		vector<Color> expected(dst_stride/sizeof(Color)*height), actual(expected.size());
+
+		set_pixelformat_simd(PF_SIMD_NONE);
+		const unsigned char *expected_end = pixelformat_to_color(
+			&expected.front(), &src.front(), formats[f], width, height, dst_stride, src_stride );
+
+		set_pixelformat_simd(level);
+		const unsigned char *actual_end = pixelformat_to_color(
+			&actual.front(), &src.front(), formats[f], width, height, dst_stride, src_stride );
+
+		if ( expected_end != actual_end
+		  || memcmp(&expected.front(), &actual.front(), expected.size()*sizeof(Color)) )
+		{
+			cerr << "pixelformat_to_color: " << test::simd_name(level)
+				 << " result differs from scalar, format " << format_names[f] << endl;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void
+benchmark(PixelFormatSimd level)
+{
+	const int width = 2048, height = 1024, repeats = 10;
+	const double megapixels = double(width)*height*repeats/1e6;
+
+	vector<Color> colors(width*height);
+	fill_colors(colors);
+	vector<unsigned char> buffer(width*height*4);
+
+	set_pixelformat_simd(level);
+	for(int f = 0; f < formats_count - 2; ++f) {
+		chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+		for(int i = 0; i < repeats; ++i)
+			color_to_pixelformat(&buffer.front(), &colors.front(), formats[f], NULL, width, height);
+		double to_pf = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+		begin = chrono::steady_clock::now();
+		for(int i = 0; i < repeats; ++i)
+			pixelformat_to_color(&colors.front(), &buffer.front(), formats[f], width, height);
+		double to_color = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+		cout << "  " << test::simd_name(level) << ", " << format_names[f]
+			 << ": color_to_pixelformat " << megapixels/to_pf << " Mpx/s"
+			 << ", pixelformat_to_color " << megapixels/to_color << " Mpx/s" << endl;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int failures = 0;
+
+	const PixelFormatSimd supported = test::get_supported_simd();
+	const Gamma gamma(2.2f);
+
+	for(int level = PF_SIMD_SSE2; level <= supported; ++level) {
+		srand(0);
+		failures += test_color_to_pixelformat((PixelFormatSimd)level, NULL);
+		failures += test_color_to_pixelformat((PixelFormatSimd)level, &gamma);
+		failures += test_pixelformat_to_color((PixelFormatSimd)level);
+	}
+
+	if (test::is_benchmark_requested(argc, argv)) {
+		cout << "throughput, megapixels per second:" << endl;
+		for(int level = PF_SIMD_NONE; level <= supported; ++level)
+			benchmark((PixelFormatSimd)level);
+	}
+
+	return failures;
+}
@@ -0,0 +1,77 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file simd.h
+**	\brief Helpers for tests and benchmarks of SIMD kernels
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_TEST_SIMD_H
+#define __SYNFIG_TEST_SIMD_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <synfig/color.h>
+#include <synfig/color/pixelformat.h>
+
+/* === M A C R O S ========================================================= */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace test {
+
+//! Names of PixelFormatSimd levels for messages
+inline const char*
+simd_name(synfig::PixelFormatSimd level)
+{
+	static const char *names[] = { "none", "sse2", "avx2" };
+	return level >= synfig::PF_SIMD_NONE && level <= synfig::PF_SIMD_AVX2 ? names[level] : "unknown";
+}
+
+//! Returns the best SIMD level supported by CPU (and not disabled by SYNFIG_DISABLE_SIMD)
+inline synfig::PixelFormatSimd
+get_supported_simd()
+	{ return synfig::set_pixelformat_simd(synfig::PF_SIMD_AVX2); }
+
+//! Random color channel, mostly in range [0, 1], but with some values out of range
+inline float
+random_channel()
+	{ return float(rand())/float(RAND_MAX)*1.4f - 0.2f; }
+
+inline void
+fill_random_colors(std::vector<synfig::Color> &colors)
+{
+	for(std::vector<synfig::Color>::iterator i = colors.begin(); i != colors.end(); ++i)
+		*i = synfig::Color(random_channel(), random_channel(), random_channel(), random_channel());
+}
+
+//! Benchmarks run only when requested, they are too slow for regular test run
+inline bool
+is_benchmark_requested(int argc, char **argv)
+	{ return argc > 1 && !strcmp(argv[1], "--benchmark"); }
+
+} // END of namespace test
+
+/* === E N D =============================================================== */
+
+#endif
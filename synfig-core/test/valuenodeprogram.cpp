@@ -0,0 +1,216 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file test/valuenodeprogram.cpp
+**	\brief Test and benchmark for compiled evaluation of value nodes
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <chrono>
+#include <vector>
+
+#include <synfig/general.h>
+#include <synfig/real.h>
+#include <synfig/type.h>
+#include <synfig/valuenode_program.h>
+#include <synfig/waypoint.h>
+#include <synfig/valuenodes/valuenode_add.h>
+#include <synfig/valuenodes/valuenode_animated.h>
+#include <synfig/valuenodes/valuenode_composite.h>
+#include <synfig/valuenodes/valuenode_const.h>
+#include <synfig/valuenodes/valuenode_cos.h>
+#include <synfig/valuenodes/valuenode_exp.h>
+#include <synfig/valuenodes/valuenode_linear.h>
+#include <synfig/valuenodes/valuenode_reference.h>
+#include <synfig/valuenodes/valuenode_scale.h>
+#include <synfig/valuenodes/valuenode_sine.h>
+#include <synfig/valuenodes/valuenode_subtract.h>
+
+#endif
+
+/* === U S I N G =========================================================== */
+
+using namespace std;
+using namespace etl;
+using namespace synfig;
+
+/* === M A C R O S ========================================================= */
+
+#define PARAMS_COUNT 200
+#define FRAMES_COUNT 240
+#define FPS          24
+
+/* === P R O C E D U R E S ================================================= */
+
+ValueNode::Handle constant(const ValueBase &value)
+	{ return ValueNode::Handle(ValueNode_Const::create(value)); }
+
+template<typename T>
+LinkableValueNode::Handle linkable(T *node, const ValueNode::Handle &a, const ValueNode::Handle &b, const ValueNode::Handle &c = ValueNode::Handle())
+{
+	LinkableValueNode::Handle handle(node);
+	handle->set_link(0, a);
+	handle->set_link(1, b);
+	if (c) handle->set_link(2, c);
+	return handle;
+}
+
+//! Creates parameters like the converted ones of typical animated document,
+//! angle of rotation is exported and shared by all of them
+vector<ValueNode::Handle> create_params()
+{
+	ValueNode::Handle rotation = linkable(ValueNode_Linear::create(Angle::deg(0)),
+		constant(Angle::deg(45)), constant(Angle::deg(10)) );
+
+	vector<ValueNode::Handle> params;
+	for(int i = 0; i < PARAMS_COUNT; ++i) {
+		ValueNode::Handle angle(new ValueNode_Reference(rotation));
+
+		ValueNode_Animated::Handle animated = ValueNode_Animated::create(type_vector);
+		animated->new_waypoint(Time(0), Vector(i, -i));
+		animated->new_waypoint(Time(5), Vector(-i, i));
+
+		LinkableValueNode::Handle position = ValueNode_Composite::create(Vector());
+		position->set_link(0, linkable(ValueNode_Sine::create(Real()), angle, constant(Real(i))));
+		position->set_link(1, linkable(ValueNode_Cos::create(Real()), angle, constant(Real(i))));
+
+		ValueNode::Handle decay = linkable(ValueNode_Exp::create(Real()),
+			linkable(ValueNode_Linear::create(Real()), constant(Real(-0.1)), constant(Real(0.5))),
+			constant(Real(1.0)) );
+
+		params.push_back(linkable(ValueNode_Add::create(Vector()),
+			position,
+			linkable(ValueNode_Scale::create(Vector()), animated, decay),
+			constant(Real(0.5)) ));
+
+		params.push_back(linkable(ValueNode_Subtract::create(Vector()),
+			animated,
+			position,
+			linkable(ValueNode_Linear::create(Real()), constant(Real(0.25)), constant(Real(-1.0))) ));
+
+		LinkableValueNode::Handle color = ValueNode_Composite::create(Color());
+		color->set_link(0, linkable(ValueNode_Sine::create(Real()), angle, constant(Real(1.0))));
+		color->set_link(1, constant(Real(0.5)));
+		color->set_link(2, linkable(ValueNode_Cos::create(Real()), angle, constant(Real(1.0))));
+		color->set_link(3, constant(Real(1.0)));
+		params.push_back(linkable(ValueNode_Scale::create(Color()), color, decay));
+	}
+	return params;
+}
+
+//! Program repeats expressions of nodes, so values must be bit-exact,
+//! operator== of Vector compares with tolerance, so channels are compared here
+bool exactly_equal(const ValueBase &a, const ValueBase &b)
+{
+	if (a.get_type() != b.get_type())
+		return false;
+	if (a.get_type() == type_vector) {
+		Vector va = a.get(Vector()), vb = b.get(Vector());
+		return va[0] == vb[0] && va[1] == vb[1];
+	}
+	if (a.get_type() == type_color) {
+		Color ca = a.get(Color()), cb = b.get(Color());
+		return ca.get_r() == cb.get_r() && ca.get_g() == cb.get_g()
+		    && ca.get_b() == cb.get_b() && ca.get_a() == cb.get_a();
+	}
+	return a == b;
+}
+
+int test_values(ValueNodeProgram &program, const vector<ValueNode::Handle> &params)
+{
+	for(int f = 0; f < FRAMES_COUNT; ++f) {
+		Time t(f/(Real)FPS);
+		program.run(t);
+		for(int i = 0; i < (int)params.size(); ++i) {
+			if (!exactly_equal(program.get(i), (*params[i])(t))) {
+				error("value of param %d at %f differs from evaluated one", i, (double)t);
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+double benchmark_nodes(const vector<ValueNode::Handle> &params)
+{
+	Real sum = 0;
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	for(int f = 0; f < FRAMES_COUNT; ++f)
+		for(vector<ValueNode::Handle>::const_iterator i = params.begin(); i != params.end(); ++i)
+			sum += (**i)(Time(f/(Real)FPS)).get_type() == type_vector ? 1.0 : 0.0;
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	if (sum == 0.123) info("unused"); // prevent optimizing the loop out
+	return chrono::duration<double, micro>(end - begin).count()/FRAMES_COUNT;
+}
+
+double benchmark_program(ValueNodeProgram &program)
+{
+	Real sum = 0;
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	for(int f = 0; f < FRAMES_COUNT; ++f) {
+		program.run(Time(f/(Real)FPS));
+		for(int i = 0; i < program.output_count(); ++i)
+			sum += program.get(i).get_type() == type_vector ? 1.0 : 0.0;
+	}
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	if (sum == 0.123) info("unused"); // prevent optimizing the loop out
+	return chrono::duration<double, micro>(end - begin).count()/FRAMES_COUNT;
+}
+
+/* === E N T R Y P O I N T ================================================= */
+
+int main()
+{
+	Type::subsys_init();
+
+	int failures = 0;
+	try {
+		vector<ValueNode::Handle> params = create_params();
+
+		ValueNodeProgram program;
+		for(vector<ValueNode::Handle>::const_iterator i = params.begin(); i != params.end(); ++i)
+			program.add(*i);
+
+		failures += test_values(program, params);
+
+		info("%d params, %d instructions, %d nodes lowered",
+			(int)params.size(), (int)program.get_instructions().size(), program.get_optimized_count());
+		info("virtual calls: %.3f us per frame", benchmark_nodes(params));
+		info("program:       %.3f us per frame", benchmark_program(program));
+	} catch (...) {
+		error("Some exception has been thrown.");
+		++failures;
+	}
+
+	if (failures)
+		error("Test finished with %i errors", failures);
+	else
+		info("Success");
+
+	Type::subsys_stop();
+
+	return failures ? 1 : 0;
+}